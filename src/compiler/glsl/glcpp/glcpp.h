@@ -246,6 +246,19 @@ glcpp_preprocess(void *ralloc_ctx, const char **shader, char **info_log,
 		 glcpp_extension_iterator extensions, void *state,
 		 struct gl_context *g_ctx);
 
+/* Variant of glcpp_preprocess() for feeding the GLSL compiler.  Output for
+ * a given source and context configuration is memoized, and shaders that
+ * need no preprocessing at all are passed through untouched, so the result
+ * is only equivalent to glcpp's output up to whitespace.
+ */
+int
+glcpp_preprocess_cached(void *ralloc_ctx, const char **shader, char **info_log,
+			glcpp_extension_iterator extensions, void *state,
+			struct gl_context *g_ctx);
+
+void
+glcpp_cache_release(void);
+
 /* Functions for writing to the info log */
 
 void
@@ -24,8 +24,11 @@
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>
+#include "c11/threads.h"
 #include "glcpp.h"
 #include "main/mtypes.h"
+#include "util/list.h"
+#include "util/mesa-sha1.h"
 
 void
 glcpp_error (YYLTYPE *locp, glcpp_parser_t *parser, const char *fmt, ...)
@@ -254,3 +257,275 @@ glcpp_preprocess(void *ralloc_ctx, const char **shader, char **info_log,
 	glcpp_parser_destroy (parser);
 	return errors;
 }
+
+/* Skips a leading "#version <number> [<profile>]" line, which glcpp passes
+ * through to the GLSL lexer unchanged.  Returns the start of the next line,
+ * or the shader itself if it doesn't start with such a line.
+ */
+static const char *
+skip_version_line(const char *shader)
+{
+	const char *c = shader;
+
+	while (*c == ' ' || *c == '\t')
+		c++;
+	if (*c++ != '#')
+		return shader;
+	while (*c == ' ' || *c == '\t')
+		c++;
+	if (strncmp(c, "version", 7) != 0)
+		return shader;
+	c += 7;
+	if (*c != ' ' && *c != '\t')
+		return shader;
+	while (*c == ' ' || *c == '\t')
+		c++;
+
+	/* Octal and hexadecimal versions are errors in glcpp */
+	if (*c < '1' || *c > '9')
+		return shader;
+	while (isdigit((unsigned char) *c))
+		c++;
+	while (*c == ' ' || *c == '\t')
+		c++;
+
+	/* The profile is one of "core", "compatibility" or "es" */
+	if (islower((unsigned char) *c)) {
+		while (islower((unsigned char) *c))
+			c++;
+		while (*c == ' ' || *c == '\t')
+			c++;
+	}
+
+	if (*c == '\r')
+		c++;
+	if (*c != '\n')
+		return shader;
+
+	return c + 1;
+}
+
+/* Returns true if running the preprocessor over the shader could not change
+ * what the GLSL lexer sees: apart from an optional #version line there are
+ * no directives, comments or line continuations, and no identifier that
+ * could name a built-in macro (__LINE__, __VERSION__, GL_ES, the
+ * GL_<extension> defines, ...).  Such a shader only differs from glcpp's
+ * output in whitespace, which the GLSL lexer ignores.
+ */
+static bool
+shader_is_directive_free(const char *shader)
+{
+	bool in_word = false;
+
+	for (const char *c = skip_version_line(shader); *c; c++) {
+		if (*c == '#' || *c == '\\')
+			return false;
+
+		/* Only pass the whitespace the GLSL lexer skips, and leave anything
+		 * else unusual to glcpp's error reporting.
+		 */
+		if (*c == '\r') {
+			if (c[1] != '\n')
+				return false;
+		} else if (*c != '\t' && *c != '\n' &&
+			   !isprint((unsigned char) *c)) {
+			return false;
+		}
+
+		if (*c == '/' && (c[1] == '/' || c[1] == '*'))
+			return false;
+
+		if (isalnum((unsigned char) *c) || *c == '_') {
+			if (!in_word &&
+			    (strncmp(c, "GL_", 3) == 0 ||
+			     strncmp(c, "__", 2) == 0))
+				return false;
+			in_word = true;
+		} else {
+			in_word = false;
+		}
+	}
+
+	return true;
+}
+
+/* Upper bound on the memory used by memoized preprocessor output.  Least
+ * recently used entries are evicted first.
+ */
+#define GLCPP_CACHE_MAX_SIZE (8 * 1024 * 1024)
+
+struct glcpp_cache_entry {
+	struct list_head link;
+	unsigned char key[20];
+	char *output;
+	char *info_log;
+	size_t size;
+};
+
+static struct {
+	mtx_t mutex;
+	void *mem_ctx;
+	struct hash_table *table;
+	struct list_head lru;
+	size_t size;
+} glcpp_cache = {
+	_MTX_INITIALIZER_NP,
+};
+
+static uint32_t
+cache_key_hash(const void *key)
+{
+	uint32_t hash;
+	memcpy(&hash, key, sizeof(hash));
+	return hash;
+}
+
+static bool
+cache_key_equal(const void *a, const void *b)
+{
+	return memcmp(a, b, 20) == 0;
+}
+
+/* Hash everything the output of glcpp depends on besides the source: the
+ * extension defines and supported versions (both derived from the context's
+ * API, version and extension set) and the line continuation setting.
+ */
+static void
+compute_cache_key(unsigned char key[20], const char *shader,
+		  glcpp_extension_iterator extensions, struct gl_context *gl_ctx)
+{
+	struct mesa_sha1 sha1;
+
+	_mesa_sha1_init(&sha1);
+	_mesa_sha1_update(&sha1, &extensions, sizeof(extensions));
+	_mesa_sha1_update(&sha1, &gl_ctx->API, sizeof(gl_ctx->API));
+	_mesa_sha1_update(&sha1, &gl_ctx->Version, sizeof(gl_ctx->Version));
+	_mesa_sha1_update(&sha1, &gl_ctx->Const.GLSLVersion,
+			  sizeof(gl_ctx->Const.GLSLVersion));
+	_mesa_sha1_update(&sha1, &gl_ctx->Const.DisableGLSLLineContinuations,
+			  sizeof(gl_ctx->Const.DisableGLSLLineContinuations));
+	_mesa_sha1_update(&sha1, &gl_ctx->Extensions,
+			  sizeof(gl_ctx->Extensions));
+	_mesa_sha1_update(&sha1, shader, strlen(shader));
+	_mesa_sha1_final(&sha1, key);
+}
+
+static bool
+cache_lookup(const unsigned char key[20], void *ralloc_ctx,
+	     const char **shader, char **info_log)
+{
+	bool found = false;
+
+	mtx_lock(&glcpp_cache.mutex);
+	if (glcpp_cache.table) {
+		struct hash_entry *he =
+			_mesa_hash_table_search(glcpp_cache.table, key);
+		if (he) {
+			struct glcpp_cache_entry *entry = he->data;
+
+			/* Move to the most recently used end */
+			list_del(&entry->link);
+			list_addtail(&entry->link, &glcpp_cache.lru);
+
+			*shader = ralloc_strdup(ralloc_ctx, entry->output);
+			ralloc_strcat(info_log, entry->info_log);
+			found = true;
+		}
+	}
+	mtx_unlock(&glcpp_cache.mutex);
+
+	return found;
+}
+
+static void
+cache_insert(const unsigned char key[20], const char *output,
+	     const char *info_log)
+{
+	size_t size = strlen(output) + strlen(info_log) + 2 +
+		      sizeof(struct glcpp_cache_entry);
+
+	if (size > GLCPP_CACHE_MAX_SIZE / 4)
+		return;
+
+	mtx_lock(&glcpp_cache.mutex);
+
+	if (glcpp_cache.table == NULL) {
+		glcpp_cache.mem_ctx = ralloc_context(NULL);
+		glcpp_cache.table = _mesa_hash_table_create(glcpp_cache.mem_ctx,
+							    cache_key_hash,
+							    cache_key_equal);
+		list_inithead(&glcpp_cache.lru);
+		glcpp_cache.size = 0;
+	}
+
+	/* Another thread may have raced us to it */
+	if (_mesa_hash_table_search(glcpp_cache.table, key)) {
+		mtx_unlock(&glcpp_cache.mutex);
+		return;
+	}
+
+	while (glcpp_cache.size + size > GLCPP_CACHE_MAX_SIZE) {
+		struct glcpp_cache_entry *lru =
+			LIST_ENTRY(struct glcpp_cache_entry,
+				   glcpp_cache.lru.next, link);
+
+		_mesa_hash_table_remove_key(glcpp_cache.table, lru->key);
+		list_del(&lru->link);
+		glcpp_cache.size -= lru->size;
+		ralloc_free(lru);
+	}
+
+	struct glcpp_cache_entry *entry =
+		ralloc(glcpp_cache.mem_ctx, struct glcpp_cache_entry);
+	memcpy(entry->key, key, sizeof(entry->key));
+	entry->output = ralloc_strdup(entry, output);
+	entry->info_log = ralloc_strdup(entry, info_log);
+	entry->size = size;
+
+	_mesa_hash_table_insert(glcpp_cache.table, entry->key, entry);
+	list_addtail(&entry->link, &glcpp_cache.lru);
+	glcpp_cache.size += size;
+
+	mtx_unlock(&glcpp_cache.mutex);
+}
+
+void
+glcpp_cache_release(void)
+{
+	mtx_lock(&glcpp_cache.mutex);
+	ralloc_free(glcpp_cache.mem_ctx);
+	glcpp_cache.mem_ctx = NULL;
+	glcpp_cache.table = NULL;
+	glcpp_cache.size = 0;
+	mtx_unlock(&glcpp_cache.mutex);
+}
+
+int
+glcpp_preprocess_cached(void *ralloc_ctx, const char **shader, char **info_log,
+			glcpp_extension_iterator extensions, void *state,
+			struct gl_context *gl_ctx)
+{
+	if (shader_is_directive_free(*shader))
+		return 0;
+
+	unsigned char key[20];
+	compute_cache_key(key, *shader, extensions, gl_ctx);
+
+	if (cache_lookup(key, ralloc_ctx, shader, info_log))
+		return 0;
+
+	char *log = ralloc_strdup(ralloc_ctx, "");
+	int errors = glcpp_preprocess(ralloc_ctx, shader, &log, extensions,
+				      state, gl_ctx);
+
+	/* Only successful runs are memoized, so that a failing shader keeps
+	 * reporting its errors through the normal path.
+	 */
+	if (!errors)
+		cache_insert(key, *shader, log);
+
+	ralloc_strcat(info_log, log);
+	ralloc_free(log);
+
+	return errors;
+}
@@ -2107,14 +2107,18 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
       (void) p_atomic_cmpxchg(&ir_variable::temporaries_allocate_names,
                               false, true);
 
-   state->error = glcpp_preprocess(state, &source, &state->info_log,
-                                   add_builtin_defines, state, ctx);
+   _mesa_glsl_phase_begin("glcpp");
+   state->error = glcpp_preprocess_cached(state, &source, &state->info_log,
+                                          add_builtin_defines, state, ctx);
+   _mesa_glsl_phase_end("glcpp");
 
    if (!state->error) {
+     _mesa_glsl_phase_begin("parse");
      _mesa_glsl_lexer_ctor(state, source);
      _mesa_glsl_parse(state);
      _mesa_glsl_lexer_dtor(state);
      do_late_parsing_checks(state);
+     _mesa_glsl_phase_end("parse");
    }
 
    if (dump_ast) {
@@ -2126,8 +2130,11 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
 
    ralloc_free(shader->ir);
    shader->ir = new(shader) exec_list;
-   if (!state->error && !state->translation_unit.is_empty())
+   if (!state->error && !state->translation_unit.is_empty()) {
+      _mesa_glsl_phase_begin("ast_to_hir");
       _mesa_ast_to_hir(shader->ir, state);
+      _mesa_glsl_phase_end("ast_to_hir");
+   }
 
    if (!state->error) {
       validate_ir_tree(shader->ir);
@@ -2154,9 +2161,11 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
       assign_subroutine_indexes(state);
       lower_subroutine(shader->ir, state);
 
-      if (!ctx->Cache || force_recompile)
+      if (!ctx->Cache || force_recompile) {
+         _mesa_glsl_phase_begin("compile_opt");
          opt_shader_and_create_symbol_table(ctx, state->symbols, shader);
-      else {
+         _mesa_glsl_phase_end("compile_opt");
+      } else {
          reparent_ir(shader->ir, shader->ir);
          shader->CompileStatus = COMPILED_NO_OPTS;
       }
@@ -2210,7 +2219,9 @@ do_common_optimization(exec_list *ir, bool linked,
          fprintf(stderr, "GLSL optimization %s: %s progress\n",         \
                  #PASS, opt_progress ? "made" : "no");                  \
       } else {                                                          \
+         _mesa_glsl_phase_begin(#PASS);                                 \
          progress = PASS(__VA_ARGS__) || progress;                      \
+         _mesa_glsl_phase_end(#PASS);                                   \
       }                                                                 \
    } while (false)
 
@@ -2297,6 +2308,8 @@ do_common_optimization(exec_list *ir, bool linked,
 
 extern "C" {
 
+const struct glsl_phase_hooks *_mesa_glsl_phase_hooks = NULL;
+
 /**
  * To be called at GL teardown time, this frees compiler datastructures.
  *
@@ -2321,6 +2334,7 @@ void
 _mesa_destroy_shader_compiler_caches(void)
 {
    _mesa_glsl_release_builtin_functions();
+   glcpp_cache_release();
 }
 
 }
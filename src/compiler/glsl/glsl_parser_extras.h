@@ -993,6 +993,40 @@ extern int glcpp_preprocess(void *ctx, const char **shader, char **info_log,
                             struct _mesa_glsl_parse_state *state,
                             struct gl_context *gl_ctx);
 
+extern int glcpp_preprocess_cached(void *ctx, const char **shader,
+                                   char **info_log,
+                                   glcpp_extension_iterator extensions,
+                                   struct _mesa_glsl_parse_state *state,
+                                   struct gl_context *gl_ctx);
+
+extern void glcpp_cache_release(void);
+
+/**
+ * Optional callbacks bracketing each compiler phase (preprocessing,
+ * parsing, AST-to-HIR conversion and the individual optimization passes).
+ * Used by the standalone compiler's --benchmark mode; NULL otherwise.
+ */
+struct glsl_phase_hooks {
+   void (*begin)(const char *phase);
+   void (*end)(const char *phase);
+};
+
+extern const struct glsl_phase_hooks *_mesa_glsl_phase_hooks;
+
+static inline void
+_mesa_glsl_phase_begin(const char *phase)
+{
+   if (_mesa_glsl_phase_hooks)
+      _mesa_glsl_phase_hooks->begin(phase);
+}
+
+static inline void
+_mesa_glsl_phase_end(const char *phase)
+{
+   if (_mesa_glsl_phase_hooks)
+      _mesa_glsl_phase_hooks->end(phase);
+}
+
 extern void _mesa_destroy_shader_compiler(void);
 extern void _mesa_destroy_shader_compiler_caches(void);
 
@@ -38,6 +38,48 @@
 
 static struct standalone_options options;
 
+#if defined(__GLIBC__) && defined(GLSL_COMPILER_COUNT_ALLOCS)
+/* Count heap allocations for --benchmark by interposing on the glibc
+ * allocator entry points.  This replaces malloc for the whole process, so
+ * it is only built into glsl_compiler_benchmark, never into the regular
+ * glsl_compiler.  The compiler is single-threaded here.
+ */
+extern "C" {
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t malloc_count;
+
+void *
+malloc(size_t size) __THROW
+{
+   malloc_count++;
+   return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size) __THROW
+{
+   malloc_count++;
+   return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size) __THROW
+{
+   malloc_count++;
+   return __libc_realloc(ptr, size);
+}
+}
+
+static uint64_t
+get_malloc_count(void)
+{
+   return malloc_count;
+}
+#endif
+
 const struct option compiler_opts[] = {
    { "dump-ast", no_argument, &options.dump_ast, 1 },
    { "dump-hir", no_argument, &options.dump_hir, 1 },
@@ -46,6 +88,7 @@ const struct option compiler_opts[] = {
    { "link",     no_argument, &options.do_link,  1 },
    { "just-log", no_argument, &options.just_log, 1 },
    { "version",  required_argument, NULL, 'v' },
+   { "benchmark", required_argument, NULL, 'b' },
    { NULL, 0, NULL, 0 }
 };
 
@@ -58,9 +101,10 @@ usage_fail(const char *name)
 
    const char *header =
       "usage: %s [options] <file.vert | file.tesc | file.tese | file.geom | file.frag | file.comp>\n"
+      "       %s --benchmark <iterations> [options] <file.shader_test | directory>...\n"
       "\n"
       "Possible options are:\n";
-   printf(header, name);
+   printf(header, name, name);
    for (const struct option *o = compiler_opts; o->name != 0; ++o) {
       printf("    --%s", o->name);
       if (o->has_arg == required_argument)
@@ -82,6 +126,9 @@ main(int argc, char * const* argv)
       case 'v':
          options.glsl_version = strtol(optarg, NULL, 10);
          break;
+      case 'b':
+         options.benchmark = strtol(optarg, NULL, 10);
+         break;
       default:
          break;
       }
@@ -90,6 +137,13 @@ main(int argc, char * const* argv)
    if (argc <= optind)
       usage_fail(argv[0]);
 
+   if (options.benchmark > 0) {
+#if defined(__GLIBC__) && defined(GLSL_COMPILER_COUNT_ALLOCS)
+      options.alloc_count = get_malloc_count;
+#endif
+      return standalone_benchmark(&options, argc - optind, &argv[optind]);
+   }
+
    struct gl_shader_program *whole_program;
 
    whole_program = standalone_compile_shader(&options, argc - optind, &argv[optind]);
@@ -21,6 +21,11 @@
  * DEALINGS IN THE SOFTWARE.
  */
 #include <getopt.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <dirent.h>
+#endif
 
 /** @file standalone.cpp
  *
@@ -43,7 +48,10 @@
 #include "ir_builder_print_visitor.h"
 #include "builtin_functions.h"
 #include "opt_add_neg_to_sub.h"
+#include "glsl_to_nir.h"
 #include "main/mtypes.h"
+#include "util/os_time.h"
+#include "util/u_dynarray.h"
 
 class dead_variable_visitor : public ir_hierarchical_visitor {
 public:
@@ -400,17 +408,11 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
    return;
 }
 
-extern "C" struct gl_shader_program *
-standalone_compile_shader(const struct standalone_options *_options,
-      unsigned num_files, char* const* files)
+static bool
+initialize_context_for_version(struct gl_context *ctx)
 {
-   int status = EXIT_SUCCESS;
-   static struct gl_context local_ctx;
-   struct gl_context *ctx = &local_ctx;
    bool glsl_es = false;
 
-   options = _options;
-
    switch (options->glsl_version) {
    case 100:
    case 300:
@@ -433,7 +435,7 @@ standalone_compile_shader(const struct standalone_options *_options,
       break;
    default:
       fprintf(stderr, "Unrecognized GLSL version `%d'\n", options->glsl_version);
-      return NULL;
+      return false;
    }
 
    if (glsl_es) {
@@ -442,18 +444,55 @@ standalone_compile_shader(const struct standalone_options *_options,
       initialize_context(ctx, options->glsl_version > 130 ? API_OPENGL_CORE : API_OPENGL_COMPAT);
    }
 
-   struct gl_shader_program *whole_program;
+   return true;
+}
 
-   whole_program = rzalloc (NULL, struct gl_shader_program);
-   assert(whole_program != NULL);
-   whole_program->data = rzalloc(whole_program, struct gl_shader_program_data);
-   assert(whole_program->data != NULL);
-   whole_program->data->InfoLog = ralloc_strdup(whole_program->data, "");
+static struct gl_shader_program *
+create_standalone_program()
+{
+   struct gl_shader_program *prog = rzalloc (NULL, struct gl_shader_program);
+   assert(prog != NULL);
+   prog->data = rzalloc(prog, struct gl_shader_program_data);
+   assert(prog->data != NULL);
+   prog->data->InfoLog = ralloc_strdup(prog->data, "");
 
    /* Created just to avoid segmentation faults */
-   whole_program->AttributeBindings = new string_to_uint_map;
-   whole_program->FragDataBindings = new string_to_uint_map;
-   whole_program->FragDataIndexBindings = new string_to_uint_map;
+   prog->AttributeBindings = new string_to_uint_map;
+   prog->FragDataBindings = new string_to_uint_map;
+   prog->FragDataIndexBindings = new string_to_uint_map;
+
+   return prog;
+}
+
+static void
+destroy_standalone_program(struct gl_shader_program *prog)
+{
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i])
+         ralloc_free(prog->_LinkedShaders[i]->Program);
+   }
+
+   delete prog->AttributeBindings;
+   delete prog->FragDataBindings;
+   delete prog->FragDataIndexBindings;
+
+   ralloc_free(prog);
+}
+
+extern "C" struct gl_shader_program *
+standalone_compile_shader(const struct standalone_options *_options,
+      unsigned num_files, char* const* files)
+{
+   int status = EXIT_SUCCESS;
+   static struct gl_context local_ctx;
+   struct gl_context *ctx = &local_ctx;
+
+   options = _options;
+
+   if (!initialize_context_for_version(ctx))
+      return NULL;
+
+   struct gl_shader_program *whole_program = create_standalone_program();
 
    for (unsigned i = 0; i < num_files; i++) {
       whole_program->Shaders =
@@ -606,16 +645,374 @@ fail:
 extern "C" void
 standalone_compiler_cleanup(struct gl_shader_program *whole_program)
 {
-   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
-      if (whole_program->_LinkedShaders[i])
-         ralloc_free(whole_program->_LinkedShaders[i]->Program);
+   destroy_standalone_program(whole_program);
+   _mesa_glsl_release_types();
+   _mesa_glsl_release_builtin_functions();
+}
+
+/*
+ * --benchmark: compile and link every program of a set of shader_test files
+ * a number of times, recording the time and heap allocations spent in each
+ * compiler phase.
+ */
+
+#define MAX_BENCHMARK_PHASES 256
+#define MAX_BENCHMARK_DEPTH 16
+
+struct benchmark_phase {
+   const char *name;
+   int parent;
+   unsigned depth;
+   uint64_t calls;
+   int64_t time;
+   uint64_t allocs;
+};
+
+static struct {
+   struct benchmark_phase phases[MAX_BENCHMARK_PHASES];
+   unsigned num_phases;
+
+   struct {
+      int phase;
+      int64_t start;
+      uint64_t allocs;
+   } stack[MAX_BENCHMARK_DEPTH];
+   unsigned depth;
+} bench;
+
+static uint64_t
+benchmark_alloc_count()
+{
+   return options->alloc_count ? options->alloc_count() : 0;
+}
+
+static int
+benchmark_find_phase(const char *name, int parent)
+{
+   for (unsigned i = 0; i < bench.num_phases; i++) {
+      if (bench.phases[i].parent == parent &&
+          strcmp(bench.phases[i].name, name) == 0)
+         return i;
    }
 
-   delete whole_program->AttributeBindings;
-   delete whole_program->FragDataBindings;
-   delete whole_program->FragDataIndexBindings;
+   if (bench.num_phases == MAX_BENCHMARK_PHASES)
+      return -1;
 
-   ralloc_free(whole_program);
-   _mesa_glsl_release_types();
-   _mesa_glsl_release_builtin_functions();
+   struct benchmark_phase *phase = &bench.phases[bench.num_phases];
+   phase->name = name;
+   phase->parent = parent;
+   phase->depth = bench.depth;
+   phase->calls = 0;
+   phase->time = 0;
+   phase->allocs = 0;
+
+   return bench.num_phases++;
+}
+
+static void
+benchmark_phase_begin(const char *name)
+{
+   /* Phases nested too deeply are not recorded, but still counted so that
+    * the stack stays balanced.
+    */
+   if (bench.depth < MAX_BENCHMARK_DEPTH) {
+      const int parent =
+         bench.depth > 0 ? bench.stack[bench.depth - 1].phase : -1;
+
+      bench.stack[bench.depth].phase = benchmark_find_phase(name, parent);
+      bench.stack[bench.depth].allocs = benchmark_alloc_count();
+      bench.stack[bench.depth].start = os_time_get_nano();
+   }
+
+   bench.depth++;
+}
+
+static void
+benchmark_phase_end(MAYBE_UNUSED const char *name)
+{
+   const int64_t end = os_time_get_nano();
+   const uint64_t allocs = benchmark_alloc_count();
+
+   assert(bench.depth > 0);
+   bench.depth--;
+
+   if (bench.depth >= MAX_BENCHMARK_DEPTH ||
+       bench.stack[bench.depth].phase < 0)
+      return;
+
+   struct benchmark_phase *phase =
+      &bench.phases[bench.stack[bench.depth].phase];
+   assert(strcmp(phase->name, name) == 0);
+
+   phase->calls++;
+   phase->time += end - bench.stack[bench.depth].start;
+   phase->allocs += allocs - bench.stack[bench.depth].allocs;
+}
+
+static const struct glsl_phase_hooks benchmark_hooks = {
+   benchmark_phase_begin,
+   benchmark_phase_end,
+};
+
+struct benchmark_shader {
+   GLenum type;
+   const char *source;
+};
+
+struct benchmark_program {
+   const char *path;
+   struct util_dynarray shaders;
+};
+
+static const struct {
+   const char *header;
+   GLenum type;
+} shader_test_sections[] = {
+   { "[vertex shader]",                  GL_VERTEX_SHADER },
+   { "[tessellation control shader]",    GL_TESS_CONTROL_SHADER },
+   { "[tessellation evaluation shader]", GL_TESS_EVALUATION_SHADER },
+   { "[geometry shader]",                GL_GEOMETRY_SHADER },
+   { "[fragment shader]",                GL_FRAGMENT_SHADER },
+   { "[compute shader]",                 GL_COMPUTE_SHADER },
+};
+
+/* Splits a shader_test file into its shader sources, in place. */
+static bool
+parse_shader_test(void *mem_ctx, const char *path,
+                  struct benchmark_program *program)
+{
+   char *text = load_text_file(mem_ctx, path);
+   if (text == NULL)
+      return false;
+
+   program->path = path;
+   util_dynarray_init(&program->shaders, mem_ctx);
+
+   bool in_shader = false;
+   for (char *line = text; line != NULL && *line != '\0';) {
+      char *next = strchr(line, '\n');
+
+      if (line[0] == '[') {
+         GLenum type = GL_NONE;
+         for (unsigned i = 0; i < ARRAY_SIZE(shader_test_sections); i++) {
+            const char *header = shader_test_sections[i].header;
+            if (strncmp(line, header, strlen(header)) == 0)
+               type = shader_test_sections[i].type;
+         }
+
+         /* Terminate the previous shader's source */
+         if (in_shader)
+            *line = '\0';
+
+         in_shader = type != GL_NONE;
+         if (in_shader) {
+            struct benchmark_shader shader = {
+               type, next ? next + 1 : "",
+            };
+            util_dynarray_append(&program->shaders,
+                                 struct benchmark_shader, shader);
+         }
+      }
+
+      line = next ? next + 1 : NULL;
+   }
+
+   return util_dynarray_num_elements(&program->shaders,
+                                     struct benchmark_shader) > 0;
+}
+
+static int
+compare_paths(const void *a, const void *b)
+{
+   return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+/* Appends path, or every .shader_test file below it if it is a directory */
+static void
+collect_shader_tests(void *mem_ctx, const char *path,
+                     struct util_dynarray *paths)
+{
+   struct stat st;
+   if (stat(path, &st) != 0) {
+      fprintf(stderr, "Could not stat \"%s\"\n", path);
+      return;
+   }
+
+#ifndef _WIN32
+   if (S_ISDIR(st.st_mode)) {
+      DIR *dir = opendir(path);
+      if (dir == NULL)
+         return;
+
+      struct dirent *entry;
+      while ((entry = readdir(dir)) != NULL) {
+         if (strcmp(entry->d_name, ".") == 0 ||
+             strcmp(entry->d_name, "..") == 0)
+            continue;
+
+         const char *child = ralloc_asprintf(mem_ctx, "%s/%s", path,
+                                             entry->d_name);
+         struct stat child_st;
+         if (stat(child, &child_st) != 0)
+            continue;
+
+         const size_t len = strlen(child);
+         if (S_ISDIR(child_st.st_mode) ||
+             (len > 12 && strcmp(child + len - 12, ".shader_test") == 0))
+            collect_shader_tests(mem_ctx, child, paths);
+      }
+      closedir(dir);
+      return;
+   }
+#endif
+
+   util_dynarray_append(paths, const char *, path);
+}
+
+/* Compiles, links and converts to NIR one program.  Returns false if it
+ * failed to compile or link.
+ */
+static bool
+benchmark_program(struct gl_context *ctx,
+                  const struct benchmark_program *bp)
+{
+   static const nir_shader_compiler_options nir_options = { };
+   struct gl_shader_program *prog = create_standalone_program();
+   bool ok = true;
+
+   util_dynarray_foreach(&bp->shaders, struct benchmark_shader, bs) {
+      prog->Shaders = reralloc(prog, prog->Shaders, struct gl_shader *,
+                               prog->NumShaders + 1);
+
+      struct gl_shader *shader = rzalloc(prog, gl_shader);
+      shader->Type = bs->type;
+      shader->Stage = _mesa_shader_enum_to_shader_stage(bs->type);
+      shader->Source = bs->source;
+      prog->Shaders[prog->NumShaders++] = shader;
+
+      _mesa_glsl_phase_begin("compile");
+      _mesa_glsl_compile_shader(ctx, shader, false, false, true);
+      _mesa_glsl_phase_end("compile");
+
+      if (!shader->CompileStatus) {
+         ok = false;
+         break;
+      }
+   }
+
+   if (ok) {
+      _mesa_clear_shader_program_data(ctx, prog);
+
+      _mesa_glsl_phase_begin("link");
+      link_shaders(ctx, prog);
+      _mesa_glsl_phase_end("link");
+
+      ok = prog->data->LinkStatus;
+   }
+
+   for (unsigned i = 0; ok && i < MESA_SHADER_STAGES; i++) {
+      struct gl_linked_shader *sh = prog->_LinkedShaders[i];
+      if (sh == NULL)
+         continue;
+
+      _mesa_glsl_phase_begin("glsl_to_nir");
+
+      /* The lowering st/mesa always does before handing IR to NIR */
+      lower_instructions(sh->ir, MOD_TO_FLOOR | EXP_TO_EXP2 | LOG_TO_LOG2 |
+                                 DFREXP_DLDEXP_TO_ARITH | CARRY_TO_ARITH |
+                                 BORROW_TO_ARITH);
+      lower_vector_insert(sh->ir, true);
+      lower_quadop_vector(sh->ir, false);
+      lower_noise(sh->ir);
+
+      nir_shader *nir = glsl_to_nir(prog, (gl_shader_stage) i, &nir_options);
+      ralloc_free(nir);
+
+      _mesa_glsl_phase_end("glsl_to_nir");
+   }
+
+   destroy_standalone_program(prog);
+
+   return ok;
+}
+
+extern "C" int
+standalone_benchmark(const struct standalone_options *_options,
+                     unsigned num_paths, char* const* paths)
+{
+   static struct gl_context local_ctx;
+   struct gl_context *ctx = &local_ctx;
+
+   options = _options;
+
+   if (!initialize_context_for_version(ctx))
+      return EXIT_FAILURE;
+
+   void *mem_ctx = ralloc_context(NULL);
+
+   struct util_dynarray files;
+   util_dynarray_init(&files, mem_ctx);
+   for (unsigned i = 0; i < num_paths; i++)
+      collect_shader_tests(mem_ctx, paths[i], &files);
+
+   /* Make runs over the same directory comparable */
+   qsort(files.data, util_dynarray_num_elements(&files, const char *),
+         sizeof(const char *), compare_paths);
+
+   struct util_dynarray programs;
+   util_dynarray_init(&programs, mem_ctx);
+   util_dynarray_foreach(&files, const char *, path) {
+      struct benchmark_program program;
+      if (parse_shader_test(mem_ctx, *path, &program))
+         util_dynarray_append(&programs, struct benchmark_program, program);
+   }
+
+   const unsigned num_programs =
+      util_dynarray_num_elements(&programs, struct benchmark_program);
+   const unsigned iterations = MAX2(options->benchmark, 1);
+   unsigned failed = 0;
+
+   memset(&bench, 0, sizeof(bench));
+   _mesa_glsl_phase_hooks = &benchmark_hooks;
+
+   const int64_t start = os_time_get_nano();
+   for (unsigned iter = 0; iter < iterations; iter++) {
+      /* Measure the preprocessor itself on every iteration rather than its
+       * memoized output.
+       */
+      glcpp_cache_release();
+
+      util_dynarray_foreach(&programs, struct benchmark_program, program) {
+         if (!benchmark_program(ctx, program) && iter == 0) {
+            if (!options->just_log)
+               printf("Failed to compile or link %s\n", program->path);
+            failed++;
+         }
+      }
+   }
+   const int64_t total = os_time_get_nano() - start;
+
+   _mesa_glsl_phase_hooks = NULL;
+
+   printf("%u programs, %u iterations, %u failed\n",
+          num_programs, iterations, failed);
+   printf("%-48s %10s %12s %14s\n",
+          "phase", "calls/iter", "ms/iter", "allocs/iter");
+   for (unsigned i = 0; i < bench.num_phases; i++) {
+      const struct benchmark_phase *phase = &bench.phases[i];
+      const int indent = 2 * phase->depth;
+
+      printf("%*s%-*s %10" PRIu64 " %12.3f", indent, "", 48 - indent,
+             phase->name, phase->calls / iterations,
+             phase->time / 1e6 / iterations);
+      if (options->alloc_count)
+         printf(" %14" PRIu64 "\n", phase->allocs / iterations);
+      else
+         printf(" %14s\n", "-");
+   }
+   printf("%-48s %10s %12.3f\n", "total", "", total / 1e6 / iterations);
+
+   ralloc_free(mem_ctx);
+
+   return EXIT_SUCCESS;
 }
@@ -24,6 +24,8 @@
 #ifndef GLSL_STANDALONE_H
 #define GLSL_STANDALONE_H
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -36,6 +38,11 @@ struct standalone_options {
    int dump_builder;
    int do_link;
    int just_log;
+
+   /* Number of iterations for standalone_benchmark() */
+   int benchmark;
+   /* Optional heap allocation counter reported by standalone_benchmark() */
+   uint64_t (*alloc_count)(void);
 };
 
 struct gl_shader_program;
@@ -46,6 +53,9 @@ struct gl_shader_program * standalone_compile_shader(
 
 void standalone_compiler_cleanup(struct gl_shader_program *prog);
 
+int standalone_benchmark(const struct standalone_options *options,
+                         unsigned num_paths, char* const* paths);
+
 #ifdef __cplusplus
 }
 #endif
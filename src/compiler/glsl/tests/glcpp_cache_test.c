@@ -0,0 +1,257 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Unit tests for glcpp_preprocess_cached() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "util/macros.h"
+#include "util/ralloc.h"
+#include "main/mtypes.h"
+#include "glcpp/glcpp.h"
+
+static bool error = false;
+
+/* Number of times glcpp actually ran.  glcpp calls the extension iterator
+ * exactly once per run, when it settles on the shader's version.
+ */
+static unsigned glcpp_runs;
+
+static void
+count_runs(struct _mesa_glsl_parse_state *state,
+           void (*add_builtin_define)(glcpp_parser_t *, const char *, int),
+           glcpp_parser_t *data, unsigned version, bool es)
+{
+   glcpp_runs++;
+}
+
+static void
+expect_true(bool value, const char *test, const char *shader)
+{
+   if (!value) {
+      fprintf(stderr, "Error: Test '%s' failed for \"%s\"\n", test, shader);
+      error = true;
+   }
+}
+
+struct result {
+   int errors;
+   bool ran;
+   bool passed_through;
+   const char *output;
+   const char *info_log;
+};
+
+static struct result
+preprocess(void *mem_ctx, struct gl_context *ctx, const char *source)
+{
+   struct result result;
+   const char *shader = source;
+   char *info_log = ralloc_strdup(mem_ctx, "");
+   unsigned runs = glcpp_runs;
+
+   result.errors = glcpp_preprocess_cached(mem_ctx, &shader, &info_log,
+                                           count_runs, NULL, ctx);
+   result.ran = glcpp_runs != runs;
+   result.passed_through = shader == source;
+   result.output = shader;
+   result.info_log = info_log;
+
+   return result;
+}
+
+/* Output of the uncached preprocessor, for comparison */
+static const char *
+reference_output(void *mem_ctx, struct gl_context *ctx, const char *source)
+{
+   const char *shader = source;
+   char *info_log = ralloc_strdup(mem_ctx, "");
+
+   glcpp_preprocess(mem_ctx, &shader, &info_log, count_runs, NULL, ctx);
+
+   return shader;
+}
+
+static struct gl_context *
+create_context(void)
+{
+   struct gl_context *ctx = calloc(1, sizeof(*ctx));
+
+   ctx->API = API_OPENGL_CORE;
+   ctx->Version = 45;
+   ctx->Const.GLSLVersion = 450;
+
+   return ctx;
+}
+
+static void
+test_pass_through(void)
+{
+   static const char *const shaders[] = {
+      "void main() { gl_FragColor = vec4(1.0); }\n",
+      "#version 330\nout vec4 c;\nvoid main() { c = vec4(1.0); }\n",
+      "  #  version 300 es \r\nvoid main() {\r\n}\r\n",
+      "#version 450 core\n\tvoid main() { }",
+   };
+   void *mem_ctx = ralloc_context(NULL);
+   struct gl_context *ctx = create_context();
+
+   for (unsigned i = 0; i < ARRAY_SIZE(shaders); i++) {
+      struct result r = preprocess(mem_ctx, ctx, shaders[i]);
+
+      expect_true(r.errors == 0, "pass through: no errors", shaders[i]);
+      expect_true(!r.ran, "pass through: glcpp not run", shaders[i]);
+      expect_true(r.passed_through, "pass through: source unchanged",
+                  shaders[i]);
+      expect_true(r.info_log[0] == '\0', "pass through: empty log",
+                  shaders[i]);
+   }
+
+   free(ctx);
+   ralloc_free(mem_ctx);
+}
+
+static void
+test_needs_preprocessing(void)
+{
+   static const char *const shaders[] = {
+      "#define X 1.0\nfloat x = X;\n",
+      "#version 330\n#extension GL_ARB_foo : enable\n",
+      "#version 330\nvoid main() { }\n#line 1\n",
+      "#version 0x130\nvoid main() { }\n",
+      "#version 110 /* comment */\nvoid main() { }\n",
+      "void main() { }\n#version 330\n",
+      "float x = __LINE__;\n",
+      "float x = a/*comment*/;\n",
+      "float x = a; // comment\n",
+      "float x = \\\n1.0;\n",
+      "bool es = GL_ES;\n",
+      "float x;\vfloat y;\n",
+      "float x;\ffloat y;\n",
+      "float x;\rfloat y;\n",
+   };
+   void *mem_ctx = ralloc_context(NULL);
+   struct gl_context *ctx = create_context();
+
+   glcpp_cache_release();
+
+   for (unsigned i = 0; i < ARRAY_SIZE(shaders); i++) {
+      struct result r = preprocess(mem_ctx, ctx, shaders[i]);
+
+      expect_true(r.ran, "needs preprocessing: glcpp run", shaders[i]);
+   }
+
+   free(ctx);
+   ralloc_free(mem_ctx);
+}
+
+static void
+test_cache(void)
+{
+   static const char *shader =
+      "#version 330\n"
+      "#define COLOR vec4(1.0, 0.0, 0.0, 1.0)\n"
+      "out vec4 c;\n"
+      "void main() { c = COLOR; }\n";
+   void *mem_ctx = ralloc_context(NULL);
+   struct gl_context *ctx = create_context();
+   const char *expected = reference_output(mem_ctx, ctx, shader);
+   struct result r;
+
+   glcpp_cache_release();
+
+   r = preprocess(mem_ctx, ctx, shader);
+   expect_true(r.errors == 0 && r.ran, "cache: first use runs glcpp",
+               shader);
+   expect_true(strcmp(r.output, expected) == 0, "cache: first output",
+               shader);
+
+   r = preprocess(mem_ctx, ctx, shader);
+   expect_true(r.errors == 0 && !r.ran, "cache: second use hits", shader);
+   expect_true(!r.passed_through && strcmp(r.output, expected) == 0,
+               "cache: cached output", shader);
+
+   /* Everything else glcpp's output depends on is part of the key */
+   ctx->Const.GLSLVersion = 430;
+   expect_true(preprocess(mem_ctx, ctx, shader).ran,
+               "cache: GLSL version is part of the key", shader);
+
+   ctx->Extensions.ARB_gpu_shader_fp64 = true;
+   expect_true(preprocess(mem_ctx, ctx, shader).ran,
+               "cache: extensions are part of the key", shader);
+
+   ctx->Const.DisableGLSLLineContinuations = true;
+   expect_true(preprocess(mem_ctx, ctx, shader).ran,
+               "cache: line continuations are part of the key", shader);
+
+   ctx->API = API_OPENGL_COMPAT;
+   expect_true(preprocess(mem_ctx, ctx, shader).ran,
+               "cache: API is part of the key", shader);
+
+   expect_true(!preprocess(mem_ctx, ctx, shader).ran,
+               "cache: hit after key changes", shader);
+
+   glcpp_cache_release();
+   expect_true(preprocess(mem_ctx, ctx, shader).ran,
+               "cache: miss after release", shader);
+
+   free(ctx);
+   ralloc_free(mem_ctx);
+}
+
+static void
+test_errors_not_cached(void)
+{
+   static const char *shader = "#error broken\nvoid main() { }\n";
+   void *mem_ctx = ralloc_context(NULL);
+   struct gl_context *ctx = create_context();
+
+   glcpp_cache_release();
+
+   for (unsigned i = 0; i < 2; i++) {
+      struct result r = preprocess(mem_ctx, ctx, shader);
+
+      expect_true(r.errors != 0 && r.ran, "errors: glcpp run", shader);
+      expect_true(strstr(r.info_log, "broken") != NULL,
+                  "errors: reported in the log", shader);
+   }
+
+   free(ctx);
+   ralloc_free(mem_ctx);
+}
+
+int
+main(void)
+{
+   test_pass_through();
+   test_needs_preprocessing();
+   test_cache();
+   test_errors_not_cached();
+
+   glcpp_cache_release();
+
+   return error ? 1 : 0;
+}
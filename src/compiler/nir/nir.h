@@ -3182,6 +3182,25 @@ bool nir_opt_large_constants(nir_shader *shader,
 
 bool nir_opt_loop_unroll(nir_shader *shader, nir_variable_mode indirect_mask);
 
+/**
+ * Callback for nir_opt_load_store_vectorize() deciding whether two memory
+ * accesses should be combined.
+ *
+ * \param align            alignment in bytes of the combined access
+ * \param bit_size         bit size of the combined access
+ * \param num_components   number of components of the combined access
+ * \param high_offset      byte offset of "high" relative to "low"
+ * \param low, high        the two accesses being combined, ordered by offset
+ */
+typedef bool (*nir_should_vectorize_mem_func)(unsigned align, unsigned bit_size,
+                                              unsigned num_components,
+                                              unsigned high_offset,
+                                              nir_intrinsic_instr *low,
+                                              nir_intrinsic_instr *high);
+
+bool nir_opt_load_store_vectorize(nir_shader *shader, nir_variable_mode modes,
+                                  nir_should_vectorize_mem_func callback);
+
 bool nir_opt_move_comparisons(nir_shader *shader);
 
 bool nir_opt_move_load_ubo(nir_shader *shader);
@@ -0,0 +1,628 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "util/u_dynarray.h"
+
+/**
+ * \file nir_opt_load_store_vectorize.c
+ *
+ * Combines adjacent load_ubo, load_ssbo, load_shared, store_ssbo and
+ * store_shared intrinsics inside a basic block into wider accesses.
+ *
+ * Two accesses are candidates for combining when they use the same
+ * intrinsic, the same buffer and an offset of the form "base + constant"
+ * with the same SSA base, and when the byte ranges they touch are adjacent
+ * or overlapping.  Loads are combined at the position of the earlier load
+ * and stores at the position of the later store, so the pass checks the
+ * instructions in between for anything that may observe or modify the
+ * memory being moved.  Accesses of different bit sizes are combined using
+ * the smaller bit size and bitcast back for the users.
+ *
+ * The driver decides which of the resulting accesses it supports through
+ * the nir_should_vectorize_mem_func callback.
+ */
+
+struct intrinsic_info {
+   nir_intrinsic_op op;
+   nir_variable_mode mode;
+   bool is_store;
+   int resource_src; /* -1 if there is no resource source */
+   int offset_src;
+   int value_src;    /* -1 for loads */
+   bool has_base;
+};
+
+static const struct intrinsic_info intrinsic_infos[] = {
+   { nir_intrinsic_load_ubo,     nir_var_uniform,        false,  0, 1, -1, false },
+   { nir_intrinsic_load_ssbo,    nir_var_shader_storage, false,  0, 1, -1, false },
+   { nir_intrinsic_load_shared,  nir_var_shared,         false, -1, 0, -1, true  },
+   { nir_intrinsic_store_ssbo,   nir_var_shader_storage, true,   1, 2,  0, false },
+   { nir_intrinsic_store_shared, nir_var_shared,         true,  -1, 1,  0, true  },
+};
+
+static const struct intrinsic_info *
+get_info(nir_intrinsic_op op)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(intrinsic_infos); i++) {
+      if (intrinsic_infos[i].op == op)
+         return &intrinsic_infos[i];
+   }
+   return NULL;
+}
+
+/* A load or store whose address we understand. */
+struct entry {
+   nir_intrinsic_instr *intrin;
+   const struct intrinsic_info *info;
+
+   nir_ssa_def *resource;
+
+   /* The offset is offset_base.x[offset_base_comp] + offset_const, or just
+    * offset_const when offset_base is NULL.  The BASE index of shared
+    * memory intrinsics is included in offset_const.
+    */
+   nir_ssa_def *offset_base;
+   unsigned offset_base_comp;
+   int64_t offset_const;
+
+   unsigned bit_size;
+   unsigned num_components;
+   nir_component_mask_t write_mask;
+   enum gl_access_qualifier access;
+};
+
+struct vectorize_ctx {
+   nir_variable_mode modes;
+   nir_should_vectorize_mem_func callback;
+   nir_builder b;
+};
+
+static bool
+parse_offset(nir_src *src, struct entry *entry)
+{
+   if (!src->is_ssa)
+      return false;
+
+   if (nir_src_is_const(*src)) {
+      entry->offset_base = NULL;
+      entry->offset_base_comp = 0;
+      entry->offset_const += nir_src_as_int(*src);
+      return true;
+   }
+
+   entry->offset_base = src->ssa;
+   entry->offset_base_comp = 0;
+
+   if (src->ssa->parent_instr->type != nir_instr_type_alu)
+      return true;
+
+   nir_alu_instr *alu = nir_instr_as_alu(src->ssa->parent_instr);
+   if (alu->op != nir_op_iadd || !alu->dest.dest.is_ssa)
+      return true;
+
+   for (unsigned i = 0; i < 2; i++) {
+      nir_alu_src *const_src = &alu->src[i];
+      nir_alu_src *base_src = &alu->src[1 - i];
+
+      if (!nir_src_is_const(const_src->src) || !base_src->src.is_ssa ||
+          const_src->abs || const_src->negate ||
+          base_src->abs || base_src->negate)
+         continue;
+
+      entry->offset_base = base_src->src.ssa;
+      entry->offset_base_comp = base_src->swizzle[0];
+      entry->offset_const +=
+         nir_src_comp_as_int(const_src->src, const_src->swizzle[0]);
+      return true;
+   }
+
+   return true;
+}
+
+static bool
+parse_entry(nir_intrinsic_instr *intrin, nir_variable_mode modes,
+            struct entry *entry)
+{
+   const struct intrinsic_info *info = get_info(intrin->intrinsic);
+   if (!info || !(info->mode & modes))
+      return false;
+
+   memset(entry, 0, sizeof(*entry));
+   entry->intrin = intrin;
+   entry->info = info;
+
+   if (info->resource_src >= 0) {
+      if (!intrin->src[info->resource_src].is_ssa)
+         return false;
+      entry->resource = intrin->src[info->resource_src].ssa;
+   }
+
+   if (info->has_base)
+      entry->offset_const = nir_intrinsic_base(intrin);
+
+   if (!parse_offset(&intrin->src[info->offset_src], entry))
+      return false;
+
+   if (info->is_store) {
+      if (!intrin->src[info->value_src].is_ssa)
+         return false;
+      entry->bit_size = intrin->src[info->value_src].ssa->bit_size;
+      entry->write_mask = nir_intrinsic_write_mask(intrin);
+   } else {
+      if (!intrin->dest.is_ssa)
+         return false;
+      entry->bit_size = intrin->dest.ssa.bit_size;
+      entry->write_mask = 0;
+   }
+   entry->num_components = intrin->num_components;
+
+   if (info->mode == nir_var_shader_storage)
+      entry->access = nir_intrinsic_access(intrin);
+
+   return true;
+}
+
+static unsigned
+entry_size(const struct entry *entry)
+{
+   return entry->num_components * (entry->bit_size / 8);
+}
+
+static unsigned
+entry_align(const struct entry *entry)
+{
+   unsigned align_mul = nir_intrinsic_align_mul(entry->intrin);
+   if (!align_mul)
+      return entry->bit_size / 8;
+   return nir_intrinsic_align(entry->intrin);
+}
+
+static bool
+same_address_base(const struct entry *a, const struct entry *b)
+{
+   return a->resource == b->resource &&
+          a->offset_base == b->offset_base &&
+          a->offset_base_comp == b->offset_base_comp;
+}
+
+/* Returns true if the memory accessed by a and b may overlap. */
+static bool
+may_alias(const struct entry *a, const struct entry *b)
+{
+   /* Shared memory and SSBOs never alias each other and UBOs are
+    * read-only.
+    */
+   if (a->info->mode != b->info->mode)
+      return false;
+
+   if (!same_address_base(a, b))
+      return true;
+
+   return a->offset_const < b->offset_const + entry_size(b) &&
+          b->offset_const < a->offset_const + entry_size(a);
+}
+
+/* Returns true if moving "moved" across "instr" could change the result of
+ * the program.  Loads are moved up and stores are moved down.
+ */
+static bool
+is_hazard(nir_instr *instr, const struct entry *moved)
+{
+   if (instr->type == nir_instr_type_call)
+      return true;
+
+   if (instr->type != nir_instr_type_intrinsic)
+      return false;
+
+   nir_intrinsic_instr *intrin = nir_instr_as_intrinsic(instr);
+   struct entry other;
+   if (parse_entry(intrin, nir_var_all, &other)) {
+      /* Two loads can always be reordered. */
+      if (!moved->info->is_store && !other.info->is_store)
+         return false;
+      return may_alias(moved, &other);
+   }
+
+   const nir_intrinsic_semantic_flag flags =
+      nir_intrinsic_infos[intrin->intrinsic].flags;
+
+   /* Moving a load across something that doesn't write memory is fine.
+    * Moving a store across something that may read memory is not.
+    */
+   if (moved->info->is_store)
+      return !(flags & NIR_INTRINSIC_CAN_REORDER);
+   else
+      return !(flags & NIR_INTRINSIC_CAN_ELIMINATE);
+}
+
+static bool
+has_hazard_between(const struct entry *first, const struct entry *second)
+{
+   /* UBOs are read-only and can't be affected by anything. */
+   if (first->info->mode == nir_var_uniform)
+      return false;
+
+   const struct entry *moved = first->info->is_store ? first : second;
+
+   for (nir_instr *instr = nir_instr_next(&first->intrin->instr);
+        instr != &second->intrin->instr; instr = nir_instr_next(instr)) {
+      if (is_hazard(instr, moved))
+         return true;
+   }
+
+   return false;
+}
+
+static nir_ssa_def *
+build_offset(nir_builder *b, const struct entry *entry, int64_t offset)
+{
+   if (!entry->offset_base)
+      return nir_imm_int(b, offset);
+
+   nir_ssa_def *base = entry->offset_base;
+   if (base->num_components > 1)
+      base = nir_channel(b, base, entry->offset_base_comp);
+   if (offset == 0)
+      return base;
+
+   return nir_iadd(b, base, nir_imm_intN_t(b, offset, base->bit_size));
+}
+
+/* Returns a new intrinsic covering both entries, with its sources and
+ * indices set up but not yet inserted.
+ */
+static nir_intrinsic_instr *
+create_combined(struct vectorize_ctx *ctx, const struct entry *low,
+                unsigned num_components, nir_ssa_def *offset)
+{
+   nir_shader *shader = ctx->b.shader;
+   const struct intrinsic_info *info = low->info;
+
+   nir_intrinsic_instr *combined =
+      nir_intrinsic_instr_create(shader, low->intrin->intrinsic);
+   combined->num_components = num_components;
+
+   memcpy(combined->const_index, low->intrin->const_index,
+          sizeof(combined->const_index));
+
+   if (info->resource_src >= 0) {
+      combined->src[info->resource_src] =
+         nir_src_for_ssa(low->resource);
+   }
+   combined->src[info->offset_src] = nir_src_for_ssa(offset);
+
+   return combined;
+}
+
+static bool
+can_combine(struct vectorize_ctx *ctx, const struct entry *first,
+            const struct entry *second, const struct entry **low_out,
+            const struct entry **high_out, unsigned *bit_size_out,
+            unsigned *num_components_out)
+{
+   if (first->intrin->intrinsic != second->intrin->intrinsic)
+      return false;
+
+   if (!same_address_base(first, second))
+      return false;
+
+   if (first->access != second->access || (first->access & ACCESS_VOLATILE))
+      return false;
+
+   const struct entry *low, *high;
+   if (first->offset_const <= second->offset_const) {
+      low = first;
+      high = second;
+   } else {
+      low = second;
+      high = first;
+   }
+
+   /* Require the ranges to touch so we never load or store bytes which
+    * neither access covered.
+    */
+   const int64_t low_end = low->offset_const + entry_size(low);
+   const int64_t high_end = high->offset_const + entry_size(high);
+   if (high->offset_const > low_end)
+      return false;
+
+   const unsigned bit_size = MIN2(low->bit_size, high->bit_size);
+   const unsigned comp_size = bit_size / 8;
+   const int64_t high_offset = high->offset_const - low->offset_const;
+   const int64_t total_size = MAX2(low_end, high_end) - low->offset_const;
+
+   if (high_offset % comp_size || total_size % comp_size)
+      return false;
+
+   const unsigned num_components = total_size / comp_size;
+   if (num_components > NIR_MAX_VEC_COMPONENTS)
+      return false;
+
+   /* The combined access must start at the same place as the low one, so
+    * it inherits that alignment.
+    */
+   if (!ctx->callback(entry_align(low), bit_size, num_components,
+                      high_offset, low->intrin, high->intrin))
+      return false;
+
+   *low_out = low;
+   *high_out = high;
+   *bit_size_out = bit_size;
+   *num_components_out = num_components;
+   return true;
+}
+
+static nir_ssa_def *
+extract_load_value(nir_builder *b, nir_ssa_def *combined,
+                   const struct entry *low, const struct entry *entry)
+{
+   const unsigned comp_size = combined->bit_size / 8;
+   const unsigned start = (entry->offset_const - low->offset_const) / comp_size;
+   const unsigned count = entry_size(entry) / comp_size;
+
+   nir_ssa_def *value =
+      nir_channels(b, combined, ((1 << count) - 1) << start);
+   return nir_bitcast_vector(b, value, entry->bit_size);
+}
+
+static nir_intrinsic_instr *
+combine_loads(struct vectorize_ctx *ctx, const struct entry *first,
+              const struct entry *second, const struct entry *low,
+              unsigned bit_size, unsigned num_components)
+{
+   nir_builder *b = &ctx->b;
+
+   /* The combined load replaces the first one.  The offset of the first
+    * load can be reused as-is if it is also the lowest; otherwise it has
+    * to be rebuilt since the second one's offset may be defined later.
+    */
+   b->cursor = nir_before_instr(&first->intrin->instr);
+
+   nir_ssa_def *offset;
+   if (low == first) {
+      offset = first->intrin->src[first->info->offset_src].ssa;
+   } else {
+      const int64_t base_index =
+         low->info->has_base ? nir_intrinsic_base(low->intrin) : 0;
+      offset = build_offset(b, low, low->offset_const - base_index);
+   }
+
+   nir_intrinsic_instr *combined =
+      create_combined(ctx, low, num_components, offset);
+   nir_ssa_dest_init(&combined->instr, &combined->dest,
+                     num_components, bit_size, NULL);
+   nir_builder_instr_insert(b, &combined->instr);
+
+   b->cursor = nir_after_instr(&combined->instr);
+
+   nir_ssa_def *first_value =
+      extract_load_value(b, &combined->dest.ssa, low, first);
+   nir_ssa_def *second_value =
+      extract_load_value(b, &combined->dest.ssa, low, second);
+
+   nir_ssa_def_rewrite_uses(&first->intrin->dest.ssa,
+                            nir_src_for_ssa(first_value));
+   nir_ssa_def_rewrite_uses(&second->intrin->dest.ssa,
+                            nir_src_for_ssa(second_value));
+
+   nir_instr_remove(&first->intrin->instr);
+   nir_instr_remove(&second->intrin->instr);
+
+   return combined;
+}
+
+static void
+gather_store_value(nir_builder *b, const struct entry *low,
+                   const struct entry *entry, unsigned bit_size,
+                   nir_ssa_def **comps, nir_component_mask_t *write_mask)
+{
+   const unsigned comp_size = bit_size / 8;
+   const unsigned start = (entry->offset_const - low->offset_const) / comp_size;
+   const unsigned divisor = entry->bit_size / bit_size;
+
+   nir_ssa_def *value =
+      nir_bitcast_vector(b, entry->intrin->src[entry->info->value_src].ssa,
+                         bit_size);
+
+   for (unsigned i = 0; i < entry->num_components; i++) {
+      if (!(entry->write_mask & (1 << i)))
+         continue;
+
+      for (unsigned j = 0; j < divisor; j++) {
+         const unsigned src_comp = i * divisor + j;
+         comps[start + src_comp] = nir_channel(b, value, src_comp);
+         *write_mask |= 1 << (start + src_comp);
+      }
+   }
+}
+
+static nir_intrinsic_instr *
+combine_stores(struct vectorize_ctx *ctx, const struct entry *first,
+               const struct entry *second, const struct entry *low,
+               unsigned bit_size, unsigned num_components)
+{
+   nir_builder *b = &ctx->b;
+
+   /* The combined store replaces the second one.  Everything the first
+    * store uses is already available there.
+    */
+   b->cursor = nir_before_instr(&second->intrin->instr);
+
+   nir_ssa_def *comps[NIR_MAX_VEC_COMPONENTS] = { NULL, };
+   nir_component_mask_t write_mask = 0;
+
+   /* The second store wins where both write the same component. */
+   gather_store_value(b, low, first, bit_size, comps, &write_mask);
+   gather_store_value(b, low, second, bit_size, comps, &write_mask);
+
+   nir_ssa_def *undef = NULL;
+   for (unsigned i = 0; i < num_components; i++) {
+      if (comps[i])
+         continue;
+      if (!undef)
+         undef = nir_ssa_undef(b, 1, bit_size);
+      comps[i] = undef;
+   }
+
+   nir_ssa_def *offset = low->intrin->src[low->info->offset_src].ssa;
+   nir_intrinsic_instr *combined =
+      create_combined(ctx, low, num_components, offset);
+   combined->src[low->info->value_src] =
+      nir_src_for_ssa(nir_vec(b, comps, num_components));
+   nir_intrinsic_set_write_mask(combined, write_mask);
+   nir_builder_instr_insert(b, &combined->instr);
+
+   nir_instr_remove(&first->intrin->instr);
+   nir_instr_remove(&second->intrin->instr);
+
+   return combined;
+}
+
+/* Tries to combine two entries and returns the combined intrinsic, or NULL
+ * if they can't be combined.  Both original intrinsics are removed on
+ * success.
+ */
+static nir_intrinsic_instr *
+try_combine(struct vectorize_ctx *ctx, const struct entry *a,
+            const struct entry *b)
+{
+   /* Instruction indices give us the program order of the two accesses. */
+   const struct entry *first = a->intrin->instr.index < b->intrin->instr.index ?
+                               a : b;
+   const struct entry *second = first == a ? b : a;
+
+   const struct entry *low, *high;
+   unsigned bit_size, num_components;
+
+   if (!can_combine(ctx, first, second, &low, &high,
+                    &bit_size, &num_components))
+      return NULL;
+
+   if (has_hazard_between(first, second))
+      return NULL;
+
+   nir_intrinsic_instr *combined;
+   if (first->info->is_store) {
+      combined = combine_stores(ctx, first, second, low,
+                                bit_size, num_components);
+      combined->instr.index = second->intrin->instr.index;
+   } else {
+      combined = combine_loads(ctx, first, second, low,
+                               bit_size, num_components);
+      combined->instr.index = first->intrin->instr.index;
+   }
+
+   return combined;
+}
+
+static bool
+vectorize_block(struct vectorize_ctx *ctx, nir_block *block, void *mem_ctx)
+{
+   bool progress = false;
+
+   struct util_dynarray entries;
+   util_dynarray_init(&entries, mem_ctx);
+
+   nir_foreach_instr_safe(instr, block) {
+      if (instr->type != nir_instr_type_intrinsic)
+         continue;
+
+      struct entry entry;
+      if (!parse_entry(nir_instr_as_intrinsic(instr), ctx->modes, &entry))
+         continue;
+
+      /* Search backwards so the closest candidate is tried first.  Every
+       * time something gets combined the search starts over with the
+       * combined access, which may now be combinable with other entries.
+       */
+      for (int i = util_dynarray_num_elements(&entries, struct entry) - 1;
+           i >= 0; i--) {
+         struct entry *prev =
+            util_dynarray_element(&entries, struct entry, i);
+
+         nir_intrinsic_instr *combined = try_combine(ctx, prev, &entry);
+         if (!combined)
+            continue;
+
+         MAYBE_UNUSED bool parsed = parse_entry(combined, ctx->modes, &entry);
+         assert(parsed);
+
+         /* prev has been removed from the shader. */
+         struct entry last = util_dynarray_pop(&entries, struct entry);
+         if (i < (int)util_dynarray_num_elements(&entries, struct entry))
+            *prev = last;
+
+         progress = true;
+         i = util_dynarray_num_elements(&entries, struct entry);
+      }
+
+      util_dynarray_append(&entries, struct entry, entry);
+   }
+
+   util_dynarray_fini(&entries);
+
+   return progress;
+}
+
+static bool
+vectorize_impl(struct vectorize_ctx *ctx, nir_function_impl *impl)
+{
+   bool progress = false;
+   void *mem_ctx = ralloc_context(NULL);
+
+   nir_builder_init(&ctx->b, impl);
+   nir_index_instrs(impl);
+
+   nir_foreach_block(block, impl)
+      progress |= vectorize_block(ctx, block, mem_ctx);
+
+   ralloc_free(mem_ctx);
+
+   if (progress) {
+      nir_metadata_preserve(impl, nir_metadata_block_index |
+                                  nir_metadata_dominance);
+   }
+
+   return progress;
+}
+
+bool
+nir_opt_load_store_vectorize(nir_shader *shader, nir_variable_mode modes,
+                             nir_should_vectorize_mem_func callback)
+{
+   bool progress = false;
+
+   struct vectorize_ctx ctx = {
+      .modes = modes,
+      .callback = callback,
+   };
+
+   nir_foreach_function(function, shader) {
+      if (function->impl)
+         progress |= vectorize_impl(&ctx, function->impl);
+   }
+
+   return progress;
+}
@@ -31,6 +31,60 @@ typedef struct {
    nir_block *block;
 } write_phi_fixup;
 
+/* Instructions start with a 32-bit header holding the instruction type and
+ * the fields which are small enough to be packed next to it.
+ */
+union packed_instr {
+   uint32_t u32;
+   struct {
+      unsigned instr_type:4;
+      unsigned _pad:28;
+   } any;
+   struct {
+      unsigned instr_type:4;
+      unsigned exact:1;
+      unsigned saturate:1;
+      unsigned write_mask:4;
+      unsigned op:10;
+      unsigned _pad:12;
+   } alu;
+   struct {
+      unsigned instr_type:4;
+      unsigned deref_type:3;
+      unsigned mode:10;
+      unsigned _pad:15;
+   } deref;
+   struct {
+      unsigned instr_type:4;
+      unsigned intrinsic:10;
+      unsigned num_components:3;
+      unsigned _pad:15;
+   } intrinsic;
+   struct {
+      unsigned instr_type:4;
+      unsigned num_components:3;
+      unsigned bit_size:7;
+      unsigned _pad:18;
+   } load_const;
+   struct {
+      unsigned instr_type:4;
+      unsigned num_components:3;
+      unsigned bit_size:7;
+      unsigned _pad:18;
+   } undef;
+   struct {
+      unsigned instr_type:4;
+      unsigned num_srcs:6;
+      unsigned op:5;
+      unsigned _pad:17;
+   } tex;
+   struct {
+      unsigned instr_type:4;
+      unsigned type:2;
+      unsigned _pad:26;
+   } jump;
+};
+
 typedef struct {
    const nir_shader *nir;
 
@@ -40,7 +94,13 @@ typedef struct {
    struct hash_table *remap_table;
 
    /* the next index to assign to a NIR in-memory object */
-   uintptr_t next_idx;
+   uint32_t next_idx;
+
+   /* maps glsl_type pointer to index, so each type is only encoded once */
+   struct hash_table *type_table;
+
+   /* the next index to assign to a glsl_type, 0 is reserved for NULL */
+   uint32_t next_type_idx;
 
    /* Array of write_phi_fixup structs representing phi sources that need to
     * be resolved in the second pass.
@@ -54,14 +114,17 @@ typedef struct {
    struct blob_reader *blob;
 
    /* the next index to assign to a NIR in-memory object */
-   uintptr_t next_idx;
+   uint32_t next_idx;
 
    /* The length of the index -> object table */
-   uintptr_t idx_table_len;
+   uint32_t idx_table_len;
 
    /* map from index to deserialized pointer */
    void **idx_table;
 
+   /* map from type index to decoded glsl_type, in encoding order */
+   struct util_dynarray types;
+
    /* List of phi sources. */
    struct list_head phi_srcs;
 
@@ -70,22 +133,22 @@ typedef struct {
 static void
 write_add_object(write_ctx *ctx, const void *obj)
 {
-   uintptr_t index = ctx->next_idx++;
-   _mesa_hash_table_insert(ctx->remap_table, obj, (void *) index);
+   uint32_t index = ctx->next_idx++;
+   _mesa_hash_table_insert(ctx->remap_table, obj, (void *)(uintptr_t) index);
 }
 
-static uintptr_t
+static uint32_t
 write_lookup_object(write_ctx *ctx, const void *obj)
 {
    struct hash_entry *entry = _mesa_hash_table_search(ctx->remap_table, obj);
    assert(entry);
-   return (uintptr_t) entry->data;
+   return (uint32_t)(uintptr_t) entry->data;
 }
 
 static void
 write_object(write_ctx *ctx, const void *obj)
 {
-   blob_write_intptr(ctx->blob, write_lookup_object(ctx, obj));
+   blob_write_uint32(ctx->blob, write_lookup_object(ctx, obj));
 }
 
 static void
@@ -96,7 +159,7 @@ read_add_object(read_ctx *ctx, void *obj)
 }
 
 static void *
-read_lookup_object(read_ctx *ctx, uintptr_t idx)
+read_lookup_object(read_ctx *ctx, uint32_t idx)
 {
    assert(idx < ctx->idx_table_len);
    return ctx->idx_table[idx];
@@ -105,7 +168,52 @@ read_lookup_object(read_ctx *ctx, uintptr_t idx)
 static void *
 read_object(read_ctx *ctx)
 {
-   return read_lookup_object(ctx, blob_read_intptr(ctx->blob));
+   return read_lookup_object(ctx, blob_read_uint32(ctx->blob));
+}
+
+static void
+write_type(write_ctx *ctx, const struct glsl_type *type)
+{
+   /* Shaders tend to use the same handful of types over and over again,
+    * and struct and interface types are expensive to encode since they
+    * carry all of their field names.  Encode each type the first time we
+    * see it and refer to it by index afterwards.
+    */
+   if (!type) {
+      blob_write_uint32(ctx->blob, 0);
+      return;
+   }
+
+   struct hash_entry *entry = _mesa_hash_table_search(ctx->type_table, type);
+   if (entry) {
+      blob_write_uint32(ctx->blob, (uint32_t)(uintptr_t) entry->data);
+      return;
+   }
+
+   uint32_t index = ctx->next_type_idx++;
+   _mesa_hash_table_insert(ctx->type_table, type, (void *)(uintptr_t) index);
+   blob_write_uint32(ctx->blob, index);
+   encode_type_to_blob(ctx->blob, type);
+}
+
+static const struct glsl_type *
+read_type(read_ctx *ctx)
+{
+   uint32_t index = blob_read_uint32(ctx->blob);
+   if (index == 0)
+      return NULL;
+
+   unsigned num_types =
+      util_dynarray_num_elements(&ctx->types, const struct glsl_type *);
+   if (index <= num_types) {
+      return *util_dynarray_element(&ctx->types, const struct glsl_type *,
+                                    index - 1);
+   }
+
+   assert(index == num_types + 1);
+   const struct glsl_type *type = decode_type_from_blob(ctx->blob);
+   util_dynarray_append(&ctx->types, const struct glsl_type *, type);
+   return type;
 }
 
 static void
@@ -124,9 +232,13 @@ read_constant(read_ctx *ctx, nir_variable *nvar)
 
    blob_copy_bytes(ctx->blob, (uint8_t *)c->values, sizeof(c->values));
    c->num_elements = blob_read_uint32(ctx->blob);
-   c->elements = ralloc_array(nvar, nir_constant *, c->num_elements);
-   for (unsigned i = 0; i < c->num_elements; i++)
-      c->elements[i] = read_constant(ctx, nvar);
+   if (c->num_elements > 0) {
+      c->elements = ralloc_array(nvar, nir_constant *, c->num_elements);
+      for (unsigned i = 0; i < c->num_elements; i++)
+         c->elements[i] = read_constant(ctx, nvar);
+   } else {
+      c->elements = NULL;
+   }
 
    return c;
 }
@@ -135,7 +247,7 @@ static void
 write_variable(write_ctx *ctx, const nir_variable *var)
 {
    write_add_object(ctx, var);
-   encode_type_to_blob(ctx->blob, var->type);
+   write_type(ctx, var->type);
    blob_write_uint32(ctx->blob, !!(var->name));
    if (var->name)
       blob_write_string(ctx->blob, var->name);
@@ -148,7 +260,7 @@ write_variable(write_ctx *ctx, const nir_variable *var)
       write_constant(ctx, var->constant_initializer);
    blob_write_uint32(ctx->blob, !!(var->interface_type));
    if (var->interface_type)
-      encode_type_to_blob(ctx->blob, var->interface_type);
+      write_type(ctx, var->interface_type);
    blob_write_uint32(ctx->blob, var->num_members);
    if (var->num_members > 0) {
       blob_write_bytes(ctx->blob, (uint8_t *) var->members,
@@ -162,7 +274,7 @@ read_variable(read_ctx *ctx)
    nir_variable *var = rzalloc(ctx->nir, nir_variable);
    read_add_object(ctx, var);
 
-   var->type = decode_type_from_blob(ctx->blob);
+   var->type = read_type(ctx);
    bool has_name = blob_read_uint32(ctx->blob);
    if (has_name) {
       const char *name = blob_read_string(ctx->blob);
@@ -172,9 +284,14 @@ read_variable(read_ctx *ctx)
    }
    blob_copy_bytes(ctx->blob, (uint8_t *) &var->data, sizeof(var->data));
    var->num_state_slots = blob_read_uint32(ctx->blob);
-   var->state_slots = ralloc_array(var, nir_state_slot, var->num_state_slots);
-   blob_copy_bytes(ctx->blob, (uint8_t *) var->state_slots,
-                   var->num_state_slots * sizeof(nir_state_slot));
+   if (var->num_state_slots > 0) {
+      var->state_slots = ralloc_array(var, nir_state_slot,
+                                      var->num_state_slots);
+      blob_copy_bytes(ctx->blob, (uint8_t *) var->state_slots,
+                      var->num_state_slots * sizeof(nir_state_slot));
+   } else {
+      var->state_slots = NULL;
+   }
    bool has_const_initializer = blob_read_uint32(ctx->blob);
    if (has_const_initializer)
       var->constant_initializer = read_constant(ctx, var);
@@ -182,7 +299,7 @@ read_variable(read_ctx *ctx)
       var->constant_initializer = NULL;
    bool has_interface_type = blob_read_uint32(ctx->blob);
    if (has_interface_type)
-      var->interface_type = decode_type_from_blob(ctx->blob);
+      var->interface_type = read_type(ctx);
    else
       var->interface_type = NULL;
    var->num_members = blob_read_uint32(ctx->blob);
@@ -281,19 +398,18 @@ write_src(write_ctx *ctx, const nir_src *src)
 {
    /* Since sources are very frequent, we try to save some space when storing
     * them. In particular, we store whether the source is a register and
-    * whether the register has an indirect index in the low two bits. We can
-    * assume that the high two bits of the index are zero, since otherwise our
-    * address space would've been exhausted allocating the remap table!
+    * whether the register has an indirect index in the low two bits, which
+    * leaves 30 bits for the object index.
     */
    if (src->is_ssa) {
-      uintptr_t idx = write_lookup_object(ctx, src->ssa) << 2;
+      uint32_t idx = write_lookup_object(ctx, src->ssa) << 2;
       idx |= 1;
-      blob_write_intptr(ctx->blob, idx);
+      blob_write_uint32(ctx->blob, idx);
    } else {
-      uintptr_t idx = write_lookup_object(ctx, src->reg.reg) << 2;
+      uint32_t idx = write_lookup_object(ctx, src->reg.reg) << 2;
       if (src->reg.indirect)
          idx |= 2;
-      blob_write_intptr(ctx->blob, idx);
+      blob_write_uint32(ctx->blob, idx);
       blob_write_uint32(ctx->blob, src->reg.base_offset);
       if (src->reg.indirect) {
          write_src(ctx, src->reg.indirect);
@@ -304,8 +420,8 @@ write_src(write_ctx *ctx, const nir_src *src)
 static void
 read_src(read_ctx *ctx, nir_src *src, void *mem_ctx)
 {
-   uintptr_t val = blob_read_intptr(ctx->blob);
-   uintptr_t idx = val >> 2;
+   uint32_t val = blob_read_uint32(ctx->blob);
+   uint32_t idx = val >> 2;
    src->is_ssa = val & 0x1;
    if (src->is_ssa) {
       src->ssa = read_lookup_object(ctx, idx);
@@ -339,7 +455,7 @@ write_dest(write_ctx *ctx, const nir_dest *dst)
       if (dst->ssa.name)
          blob_write_string(ctx->blob, dst->ssa.name);
    } else {
-      blob_write_intptr(ctx->blob, write_lookup_object(ctx, dst->reg.reg));
+      write_object(ctx, dst->reg.reg);
       blob_write_uint32(ctx->blob, dst->reg.base_offset);
       if (dst->reg.indirect)
          write_src(ctx, dst->reg.indirect);
@@ -372,17 +488,20 @@ read_dest(read_ctx *ctx, nir_dest *dst, nir_instr *instr)
 static void
 write_alu(write_ctx *ctx, const nir_alu_instr *alu)
 {
-   blob_write_uint32(ctx->blob, alu->op);
-   uint32_t flags = alu->exact;
-   flags |= alu->dest.saturate << 1;
-   flags |= alu->dest.write_mask << 2;
-   blob_write_uint32(ctx->blob, flags);
+   union packed_instr header = {
+      .alu.instr_type = alu->instr.type,
+      .alu.exact = alu->exact,
+      .alu.saturate = alu->dest.saturate,
+      .alu.write_mask = alu->dest.write_mask,
+      .alu.op = alu->op,
+   };
+   blob_write_uint32(ctx->blob, header.u32);
 
    write_dest(ctx, &alu->dest.dest);
 
    for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
       write_src(ctx, &alu->src[i].src);
-      flags = alu->src[i].negate;
+      uint32_t flags = alu->src[i].negate;
       flags |= alu->src[i].abs << 1;
       for (unsigned j = 0; j < 4; j++)
          flags |= alu->src[i].swizzle[j] << (2 + 2 * j);
@@ -391,21 +510,20 @@ write_alu(write_ctx *ctx, const nir_alu_instr *alu)
 }
 
 static nir_alu_instr *
-read_alu(read_ctx *ctx)
+read_alu(read_ctx *ctx, union packed_instr header)
 {
-   nir_op op = blob_read_uint32(ctx->blob);
+   nir_op op = header.alu.op;
    nir_alu_instr *alu = nir_alu_instr_create(ctx->nir, op);
 
-   uint32_t flags = blob_read_uint32(ctx->blob);
-   alu->exact = flags & 1;
-   alu->dest.saturate = flags & 2;
-   alu->dest.write_mask = flags >> 2;
+   alu->exact = header.alu.exact;
+   alu->dest.saturate = header.alu.saturate;
+   alu->dest.write_mask = header.alu.write_mask;
 
    read_dest(ctx, &alu->dest.dest, &alu->instr);
 
    for (unsigned i = 0; i < nir_op_infos[op].num_inputs; i++) {
       read_src(ctx, &alu->src[i].src, &alu->instr);
-      flags = blob_read_uint32(ctx->blob);
+      uint32_t flags = blob_read_uint32(ctx->blob);
       alu->src[i].negate = flags & 1;
       alu->src[i].abs = flags & 2;
       for (unsigned j = 0; j < 4; j++)
@@ -418,10 +536,14 @@ read_alu(read_ctx *ctx)
 static void
 write_deref(write_ctx *ctx, const nir_deref_instr *deref)
 {
-   blob_write_uint32(ctx->blob, deref->deref_type);
+   union packed_instr header = {
+      .deref.instr_type = deref->instr.type,
+      .deref.deref_type = deref->deref_type,
+      .deref.mode = deref->mode,
+   };
+   blob_write_uint32(ctx->blob, header.u32);
 
-   blob_write_uint32(ctx->blob, deref->mode);
-   encode_type_to_blob(ctx->blob, deref->type);
+   write_type(ctx, deref->type);
 
    write_dest(ctx, &deref->dest);
 
@@ -452,13 +574,13 @@ write_deref(write_ctx *ctx, const nir_deref_instr *deref)
 }
 
 static nir_deref_instr *
-read_deref(read_ctx *ctx)
+read_deref(read_ctx *ctx, union packed_instr header)
 {
-   nir_deref_type deref_type = blob_read_uint32(ctx->blob);
+   nir_deref_type deref_type = header.deref.deref_type;
    nir_deref_instr *deref = nir_deref_instr_create(ctx->nir, deref_type);
 
-   deref->mode = blob_read_uint32(ctx->blob);
-   deref->type = decode_type_from_blob(ctx->blob);
+   deref->mode = header.deref.mode;
+   deref->type = read_type(ctx);
 
    read_dest(ctx, &deref->dest, &deref->instr);
 
@@ -493,13 +615,16 @@ read_deref(read_ctx *ctx)
 static void
 write_intrinsic(write_ctx *ctx, const nir_intrinsic_instr *intrin)
 {
-   blob_write_uint32(ctx->blob, intrin->intrinsic);
+   union packed_instr header = {
+      .intrinsic.instr_type = intrin->instr.type,
+      .intrinsic.intrinsic = intrin->intrinsic,
+      .intrinsic.num_components = intrin->num_components,
+   };
+   blob_write_uint32(ctx->blob, header.u32);
 
    unsigned num_srcs = nir_intrinsic_infos[intrin->intrinsic].num_srcs;
    unsigned num_indices = nir_intrinsic_infos[intrin->intrinsic].num_indices;
 
-   blob_write_uint32(ctx->blob, intrin->num_components);
-
    if (nir_intrinsic_infos[intrin->intrinsic].has_dest)
       write_dest(ctx, &intrin->dest);
 
@@ -511,16 +636,16 @@ write_intrinsic(write_ctx *ctx, const nir_intrinsic_instr *intrin)
 }
 
 static nir_intrinsic_instr *
-read_intrinsic(read_ctx *ctx)
+read_intrinsic(read_ctx *ctx, union packed_instr header)
 {
-   nir_intrinsic_op op = blob_read_uint32(ctx->blob);
+   nir_intrinsic_op op = header.intrinsic.intrinsic;
 
    nir_intrinsic_instr *intrin = nir_intrinsic_instr_create(ctx->nir, op);
 
    unsigned num_srcs = nir_intrinsic_infos[op].num_srcs;
    unsigned num_indices = nir_intrinsic_infos[op].num_indices;
 
-   intrin->num_components = blob_read_uint32(ctx->blob);
+   intrin->num_components = header.intrinsic.num_components;
 
    if (nir_intrinsic_infos[op].has_dest)
       read_dest(ctx, &intrin->dest, &intrin->instr);
@@ -534,25 +659,41 @@ read_intrinsic(read_ctx *ctx)
    return intrin;
 }
 
+/* Only the components which are actually used are stored.  The per-bit-size
+ * arrays of nir_const_value all start at the beginning of the union, so this
+ * is just a prefix of it.
+ */
+static unsigned
+load_const_value_size(unsigned num_components, unsigned bit_size)
+{
+   return num_components * DIV_ROUND_UP(bit_size, 8);
+}
+
 static void
 write_load_const(write_ctx *ctx, const nir_load_const_instr *lc)
 {
-   uint32_t val = lc->def.num_components;
-   val |= lc->def.bit_size << 3;
-   blob_write_uint32(ctx->blob, val);
-   blob_write_bytes(ctx->blob, (uint8_t *) &lc->value, sizeof(lc->value));
+   union packed_instr header = {
+      .load_const.instr_type = lc->instr.type,
+      .load_const.num_components = lc->def.num_components,
+      .load_const.bit_size = lc->def.bit_size,
+   };
+   blob_write_uint32(ctx->blob, header.u32);
+   blob_write_bytes(ctx->blob, (uint8_t *) &lc->value,
+                    load_const_value_size(lc->def.num_components,
+                                          lc->def.bit_size));
    write_add_object(ctx, &lc->def);
 }
 
 static nir_load_const_instr *
-read_load_const(read_ctx *ctx)
+read_load_const(read_ctx *ctx, union packed_instr header)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
-
    nir_load_const_instr *lc =
-      nir_load_const_instr_create(ctx->nir, val & 0x7, val >> 3);
+      nir_load_const_instr_create(ctx->nir, header.load_const.num_components,
+                                  header.load_const.bit_size);
 
-   blob_copy_bytes(ctx->blob, (uint8_t *) &lc->value, sizeof(lc->value));
+   blob_copy_bytes(ctx->blob, (uint8_t *) &lc->value,
+                   load_const_value_size(header.load_const.num_components,
+                                         header.load_const.bit_size));
    read_add_object(ctx, &lc->def);
    return lc;
 }
@@ -560,19 +701,21 @@ read_load_const(read_ctx *ctx)
 static void
 write_ssa_undef(write_ctx *ctx, const nir_ssa_undef_instr *undef)
 {
-   uint32_t val = undef->def.num_components;
-   val |= undef->def.bit_size << 3;
-   blob_write_uint32(ctx->blob, val);
+   union packed_instr header = {
+      .undef.instr_type = undef->instr.type,
+      .undef.num_components = undef->def.num_components,
+      .undef.bit_size = undef->def.bit_size,
+   };
+   blob_write_uint32(ctx->blob, header.u32);
    write_add_object(ctx, &undef->def);
 }
 
 static nir_ssa_undef_instr *
-read_ssa_undef(read_ctx *ctx)
+read_ssa_undef(read_ctx *ctx, union packed_instr header)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
-
    nir_ssa_undef_instr *undef =
-      nir_ssa_undef_instr_create(ctx->nir, val & 0x7, val >> 3);
+      nir_ssa_undef_instr_create(ctx->nir, header.undef.num_components,
+                                 header.undef.bit_size);
 
    read_add_object(ctx, &undef->def);
    return undef;
@@ -595,8 +738,12 @@ union packed_tex_data {
 static void
 write_tex(write_ctx *ctx, const nir_tex_instr *tex)
 {
-   blob_write_uint32(ctx->blob, tex->num_srcs);
-   blob_write_uint32(ctx->blob, tex->op);
+   union packed_instr header = {
+      .tex.instr_type = tex->instr.type,
+      .tex.num_srcs = tex->num_srcs,
+      .tex.op = tex->op,
+   };
+   blob_write_uint32(ctx->blob, header.u32);
    blob_write_uint32(ctx->blob, tex->texture_index);
    blob_write_uint32(ctx->blob, tex->texture_array_size);
    blob_write_uint32(ctx->blob, tex->sampler_index);
@@ -621,12 +768,11 @@ write_tex(write_ctx *ctx, const nir_tex_instr *tex)
 }
 
 static nir_tex_instr *
-read_tex(read_ctx *ctx)
+read_tex(read_ctx *ctx, union packed_instr header)
 {
-   unsigned num_srcs = blob_read_uint32(ctx->blob);
-   nir_tex_instr *tex = nir_tex_instr_create(ctx->nir, num_srcs);
+   nir_tex_instr *tex = nir_tex_instr_create(ctx->nir, header.tex.num_srcs);
 
-   tex->op = blob_read_uint32(ctx->blob);
+   tex->op = header.tex.op;
    tex->texture_index = blob_read_uint32(ctx->blob);
    tex->texture_array_size = blob_read_uint32(ctx->blob);
    tex->sampler_index = blob_read_uint32(ctx->blob);
@@ -653,8 +799,13 @@ read_tex(read_ctx *ctx)
 static void
 write_phi(write_ctx *ctx, const nir_phi_instr *phi)
 {
+   union packed_instr header = {
+      .any.instr_type = phi->instr.type,
+   };
+   blob_write_uint32(ctx->blob, header.u32);
+
    /* Phi nodes are special, since they may reference SSA definitions and
-    * basic blocks that don't exist yet. We leave two empty uintptr_t's here,
+    * basic blocks that don't exist yet. We leave two empty uint32_t's here,
     * and then store enough information so that a later fixup pass can fill
     * them in correctly.
     */
@@ -664,9 +815,9 @@ write_phi(write_ctx *ctx, const nir_phi_instr *phi)
 
    nir_foreach_phi_src(src, phi) {
       assert(src->src.is_ssa);
-      size_t blob_offset = blob_reserve_intptr(ctx->blob);
-      MAYBE_UNUSED size_t blob_offset2 = blob_reserve_intptr(ctx->blob);
-      assert(blob_offset + sizeof(uintptr_t) == blob_offset2);
+      size_t blob_offset = blob_reserve_uint32(ctx->blob);
+      MAYBE_UNUSED size_t blob_offset2 = blob_reserve_uint32(ctx->blob);
+      assert(blob_offset + sizeof(uint32_t) == blob_offset2);
       write_phi_fixup fixup = {
          .blob_offset = blob_offset,
          .src = src->src.ssa,
@@ -680,7 +831,7 @@ static void
 write_fixup_phis(write_ctx *ctx)
 {
    util_dynarray_foreach(&ctx->phi_fixups, write_phi_fixup, fixup) {
-      uintptr_t *blob_ptr = (uintptr_t *)(ctx->blob->data + fixup->blob_offset);
+      uint32_t *blob_ptr = (uint32_t *)(ctx->blob->data + fixup->blob_offset);
       blob_ptr[0] = write_lookup_object(ctx, fixup->src);
       blob_ptr[1] = write_lookup_object(ctx, fixup->block);
    }
@@ -711,8 +862,8 @@ read_phi(read_ctx *ctx, nir_block *blk)
       nir_phi_src *src = ralloc(phi, nir_phi_src);
 
       src->src.is_ssa = true;
-      src->src.ssa = (nir_ssa_def *) blob_read_intptr(ctx->blob);
-      src->pred = (nir_block *) blob_read_intptr(ctx->blob);
+      src->src.ssa = (nir_ssa_def *)(uintptr_t) blob_read_uint32(ctx->blob);
+      src->pred = (nir_block *)(uintptr_t) blob_read_uint32(ctx->blob);
 
       /* Since we're not letting nir_insert_instr handle use/def stuff for us,
        * we have to set the parent_instr manually.  It doesn't really matter
@@ -749,21 +900,29 @@ read_fixup_phis(read_ctx *ctx)
 static void
 write_jump(write_ctx *ctx, const nir_jump_instr *jmp)
 {
-   blob_write_uint32(ctx->blob, jmp->type);
+   union packed_instr header = {
+      .jump.instr_type = jmp->instr.type,
+      .jump.type = jmp->type,
+   };
+   blob_write_uint32(ctx->blob, header.u32);
 }
 
 static nir_jump_instr *
-read_jump(read_ctx *ctx)
+read_jump(read_ctx *ctx, union packed_instr header)
 {
-   nir_jump_type type = blob_read_uint32(ctx->blob);
-   nir_jump_instr *jmp = nir_jump_instr_create(ctx->nir, type);
+   nir_jump_instr *jmp = nir_jump_instr_create(ctx->nir, header.jump.type);
    return jmp;
 }
 
 static void
 write_call(write_ctx *ctx, const nir_call_instr *call)
 {
-   blob_write_intptr(ctx->blob, write_lookup_object(ctx, call->callee));
+   union packed_instr header = {
+      .any.instr_type = call->instr.type,
+   };
+   blob_write_uint32(ctx->blob, header.u32);
+
+   write_object(ctx, call->callee);
 
    for (unsigned i = 0; i < call->num_params; i++)
       write_src(ctx, &call->params[i]);
@@ -784,7 +943,7 @@ read_call(read_ctx *ctx)
 static void
 write_instr(write_ctx *ctx, const nir_instr *instr)
 {
-   blob_write_uint32(ctx->blob, instr->type);
+   /* Each write_* function starts with the packed instruction header. */
    switch (instr->type) {
    case nir_instr_type_alu:
       write_alu(ctx, nir_instr_as_alu(instr));
@@ -820,29 +979,37 @@ write_instr(write_ctx *ctx, const nir_instr *instr)
    }
 }
 
+/* Instructions are still allocated one by one through the usual
+ * nir_*_instr_create() helpers rather than carved out of one preallocated
+ * block: passes free individual instructions with ralloc_free() and
+ * nir_sweep() reparents each of them, so every instruction has to be its
+ * own ralloc allocation.
+ */
 static void
 read_instr(read_ctx *ctx, nir_block *block)
 {
-   nir_instr_type type = blob_read_uint32(ctx->blob);
+   union packed_instr header;
+   header.u32 = blob_read_uint32(ctx->blob);
+
    nir_instr *instr;
-   switch (type) {
+   switch (header.any.instr_type) {
    case nir_instr_type_alu:
-      instr = &read_alu(ctx)->instr;
+      instr = &read_alu(ctx, header)->instr;
       break;
    case nir_instr_type_deref:
-      instr = &read_deref(ctx)->instr;
+      instr = &read_deref(ctx, header)->instr;
       break;
    case nir_instr_type_intrinsic:
-      instr = &read_intrinsic(ctx)->instr;
+      instr = &read_intrinsic(ctx, header)->instr;
       break;
    case nir_instr_type_load_const:
-      instr = &read_load_const(ctx)->instr;
+      instr = &read_load_const(ctx, header)->instr;
       break;
    case nir_instr_type_ssa_undef:
-      instr = &read_ssa_undef(ctx)->instr;
+      instr = &read_ssa_undef(ctx, header)->instr;
       break;
    case nir_instr_type_tex:
-      instr = &read_tex(ctx)->instr;
+      instr = &read_tex(ctx, header)->instr;
       break;
    case nir_instr_type_phi:
       /* Phi instructions are a bit of a special case when reading because we
@@ -853,7 +1020,7 @@ read_instr(read_ctx *ctx, nir_block *block)
       read_phi(ctx, block);
       return;
    case nir_instr_type_jump:
-      instr = &read_jump(ctx)->instr;
+      instr = &read_jump(ctx, header)->instr;
       break;
    case nir_instr_type_call:
       instr = &read_call(ctx)->instr;
@@ -1073,11 +1240,20 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
    ctx.remap_table = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
                                              _mesa_key_pointer_equal);
    ctx.next_idx = 0;
+   ctx.type_table = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                            _mesa_key_pointer_equal);
+   ctx.next_type_idx = 1;
    ctx.blob = blob;
    ctx.nir = nir;
    util_dynarray_init(&ctx.phi_fixups, NULL);
 
-   size_t idx_size_offset = blob_reserve_intptr(blob);
+   STATIC_ASSERT(sizeof(union packed_instr) == sizeof(uint32_t));
+   STATIC_ASSERT(nir_num_opcodes <= (1 << 10));
+   STATIC_ASSERT(nir_num_intrinsics <= (1 << 10));
+   STATIC_ASSERT(nir_num_tex_src_types < (1 << 6));
+   STATIC_ASSERT(nir_texop_samples_identical < (1 << 5));
+
+   size_t idx_size_offset = blob_reserve_uint32(blob);
 
    struct shader_info info = nir->info;
    uint32_t strings = 0;
@@ -1120,9 +1296,10 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
    if (nir->constant_data_size > 0)
       blob_write_bytes(blob, nir->constant_data, nir->constant_data_size);
 
-   *(uintptr_t *)(blob->data + idx_size_offset) = ctx.next_idx;
+   blob_overwrite_uint32(blob, idx_size_offset, ctx.next_idx);
 
    _mesa_hash_table_destroy(ctx.remap_table, NULL);
+   _mesa_hash_table_destroy(ctx.type_table, NULL);
    util_dynarray_fini(&ctx.phi_fixups);
 }
 
@@ -1134,9 +1311,11 @@ nir_deserialize(void *mem_ctx,
    read_ctx ctx;
    ctx.blob = blob;
    list_inithead(&ctx.phi_srcs);
-   ctx.idx_table_len = blob_read_intptr(blob);
-   ctx.idx_table = calloc(ctx.idx_table_len, sizeof(uintptr_t));
+   ctx.idx_table_len = blob_read_uint32(blob);
+   /* Every entry is written before it is read, so no need to clear it. */
+   ctx.idx_table = malloc(ctx.idx_table_len * sizeof(void *));
    ctx.next_idx = 0;
+   util_dynarray_init(&ctx.types, NULL);
 
    uint32_t strings = blob_read_uint32(blob);
    char *name = (strings & 0x1) ? blob_read_string(blob) : NULL;
@@ -1182,6 +1361,7 @@ nir_deserialize(void *mem_ctx,
    }
 
    free(ctx.idx_table);
+   util_dynarray_fini(&ctx.types);
 
    return ctx.nir;
 }
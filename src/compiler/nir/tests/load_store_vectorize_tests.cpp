@@ -0,0 +1,434 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+
+namespace {
+
+class nir_load_store_vectorize_test : public ::testing::Test {
+protected:
+   nir_load_store_vectorize_test();
+   ~nir_load_store_vectorize_test();
+
+   nir_intrinsic_instr *create_load(nir_intrinsic_op op, uint32_t binding,
+                                    nir_ssa_def *offset,
+                                    unsigned bit_size = 32,
+                                    unsigned components = 1);
+   nir_intrinsic_instr *create_store(nir_intrinsic_op op, uint32_t binding,
+                                     nir_ssa_def *offset, nir_ssa_def *value,
+                                     unsigned wrmask = 0x1);
+
+   unsigned count_intrinsics(nir_intrinsic_op intrinsic);
+
+   nir_intrinsic_instr *find_next_intrinsic(nir_intrinsic_op intrinsic,
+                                            nir_intrinsic_instr *after);
+
+   static bool allow_vec4(unsigned align, unsigned bit_size,
+                          unsigned num_components, unsigned high_offset,
+                          nir_intrinsic_instr *low, nir_intrinsic_instr *high)
+   {
+      return num_components <= 4;
+   }
+
+   static bool allow_none(unsigned align, unsigned bit_size,
+                          unsigned num_components, unsigned high_offset,
+                          nir_intrinsic_instr *low, nir_intrinsic_instr *high)
+   {
+      return false;
+   }
+
+   nir_ssa_def *get_resource(uint32_t binding);
+
+   void *mem_ctx;
+
+   nir_builder *b;
+   nir_ssa_def *resources[4];
+};
+
+nir_load_store_vectorize_test::nir_load_store_vectorize_test()
+{
+   mem_ctx = ralloc_context(NULL);
+   static const nir_shader_compiler_options options = { };
+   b = rzalloc(mem_ctx, nir_builder);
+   nir_builder_init_simple_shader(b, mem_ctx, MESA_SHADER_COMPUTE, &options);
+   memset(resources, 0, sizeof(resources));
+}
+
+nir_load_store_vectorize_test::~nir_load_store_vectorize_test()
+{
+   if (HasFailure()) {
+      printf("\nShader from the failed test:\n\n");
+      nir_print_shader(b->shader, stdout);
+   }
+
+   ralloc_free(mem_ctx);
+}
+
+nir_ssa_def *
+nir_load_store_vectorize_test::get_resource(uint32_t binding)
+{
+   /* Accesses to the same binding must share the resource SSA value. */
+   assert(binding < ARRAY_SIZE(resources));
+   if (!resources[binding])
+      resources[binding] = nir_imm_int(b, binding);
+   return resources[binding];
+}
+
+nir_intrinsic_instr *
+nir_load_store_vectorize_test::create_load(nir_intrinsic_op op,
+                                           uint32_t binding,
+                                           nir_ssa_def *offset,
+                                           unsigned bit_size,
+                                           unsigned components)
+{
+   nir_intrinsic_instr *load = nir_intrinsic_instr_create(b->shader, op);
+   load->num_components = components;
+   if (op == nir_intrinsic_load_shared) {
+      load->src[0] = nir_src_for_ssa(offset);
+      nir_intrinsic_set_base(load, 0);
+   } else {
+      load->src[0] = nir_src_for_ssa(get_resource(binding));
+      load->src[1] = nir_src_for_ssa(offset);
+   }
+   nir_intrinsic_set_align(load, bit_size / 8, 0);
+   nir_ssa_dest_init(&load->instr, &load->dest, components, bit_size, NULL);
+   nir_builder_instr_insert(b, &load->instr);
+   return load;
+}
+
+nir_intrinsic_instr *
+nir_load_store_vectorize_test::create_store(nir_intrinsic_op op,
+                                            uint32_t binding,
+                                            nir_ssa_def *offset,
+                                            nir_ssa_def *value,
+                                            unsigned wrmask)
+{
+   nir_intrinsic_instr *store = nir_intrinsic_instr_create(b->shader, op);
+   store->num_components = value->num_components;
+   store->src[0] = nir_src_for_ssa(value);
+   if (op == nir_intrinsic_store_shared) {
+      store->src[1] = nir_src_for_ssa(offset);
+      nir_intrinsic_set_base(store, 0);
+   } else {
+      store->src[1] = nir_src_for_ssa(get_resource(binding));
+      store->src[2] = nir_src_for_ssa(offset);
+   }
+   nir_intrinsic_set_write_mask(store, wrmask);
+   nir_intrinsic_set_align(store, value->bit_size / 8, 0);
+   nir_builder_instr_insert(b, &store->instr);
+   return store;
+}
+
+unsigned
+nir_load_store_vectorize_test::count_intrinsics(nir_intrinsic_op intrinsic)
+{
+   unsigned count = 0;
+   nir_foreach_block(block, b->impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_intrinsic)
+            continue;
+         nir_intrinsic_instr *intrin = nir_instr_as_intrinsic(instr);
+         if (intrin->intrinsic == intrinsic)
+            count++;
+      }
+   }
+   return count;
+}
+
+nir_intrinsic_instr *
+nir_load_store_vectorize_test::find_next_intrinsic(nir_intrinsic_op intrinsic,
+                                                   nir_intrinsic_instr *after)
+{
+   bool seen = after == NULL;
+   nir_foreach_block(block, b->impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_intrinsic)
+            continue;
+         nir_intrinsic_instr *intrin = nir_instr_as_intrinsic(instr);
+         if (!seen) {
+            seen = (after == intrin);
+            continue;
+         }
+         if (intrin->intrinsic == intrinsic)
+            return intrin;
+      }
+   }
+   return NULL;
+}
+
+} // namespace
+
+TEST_F(nir_load_store_vectorize_test, ubo_load_adjacent)
+{
+   create_load(nir_intrinsic_load_ubo, 0, nir_imm_int(b, 0));
+   create_load(nir_intrinsic_load_ubo, 0, nir_imm_int(b, 4));
+
+   nir_validate_shader(b->shader, NULL);
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_ubo), 2);
+
+   EXPECT_TRUE(nir_opt_load_store_vectorize(b->shader, nir_var_uniform,
+                                            allow_vec4));
+
+   nir_validate_shader(b->shader, NULL);
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_ubo), 1);
+
+   nir_intrinsic_instr *load = find_next_intrinsic(nir_intrinsic_load_ubo, NULL);
+   EXPECT_EQ(load->dest.ssa.num_components, 2);
+   EXPECT_EQ(load->dest.ssa.bit_size, 32);
+   EXPECT_EQ(nir_src_as_uint(load->src[1]), 0);
+}
+
+TEST_F(nir_load_store_vectorize_test, ubo_load_indirect_adjacent)
+{
+   nir_ssa_def *index = nir_load_local_invocation_index(b);
+   nir_ssa_def *base = nir_imul(b, index, nir_imm_int(b, 16));
+
+   create_load(nir_intrinsic_load_ubo, 0, nir_iadd(b, base, nir_imm_int(b, 4)));
+   create_load(nir_intrinsic_load_ubo, 0, base);
+   create_load(nir_intrinsic_load_ubo, 0, nir_iadd(b, base, nir_imm_int(b, 8)));
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(nir_opt_load_store_vectorize(b->shader, nir_var_uniform,
+                                            allow_vec4));
+
+   nir_validate_shader(b->shader, NULL);
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_ubo), 1);
+
+   nir_intrinsic_instr *load = find_next_intrinsic(nir_intrinsic_load_ubo, NULL);
+   EXPECT_EQ(load->dest.ssa.num_components, 3);
+}
+
+TEST_F(nir_load_store_vectorize_test, ubo_load_different_bindings)
+{
+   create_load(nir_intrinsic_load_ubo, 0, nir_imm_int(b, 0));
+   create_load(nir_intrinsic_load_ubo, 1, nir_imm_int(b, 4));
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_FALSE(nir_opt_load_store_vectorize(b->shader, nir_var_uniform,
+                                             allow_vec4));
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_ubo), 2);
+}
+
+TEST_F(nir_load_store_vectorize_test, ubo_load_gap)
+{
+   create_load(nir_intrinsic_load_ubo, 0, nir_imm_int(b, 0));
+   create_load(nir_intrinsic_load_ubo, 0, nir_imm_int(b, 8));
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_FALSE(nir_opt_load_store_vectorize(b->shader, nir_var_uniform,
+                                             allow_vec4));
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_ubo), 2);
+}
+
+TEST_F(nir_load_store_vectorize_test, ubo_load_callback_rejects)
+{
+   create_load(nir_intrinsic_load_ubo, 0, nir_imm_int(b, 0));
+   create_load(nir_intrinsic_load_ubo, 0, nir_imm_int(b, 4));
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_FALSE(nir_opt_load_store_vectorize(b->shader, nir_var_uniform,
+                                             allow_none));
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_ubo), 2);
+}
+
+TEST_F(nir_load_store_vectorize_test, ssbo_load_mixed_bit_sizes)
+{
+   create_load(nir_intrinsic_load_ssbo, 0, nir_imm_int(b, 0), 32, 1);
+   create_load(nir_intrinsic_load_ssbo, 0, nir_imm_int(b, 4), 64, 1);
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(nir_opt_load_store_vectorize(b->shader,
+                                            nir_var_shader_storage,
+                                            allow_vec4));
+
+   nir_validate_shader(b->shader, NULL);
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_ssbo), 1);
+
+   nir_intrinsic_instr *load = find_next_intrinsic(nir_intrinsic_load_ssbo, NULL);
+   EXPECT_EQ(load->dest.ssa.num_components, 3);
+   EXPECT_EQ(load->dest.ssa.bit_size, 32);
+}
+
+TEST_F(nir_load_store_vectorize_test, ssbo_load_across_aliasing_store)
+{
+   nir_ssa_def *index = nir_load_local_invocation_index(b);
+
+   create_load(nir_intrinsic_load_ssbo, 0, nir_imm_int(b, 0));
+   create_store(nir_intrinsic_store_ssbo, 0, index, nir_imm_int(b, 1));
+   create_load(nir_intrinsic_load_ssbo, 0, nir_imm_int(b, 4));
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_FALSE(nir_opt_load_store_vectorize(b->shader,
+                                             nir_var_shader_storage,
+                                             allow_vec4));
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_ssbo), 2);
+}
+
+TEST_F(nir_load_store_vectorize_test, ssbo_load_across_disjoint_store)
+{
+   create_load(nir_intrinsic_load_ssbo, 0, nir_imm_int(b, 0));
+   create_store(nir_intrinsic_store_ssbo, 0, nir_imm_int(b, 16),
+                nir_imm_int(b, 1));
+   create_load(nir_intrinsic_load_ssbo, 0, nir_imm_int(b, 4));
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(nir_opt_load_store_vectorize(b->shader,
+                                            nir_var_shader_storage,
+                                            allow_vec4));
+
+   nir_validate_shader(b->shader, NULL);
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_ssbo), 1);
+}
+
+TEST_F(nir_load_store_vectorize_test, ssbo_load_across_negative_offset_store)
+{
+   /* The store covers index - 4 to index + 12, so it overlaps both loads
+    * even though its constant offset is negative.
+    */
+   nir_ssa_def *index = nir_load_local_invocation_index(b);
+
+   create_load(nir_intrinsic_load_ssbo, 0, nir_iadd(b, index, nir_imm_int(b, 4)));
+   create_store(nir_intrinsic_store_ssbo, 0,
+                nir_iadd(b, index, nir_imm_int(b, -4)),
+                nir_imm_ivec4(b, 1, 2, 3, 4), 0xf);
+   create_load(nir_intrinsic_load_ssbo, 0, nir_iadd(b, index, nir_imm_int(b, 8)));
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_FALSE(nir_opt_load_store_vectorize(b->shader,
+                                             nir_var_shader_storage,
+                                             allow_vec4));
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_ssbo), 2);
+}
+
+TEST_F(nir_load_store_vectorize_test, ssbo_store_adjacent)
+{
+   create_store(nir_intrinsic_store_ssbo, 0, nir_imm_int(b, 0),
+                nir_imm_int(b, 1));
+   create_store(nir_intrinsic_store_ssbo, 0, nir_imm_int(b, 4),
+                nir_imm_int(b, 2));
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(nir_opt_load_store_vectorize(b->shader,
+                                            nir_var_shader_storage,
+                                            allow_vec4));
+
+   nir_validate_shader(b->shader, NULL);
+   nir_opt_constant_folding(b->shader);
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_store_ssbo), 1);
+
+   nir_intrinsic_instr *store = find_next_intrinsic(nir_intrinsic_store_ssbo, NULL);
+   EXPECT_EQ(store->num_components, 2);
+   EXPECT_EQ(nir_intrinsic_write_mask(store), 0x3);
+   ASSERT_TRUE(nir_src_is_const(store->src[0]));
+   EXPECT_EQ(nir_src_comp_as_uint(store->src[0], 0), 1);
+   EXPECT_EQ(nir_src_comp_as_uint(store->src[0], 1), 2);
+}
+
+TEST_F(nir_load_store_vectorize_test, ssbo_store_overlapping)
+{
+   /* The later store must win where the two overlap. */
+   create_store(nir_intrinsic_store_ssbo, 0, nir_imm_int(b, 0),
+                nir_imm_ivec2(b, 1, 2), 0x3);
+   create_store(nir_intrinsic_store_ssbo, 0, nir_imm_int(b, 4),
+                nir_imm_ivec2(b, 3, 4), 0x3);
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(nir_opt_load_store_vectorize(b->shader,
+                                            nir_var_shader_storage,
+                                            allow_vec4));
+
+   nir_validate_shader(b->shader, NULL);
+   nir_opt_constant_folding(b->shader);
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_store_ssbo), 1);
+
+   nir_intrinsic_instr *store = find_next_intrinsic(nir_intrinsic_store_ssbo, NULL);
+   EXPECT_EQ(store->num_components, 3);
+   ASSERT_TRUE(nir_src_is_const(store->src[0]));
+   EXPECT_EQ(nir_src_comp_as_uint(store->src[0], 0), 1);
+   EXPECT_EQ(nir_src_comp_as_uint(store->src[0], 1), 3);
+   EXPECT_EQ(nir_src_comp_as_uint(store->src[0], 2), 4);
+}
+
+TEST_F(nir_load_store_vectorize_test, ssbo_store_across_aliasing_load)
+{
+   nir_ssa_def *index = nir_load_local_invocation_index(b);
+
+   create_store(nir_intrinsic_store_ssbo, 0, nir_imm_int(b, 0),
+                nir_imm_int(b, 1));
+   create_load(nir_intrinsic_load_ssbo, 0, index);
+   create_store(nir_intrinsic_store_ssbo, 0, nir_imm_int(b, 4),
+                nir_imm_int(b, 2));
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_FALSE(nir_opt_load_store_vectorize(b->shader,
+                                             nir_var_shader_storage,
+                                             allow_vec4));
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_store_ssbo), 2);
+}
+
+TEST_F(nir_load_store_vectorize_test, shared_load_across_barrier)
+{
+   create_load(nir_intrinsic_load_shared, 0, nir_imm_int(b, 0));
+   nir_intrinsic_instr *barrier =
+      nir_intrinsic_instr_create(b->shader, nir_intrinsic_barrier);
+   nir_builder_instr_insert(b, &barrier->instr);
+   create_load(nir_intrinsic_load_shared, 0, nir_imm_int(b, 4));
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_FALSE(nir_opt_load_store_vectorize(b->shader, nir_var_shared,
+                                             allow_vec4));
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_shared), 2);
+}
+
+TEST_F(nir_load_store_vectorize_test, shared_load_adjacent)
+{
+   create_load(nir_intrinsic_load_shared, 0, nir_imm_int(b, 4));
+   create_load(nir_intrinsic_load_shared, 0, nir_imm_int(b, 0));
+
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(nir_opt_load_store_vectorize(b->shader, nir_var_shared,
+                                            allow_vec4));
+
+   nir_validate_shader(b->shader, NULL);
+   ASSERT_EQ(count_intrinsics(nir_intrinsic_load_shared), 1);
+
+   nir_intrinsic_instr *load = find_next_intrinsic(nir_intrinsic_load_shared, NULL);
+   EXPECT_EQ(load->dest.ssa.num_components, 2);
+   EXPECT_EQ(nir_src_as_uint(load->src[0]), 0);
+}
@@ -81,6 +81,39 @@ nir_function *spirv_to_nir(const uint32_t *words, size_t word_count,
                            const struct spirv_to_nir_options *options,
                            const nir_shader_compiler_options *nir_options);
 
+/* A parsed SPIR-V module.
+ *
+ * spirv_module_create() runs the stage and specialization independent part
+ * of the translation once: the preamble, and the types and constants which
+ * don't depend on specialization constants.  spirv_module_to_nir() can
+ * then be called any number of times, possibly from several threads at
+ * once, to build the NIR for a given entry point and set of specialization
+ * constants.  Specialization constants, the types and constants built from
+ * them, variables and the CFG are still built by every
+ * spirv_module_to_nir() call.  The words passed to spirv_module_create()
+ * must outlive the module.
+ *
+ * The module is a single allocation made through alloc.  If alloc is NULL
+ * it comes from malloc() and is released with spirv_module_destroy(),
+ * otherwise the caller releases it with its own matching free function.
+ */
+struct spirv_module;
+
+struct spirv_module *
+spirv_module_create(const uint32_t *words, size_t word_count,
+                    const struct spirv_to_nir_options *options,
+                    void *(*alloc)(void *data, size_t size),
+                    void *alloc_data);
+
+void spirv_module_destroy(struct spirv_module *module);
+
+nir_function *
+spirv_module_to_nir(const struct spirv_module *module,
+                    struct nir_spirv_specialization *specializations,
+                    unsigned num_specializations,
+                    gl_shader_stage stage, const char *entry_point_name,
+                    const nir_shader_compiler_options *nir_options);
+
 #ifdef __cplusplus
 }
 #endif
@@ -31,6 +31,7 @@
 #include "nir/nir_constant_expressions.h"
 #include "nir/nir_deref.h"
 #include "spirv_info.h"
+#include "util/u_math.h"
 
 #include <stdio.h>
 
@@ -3347,6 +3348,22 @@ vtn_handle_entry_point(struct vtn_builder *b, const uint32_t *w,
    unsigned name_words;
    entry_point->name = vtn_string_literal(b, &w[3], count - 3, &name_words);
 
+   /* When parsing a module for later instantiation, the entry point is not
+    * known yet.  Just record it so that spirv_module_to_nir() can pick one.
+    */
+   if (b->module_entry_points) {
+      struct vtn_module_entry_point ep = {
+         .value_id = w[2],
+         /* Don't fail on models we can't handle unless they get picked */
+         .stage = w[1] <= SpvExecutionModelGLCompute ?
+                  stage_for_execution_model(b, w[1]) : MESA_SHADER_NONE,
+         .name = entry_point->name,
+      };
+      util_dynarray_append(b->module_entry_points,
+                           struct vtn_module_entry_point, ep);
+      return;
+   }
+
    if (strcmp(entry_point->name, b->entry_point_name) != 0 ||
        stage_for_execution_model(b, w[1]) != b->entry_point_stage)
       return;
@@ -3843,6 +3860,178 @@ vtn_handle_variable_or_type_instruction(struct vtn_builder *b, SpvOp opcode,
    return true;
 }
 
+static bool
+vtn_value_is_type_or_constant(struct vtn_builder *b, uint32_t value_id)
+{
+   const struct vtn_value *val = vtn_untyped_value(b, value_id);
+   return val->value_type == vtn_value_type_type ||
+          val->value_type == vtn_value_type_constant;
+}
+
+/* Whether all the types and constants a type instruction refers to have
+ * been built while parsing the module.
+ */
+static bool
+vtn_module_type_operands_built(struct vtn_builder *b, SpvOp opcode,
+                               const uint32_t *w, unsigned count)
+{
+   unsigned first = 2, end;
+
+   switch (opcode) {
+   case SpvOpTypeVector:
+   case SpvOpTypeMatrix:
+   case SpvOpTypeImage:
+   case SpvOpTypeSampledImage:
+   case SpvOpTypeRuntimeArray:
+      end = 3;
+      break;
+   case SpvOpTypeArray:
+      end = 4;
+      break;
+   case SpvOpTypePointer:
+      first = 3;
+      end = 4;
+      break;
+   case SpvOpTypeStruct:
+   case SpvOpTypeFunction:
+      end = count;
+      break;
+   default:
+      end = 2;
+      break;
+   }
+
+   for (unsigned i = first; i < end; i++) {
+      if (!vtn_value_is_type_or_constant(b, w[i]))
+         return false;
+   }
+
+   return true;
+}
+
+/* Build the types and constants which don't depend on specialization
+ * constants or on the stage, for spirv_module_create().  Everything else
+ * is left for spirv_module_to_nir(), which skips what was built here.
+ */
+static bool
+vtn_handle_module_type_instruction(struct vtn_builder *b, SpvOp opcode,
+                                   const uint32_t *w, unsigned count)
+{
+   switch (opcode) {
+   case SpvOpTypeVoid:
+   case SpvOpTypeBool:
+   case SpvOpTypeInt:
+   case SpvOpTypeFloat:
+   case SpvOpTypeVector:
+   case SpvOpTypeMatrix:
+   case SpvOpTypeImage:
+   case SpvOpTypeSampler:
+   case SpvOpTypeSampledImage:
+   case SpvOpTypeArray:
+   case SpvOpTypeRuntimeArray:
+   case SpvOpTypeStruct:
+   case SpvOpTypeOpaque:
+   case SpvOpTypePointer:
+   case SpvOpTypeFunction:
+   case SpvOpTypeEvent:
+   case SpvOpTypeDeviceEvent:
+   case SpvOpTypeReserveId:
+   case SpvOpTypeQueue:
+   case SpvOpTypePipe:
+      if (vtn_module_type_operands_built(b, opcode, w, count))
+         vtn_handle_type(b, opcode, w, count);
+      break;
+
+   case SpvOpConstantTrue:
+   case SpvOpConstantFalse:
+   case SpvOpConstant:
+   case SpvOpConstantComposite:
+   case SpvOpConstantNull: {
+      /* A WorkgroupSize decoration sets the shader's local size, so leave
+       * decorated constants to the instances.
+       */
+      if (vtn_untyped_value(b, w[2])->decoration ||
+          vtn_untyped_value(b, w[1])->value_type != vtn_value_type_type)
+         break;
+
+      if (opcode == SpvOpConstantComposite) {
+         for (unsigned i = 3; i < count; i++) {
+            if (vtn_untyped_value(b, w[i])->value_type !=
+                vtn_value_type_constant)
+               return true;
+         }
+      }
+
+      vtn_set_instruction_result_type(b, opcode, w, count);
+      vtn_handle_constant(b, opcode, w, count);
+      break;
+   }
+
+   case SpvOpConstantSampler:
+   case SpvOpSpecConstantTrue:
+   case SpvOpSpecConstantFalse:
+   case SpvOpSpecConstant:
+   case SpvOpSpecConstantComposite:
+   case SpvOpSpecConstantOp:
+   case SpvOpUndef:
+   case SpvOpVariable:
+      break;
+
+   default:
+      return false; /* End of preamble */
+   }
+
+   return true;
+}
+
+/* Like vtn_handle_variable_or_type_instruction(), skipping the types and
+ * constants which the module already holds.
+ */
+static bool
+vtn_handle_instance_type_instruction(struct vtn_builder *b, SpvOp opcode,
+                                     const uint32_t *w, unsigned count)
+{
+   switch (opcode) {
+   case SpvOpTypeVoid:
+   case SpvOpTypeBool:
+   case SpvOpTypeInt:
+   case SpvOpTypeFloat:
+   case SpvOpTypeVector:
+   case SpvOpTypeMatrix:
+   case SpvOpTypeImage:
+   case SpvOpTypeSampler:
+   case SpvOpTypeSampledImage:
+   case SpvOpTypeArray:
+   case SpvOpTypeRuntimeArray:
+   case SpvOpTypeStruct:
+   case SpvOpTypeOpaque:
+   case SpvOpTypePointer:
+   case SpvOpTypeFunction:
+   case SpvOpTypeEvent:
+   case SpvOpTypeDeviceEvent:
+   case SpvOpTypeReserveId:
+   case SpvOpTypeQueue:
+   case SpvOpTypePipe:
+      if (vtn_untyped_value(b, w[1])->value_type == vtn_value_type_type)
+         return true;
+      break;
+
+   case SpvOpConstantTrue:
+   case SpvOpConstantFalse:
+   case SpvOpConstant:
+   case SpvOpConstantComposite:
+   case SpvOpConstantNull:
+      if (vtn_untyped_value(b, w[2])->value_type == vtn_value_type_constant)
+         return true;
+      break;
+
+   default:
+      break;
+   }
+
+   return vtn_handle_variable_or_type_instruction(b, opcode, w, count);
+}
+
 static bool
 vtn_handle_body_instruction(struct vtn_builder *b, SpvOp opcode,
                             const uint32_t *w, unsigned count)
@@ -4232,23 +4421,184 @@ vtn_create_builder(const uint32_t *words, size_t word_count,
    return NULL;
 }
 
-nir_function *
-spirv_to_nir(const uint32_t *words, size_t word_count,
-             struct nir_spirv_specialization *spec, unsigned num_spec,
-             gl_shader_stage stage, const char *entry_point_name,
-             const struct spirv_to_nir_options *options,
-             const nir_shader_compiler_options *nir_options)
+static size_t
+module_string_size(const char *str)
+{
+   return str ? strlen(str) + 1 : 0;
+}
+
+static const char *
+module_copy_string(char **dst, const char *str)
+{
+   if (str == NULL)
+      return NULL;
+
+   size_t size = strlen(str) + 1;
+   char *copy = memcpy(*dst, str, size);
+   *dst += size;
+   return copy;
+}
+
+/* The size of a copy of type, and of everything it points to that wasn't
+ * counted yet, in module memory.
+ */
+static size_t
+module_type_size(struct set *seen, const struct vtn_type *type)
+{
+   if (type == NULL || _mesa_set_search(seen, type))
+      return 0;
+
+   _mesa_set_add(seen, type);
+   size_t size = align64(sizeof(*type), 8);
+
+   switch (type->base_type) {
+   case vtn_base_type_vector:
+   case vtn_base_type_matrix:
+   case vtn_base_type_array:
+      size += module_type_size(seen, type->array_element);
+      break;
+   case vtn_base_type_struct:
+      size += align64(type->length * sizeof(*type->members), 8);
+      size += align64(type->length * sizeof(*type->offsets), 8);
+      for (unsigned i = 0; i < type->length; i++)
+         size += module_type_size(seen, type->members[i]);
+      break;
+   case vtn_base_type_pointer:
+      size += module_type_size(seen, type->deref);
+      break;
+   case vtn_base_type_sampled_image:
+      size += module_type_size(seen, type->image);
+      break;
+   case vtn_base_type_function:
+      size += align64(type->length * sizeof(*type->params), 8);
+      size += module_type_size(seen, type->return_type);
+      for (unsigned i = 0; i < type->length; i++)
+         size += module_type_size(seen, type->params[i]);
+      break;
+   default:
+      break;
+   }
+
+   return size;
+}
+
+static size_t
+module_constant_size(struct set *seen, const nir_constant *constant)
+{
+   if (_mesa_set_search(seen, constant))
+      return 0;
+
+   _mesa_set_add(seen, constant);
+   size_t size = align64(sizeof(*constant), 8) +
+                 align64(constant->num_elements *
+                         sizeof(*constant->elements), 8);
+   for (unsigned i = 0; i < constant->num_elements; i++)
+      size += module_constant_size(seen, constant->elements[i]);
+
+   return size;
+}
+
+static void *
+module_copy_block(char **dst, const void *src, size_t size)
+{
+   if (size == 0)
+      return NULL;
+
+   void *copy = memcpy(*dst, src, size);
+   *dst += align64(size, 8);
+   return copy;
+}
+
+/* Copy type and everything it points to into module memory, once. */
+static struct vtn_type *
+module_copy_type(struct hash_table *copies, char **dst,
+                 const struct vtn_type *type)
+{
+   if (type == NULL)
+      return NULL;
+
+   struct hash_entry *entry = _mesa_hash_table_search(copies, type);
+   if (entry)
+      return entry->data;
+
+   struct vtn_type *copy = module_copy_block(dst, type, sizeof(*type));
+   _mesa_hash_table_insert(copies, type, copy);
+
+   switch (type->base_type) {
+   case vtn_base_type_vector:
+   case vtn_base_type_matrix:
+   case vtn_base_type_array:
+      copy->array_element =
+         module_copy_type(copies, dst, type->array_element);
+      break;
+   case vtn_base_type_struct:
+      copy->members = module_copy_block(dst, type->members,
+                                        type->length * sizeof(*type->members));
+      copy->offsets = module_copy_block(dst, type->offsets,
+                                        type->length * sizeof(*type->offsets));
+      for (unsigned i = 0; i < type->length; i++)
+         copy->members[i] = module_copy_type(copies, dst, type->members[i]);
+      break;
+   case vtn_base_type_pointer:
+      copy->deref = module_copy_type(copies, dst, type->deref);
+      break;
+   case vtn_base_type_sampled_image:
+      copy->image = module_copy_type(copies, dst, type->image);
+      break;
+   case vtn_base_type_function:
+      copy->params = module_copy_block(dst, type->params,
+                                       type->length * sizeof(*type->params));
+      copy->return_type = module_copy_type(copies, dst, type->return_type);
+      for (unsigned i = 0; i < type->length; i++)
+         copy->params[i] = module_copy_type(copies, dst, type->params[i]);
+      break;
+   default:
+      break;
+   }
+
+   return copy;
+}
+
+static nir_constant *
+module_copy_constant(struct hash_table *copies, char **dst,
+                     const nir_constant *constant)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(copies, constant);
+   if (entry)
+      return entry->data;
+
+   nir_constant *copy = module_copy_block(dst, constant, sizeof(*constant));
+   _mesa_hash_table_insert(copies, constant, copy);
 
+   copy->elements =
+      module_copy_block(dst, constant->elements,
+                        constant->num_elements * sizeof(*constant->elements));
+   for (unsigned i = 0; i < constant->num_elements; i++) {
+      copy->elements[i] =
+         module_copy_constant(copies, dst, constant->elements[i]);
+   }
+
+   return copy;
+}
+
+struct spirv_module *
+spirv_module_create(const uint32_t *words, size_t word_count,
+                    const struct spirv_to_nir_options *options,
+                    void *(*alloc)(void *data, size_t size),
+                    void *alloc_data)
 {
    const uint32_t *word_end = words + word_count;
 
    struct vtn_builder *b = vtn_create_builder(words, word_count,
-                                              stage, entry_point_name,
+                                              MESA_SHADER_NONE, NULL,
                                               options);
-
    if (b == NULL)
       return NULL;
 
+   struct util_dynarray entry_points;
+   util_dynarray_init(&entry_points, b);
+   b->module_entry_points = &entry_points;
+
    /* See also _vtn_fail() */
    if (setjmp(b->fail_jump)) {
       ralloc_free(b);
@@ -4256,11 +4606,186 @@ spirv_to_nir(const uint32_t *words, size_t word_count,
    }
 
    /* Skip the SPIR-V header, handled at vtn_create_builder */
-   words+= 5;
+   words += 5;
 
    /* Handle all the preamble instructions */
-   words = vtn_foreach_instruction(b, words, word_end,
-                                   vtn_handle_preamble_instruction);
+   const uint32_t *body =
+      vtn_foreach_instruction(b, words, word_end,
+                              vtn_handle_preamble_instruction);
+
+   /* Types and constants only depend on specialization constants through
+    * array lengths and OpSpecConstantOp, so most can be built once too.
+    */
+   vtn_foreach_instruction(b, body, word_end,
+                           vtn_handle_module_type_instruction);
+
+   /* That leaves names, strings, extension handlers, decorations, types and
+    * constants behind.  Copy all of it into a single block so that the
+    * caller decides where the module lives.
+    */
+   const unsigned num_entry_points =
+      util_dynarray_num_elements(&entry_points,
+                                 struct vtn_module_entry_point);
+   struct set *seen = _mesa_set_create(b, _mesa_hash_pointer,
+                                       _mesa_key_pointer_equal);
+   unsigned num_decorations = 0;
+   size_t types_size = 0;
+   size_t strings_size = 0;
+   for (unsigned i = 0; i < b->value_id_bound; i++) {
+      const struct vtn_value *val = &b->values[i];
+      assert(val->value_type == vtn_value_type_invalid ||
+             val->value_type == vtn_value_type_string ||
+             val->value_type == vtn_value_type_decoration_group ||
+             val->value_type == vtn_value_type_extension ||
+             val->value_type == vtn_value_type_type ||
+             val->value_type == vtn_value_type_constant);
+
+      if (val->value_type == vtn_value_type_type ||
+          val->value_type == vtn_value_type_constant)
+         types_size += module_type_size(seen, val->type);
+      if (val->value_type == vtn_value_type_constant)
+         types_size += module_constant_size(seen, val->constant);
+
+      strings_size += module_string_size(val->name);
+      if (val->value_type == vtn_value_type_string)
+         strings_size += module_string_size(val->str);
+      for (struct vtn_decoration *dec = val->decoration; dec; dec = dec->next)
+         num_decorations++;
+   }
+   util_dynarray_foreach(&entry_points, struct vtn_module_entry_point, ep)
+      strings_size += module_string_size(ep->name);
+
+   const size_t values_offset = align64(sizeof(struct spirv_module), 8);
+   const size_t decorations_offset =
+      align64(values_offset + b->value_id_bound * sizeof(struct vtn_value), 8);
+   const size_t types_offset =
+      align64(decorations_offset +
+              num_decorations * sizeof(struct vtn_decoration), 8);
+   const size_t entry_points_offset = types_offset + types_size;
+   const size_t strings_offset =
+      entry_points_offset +
+      num_entry_points * sizeof(struct vtn_module_entry_point);
+   const size_t size = strings_offset + strings_size;
+
+   char *mem = alloc ? alloc(alloc_data, size) : malloc(size);
+   if (mem == NULL) {
+      ralloc_free(b);
+      return NULL;
+   }
+
+   struct spirv_module *module = (struct spirv_module *)mem;
+   struct vtn_value *values = (struct vtn_value *)(mem + values_offset);
+   struct vtn_decoration *dec_copy =
+      (struct vtn_decoration *)(mem + decorations_offset);
+   char *types = mem + types_offset;
+   char *strings = mem + strings_offset;
+   struct hash_table *copies =
+      _mesa_hash_table_create(b, _mesa_hash_pointer, _mesa_key_pointer_equal);
+
+   module->words = b->spirv;
+   module->word_count = word_count;
+   module->body = body;
+   if (options)
+      module->options = *options;
+   else
+      memset(&module->options, 0, sizeof(module->options));
+   module->value_id_bound = b->value_id_bound;
+   module->values = values;
+   module->num_entry_points = num_entry_points;
+   module->entry_points =
+      (struct vtn_module_entry_point *)(mem + entry_points_offset);
+
+   memcpy(values, b->values, b->value_id_bound * sizeof(struct vtn_value));
+   for (unsigned i = 0; i < b->value_id_bound; i++) {
+      const struct vtn_value *val = &b->values[i];
+
+      values[i].name = module_copy_string(&strings, val->name);
+      if (val->value_type == vtn_value_type_string)
+         values[i].str = (char *)module_copy_string(&strings, val->str);
+      if (val->value_type == vtn_value_type_type ||
+          val->value_type == vtn_value_type_constant)
+         values[i].type = module_copy_type(copies, &types, val->type);
+      if (val->value_type == vtn_value_type_constant) {
+         values[i].constant =
+            module_copy_constant(copies, &types, val->constant);
+      }
+
+      struct vtn_decoration **link = &values[i].decoration;
+      for (struct vtn_decoration *dec = val->decoration; dec; dec = dec->next) {
+         *dec_copy = *dec;
+         if (dec->group)
+            dec_copy->group = &values[dec->group - b->values];
+         *link = dec_copy;
+         link = &dec_copy->next;
+         dec_copy++;
+      }
+      *link = NULL;
+   }
+
+   assert(types == mem + entry_points_offset);
+
+   unsigned e = 0;
+   util_dynarray_foreach(&entry_points, struct vtn_module_entry_point, ep) {
+      module->entry_points[e] = *ep;
+      module->entry_points[e].name = module_copy_string(&strings, ep->name);
+      e++;
+   }
+
+   ralloc_free(b);
+
+   return module;
+}
+
+void
+spirv_module_destroy(struct spirv_module *module)
+{
+   free(module);
+}
+
+nir_function *
+spirv_module_to_nir(const struct spirv_module *module,
+                    struct nir_spirv_specialization *spec, unsigned num_spec,
+                    gl_shader_stage stage, const char *entry_point_name,
+                    const nir_shader_compiler_options *nir_options)
+{
+   const uint32_t *words = module->body;
+   const uint32_t *word_end = module->words + module->word_count;
+
+   struct vtn_builder *b = rzalloc(NULL, struct vtn_builder);
+   b->spirv = module->words;
+   b->spirv_word_count = module->word_count;
+   b->file = NULL;
+   b->line = -1;
+   b->col = -1;
+   exec_list_make_empty(&b->functions);
+   b->entry_point_stage = stage;
+   b->entry_point_name = entry_point_name;
+   b->options = &module->options;
+
+   /* The parsed state is shared, read-only, with the module.  Decoration
+    * lists, names, types and constants keep pointing into module memory;
+    * only the value array itself is copied since everything after the
+    * preamble writes to it.  Types are copied before they are changed.
+    */
+   b->value_id_bound = module->value_id_bound;
+   b->values = ralloc_array(b, struct vtn_value, module->value_id_bound);
+   memcpy(b->values, module->values,
+          module->value_id_bound * sizeof(struct vtn_value));
+
+   /* See also _vtn_fail() */
+   if (setjmp(b->fail_jump)) {
+      ralloc_free(b);
+      return NULL;
+   }
+
+   for (unsigned i = 0; i < module->num_entry_points; i++) {
+      const struct vtn_module_entry_point *ep = &module->entry_points[i];
+      if (ep->stage != stage || strcmp(ep->name, entry_point_name) != 0)
+         continue;
+
+      vtn_assert(b->entry_point == NULL);
+      b->entry_point = &b->values[ep->value_id];
+   }
 
    if (b->entry_point == NULL) {
       vtn_fail("Entry point not found");
@@ -4282,7 +4807,7 @@ spirv_to_nir(const uint32_t *words, size_t word_count,
 
    /* Handle all variable, type, and constant instructions */
    words = vtn_foreach_instruction(b, words, word_end,
-                                   vtn_handle_variable_or_type_instruction);
+                                   vtn_handle_instance_type_instruction);
 
    /* Set types on all vtn_values */
    vtn_foreach_instruction(b, words, word_end, vtn_set_instruction_result_type);
@@ -4322,3 +4847,24 @@ spirv_to_nir(const uint32_t *words, size_t word_count,
 
    return entry_point;
 }
+
+nir_function *
+spirv_to_nir(const uint32_t *words, size_t word_count,
+             struct nir_spirv_specialization *spec, unsigned num_spec,
+             gl_shader_stage stage, const char *entry_point_name,
+             const struct spirv_to_nir_options *options,
+             const nir_shader_compiler_options *nir_options)
+{
+   struct spirv_module *module =
+      spirv_module_create(words, word_count, options, NULL, NULL);
+   if (module == NULL)
+      return NULL;
+
+   nir_function *entry_point =
+      spirv_module_to_nir(module, spec, num_spec, stage, entry_point_name,
+                          nir_options);
+
+   spirv_module_destroy(module);
+
+   return entry_point;
+}
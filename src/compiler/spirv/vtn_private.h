@@ -552,6 +552,37 @@ struct vtn_decoration {
    };
 };
 
+struct vtn_module_entry_point {
+   uint32_t value_id;
+   gl_shader_stage stage;
+   const char *name;
+};
+
+/* The result of running the preamble (capabilities, extension imports,
+ * entry points, names, strings and decorations) over a SPIR-V binary, plus
+ * the types and constants which don't depend on specialization constants.
+ * None of this depends on the stage, entry point or specialization
+ * constants, so it can be shared by every pipeline built from the module.
+ *
+ * The module, its value array, decorations, types, constants, entry points
+ * and strings are all one allocation.
+ */
+struct spirv_module {
+   const uint32_t *words;
+   size_t word_count;
+
+   /* First instruction after the preamble */
+   const uint32_t *body;
+
+   struct spirv_to_nir_options options;
+
+   unsigned value_id_bound;
+   struct vtn_value *values;
+
+   unsigned num_entry_points;
+   struct vtn_module_entry_point *entry_points;
+};
+
 struct vtn_builder {
    nir_builder nb;
 
@@ -595,6 +626,11 @@ struct vtn_builder {
    gl_shader_stage entry_point_stage;
    const char *entry_point_name;
    struct vtn_value *entry_point;
+
+   /* Array of struct vtn_module_entry_point, non-NULL while
+    * spirv_module_create() runs the preamble
+    */
+   struct util_dynarray *module_entry_points;
    bool origin_upper_left;
    bool pixel_center_integer;
 
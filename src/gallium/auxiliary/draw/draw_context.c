@@ -793,6 +793,23 @@ draw_set_indexes(struct draw_context *draw,
       draw->pt.user.eltMax = elem_buffer_space / elem_size;
    else
       draw->pt.user.eltMax = 0;
+   draw->pt.user.elts_key = NULL;
+   draw->pt.user.elts_stamp = 0;
+}
+
+
+/**
+ * Identify the contents of the index buffer set with draw_set_indexes(),
+ * so that the analysis of its indices can be reused across draws.  The
+ * stamp must be unique to the current contents of buffer;  0 disables
+ * the reuse.
+ */
+void
+draw_set_indexes_stamp(struct draw_context *draw,
+                       const void *buffer, unsigned stamp)
+{
+   draw->pt.user.elts_key = buffer;
+   draw->pt.user.elts_stamp = stamp;
 }
 
 
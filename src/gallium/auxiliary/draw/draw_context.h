@@ -243,6 +243,9 @@ void draw_set_indexes(struct draw_context *draw,
                       const void *elements, unsigned elem_size,
                       unsigned available_space);
 
+void draw_set_indexes_stamp(struct draw_context *draw,
+                            const void *buffer, unsigned stamp);
+
 void draw_set_mapped_vertex_buffer(struct draw_context *draw,
                                    unsigned attr, const void *buffer,
                                    size_t size);
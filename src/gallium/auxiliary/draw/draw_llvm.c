@@ -65,6 +65,10 @@
 static void
 draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *var);
 
+static void
+draw_llvm_generate_tri_classify(struct draw_llvm *llvm,
+                                struct draw_llvm_variant *variant);
+
 
 struct draw_gs_llvm_iface {
    struct lp_build_tgsi_gs_iface base;
@@ -582,11 +586,23 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
 
    draw_llvm_generate(llvm, variant);
 
+   /* GS output doesn't have the VS vertex layout */
+   variant->tri_classify_function = NULL;
+   variant->tri_classify_func = NULL;
+   if (!key->has_gs)
+      draw_llvm_generate_tri_classify(llvm, variant);
+
    gallivm_compile_module(variant->gallivm);
 
    variant->jit_func = (draw_jit_vert_func)
          gallivm_jit_function(variant->gallivm, variant->function);
 
+   if (variant->tri_classify_function) {
+      variant->tri_classify_func = (draw_jit_tri_classify_func)
+         gallivm_jit_function(variant->gallivm,
+                              variant->tri_classify_function);
+   }
+
    gallivm_free_ir(variant->gallivm);
 
    variant->list_item_global.base = variant;
@@ -1961,6 +1977,253 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant)
 }
 
 
+/**
+ * Generate the triangle classification function for a variant, which
+ * does the clip stage's trivial accept / reject tests and the cull
+ * stage's face culling for a vector of triangles at a time.
+ * See draw_jit_tri_classify_func and draw_pipeline_run_tris().
+ */
+static void
+draw_llvm_generate_tri_classify(struct draw_llvm *llvm,
+                                struct draw_llvm_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef int8_ptr_type =
+      LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+   LLVMTypeRef arg_types[8];
+   LLVMTypeRef func_type, classes_vec_type;
+   LLVMValueRef func, io_ptr, elts_ptr, num_tris, max_index, stride;
+   LLVMValueRef clip_mask, cull_bits, classes_ptr;
+   LLVMValueRef ind_vec, tri_max, have_elts, max_index_vec, stride_vec;
+   LLVMValueRef clip_mask_vec, cull_ccw, cull_cw, cull_zero, zero;
+   LLVMBasicBlockRef block;
+   struct lp_type vs_type;
+   struct lp_build_context bld, blduivec;
+   struct lp_build_loop_state lp_loop;
+   const unsigned vector_length = lp_native_vector_width / 32;
+   const unsigned pos = llvm->draw->vs.position_output;
+   const unsigned pos_offset = offsetof(struct vertex_header, data) +
+                               pos * 4 * sizeof(float);
+   char func_name[64];
+   unsigned i;
+
+   util_snprintf(func_name, sizeof(func_name), "draw_llvm_tri_classify%u",
+                 variant->shader->variants_cached);
+
+   i = 0;
+   arg_types[i++] = int8_ptr_type;                      /* io */
+   arg_types[i++] = int8_ptr_type;                      /* elts */
+   arg_types[i++] = int32_type;                         /* num_tris */
+   arg_types[i++] = int32_type;                         /* max_index */
+   arg_types[i++] = int32_type;                         /* stride */
+   arg_types[i++] = int32_type;                         /* clip_mask */
+   arg_types[i++] = int32_type;                         /* cull_bits */
+   arg_types[i++] = int8_ptr_type;                      /* classes */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+
+   func = LLVMAddFunction(gallivm->module, func_name, func_type);
+   variant->tri_classify_function = func;
+
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(func, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   io_ptr      = LLVMGetParam(func, 0);
+   elts_ptr    = LLVMGetParam(func, 1);
+   num_tris    = LLVMGetParam(func, 2);
+   max_index   = LLVMGetParam(func, 3);
+   stride      = LLVMGetParam(func, 4);
+   clip_mask   = LLVMGetParam(func, 5);
+   cull_bits   = LLVMGetParam(func, 6);
+   classes_ptr = LLVMGetParam(func, 7);
+
+   lp_build_name(io_ptr, "io");
+   lp_build_name(elts_ptr, "elts");
+   lp_build_name(num_tris, "num_tris");
+   lp_build_name(max_index, "max_index");
+   lp_build_name(stride, "stride");
+   lp_build_name(clip_mask, "clip_mask");
+   lp_build_name(cull_bits, "cull_bits");
+   lp_build_name(classes_ptr, "classes");
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   memset(&vs_type, 0, sizeof vs_type);
+   vs_type.floating = TRUE;
+   vs_type.sign = TRUE;
+   vs_type.width = 32;
+   vs_type.length = vector_length;
+
+   lp_build_context_init(&bld, gallivm, vs_type);
+   lp_build_context_init(&blduivec, gallivm, lp_uint_type(vs_type));
+
+   ind_vec = blduivec.undef;
+   for (i = 0; i < vector_length; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      ind_vec = LLVMBuildInsertElement(builder, ind_vec, index, index, "");
+   }
+
+   have_elts = LLVMBuildICmp(builder, LLVMIntNE,
+                             LLVMConstPointerNull(int8_ptr_type), elts_ptr, "");
+   tri_max = LLVMBuildSub(builder, num_tris, lp_build_const_int32(gallivm, 1), "");
+   tri_max = lp_build_broadcast_scalar(&blduivec, tri_max);
+   max_index_vec = lp_build_broadcast_scalar(&blduivec, max_index);
+   stride_vec = lp_build_broadcast_scalar(&blduivec, stride);
+   clip_mask_vec = lp_build_broadcast_scalar(&blduivec, clip_mask);
+   zero = bld.zero;
+
+   /* Turn the DRAW_CULL_x bits into all-ones / all-zeros masks */
+   {
+      const unsigned bits[3] = { DRAW_CULL_CCW, DRAW_CULL_CW, DRAW_CULL_ZERO };
+      LLVMValueRef masks[3];
+
+      for (i = 0; i < 3; i++) {
+         LLVMValueRef bit = LLVMBuildAnd(builder, cull_bits,
+                                         lp_build_const_int32(gallivm, bits[i]), "");
+         bit = LLVMBuildICmp(builder, LLVMIntNE, bit,
+                             lp_build_const_int32(gallivm, 0), "");
+         bit = LLVMBuildSExt(builder, bit, int32_type, "");
+         masks[i] = lp_build_broadcast_scalar(&blduivec, bit);
+      }
+      cull_ccw = masks[0];
+      cull_cw = masks[1];
+      cull_zero = masks[2];
+   }
+
+   classes_vec_type = LLVMVectorType(LLVMInt8TypeInContext(context),
+                                     vector_length);
+
+   lp_build_loop_begin(&lp_loop, gallivm, lp_build_const_int32(gallivm, 0));
+   {
+      LLVMValueRef tri, header[3], x[3], y[3];
+      LLVMValueRef or_mask, and_mask, need_clip, all_out;
+      LLVMValueRef ex, ey, fx, fy, det, ccw, cw, zero_area, culled;
+      LLVMValueRef rasterize, pipeline, classes, dst;
+      unsigned j;
+
+      /* Clamp the tail to the last triangle, its class is ignored */
+      tri = lp_build_broadcast_scalar(&blduivec, lp_loop.counter);
+      tri = LLVMBuildAdd(builder, tri, ind_vec, "");
+      tri = lp_build_min(&blduivec, tri, tri_max);
+      tri = LLVMBuildMul(builder, tri, lp_build_const_int_vec(gallivm,
+                                                              blduivec.type, 3), "");
+
+      for (j = 0; j < 3; j++) {
+         LLVMValueRef index, offset;
+         LLVMValueRef index_store = lp_build_alloca_undef(gallivm,
+                                                          blduivec.vec_type,
+                                                          "index_store");
+         struct lp_build_if_state if_ctx;
+
+         index = LLVMBuildAdd(builder, tri,
+                              lp_build_const_int_vec(gallivm, blduivec.type, j), "");
+
+         lp_build_if(&if_ctx, gallivm, have_elts);
+         {
+            /* Same clamping as GET_ELT() in draw_pipe.c */
+            LLVMValueRef elt;
+            offset = lp_build_shl_imm(&blduivec, index, 1);
+            elt = lp_build_gather(gallivm, vector_length, 16,
+                                  lp_type_uint(32), TRUE,
+                                  elts_ptr, offset, FALSE);
+            elt = lp_build_min(&blduivec, elt, max_index_vec);
+            LLVMBuildStore(builder, elt, index_store);
+         }
+         lp_build_else(&if_ctx);
+         {
+            LLVMBuildStore(builder, index, index_store);
+         }
+         lp_build_endif(&if_ctx);
+
+         index = LLVMBuildLoad(builder, index_store, "");
+         offset = LLVMBuildMul(builder, index, stride_vec, "");
+
+         /* The clipmask lives in the low bits of the first dword */
+         header[j] = lp_build_gather(gallivm, vector_length, 32,
+                                     lp_type_uint(32), TRUE,
+                                     io_ptr, offset, FALSE);
+
+         offset = LLVMBuildAdd(builder, offset,
+                               lp_build_const_int_vec(gallivm, blduivec.type,
+                                                      pos_offset), "");
+         x[j] = lp_build_gather(gallivm, vector_length, 32,
+                                lp_type_uint(32), TRUE,
+                                io_ptr, offset, FALSE);
+         x[j] = LLVMBuildBitCast(builder, x[j], bld.vec_type, "");
+
+         offset = LLVMBuildAdd(builder, offset,
+                               lp_build_const_int_vec(gallivm, blduivec.type,
+                                                      sizeof(float)), "");
+         y[j] = lp_build_gather(gallivm, vector_length, 32,
+                                lp_type_uint(32), TRUE,
+                                io_ptr, offset, FALSE);
+         y[j] = LLVMBuildBitCast(builder, y[j], bld.vec_type, "");
+      }
+
+      /* clip_tri() */
+      or_mask = LLVMBuildOr(builder, header[0], header[1], "");
+      or_mask = LLVMBuildOr(builder, or_mask, header[2], "");
+      or_mask = LLVMBuildAnd(builder, or_mask, clip_mask_vec, "");
+      and_mask = LLVMBuildAnd(builder, header[0], header[1], "");
+      and_mask = LLVMBuildAnd(builder, and_mask, header[2], "");
+      and_mask = LLVMBuildAnd(builder, and_mask, clip_mask_vec, "");
+      need_clip = lp_build_cmp(&blduivec, PIPE_FUNC_NOTEQUAL,
+                               or_mask, blduivec.zero);
+      all_out = lp_build_cmp(&blduivec, PIPE_FUNC_NOTEQUAL,
+                             and_mask, blduivec.zero);
+
+      /* cull_tri(): det = cross(v0 - v2, v1 - v2).z */
+      ex = LLVMBuildFSub(builder, x[0], x[2], "ex");
+      ey = LLVMBuildFSub(builder, y[0], y[2], "ey");
+      fx = LLVMBuildFSub(builder, x[1], x[2], "fx");
+      fy = LLVMBuildFSub(builder, y[1], y[2], "fy");
+      det = LLVMBuildFSub(builder,
+                          LLVMBuildFMul(builder, ex, fy, ""),
+                          LLVMBuildFMul(builder, ey, fx, ""), "det");
+      ccw = lp_build_cmp_ordered(&bld, PIPE_FUNC_LESS, det, zero);
+      zero_area = lp_build_cmp_ordered(&bld, PIPE_FUNC_EQUAL, det, zero);
+      /* A NaN det counts as clockwise, as in cull_tri() */
+      cw = LLVMBuildNot(builder, LLVMBuildOr(builder, ccw, zero_area, ""), "");
+      culled = LLVMBuildAnd(builder, ccw, cull_ccw, "");
+      culled = LLVMBuildOr(builder, culled,
+                           LLVMBuildAnd(builder, cw, cull_cw, ""), "");
+      culled = LLVMBuildOr(builder, culled,
+                           LLVMBuildAnd(builder, zero_area, cull_zero, ""), "");
+
+      rasterize = LLVMBuildNot(builder, LLVMBuildOr(builder, need_clip, culled, ""), "");
+      pipeline = LLVMBuildAnd(builder, need_clip,
+                              LLVMBuildNot(builder, all_out, ""), "");
+      classes = LLVMBuildOr(builder,
+                            LLVMBuildAnd(builder, rasterize,
+                                         lp_build_const_int_vec(gallivm, blduivec.type,
+                                                                DRAW_TRI_RASTERIZE), ""),
+                            LLVMBuildAnd(builder, pipeline,
+                                         lp_build_const_int_vec(gallivm, blduivec.type,
+                                                                DRAW_TRI_PIPELINE), ""),
+                            "");
+      classes = LLVMBuildTrunc(builder, classes, classes_vec_type, "");
+
+      dst = LLVMBuildGEP(builder, classes_ptr, &lp_loop.counter, 1, "");
+      dst = LLVMBuildBitCast(builder, dst, LLVMPointerType(classes_vec_type, 0), "");
+      LLVMSetAlignment(LLVMBuildStore(builder, classes, dst), 1);
+   }
+   lp_build_loop_end_cond(&lp_loop, num_tris,
+                          lp_build_const_int32(gallivm, vector_length),
+                          LLVMIntUGE);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+}
+
+
 struct draw_llvm_variant_key *
 draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
 {
@@ -275,6 +275,22 @@ typedef boolean
                       const unsigned *fetch_elts);
 
 
+/**
+ * Classify a list of triangles for draw_pipeline_run_tris(), writing one
+ * DRAW_TRI_x value per triangle into classes (which must have room for
+ * num_tris rounded up to the native vector length).
+ */
+typedef void
+(*draw_jit_tri_classify_func)(const struct vertex_header *io,
+                              const ushort *elts,
+                              unsigned num_tris,
+                              unsigned max_index,
+                              unsigned stride,
+                              unsigned clip_mask,
+                              unsigned cull_bits,
+                              ubyte *classes);
+
+
 typedef int
 (*draw_gs_jit_func)(struct draw_gs_jit_context *context,
                     float inputs[6][PIPE_MAX_SHADER_INPUTS][TGSI_NUM_CHANNELS][TGSI_NUM_CHANNELS],
@@ -382,6 +398,10 @@ struct draw_llvm_variant
    LLVMValueRef function;
    draw_jit_vert_func jit_func;
 
+   /* Only generated for variants without a geometry shader */
+   LLVMValueRef tri_classify_function;
+   draw_jit_tri_classify_func tri_classify_func;
+
    struct llvm_vertex_shader *shader;
 
    struct draw_llvm *llvm;
@@ -273,6 +273,60 @@ void draw_pipeline_run( struct draw_context *draw,
 }
 
 
+/**
+ * Run a triangle list which has been classified with DRAW_TRI_x values,
+ * see draw_pipeline_tri_state().  Triangles which need no clipping and
+ * survive culling skip the clip and cull stages and go straight to the
+ * rasterize stage; the rest still walk the whole pipeline, in order.
+ * The pipeline is validated first, so that flushing it reaches the
+ * rasterize stage however the triangles went.
+ */
+void draw_pipeline_run_tris( struct draw_context *draw,
+                             const struct draw_vertex_info *vert_info,
+                             const struct draw_prim_info *prim_info,
+                             const ubyte *classes )
+{
+   const unsigned stride = vert_info->stride;
+   const unsigned max_index = vert_info->count - 1;
+   const unsigned num_tris = prim_info->count / 3;
+   const ushort *elts = prim_info->linear ? NULL : prim_info->elts;
+   char *verts = (char *)vert_info->verts;
+   struct draw_stage *rasterize = draw->pipeline.rasterize;
+   struct prim_header prim;
+   unsigned i, j;
+
+   assert(prim_info->prim == PIPE_PRIM_TRIANGLES);
+   assert(prim_info->primitive_count == 1);
+
+   draw_pipeline_validate( draw );
+
+   draw->pipeline.verts = verts;
+   draw->pipeline.vertex_stride = stride;
+   draw->pipeline.vertex_count = elts ? vert_info->count : prim_info->count;
+
+   prim.flags = DRAW_PIPE_RESET_STIPPLE | DRAW_PIPE_EDGE_FLAG_ALL;
+   prim.pad = 0;
+
+   for (i = 0; i < num_tris; i++) {
+      if (classes[i] == DRAW_TRI_DISCARD)
+         continue;
+
+      for (j = 0; j < 3; j++) {
+         unsigned index = elts ? MIN2(elts[i * 3 + j], max_index) : i * 3 + j;
+         prim.v[j] = (struct vertex_header *)(verts + index * stride);
+      }
+
+      if (classes[i] == DRAW_TRI_RASTERIZE)
+         rasterize->tri( rasterize, &prim );
+      else
+         draw->pipeline.first->tri( draw->pipeline.first, &prim );
+   }
+
+   draw->pipeline.verts = NULL;
+   draw->pipeline.vertex_count = 0;
+}
+
+
 /*
  * Set up macros for draw_pt_decompose.h template code.
  * This code is for non-indexed (aka linear) rendering (no elts).
@@ -139,6 +139,60 @@ draw_need_pipeline(const struct draw_context *draw,
 
 
 
+/**
+ * Check whether triangles would only meet the clip stage and a plain face
+ * culling stage on their way to the rasterize stage.  If so, the caller
+ * may classify them in bulk and use draw_pipeline_run_tris().
+ *
+ * \param clip_mask  returns the vertex clipmask bits the clip stage tests
+ * \param cull_bits  returns a DRAW_CULL_x mask matching the cull stage
+ */
+boolean
+draw_pipeline_tri_state( const struct draw_context *draw,
+                         unsigned *clip_mask,
+                         unsigned *cull_bits )
+{
+   const struct pipe_rasterizer_state *rast = draw->rasterizer;
+   unsigned face_ccw, face_cw;
+
+   /*
+    * Anything which puts a stage other than clip and cull in the triangle
+    * path, see validate_pipeline().  Stages only meant for points or lines
+    * are included when they cause the flatshade stage to be inserted.
+    */
+   if ((rast->line_smooth && draw->pipeline.aaline) ||
+       (rast->point_smooth && draw->pipeline.aapoint) ||
+       (rast->line_width != 1.0f &&
+        roundf(rast->line_width) > draw->pipeline.wide_line_threshold) ||
+       (rast->line_stipple_enable && draw->pipeline.line_stipple) ||
+       (rast->poly_stipple_enable && draw->pipeline.pstipple) ||
+       rast->fill_front != PIPE_POLYGON_MODE_FILL ||
+       rast->fill_back != PIPE_POLYGON_MODE_FILL ||
+       rast->offset_point ||
+       rast->offset_line ||
+       rast->offset_tri ||
+       rast->light_twoside ||
+       draw_current_shader_num_written_culldistances(draw))
+      return FALSE;
+
+   *clip_mask = (draw->clip_xy || draw->clip_z || draw->clip_user) ?
+                (1 << DRAW_TOTAL_CLIP_PLANES) - 1 : 0;
+
+   /* Same rules as cull_tri() */
+   face_ccw = rast->front_ccw ? PIPE_FACE_FRONT : PIPE_FACE_BACK;
+   face_cw = rast->front_ccw ? PIPE_FACE_BACK : PIPE_FACE_FRONT;
+   *cull_bits = 0;
+   if (rast->cull_face & face_ccw)
+      *cull_bits |= DRAW_CULL_CCW;
+   if (rast->cull_face & face_cw)
+      *cull_bits |= DRAW_CULL_CW;
+   if (rast->cull_face & PIPE_FACE_BACK)
+      *cull_bits |= DRAW_CULL_ZERO;
+
+   return TRUE;
+}
+
+
 /**
  * Rebuild the rendering pipeline.
  */
@@ -278,6 +332,19 @@ static struct draw_stage *validate_pipeline( struct draw_stage *stage )
    return draw->pipeline.first;
 }
 
+
+/**
+ * Build the pipeline now rather than on the first primitive through the
+ * validate stage, for callers which send primitives past the first stage.
+ * The validate stage only flushes the rest of the pipeline once it has
+ * been built.
+ */
+void draw_pipeline_validate( struct draw_context *draw )
+{
+   if (draw->pipeline.first == draw->pipeline.validate)
+      validate_pipeline( draw->pipeline.validate );
+}
+
 static void validate_tri( struct draw_stage *stage, 
 			  struct prim_header *header )
 {
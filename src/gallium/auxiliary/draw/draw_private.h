@@ -193,6 +193,12 @@ struct draw_context
          unsigned eltSizeIB;
          unsigned eltSize;
          unsigned eltMax;
+         /**
+          * Identity of the index buffer contents: the buffer and a stamp
+          * that changes whenever they are written (0 if unknown).
+          */
+         const void *elts_key;
+         unsigned elts_stamp;
          int eltBias;         
          unsigned min_index;
          unsigned max_index;
@@ -454,6 +460,30 @@ void draw_pipeline_run_linear( struct draw_context *draw,
                                const struct draw_vertex_info *vert,
                                const struct draw_prim_info *prim);
 
+/*
+ * Per-triangle classes for draw_pipeline_run_tris(), computed in bulk
+ * when the pipeline would only clip and face-cull the triangles.
+ */
+#define DRAW_TRI_DISCARD   0  /**< culled, or entirely outside a plane */
+#define DRAW_TRI_RASTERIZE 1  /**< straight to the rasterize stage */
+#define DRAW_TRI_PIPELINE  2  /**< needs clipping, run the whole pipeline */
+
+/* Face culling bits returned by draw_pipeline_tri_state() */
+#define DRAW_CULL_CCW      0x1  /**< cull triangles with det < 0 */
+#define DRAW_CULL_CW       0x2  /**< cull triangles with det > 0 or NaN */
+#define DRAW_CULL_ZERO     0x4  /**< cull zero area triangles */
+
+boolean draw_pipeline_tri_state( const struct draw_context *draw,
+                                 unsigned *clip_mask,
+                                 unsigned *cull_bits );
+
+void draw_pipeline_validate( struct draw_context *draw );
+
+void draw_pipeline_run_tris( struct draw_context *draw,
+                             const struct draw_vertex_info *vert,
+                             const struct draw_prim_info *prim,
+                             const ubyte *classes );
+
 
 
 
@@ -25,9 +25,11 @@
  *
  **************************************************************************/
 
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_queue.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
 #include "draw/draw_vbuf.h"
@@ -40,6 +42,28 @@
 #include "gallivm/lp_bld_debug.h"
 
 
+/** Max number of threads running the vertex shader for one segment */
+#define LLVM_VS_MAX_THREADS 8
+
+/** Don't hand out fewer vertices than this to a thread */
+#define LLVM_VS_MIN_CHUNK 256
+
+
+struct llvm_middle_end;
+
+/** A range of vertices to fetch and shade */
+struct llvm_vs_job {
+   struct llvm_middle_end *fpme;
+   struct util_queue_fence fence;
+   struct vertex_header *verts;
+   unsigned count;
+   unsigned start_or_maxelt;
+   unsigned vid_base;
+   const unsigned *elts;
+   boolean clipped;
+};
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -57,6 +81,15 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /*
+    * Worker threads for the fetch + vertex shader stage, created on first
+    * use.  The calling thread shades a chunk too, so num_vs_threads
+    * is one more than the number of workers.
+    */
+   struct util_queue vs_queue;
+   unsigned num_vs_threads;
+   struct llvm_vs_job vs_jobs[LLVM_VS_MAX_THREADS];
 };
 
 
@@ -317,11 +350,59 @@ llvm_middle_end_bind_parameters(struct draw_pt_middle_end *middle)
 }
 
 
+/**
+ * Classify a triangle list with the variant's JIT function and skip
+ * the clip and cull stages for the triangles which don't need them.
+ * Returns FALSE if the pipeline does more than that to triangles.
+ */
+static boolean
+pipeline_tris(struct llvm_middle_end *llvm,
+              const struct draw_vertex_info *vert_info,
+              const struct draw_prim_info *prim_info)
+{
+   struct draw_context *draw = llvm->draw;
+   draw_jit_tri_classify_func classify =
+      llvm->current_variant->tri_classify_func;
+   const unsigned num_tris = prim_info->count / 3;
+   unsigned clip_mask, cull_bits;
+   ubyte *classes;
+
+   if (!classify ||
+       draw->gs.geometry_shader ||
+       prim_info->prim != PIPE_PRIM_TRIANGLES ||
+       prim_info->primitive_count != 1 ||
+       num_tris == 0 ||
+       !draw_pipeline_tri_state(draw, &clip_mask, &cull_bits))
+      return FALSE;
+
+   classes = MALLOC(align(num_tris, lp_native_vector_width / 32));
+   if (!classes)
+      return FALSE;
+
+   classify(vert_info->verts,
+            prim_info->linear ? NULL : prim_info->elts,
+            num_tris,
+            vert_info->count - 1,
+            vert_info->stride,
+            clip_mask,
+            cull_bits,
+            classes);
+
+   draw_pipeline_run_tris(draw, vert_info, prim_info, classes);
+
+   FREE(classes);
+   return TRUE;
+}
+
+
 static void
 pipeline(struct llvm_middle_end *llvm,
          const struct draw_vertex_info *vert_info,
          const struct draw_prim_info *prim_info)
 {
+   if (pipeline_tris(llvm, vert_info, prim_info))
+      return;
+
    if (prim_info->linear)
       draw_pipeline_run_linear( llvm->draw,
                                 vert_info,
@@ -347,6 +428,130 @@ emit(struct pt_emit *emit,
 }
 
 
+static void
+llvm_vs_job_execute(void *data, int thread_index)
+{
+   struct llvm_vs_job *job = (struct llvm_vs_job *)data;
+   struct llvm_middle_end *fpme = job->fpme;
+   struct draw_context *draw = fpme->draw;
+   unsigned fpstate = 0;
+
+   /* Match the FP state draw_vbo() sets up on the calling thread */
+   if (thread_index >= 0) {
+      fpstate = util_fpstate_get();
+      util_fpstate_set_denorms_to_zero(fpstate);
+   }
+
+   job->clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
+                                                  job->verts,
+                                                  draw->pt.user.vbuffer,
+                                                  job->count,
+                                                  job->start_or_maxelt,
+                                                  fpme->vertex_size,
+                                                  draw->pt.vertex_buffer,
+                                                  draw->instance_id,
+                                                  job->vid_base,
+                                                  draw->start_instance,
+                                                  job->elts);
+
+   if (thread_index >= 0)
+      util_fpstate_set(fpstate);
+}
+
+
+static boolean
+llvm_middle_end_init_vs_threads(struct llvm_middle_end *fpme)
+{
+   unsigned i;
+
+   if (util_queue_is_initialized(&fpme->vs_queue))
+      return TRUE;
+
+   if (!util_queue_init(&fpme->vs_queue, "drawvs", LLVM_VS_MAX_THREADS,
+                        fpme->num_vs_threads - 1, 0)) {
+      fpme->num_vs_threads = 1;
+      return FALSE;
+   }
+
+   for (i = 0; i < LLVM_VS_MAX_THREADS; i++) {
+      fpme->vs_jobs[i].fpme = fpme;
+      util_queue_fence_init(&fpme->vs_jobs[i].fence);
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Fetch and shade \p count vertices into \p verts, returning whether any
+ * of them needs clipping.
+ *
+ * Large enough segments are cut into chunks which are shaded in parallel.
+ * Chunk boundaries are multiples of the SIMD width, so every thread writes
+ * a disjoint range of \p verts and the output is exactly what a single
+ * call produces; everything downstream (GS, stream output, clipping, emit)
+ * still runs on the calling thread in primitive order.
+ */
+static boolean
+llvm_middle_end_shade(struct llvm_middle_end *fpme,
+                      struct vertex_header *verts,
+                      unsigned count,
+                      unsigned start_or_maxelt,
+                      unsigned vid_base,
+                      const unsigned *elts)
+{
+   const unsigned vector_length = lp_native_vector_width / 32;
+   unsigned num_jobs = MIN2(fpme->num_vs_threads, count / LLVM_VS_MIN_CHUNK);
+   unsigned chunk, first, i;
+   boolean clipped;
+
+   if (num_jobs > 1 && !llvm_middle_end_init_vs_threads(fpme))
+      num_jobs = 1;
+
+   if (num_jobs <= 1) {
+      struct llvm_vs_job job;
+
+      job.fpme = fpme;
+      job.verts = verts;
+      job.count = count;
+      job.start_or_maxelt = start_or_maxelt;
+      job.vid_base = vid_base;
+      job.elts = elts;
+      llvm_vs_job_execute(&job, -1);
+      return job.clipped;
+   }
+
+   chunk = align(DIV_ROUND_UP(count, num_jobs), vector_length);
+   for (i = 0, first = 0; first < count; i++, first += chunk) {
+      struct llvm_vs_job *job = &fpme->vs_jobs[i];
+
+      job->verts = (struct vertex_header *)
+         ((char *)verts + first * fpme->vertex_size);
+      job->count = MIN2(chunk, count - first);
+      /* Indexed fetches take eltMax here, linear ones the start vertex */
+      job->start_or_maxelt = elts ? start_or_maxelt : start_or_maxelt + first;
+      job->vid_base = vid_base;
+      job->elts = elts ? elts + first : NULL;
+   }
+   num_jobs = i;
+
+   /* The first chunk is shaded on this thread while the others run */
+   for (i = 1; i < num_jobs; i++) {
+      util_queue_add_job(&fpme->vs_queue, &fpme->vs_jobs[i],
+                         &fpme->vs_jobs[i].fence, llvm_vs_job_execute, NULL);
+   }
+   llvm_vs_job_execute(&fpme->vs_jobs[0], -1);
+
+   clipped = fpme->vs_jobs[0].clipped;
+   for (i = 1; i < num_jobs; i++) {
+      util_queue_fence_wait(&fpme->vs_jobs[i].fence);
+      clipped |= fpme->vs_jobs[i].clipped;
+   }
+
+   return clipped;
+}
+
+
 static void
 llvm_pipeline_generic(struct draw_pt_middle_end *middle,
                       const struct draw_fetch_info *fetch_info,
@@ -397,17 +602,9 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       vid_base = draw->pt.user.eltBias;
       elts = fetch_info->elts;
    }
-   clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
-                                             llvm_vert_info.verts,
-                                             draw->pt.user.vbuffer,
-                                             fetch_info->count,
-                                             start_or_maxelt,
-                                             fpme->vertex_size,
-                                             draw->pt.vertex_buffer,
-                                             draw->instance_id,
-                                             vid_base,
-                                             draw->start_instance,
-                                             elts);
+   clipped = llvm_middle_end_shade(fpme, llvm_vert_info.verts,
+                                   fetch_info->count, start_or_maxelt,
+                                   vid_base, elts);
 
    /* Finished with fetch and vs:
     */
@@ -607,6 +804,14 @@ llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
 
+   if (util_queue_is_initialized(&fpme->vs_queue)) {
+      unsigned i;
+
+      util_queue_destroy(&fpme->vs_queue);
+      for (i = 0; i < LLVM_VS_MAX_THREADS; i++)
+         util_queue_fence_destroy(&fpme->vs_jobs[i].fence);
+   }
+
    if (fpme->fetch)
       draw_pt_fetch_destroy( fpme->fetch );
 
@@ -645,6 +850,13 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 
    fpme->draw = draw;
 
+   /*
+    * Shading vertices on several threads competes with the rasterizer
+    * threads of software drivers for the CPUs, so it is opt-in.
+    */
+   fpme->num_vs_threads = debug_get_num_option("DRAW_THREADS", 1);
+   fpme->num_vs_threads = CLAMP(fpme->num_vs_threads, 1, LLVM_VS_MAX_THREADS);
+
    fpme->fetch = draw_pt_fetch_create( draw );
    if (!fpme->fetch)
       goto fail;
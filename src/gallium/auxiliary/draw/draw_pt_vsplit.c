@@ -25,17 +25,44 @@
 
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/bitset.h"
 
 #include "draw/draw_context.h"
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
 
-#define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+#define SEGMENT_SIZE     4096
+#define SEGMENT_MIN_SIZE 1024
+/* Aim for the shaded vertices of a segment to stay cache resident */
+#define SEGMENT_BYTES    (512 * 1024)
+
+#define CACHE_SET_BITS   10
+#define CACHE_SETS       (1 << CACHE_SET_BITS)
+
+/* Number of analysed index ranges remembered */
+#define ANALYSIS_SLOTS   8
+/* Index ranges too wide to count the unique indices of */
+#define ANALYSIS_MAX_RANGE (1 << 20)
 
 /* The largest possible index within an index buffer */
 #define MAX_ELT_IDX 0xffffffff
 
+/**
+ * What we know about the indices [start, start + count) of an index buffer
+ * whose contents are identified by key and stamp.
+ */
+struct vsplit_analysis {
+   const void *key;
+   unsigned stamp;
+   unsigned elt_size;
+   unsigned start;
+   unsigned count;
+
+   unsigned min_index;
+   unsigned max_index;
+   unsigned unique;     /**< number of distinct indices */
+};
+
 struct vsplit_frontend {
    struct draw_pt_front_end base;
    struct draw_context *draw;
@@ -53,22 +80,30 @@ struct vsplit_frontend {
    ushort identity_draw_elts[SEGMENT_SIZE];
 
    struct {
-      /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
-      boolean has_max_fetch;
+      /*
+       * Map a fetch element to a draw element.  This is a 2-way set
+       * associative cache, most recently used way first.  An entry is only
+       * valid if it is below num_fetch_elts and fetch_elts[] holds the
+       * looked up fetch element there, so it never needs to be cleared.
+       */
+      ushort draws[CACHE_SETS][2];
 
       ushort num_fetch_elts;
       ushort num_draw_elts;
    } cache;
+
+   struct vsplit_analysis analysis[ANALYSIS_SLOTS];
+   unsigned next_analysis;
+
+   /* scratch space for counting unique indices */
+   BITSET_WORD *seen;
+   unsigned seen_size;
 };
 
 
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
-   vsplit->cache.has_max_fetch = FALSE;
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
 }
@@ -87,23 +122,30 @@ vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 static inline void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch)
 {
-   unsigned hash;
-
-   hash = fetch % MAP_SIZE;
-
-   /* If the value isn't in the cache or it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch) {
-      /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
-
-      /* add fetch */
-      assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
-      vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+   /* fold the high bits in so that power of two strides spread out */
+   ushort *set = vsplit->cache.draws[(fetch ^ (fetch >> CACHE_SET_BITS)) &
+                                     (CACHE_SETS - 1)];
+   const unsigned num_fetch_elts = vsplit->cache.num_fetch_elts;
+   ushort draw;
+
+   if (set[0] < num_fetch_elts && vsplit->fetch_elts[set[0]] == fetch) {
+      draw = set[0];
+   }
+   else {
+      if (set[1] < num_fetch_elts && vsplit->fetch_elts[set[1]] == fetch) {
+         draw = set[1];
+      }
+      else {
+         /* add fetch, evicting the least recently used way */
+         assert(num_fetch_elts < vsplit->segment_size);
+         draw = num_fetch_elts;
+         vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+      }
+      set[1] = set[0];
+      set[0] = draw;
    }
 
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = draw;
 }
 
 /**
@@ -125,12 +167,6 @@ vsplit_add_cache_ubyte(struct vsplit_frontend *vsplit, const ubyte *elts,
    unsigned elt_idx;
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -142,12 +178,6 @@ vsplit_add_cache_ushort(struct vsplit_frontend *vsplit, const ushort *elts,
    unsigned elt_idx;
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -167,17 +197,72 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
     */
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* Take care for DRAW_MAX_FETCH_IDX (since cache is initialized to -1). */
-   if (elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      /* force update - any value will do except DRAW_MAX_FETCH_IDX */
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
 
+/**
+ * Look up the analysis of the current index buffer for the given range.
+ * Returns NULL if the contents of the index buffer are not identified.
+ * Otherwise *found tells whether the returned slot is already filled in;
+ * if not, the caller must fill in the result fields.
+ */
+static struct vsplit_analysis *
+vsplit_get_analysis(struct vsplit_frontend *vsplit,
+                    unsigned start, unsigned count, boolean *found)
+{
+   const struct draw_context *draw = vsplit->draw;
+   struct vsplit_analysis *analysis;
+   unsigned i;
+
+   if (!draw->pt.user.elts_stamp)
+      return NULL;
+
+   for (i = 0; i < ANALYSIS_SLOTS; i++) {
+      analysis = &vsplit->analysis[i];
+      if (analysis->stamp == draw->pt.user.elts_stamp &&
+          analysis->key == draw->pt.user.elts_key &&
+          analysis->elt_size == draw->pt.user.eltSize &&
+          analysis->start == start &&
+          analysis->count == count) {
+         *found = TRUE;
+         return analysis;
+      }
+   }
+
+   analysis = &vsplit->analysis[vsplit->next_analysis];
+   vsplit->next_analysis = (vsplit->next_analysis + 1) % ANALYSIS_SLOTS;
+
+   analysis->key = draw->pt.user.elts_key;
+   analysis->stamp = draw->pt.user.elts_stamp;
+   analysis->elt_size = draw->pt.user.eltSize;
+   analysis->start = start;
+   analysis->count = count;
+
+   *found = FALSE;
+   return analysis;
+}
+
+
+/**
+ * Return a cleared bitset of at least size bits, or NULL.
+ */
+static BITSET_WORD *
+vsplit_get_seen(struct vsplit_frontend *vsplit, unsigned size)
+{
+   if (size > vsplit->seen_size) {
+      FREE(vsplit->seen);
+      vsplit->seen = MALLOC(BITSET_WORDS(size) * sizeof(BITSET_WORD));
+      vsplit->seen_size = vsplit->seen ? size : 0;
+      if (!vsplit->seen)
+         return NULL;
+   }
+
+   memset(vsplit->seen, 0, BITSET_WORDS(size) * sizeof(BITSET_WORD));
+   return vsplit->seen;
+}
+
+
 #define FUNC vsplit_run_linear
 #include "draw_pt_vsplit_tmp.h"
 
@@ -203,6 +288,7 @@ static void vsplit_prepare(struct draw_pt_front_end *frontend,
                            unsigned opt)
 {
    struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;
+   unsigned vertex_size;
 
    switch (vsplit->draw->pt.user.eltSize) {
    case 0:
@@ -228,7 +314,16 @@ static void vsplit_prepare(struct draw_pt_front_end *frontend,
    vsplit->middle = middle;
    middle->prepare(middle, vsplit->prim, opt, &vsplit->max_vertices);
 
-   vsplit->segment_size = MIN2(SEGMENT_SIZE, vsplit->max_vertices);
+   /*
+    * Use as large segments as the middle end allows, fewer vertices are
+    * then shaded twice at segment boundaries, but not so large that the
+    * shaded vertices of a segment fall out of the cache.
+    */
+   vertex_size = sizeof(struct vertex_header) +
+                 draw_total_vs_outputs(vsplit->draw) * 4 * sizeof(float);
+   vsplit->segment_size = MIN3(SEGMENT_SIZE, vsplit->max_vertices,
+                               MAX2(SEGMENT_MIN_SIZE,
+                                    SEGMENT_BYTES / vertex_size));
 }
 
 
@@ -245,6 +340,9 @@ static void vsplit_flush(struct draw_pt_front_end *frontend, unsigned flags)
 
 static void vsplit_destroy(struct draw_pt_front_end *frontend)
 {
+   struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;
+
+   FREE(vsplit->seen);
    FREE(frontend);
 }
 
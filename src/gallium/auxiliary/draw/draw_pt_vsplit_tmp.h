@@ -28,6 +28,53 @@
 
 #ifdef ELT_TYPE
 
+/**
+ * Find the bounds and the number of distinct indices in [istart, istart +
+ * icount), or look them up if this range of the index buffer was already
+ * analysed.  Returns NULL when the index buffer contents are not known.
+ */
+static const struct vsplit_analysis *
+CONCAT(vsplit_analyze_, ELT_TYPE)(struct vsplit_frontend *vsplit,
+                                  unsigned istart, unsigned icount)
+{
+   const ELT_TYPE *ib = (const ELT_TYPE *) vsplit->draw->pt.user.elts + istart;
+   struct vsplit_analysis *analysis;
+   BITSET_WORD *seen;
+   boolean found;
+   unsigned lo, hi;
+   unsigned i;
+
+   analysis = vsplit_get_analysis(vsplit, istart, icount, &found);
+   if (!analysis || found)
+      return analysis;
+
+   lo = hi = ib[0];
+   for (i = 1; i < icount; i++) {
+      lo = MIN2(lo, ib[i]);
+      hi = MAX2(hi, ib[i]);
+   }
+
+   analysis->min_index = lo;
+   analysis->max_index = hi;
+   analysis->unique = icount;
+
+   if (hi - lo < ANALYSIS_MAX_RANGE) {
+      seen = vsplit_get_seen(vsplit, hi - lo + 1);
+      if (seen) {
+         analysis->unique = 0;
+         for (i = 0; i < icount; i++) {
+            const unsigned bit = ib[i] - lo;
+            if (!BITSET_TEST(seen, bit)) {
+               BITSET_SET(seen, bit);
+               analysis->unique++;
+            }
+         }
+      }
+   }
+
+   return analysis;
+}
+
 /**
  * Fetch all elements in [min_index, max_index] with bias, and use the
  * (rebased) index buffer as the draw elements.
@@ -38,9 +85,10 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
 {
    struct draw_context *draw = vsplit->draw;
    const ELT_TYPE *ib = (const ELT_TYPE *) draw->pt.user.elts;
-   const unsigned min_index = draw->pt.user.min_index;
-   const unsigned max_index = draw->pt.user.max_index;
+   unsigned min_index = draw->pt.user.min_index;
+   unsigned max_index = draw->pt.user.max_index;
    const int elt_bias = draw->pt.user.eltBias;
+   const struct vsplit_analysis *analysis;
    unsigned fetch_start, fetch_count;
    const ushort *draw_elts = NULL;
    unsigned i;
@@ -49,15 +97,22 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
 
    /* If the index buffer overflows we'll need to run
     * through the normal paths */
-   if (end >= draw->pt.user.eltMax ||
+   if (end > draw->pt.user.eltMax ||
        end < istart)
       return FALSE;
 
+   if (icount > vsplit->max_vertices)
+      return FALSE;
+
+   /* prefer the exact bounds over the hints of the state tracker */
+   analysis = CONCAT(vsplit_analyze_, ELT_TYPE)(vsplit, istart, icount);
+   if (analysis) {
+      min_index = analysis->min_index;
+      max_index = analysis->max_index;
+   }
+
    /* use the ib directly */
    if (min_index == 0 && sizeof(ib[0]) == sizeof(draw_elts[0])) {
-      if (icount > vsplit->max_vertices)
-         return FALSE;
-
       for (i = 0; i < icount; i++) {
          ELT_TYPE idx = DRAW_GET_IDX(ib, start + i);
          if (idx < min_index || idx > max_index) {
@@ -76,6 +131,14 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
    if (max_index - min_index > icount - 1)
       return FALSE;
 
+   /*
+    * If many vertices within the range are never referenced, the cache
+    * shades fewer of them, as long as the draw fits in one segment.
+    */
+   if (analysis && icount <= vsplit->segment_size &&
+       max_index - min_index >= analysis->unique + analysis->unique / 4)
+      return FALSE;
+
    if (elt_bias < 0 && (int) min_index < -elt_bias)
       return FALSE;
 
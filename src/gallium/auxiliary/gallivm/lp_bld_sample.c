@@ -118,6 +118,7 @@ lp_sampler_static_texture_state(struct lp_static_texture_state *state,
    state->pot_height        = util_is_power_of_two_or_zero(texture->height0);
    state->pot_depth         = util_is_power_of_two_or_zero(texture->depth0);
    state->level_zero_only   = !view->u.tex.last_level;
+   state->tiled             = (texture->flags & LP_RESOURCE_FLAG_TILED) != 0;
 
    /*
     * the layer / element / level parameters are all either dynamic
@@ -1971,6 +1972,11 @@ lp_build_cube_lookup(struct lp_build_sample_context *bld,
  *
  * @param coord   coordinate in pixels
  * @param stride  number of bytes between rows of successive pixel blocks
+ * @param texel_stride  NULL, unless the texture is stored in micro-tiles
+ *                      (see LP_TEXTURE_TILE_SIZE), in which case it is the
+ *                      number of bytes between successive texels within a
+ *                      micro-tile, and stride the number of bytes between
+ *                      successive micro-tiles divided by LP_TEXTURE_TILE_SIZE
  * @param block_length  number of pixels in a pixels block along the coordinate
  *                      axis
  * @param out_offset    resulting relative offset of the pixel block in bytes
@@ -1981,6 +1987,7 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                unsigned block_length,
                                LLVMValueRef coord,
                                LLVMValueRef stride,
+                               LLVMValueRef texel_stride,
                                LLVMValueRef *out_offset,
                                LLVMValueRef *out_subcoord)
 {
@@ -1988,6 +1995,28 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
    LLVMValueRef offset;
    LLVMValueRef subcoord;
 
+   if (texel_stride) {
+      /*
+       * (coord & ~3) * stride + (coord & 3) * texel_stride, both strides
+       * usually being constant powers of two.
+       */
+      LLVMValueRef tile_mask =
+         lp_build_const_int_vec(bld->gallivm, bld->type,
+                                LP_TEXTURE_TILE_SIZE - 1);
+      LLVMValueRef tile_coord = lp_build_andnot(bld, coord, tile_mask);
+      LLVMValueRef texel_coord = LLVMBuildAnd(builder, coord, tile_mask, "");
+
+      assert(block_length == 1);
+
+      offset = lp_build_mul(bld, tile_coord, stride);
+      offset = lp_build_add(bld, offset,
+                            lp_build_mul(bld, texel_coord, texel_stride));
+
+      *out_offset = offset;
+      *out_subcoord = bld->zero;
+      return;
+   }
+
    if (block_length == 1) {
       subcoord = bld->zero;
    }
@@ -2027,12 +2056,14 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
  * Compute the offset of a pixel block.
  *
  * x, y, z, y_stride, z_stride are vectors, and they refer to pixels.
+ * tiled says whether the texture is stored in micro-tiles.
  *
  * Returns the relative offset and i,j sub-block coordinates
  */
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -2042,22 +2073,30 @@ lp_build_sample_offset(struct lp_build_context *bld,
                        LLVMValueRef *out_i,
                        LLVMValueRef *out_j)
 {
-   LLVMValueRef x_stride;
+   LLVMValueRef x_stride, x_texel_stride = NULL, y_texel_stride = NULL;
    LLVMValueRef offset;
 
    x_stride = lp_build_const_vec(bld->gallivm, bld->type,
                                  format_desc->block.bits/8);
 
+   if (tiled) {
+      x_texel_stride = x_stride;
+      x_stride = lp_build_const_vec(bld->gallivm, bld->type,
+                                    LP_TEXTURE_TILE_SIZE *
+                                    format_desc->block.bits/8);
+      y_texel_stride = x_stride;
+   }
+
    lp_build_sample_partial_offset(bld,
                                   format_desc->block.width,
-                                  x, x_stride,
+                                  x, x_stride, x_texel_stride,
                                   &offset, out_i);
 
    if (y && y_stride) {
       LLVMValueRef y_offset;
       lp_build_sample_partial_offset(bld,
                                      format_desc->block.height,
-                                     y, y_stride,
+                                     y, y_stride, y_texel_stride,
                                      &y_offset, out_j);
       offset = lp_build_add(bld, offset, y_offset);
    }
@@ -2070,7 +2109,7 @@ lp_build_sample_offset(struct lp_build_context *bld,
       LLVMValueRef k;
       lp_build_sample_partial_offset(bld,
                                      1, /* pixel blocks are always 2D */
-                                     z, z_stride,
+                                     z, z_stride, NULL,
                                      &z_offset, &k);
       offset = lp_build_add(bld, offset, z_offset);
    }
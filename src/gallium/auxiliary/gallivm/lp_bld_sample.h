@@ -36,6 +36,7 @@
 #define LP_BLD_SAMPLE_H
 
 
+#include "pipe/p_defines.h"
 #include "pipe/p_format.h"
 #include "util/u_debug.h"
 #include "gallivm/lp_bld.h"
@@ -122,6 +123,24 @@ struct lp_sampler_size_query_params
    LLVMValueRef explicit_lod;
    LLVMValueRef *sizes_out;
 };
+/**
+ * Size of the square micro-tiles textures can be stored in.
+ *
+ * A tiled texture keeps the strides of the linear layout, but each group
+ * of LP_TEXTURE_TILE_SIZE rows holds a row of micro-tiles, the texels of
+ * each micro-tile being stored contiguously in row-major order.  The
+ * bilinear footprint of most texels thus lies within one cache line.
+ */
+#define LP_TEXTURE_TILE_SIZE 4
+
+/**
+ * pipe_resource::flags bit of textures stored in micro-tiles.  Set by the
+ * driver, so drivers using the gallivm samplers must not use this bit
+ * for anything else.
+ */
+#define LP_RESOURCE_FLAG_TILED (PIPE_RESOURCE_FLAG_DRV_PRIV << 7)
+
+
 /**
  * Texture static state.
  *
@@ -143,6 +162,7 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< stored in micro-tiles? */
 };
 
 
@@ -586,6 +606,7 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                unsigned block_length,
                                LLVMValueRef coord,
                                LLVMValueRef stride,
+                               LLVMValueRef texel_stride,
                                LLVMValueRef *out_offset,
                                LLVMValueRef *out_i);
 
@@ -593,6 +614,7 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
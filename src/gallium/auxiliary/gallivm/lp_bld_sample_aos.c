@@ -68,6 +68,8 @@
  * \param coord_f  the incoming texcoord (s,t or r) as float vec
  * \param length  the texture size along one dimension
  * \param stride  pixel stride along the coordinate axis (in bytes)
+ * \param texel_stride  texel stride within micro-tiles, for tiled textures
+ *                      (see lp_build_sample_partial_offset())
  * \param offset  the texel offset along the coord axis
  * \param is_pot  if TRUE, length is a power of two
  * \param wrap_mode  one of PIPE_TEX_WRAP_x
@@ -81,6 +83,7 @@ lp_build_sample_wrap_nearest_int(struct lp_build_sample_context *bld,
                                  LLVMValueRef coord_f,
                                  LLVMValueRef length,
                                  LLVMValueRef stride,
+                                 LLVMValueRef texel_stride,
                                  LLVMValueRef offset,
                                  boolean is_pot,
                                  unsigned wrap_mode,
@@ -127,7 +130,7 @@ lp_build_sample_wrap_nearest_int(struct lp_build_sample_context *bld,
    }
 
    lp_build_sample_partial_offset(int_coord_bld, block_length, coord, stride,
-                                  out_offset, out_i);
+                                  texel_stride, out_offset, out_i);
 }
 
 
@@ -202,6 +205,8 @@ lp_build_coord_repeat_npot_linear_int(struct lp_build_sample_context *bld,
  * \param coord_f  the incoming texcoord (s,t or r) as float vec
  * \param length  the texture size along one dimension
  * \param stride  pixel stride along the coordinate axis (in bytes)
+ * \param texel_stride  texel stride within micro-tiles, for tiled textures
+ *                      (see lp_build_sample_partial_offset())
  * \param offset  the texel offset along the coord axis
  * \param is_pot  if TRUE, length is a power of two
  * \param wrap_mode  one of PIPE_TEX_WRAP_x
@@ -218,6 +223,7 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
                                 LLVMValueRef coord_f,
                                 LLVMValueRef length,
                                 LLVMValueRef stride,
+                                LLVMValueRef texel_stride,
                                 LLVMValueRef offset,
                                 boolean is_pot,
                                 unsigned wrap_mode,
@@ -232,15 +238,15 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
    LLVMValueRef lmask, umask, mask;
 
    /*
-    * If the pixel block covers more than one pixel then there is no easy
-    * way to calculate offset1 relative to offset0. Instead, compute them
-    * independently. Otherwise, try to compute offset0 and offset1 with
-    * a single stride multiplication.
+    * If the pixel block covers more than one pixel, or the texels are in
+    * micro-tiles, then there is no easy way to calculate offset1 relative
+    * to offset0. Instead, compute them independently. Otherwise, try to
+    * compute offset0 and offset1 with a single stride multiplication.
     */
 
    length_minus_one = lp_build_sub(int_coord_bld, length, int_coord_bld->one);
 
-   if (block_length != 1) {
+   if (block_length != 1 || texel_stride) {
       LLVMValueRef coord1;
       switch(wrap_mode) {
       case PIPE_TEX_WRAP_REPEAT:
@@ -290,9 +296,9 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
          break;
       }
       lp_build_sample_partial_offset(int_coord_bld, block_length, coord0, stride,
-                                     offset0, i0);
+                                     texel_stride, offset0, i0);
       lp_build_sample_partial_offset(int_coord_bld, block_length, coord1, stride,
-                                     offset1, i1);
+                                     texel_stride, offset1, i1);
       return;
    }
 
@@ -452,7 +458,8 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
    LLVMValueRef width_vec, height_vec, depth_vec;
    LLVMValueRef s_ipart, t_ipart = NULL, r_ipart = NULL;
    LLVMValueRef s_float, t_float = NULL, r_float = NULL;
-   LLVMValueRef x_stride;
+   LLVMValueRef x_stride, y_stride;
+   LLVMValueRef x_texel_stride = NULL, y_texel_stride = NULL;
    LLVMValueRef x_offset, offset;
    LLVMValueRef x_subcoord, y_subcoord, z_subcoord;
 
@@ -503,12 +510,22 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
    x_stride = lp_build_const_vec(bld->gallivm,
                                  bld->int_coord_bld.type,
                                  bld->format_desc->block.bits/8);
+   y_stride = row_stride_vec;
+   if (bld->static_texture_state->tiled) {
+      x_texel_stride = x_stride;
+      x_stride = lp_build_const_vec(bld->gallivm,
+                                    bld->int_coord_bld.type,
+                                    LP_TEXTURE_TILE_SIZE *
+                                    bld->format_desc->block.bits/8);
+      y_texel_stride = x_stride;
+   }
 
    /* Do texcoord wrapping, compute texel offset */
    lp_build_sample_wrap_nearest_int(bld,
                                     bld->format_desc->block.width,
                                     s_ipart, s_float,
-                                    width_vec, x_stride, offsets[0],
+                                    width_vec, x_stride, x_texel_stride,
+                                    offsets[0],
                                     bld->static_texture_state->pot_width,
                                     bld->static_sampler_state->wrap_s,
                                     &x_offset, &x_subcoord);
@@ -518,7 +535,8 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
       lp_build_sample_wrap_nearest_int(bld,
                                        bld->format_desc->block.height,
                                        t_ipart, t_float,
-                                       height_vec, row_stride_vec, offsets[1],
+                                       height_vec, y_stride, y_texel_stride,
+                                       offsets[1],
                                        bld->static_texture_state->pot_height,
                                        bld->static_sampler_state->wrap_t,
                                        &y_offset, &y_subcoord);
@@ -528,7 +546,8 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
          lp_build_sample_wrap_nearest_int(bld,
                                           1, /* block length (depth) */
                                           r_ipart, r_float,
-                                          depth_vec, img_stride_vec, offsets[2],
+                                          depth_vec, img_stride_vec, NULL,
+                                          offsets[2],
                                           bld->static_texture_state->pot_depth,
                                           bld->static_sampler_state->wrap_r,
                                           &z_offset, &z_subcoord);
@@ -765,6 +784,7 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
    LLVMValueRef t_ipart = NULL, t_fpart = NULL, t_float = NULL;
    LLVMValueRef r_ipart = NULL, r_fpart = NULL, r_float = NULL;
    LLVMValueRef x_stride, y_stride, z_stride;
+   LLVMValueRef x_texel_stride = NULL, y_texel_stride = NULL;
    LLVMValueRef x_offset0, x_offset1;
    LLVMValueRef y_offset0, y_offset1;
    LLVMValueRef z_offset0, z_offset1;
@@ -860,12 +880,20 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
                                  bld->format_desc->block.bits/8);
    y_stride = row_stride_vec;
    z_stride = img_stride_vec;
+   if (bld->static_texture_state->tiled) {
+      x_texel_stride = x_stride;
+      x_stride = lp_build_const_vec(bld->gallivm, bld->int_coord_bld.type,
+                                    LP_TEXTURE_TILE_SIZE *
+                                    bld->format_desc->block.bits/8);
+      y_texel_stride = x_stride;
+   }
 
    /* do texcoord wrapping and compute texel offsets */
    lp_build_sample_wrap_linear_int(bld,
                                    bld->format_desc->block.width,
                                    s_ipart, &s_fpart, s_float,
-                                   width_vec, x_stride, offsets[0],
+                                   width_vec, x_stride, x_texel_stride,
+                                   offsets[0],
                                    bld->static_texture_state->pot_width,
                                    bld->static_sampler_state->wrap_s,
                                    &x_offset0, &x_offset1,
@@ -895,7 +923,8 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
       lp_build_sample_wrap_linear_int(bld,
                                       bld->format_desc->block.height,
                                       t_ipart, &t_fpart, t_float,
-                                      height_vec, y_stride, offsets[1],
+                                      height_vec, y_stride, y_texel_stride,
+                                      offsets[1],
                                       bld->static_texture_state->pot_height,
                                       bld->static_sampler_state->wrap_t,
                                       &y_offset0, &y_offset1,
@@ -915,7 +944,8 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
       lp_build_sample_wrap_linear_int(bld,
                                       1, /* block length (depth) */
                                       r_ipart, &r_fpart, r_float,
-                                      depth_vec, z_stride, offsets[2],
+                                      depth_vec, z_stride, NULL,
+                                      offsets[2],
                                       bld->static_texture_state->pot_depth,
                                       bld->static_sampler_state->wrap_r,
                                       &z_offset0, &z_offset1,
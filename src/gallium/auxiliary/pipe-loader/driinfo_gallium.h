@@ -2,6 +2,7 @@
 DRI_CONF_SECTION_PERFORMANCE
    DRI_CONF_MESA_GLTHREAD("false")
    DRI_CONF_MESA_NO_ERROR("false")
+   DRI_CONF_MESA_ASYNC_TEXTURE_UPLOAD("false")
    DRI_CONF_DISABLE_EXT_BUFFER_AGE("false")
    DRI_CONF_DISABLE_OML_SYNC_CONTROL("false")
    DRI_CONF_DISABLE_SGI_VIDEO_SYNC("false")
@@ -48,7 +48,8 @@ util_format_bptc_rgba_unorm_pack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stri
 {
    compress_rgba_unorm(width, height,
                        src_row, src_stride,
-                       dst_row, dst_stride);
+                       dst_row, dst_stride,
+                       BPTC_QUALITY_FAST);
 }
 
 void
@@ -81,7 +82,8 @@ util_format_bptc_rgba_unorm_pack_rgba_float(uint8_t *dst_row, unsigned dst_strid
                         0, 0, width, height);
    compress_rgba_unorm(width, height,
                        temp_block, width * 4 * sizeof(uint8_t),
-                       dst_row, dst_stride);
+                       dst_row, dst_stride,
+                       BPTC_QUALITY_FAST);
    free((void *) temp_block);
 }
 
@@ -117,7 +119,8 @@ util_format_bptc_srgba_pack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stride,
 {
    compress_rgba_unorm(width, height,
                        src_row, src_stride,
-                       dst_row, dst_stride);
+                       dst_row, dst_stride,
+                       BPTC_QUALITY_FAST);
 }
 
 void
@@ -187,7 +190,8 @@ util_format_bptc_rgb_float_pack_rgba_8unorm(uint8_t *dst_row, unsigned dst_strid
 {
    compress_rgba_unorm(width, height,
                        src_row, src_stride,
-                       dst_row, dst_stride);
+                       dst_row, dst_stride,
+                       BPTC_QUALITY_FAST);
 }
 
 void
@@ -245,7 +249,8 @@ util_format_bptc_rgb_ufloat_pack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stri
 {
    compress_rgba_unorm(width, height,
                        src_row, src_stride,
-                       dst_row, dst_stride);
+                       dst_row, dst_stride,
+                       BPTC_QUALITY_FAST);
 }
 
 void
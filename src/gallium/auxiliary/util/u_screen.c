@@ -327,6 +327,7 @@ u_pipe_screen_get_param_defaults(struct pipe_screen *pscreen,
       return 2047;
 
    case PIPE_CAP_SURFACE_SAMPLE_COUNT:
+   case PIPE_CAP_CONSTBUF0_PARTIAL_UPDATES:
       return 0;
 
    default:
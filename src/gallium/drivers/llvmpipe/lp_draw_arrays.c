@@ -97,13 +97,25 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
       draw_set_indexes(draw,
                        (ubyte *) mapped_indices,
                        info->index_size, available_space);
+
+      /* Persistently mapped buffers change behind our back */
+      if (!info->has_user_indices &&
+          !(info->index.resource->flags & (PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                                           PIPE_RESOURCE_FLAG_MAP_COHERENT))) {
+         draw_set_indexes_stamp(draw, info->index.resource,
+                                llvmpipe_resource(info->index.resource)->timestamp);
+      }
    }
 
    for (i = 0; i < lp->num_so_targets; i++) {
       void *buf = 0;
       if (lp->so_targets[i]) {
-         buf = llvmpipe_resource(lp->so_targets[i]->target.buffer)->data;
+         struct llvmpipe_resource *lpr =
+            llvmpipe_resource(lp->so_targets[i]->target.buffer);
+         buf = lpr->data;
          lp->so_targets[i]->mapping = buf;
+         /* the contents are about to be written by the pipeline */
+         lpr->timestamp = 0;
       }
    }
    draw_set_mapped_so_targets(draw, lp->num_so_targets,
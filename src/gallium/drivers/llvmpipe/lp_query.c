@@ -41,6 +41,7 @@
 #include "lp_screen.h"
 #include "lp_state.h"
 #include "lp_rast.h"
+#include "lp_texture.h"
 
 
 static struct llvmpipe_query *llvmpipe_query( struct pipe_query *p )
@@ -104,13 +105,26 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    if (pq->fence) {
       /* only have a fence if there was a scene */
       if (!lp_fence_signalled(pq->fence)) {
-         if (!lp_fence_issued(pq->fence))
+         if (!lp_fence_issued(pq->fence)) {
+            /* Don't rasterize the scene early just because the app checks
+             * whether the result is there yet, it often renders on and
+             * comes back later.  Only flush if it keeps asking, so that
+             * the result eventually becomes available.
+             */
+            if (!wait && !pq->polled) {
+               pq->polled = TRUE;
+               return FALSE;
+            }
+
             llvmpipe_flush(pipe, NULL, __FUNCTION__);
+         }
 
-         if (!wait)
-            return FALSE;
+         if (!lp_fence_signalled(pq->fence)) {
+            if (!wait)
+               return FALSE;
 
-         lp_fence_wait(pq->fence);
+            lp_fence_wait(pq->fence);
+         }
       }
    }
 
@@ -138,6 +152,22 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
          }
       }
       break;
+   case PIPE_QUERY_TIME_ELAPSED: {
+      uint64_t start = UINT64_MAX, end = 0;
+      for (i = 0; i < num_threads; i++) {
+         /* threads which rasterized no bins have no start time */
+         if (pq->start[i] && pq->start[i] < start) {
+            start = pq->start[i];
+         }
+         if (pq->end[i] > end) {
+            end = pq->end[i];
+         }
+      }
+      if (end > start) {
+         *result = end - start;
+      }
+   }
+      break;
    case PIPE_QUERY_TIMESTAMP_DISJOINT: {
       struct pipe_query_data_timestamp_disjoint *td =
          (struct pipe_query_data_timestamp_disjoint *)vresult;
@@ -169,12 +199,14 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    case PIPE_QUERY_PIPELINE_STATISTICS: {
       struct pipe_query_data_pipeline_statistics *stats =
          (struct pipe_query_data_pipeline_statistics *)vresult;
+      uint64_t ps_invocations = pq->stats.ps_invocations;
       /* only ps_invocations come from binned query */
       for (i = 0; i < num_threads; i++) {
-         pq->stats.ps_invocations += pq->end[i];
+         ps_invocations += pq->end[i];
       }
-      pq->stats.ps_invocations *= LP_RASTER_BLOCK_SIZE * LP_RASTER_BLOCK_SIZE;
       *stats = pq->stats;
+      stats->ps_invocations =
+         ps_invocations * LP_RASTER_BLOCK_SIZE * LP_RASTER_BLOCK_SIZE;
    }
       break;
    default:
@@ -186,6 +218,85 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
 }
 
 
+/**
+ * Store the result of a query, or its availability (index -1), into a
+ * buffer.  Without wait this doesn't wait for the query, the result is
+ * simply not written if it isn't available yet.  Writing still waits for
+ * queued rendering which uses the buffer.
+ */
+static void
+llvmpipe_get_query_result_resource(struct pipe_context *pipe,
+                                   struct pipe_query *q,
+                                   boolean wait,
+                                   enum pipe_query_value_type result_type,
+                                   int index,
+                                   struct pipe_resource *resource,
+                                   unsigned offset)
+{
+   struct llvmpipe_query *pq = llvmpipe_query(q);
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   union pipe_query_result result;
+   boolean available;
+   uint64_t value;
+   ubyte *dst;
+
+   available = llvmpipe_get_query_result(pipe, q, wait, &result);
+
+   if (index == -1) {
+      value = available;
+   }
+   else if (!available) {
+      return;
+   }
+   else {
+      switch (pq->type) {
+      case PIPE_QUERY_OCCLUSION_PREDICATE:
+      case PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE:
+      case PIPE_QUERY_SO_OVERFLOW_PREDICATE:
+      case PIPE_QUERY_SO_OVERFLOW_ANY_PREDICATE:
+      case PIPE_QUERY_GPU_FINISHED:
+         value = result.b;
+         break;
+      case PIPE_QUERY_SO_STATISTICS:
+         value = index ? result.so_statistics.primitives_storage_needed :
+                         result.so_statistics.num_primitives_written;
+         break;
+      case PIPE_QUERY_PIPELINE_STATISTICS:
+         /* the statistics are laid out in the order of their indices */
+         assert((unsigned)index <
+                sizeof(result.pipeline_statistics) / sizeof(uint64_t));
+         value = ((const uint64_t *)&result.pipeline_statistics)[index];
+         break;
+      default:
+         value = result.u64;
+         break;
+      }
+   }
+
+   /* The scene may still read the buffer */
+   llvmpipe_flush_resource(pipe, resource, 0, FALSE, TRUE, FALSE,
+                           __FUNCTION__);
+
+   dst = (ubyte *)llvmpipe_resource_data(resource) + offset;
+
+   /* the contents no longer match what was cached for the timestamp */
+   lpr->timestamp = 0;
+
+   switch (result_type) {
+   case PIPE_QUERY_TYPE_I32:
+      *(int32_t *)dst = (int32_t)MIN2(value, INT32_MAX);
+      break;
+   case PIPE_QUERY_TYPE_U32:
+      *(uint32_t *)dst = (uint32_t)MIN2(value, UINT32_MAX);
+      break;
+   case PIPE_QUERY_TYPE_I64:
+   case PIPE_QUERY_TYPE_U64:
+      *(uint64_t *)dst = value;
+      break;
+   }
+}
+
+
 static boolean
 llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
 {
@@ -203,6 +314,7 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
 
    memset(pq->start, 0, sizeof(pq->start));
    memset(pq->end, 0, sizeof(pq->end));
+   pq->polled = FALSE;
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -249,6 +361,7 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   pq->polled = FALSE;
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -340,6 +453,7 @@ void llvmpipe_init_query_funcs(struct llvmpipe_context *llvmpipe )
    llvmpipe->pipe.begin_query = llvmpipe_begin_query;
    llvmpipe->pipe.end_query = llvmpipe_end_query;
    llvmpipe->pipe.get_query_result = llvmpipe_get_query_result;
+   llvmpipe->pipe.get_query_result_resource = llvmpipe_get_query_result_resource;
    llvmpipe->pipe.set_active_query_state = llvmpipe_set_active_query_state;
 }
 
@@ -48,6 +48,7 @@ struct llvmpipe_query {
    unsigned type;                   /* PIPE_QUERY_* */
    unsigned num_primitives_generated;
    unsigned num_primitives_written;
+   boolean polled;                  /* result was asked for, not flushed */
 
    struct pipe_query_data_pipeline_statistics stats;
 };
@@ -121,6 +121,73 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
                          scene->zsbuf.stride * task->y +
                          scene->zsbuf.format_bytes * task->x;
    }
+
+   task->hiz = NULL;
+   if (scene->hiz.blocks) {
+      unsigned bx, by;
+
+      task->hiz = scene->hiz.blocks +
+                  scene->hiz.stride * (task->y / LP_HIZ_BLOCK_SIZE) +
+                  task->x / LP_HIZ_BLOCK_SIZE;
+
+      task->hiz_zmin = INFINITY;
+      task->hiz_zmax = -INFINITY;
+      for (by = 0; by * LP_HIZ_BLOCK_SIZE < task->height; by++) {
+         for (bx = 0; bx * LP_HIZ_BLOCK_SIZE < task->width; bx++) {
+            const struct lp_hiz_block *block = lp_rast_get_hiz_block(task, bx, by);
+            task->hiz_zmin = MIN2(task->hiz_zmin, block->zmin);
+            task->hiz_zmax = MAX2(task->hiz_zmax, block->zmax);
+         }
+      }
+   }
+}
+
+
+/**
+ * Set the depth bounds of all the hiz blocks of the current tile after
+ * a depth clear.
+ */
+static void
+lp_rast_hiz_clear(struct lp_rasterizer_task *task,
+                  uint64_t clear_value, uint64_t clear_mask)
+{
+   enum pipe_format format = task->scene->fb.zsbuf->format;
+   const struct util_format_description *desc = util_format_description(format);
+   uint64_t depth_mask = util_pack64_mask_z(format, 0xffffffff);
+   boolean exact;
+   float z = 0.0f;
+   unsigned bx, by;
+
+   if (!(clear_mask & depth_mask))
+      return;
+
+   /* Only clears of all the depth bits give known values. */
+   exact = (clear_mask & depth_mask) == depth_mask;
+   if (exact) {
+      desc->unpack_z_float(&z, 0, (const uint8_t *)&clear_value, 0, 1, 1);
+   }
+
+   task->hiz_zmin = INFINITY;
+   task->hiz_zmax = -INFINITY;
+   for (by = 0; by * LP_HIZ_BLOCK_SIZE < task->height; by++) {
+      for (bx = 0; bx * LP_HIZ_BLOCK_SIZE < task->width; bx++) {
+         struct lp_hiz_block *block = lp_rast_get_hiz_block(task, bx, by);
+         if (!exact) {
+            block->zmin = -INFINITY;
+            block->zmax = INFINITY;
+         }
+         else if (lp_rast_hiz_block_covered(task, bx, by)) {
+            block->zmin = z;
+            block->zmax = z;
+         }
+         else {
+            block->zmin = MIN2(block->zmin, z);
+            block->zmax = MAX2(block->zmax, z);
+         }
+         task->hiz_zmin = MIN2(task->hiz_zmin, block->zmin);
+         task->hiz_zmax = MAX2(task->hiz_zmax, block->zmax);
+      }
+   }
 }
 
 
@@ -281,6 +348,10 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
          }
          dst_layer += scene->zsbuf.layer_stride;
       }
+
+      if (task->hiz) {
+         lp_rast_hiz_clear(task, arg.clear_zstencil.value, clear_mask64);
+      }
    }
 }
 
@@ -316,6 +387,16 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    }
    variant = state->variant;
 
+   if (lp_rast_hiz_reject_tile(task, inputs)) {
+      return;
+   }
+
+   if (inputs->linear &&
+       lp_rast_linear_shade(task, inputs, tile_x, tile_y,
+                            task->width, task->height, 0xffff)) {
+      return;
+   }
+
    /* render the whole 64x64 tile in 4x4 chunks */
    for (y = 0; y < task->height; y += 4){
       for (x = 0; x < task->width; x += 4) {
@@ -325,6 +406,10 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
          unsigned depth_stride = 0;
          unsigned i;
 
+         if (lp_rast_hiz_reject(task, inputs, tile_x + x, tile_y + y, 4)) {
+            continue;
+         }
+
          /* color buffer */
          for (i = 0; i < scene->fb.nr_cbufs; i++){
             if (scene->fb.cbufs[i]) {
@@ -365,6 +450,15 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
          END_JIT_CALL();
       }
    }
+
+   /* the triangle covers all the blocks of the tile */
+   if (task->hiz) {
+      for (y = 0; y < task->height; y += LP_HIZ_BLOCK_SIZE) {
+         for (x = 0; x < task->width; x += LP_HIZ_BLOCK_SIZE) {
+            lp_rast_hiz_update(task, inputs, tile_x + x, tile_y + y, TRUE);
+         }
+      }
+   }
 }
 
 
@@ -446,6 +540,11 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
     * allocated 4x4 blocks hence need to filter them out here.
     */
    if ((x % TILE_SIZE) < task->width && (y % TILE_SIZE) < task->height) {
+      if (inputs->linear &&
+          lp_rast_linear_shade(task, inputs, x, y, 4, 4, mask)) {
+         return;
+      }
+
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
@@ -464,6 +563,8 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                                             stride,
                                             depth_stride);
       END_JIT_CALL();
+
+      lp_rast_hiz_update(task, inputs, x, y, FALSE);
    }
 }
 
@@ -489,6 +590,11 @@ lp_rast_begin_query(struct lp_rasterizer_task *task,
    case PIPE_QUERY_PIPELINE_STATISTICS:
       pq->start[task->thread_index] = task->thread_data.ps_invocations;
       break;
+   case PIPE_QUERY_TIME_ELAPSED:
+      /* the query may span several scenes, keep the earliest start */
+      if (!pq->start[task->thread_index])
+         pq->start[task->thread_index] = os_time_get_nano();
+      break;
    default:
       assert(0);
       break;
@@ -516,6 +622,7 @@ lp_rast_end_query(struct lp_rasterizer_task *task,
       pq->start[task->thread_index] = 0;
       break;
    case PIPE_QUERY_TIMESTAMP:
+   case PIPE_QUERY_TIME_ELAPSED:
       pq->end[task->thread_index] = os_time_get_nano();
       break;
    case PIPE_QUERY_PIPELINE_STATISTICS:
@@ -100,10 +100,13 @@ struct lp_rast_shader_inputs {
    unsigned frontfacing:1;      /** True for front-facing */
    unsigned disable:1;          /** Partially binned, disable this command */
    unsigned opaque:1;           /** Is opaque */
-   unsigned pad0:29;            /* wasted space */
+   unsigned linear:1;           /** Shade with the linear span path */
+   unsigned pad0:28;            /* wasted space */
    unsigned stride;             /* how much to advance data between a0, dadx, dady */
    unsigned layer;              /* the layer to render to (from gs, already clamped) */
    unsigned viewport_index;     /* the active viewport index (from gs, already clamped) */
+   float zmin, zmax;            /* bounds of the fragment depth values (for hiz) */
+   unsigned pad1[2];            /* keep a0 16-byte aligned */
    /* followed by a0, dadx, dady and planes[] */
 };
 
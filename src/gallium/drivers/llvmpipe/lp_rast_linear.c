@@ -0,0 +1,641 @@
+/**************************************************************************
+ *
+ * Copyright 2010 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Linear span path.
+ *
+ * Shades rectangles of variants recognized by lp_fs_linear_analyse() a
+ * whole scanline at a time, instead of calling the jitted fragment
+ * function for every 4x4 block.  Texels are handled in packed 8-bit form,
+ * and blending is done 8-bit channel-wise with the same rounding as the
+ * jitted unorm8 blend code.
+ *
+ * The results must be the same as the jitted code's, bit for bit.  So the
+ * texture coordinates are interpolated with the same float operations as
+ * in lp_bld_interp.c, and turned into texel indices and bilinear weights
+ * as in lp_bld_sample_aos.c.  That is only cheap when s varies along x
+ * and t along y alone, as it does for blits and 2D compositing: then a
+ * rectangle's texel indices and weights are computed once per column and
+ * once per row.  Other rectangles go to the jitted fragment function.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "util/u_cpu_detect.h"
+#include "util/u_math.h"
+#include "lp_debug.h"
+#include "lp_perf.h"
+#include "lp_rast_priv.h"
+#include "lp_state_fs.h"
+
+#if defined(PIPE_ARCH_SSE)
+#include <emmintrin.h>
+#endif
+
+
+/**
+ * Largest texel coordinate magnitude handled, so that the coordinates in
+ * 24.8 fixed point can't overflow.
+ */
+#define LINEAR_COORD_MAX 8192.0f
+
+/** What lp_build_fract_safe() clamps fractions to */
+#define LINEAR_FRACT_MAX (1.0f - 1.0f / (1 << 24))
+
+
+struct linear_sampler
+{
+   const uint8_t *texels;
+   unsigned stride;
+   int width;
+   int height;
+};
+
+
+/**
+ * Texels sampled along one side of a rectangle.  With nearest filtering
+ * only i0 is used.  With bilinear filtering i0 and i1 are the two texels,
+ * and weight the weight of i1 in 0..255, repeated for the four channels.
+ */
+struct linear_axis
+{
+   int i0[TILE_SIZE];
+   int i1[TILE_SIZE];
+   uint64_t weight[TILE_SIZE];
+   boolean unweighted;  /**< all weights are zero, so only i0 counts */
+   boolean contiguous;  /**< i0 steps by one texel from sample to sample */
+};
+
+
+/**
+ * a0 + dadx * x as the jitted code interpolates it, with llvm.fmuladd
+ * (see attribs_update_simple()), which is fused when the JIT targets FMA.
+ */
+static inline float
+linear_interp(float a0, float dadx, float x, boolean fused)
+{
+   if (fused) {
+      return fmaf(dadx, x, a0);
+   }
+   /* The product is exact in double, so this rounds it once, and can't be
+    * contracted into a fused multiply-add by the compiler.
+    */
+   return (float)((double)dadx * x) + a0;
+}
+
+
+/**
+ * Round to nearest even, like lp_build_iround().
+ */
+static inline int
+linear_iround(float f)
+{
+#if defined(PIPE_ARCH_SSE)
+   return _mm_cvtss_si32(_mm_set_ss(f));
+#else
+   return (int)lrintf(f);
+#endif
+}
+
+
+static void
+linear_axis_flags(struct linear_axis *axis, unsigned n, boolean filter_linear)
+{
+   unsigned k;
+
+   axis->unweighted = TRUE;
+   axis->contiguous = TRUE;
+   for (k = 0; k < n; k++) {
+      if (filter_linear && axis->weight[k]) {
+         axis->unweighted = FALSE;
+      }
+      if (axis->i0[k] != axis->i0[0] + (int)k) {
+         axis->contiguous = FALSE;
+      }
+   }
+}
+
+
+/**
+ * Texel indices for nearest filtering, as lp_build_sample_image_nearest()
+ * computes them.
+ * \param coord  texture coordinates of the samples
+ * \param size  texture width or height
+ */
+static void
+linear_axis_nearest(struct linear_axis *axis,
+                    const float *coord, unsigned n, int size,
+                    boolean normalized, boolean repeat, boolean pot)
+{
+   unsigned k;
+
+   for (k = 0; k < n; k++) {
+      const float c = coord[k];
+      int i;
+
+      if (repeat && !pot) {
+         const float f = MIN2(c - floorf(c), LINEAR_FRACT_MAX);
+         i = (int)(f * (float)size);
+      }
+      else {
+         i = (int)floorf(normalized ? c * (float)size : c);
+         i = repeat ? i & (size - 1) : CLAMP(i, 0, size - 1);
+      }
+
+      axis->i0[k] = i;
+      axis->weight[k] = 0;
+   }
+
+   linear_axis_flags(axis, n, FALSE);
+}
+
+
+/**
+ * Texel indices and weights for bilinear filtering, as
+ * lp_build_sample_image_linear() computes them, in 24.8 fixed point.
+ */
+static void
+linear_axis_bilinear(struct linear_axis *axis,
+                     const float *coord, unsigned n, int size,
+                     boolean normalized, boolean repeat, boolean pot)
+{
+   unsigned k;
+
+   for (k = 0; k < n; k++) {
+      const float c = coord[k];
+      int i, i0, i1;
+
+      if (repeat && !pot) {
+         /* lp_build_coord_repeat_npot_linear_int() */
+         i = linear_iround((c - floorf(c)) * (float)size * 256.0f) - 128;
+         i0 = i >> 8;
+         if (i0 < 0) {
+            i0 = size - 1;
+         }
+         i0 = MIN2(i0, size - 1);
+         i1 = i0 != size - 1 ? i0 + 1 : 0;
+      }
+      else {
+         i = linear_iround(normalized ? c * (float)(size << 8)
+                                      : c * 256.0f) - 128;
+         i0 = i >> 8;
+         if (repeat) {
+            i0 &= size - 1;
+            i1 = i0 != size - 1 ? i0 + 1 : 0;
+         }
+         else {
+            i1 = i0 >= 0 && i0 < size - 1 ? i0 + 1 : CLAMP(i0, 0, size - 1);
+            i0 = CLAMP(i0, 0, size - 1);
+         }
+      }
+
+      axis->i0[k] = i0;
+      axis->i1[k] = i1;
+      axis->weight[k] = (i & 0xff) * 0x0001000100010001ULL;
+   }
+
+   linear_axis_flags(axis, n, TRUE);
+}
+
+
+static inline const uint32_t *
+linear_texel_row(const struct linear_sampler *samp, int i)
+{
+   return (const uint32_t *)(samp->texels + i * samp->stride);
+}
+
+
+/**
+ * Fetch a span of texels from one texel row.
+ */
+static void
+linear_fetch_nearest(const struct linear_sampler *samp,
+                     const struct linear_axis *cols, unsigned width,
+                     int row, uint32_t *out)
+{
+   const uint32_t *texels = linear_texel_row(samp, row);
+   unsigned i;
+
+   if (cols->contiguous) {
+      memcpy(out, texels + cols->i0[0], width * 4);
+      return;
+   }
+
+   for (i = 0; i < width; i++) {
+      out[i] = texels[cols->i0[i]];
+   }
+}
+
+
+/**
+ * a + (b - a) * weight / 256 per channel, rounded down, as lp_build_lerp()
+ * does it with prescaled weights.
+ */
+static inline uint32_t
+linear_lerp(uint32_t a, uint32_t b, unsigned weight)
+{
+   uint32_t res = 0;
+   unsigned c;
+
+   for (c = 0; c < 32; c += 8) {
+      const int ca = (a >> c) & 0xff;
+      const int cb = (b >> c) & 0xff;
+      res |= (uint32_t)(ca + (((int)weight * (cb - ca)) >> 8)) << c;
+   }
+   return res;
+}
+
+
+#if defined(PIPE_ARCH_SSE)
+
+/**
+ * linear_lerp() of two pixels unpacked to 16 bits per channel.  Like the
+ * jitted code, this multiplies and shifts modulo 2^16, and adds modulo
+ * 2^8, which gives the same as rounding the signed product down.
+ */
+static inline __m128i
+linear_lerp_sse2(__m128i weight, __m128i a, __m128i b)
+{
+   __m128i d = _mm_mullo_epi16(weight, _mm_sub_epi16(b, a));
+   d = _mm_add_epi16(a, _mm_srli_epi16(d, 8));
+   return _mm_and_si128(d, _mm_set1_epi16(0xff));
+}
+
+#endif /* PIPE_ARCH_SSE */
+
+
+/**
+ * Fetch and filter a span of texels from two texel rows, horizontally
+ * first, like lp_build_lerp_2d().
+ */
+static void
+linear_fetch_bilinear(const struct linear_sampler *samp,
+                      const struct linear_axis *cols, unsigned width,
+                      int row0, int row1, unsigned weight, uint32_t *out)
+{
+   const uint32_t *texels0 = linear_texel_row(samp, row0);
+   const uint32_t *texels1 = linear_texel_row(samp, row1);
+   const int *i0 = cols->i0, *i1 = cols->i1;
+   unsigned i = 0;
+
+#if defined(PIPE_ARCH_SSE)
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i wy = _mm_set1_epi16(weight);
+
+   for (; i + 4 <= width; i += 4) {
+      const __m128i t00 = _mm_setr_epi32(texels0[i0[i]], texels0[i0[i + 1]],
+                                         texels0[i0[i + 2]], texels0[i0[i + 3]]);
+      const __m128i t01 = _mm_setr_epi32(texels0[i1[i]], texels0[i1[i + 1]],
+                                         texels0[i1[i + 2]], texels0[i1[i + 3]]);
+      const __m128i t10 = _mm_setr_epi32(texels1[i0[i]], texels1[i0[i + 1]],
+                                         texels1[i0[i + 2]], texels1[i0[i + 3]]);
+      const __m128i t11 = _mm_setr_epi32(texels1[i1[i]], texels1[i1[i + 1]],
+                                         texels1[i1[i + 2]], texels1[i1[i + 3]]);
+      const __m128i wx_lo = _mm_loadu_si128((const __m128i *)&cols->weight[i]);
+      const __m128i wx_hi = _mm_loadu_si128((const __m128i *)&cols->weight[i + 2]);
+      __m128i lo, hi;
+
+      lo = linear_lerp_sse2(wy,
+                            linear_lerp_sse2(wx_lo,
+                                             _mm_unpacklo_epi8(t00, zero),
+                                             _mm_unpacklo_epi8(t01, zero)),
+                            linear_lerp_sse2(wx_lo,
+                                             _mm_unpacklo_epi8(t10, zero),
+                                             _mm_unpacklo_epi8(t11, zero)));
+      hi = linear_lerp_sse2(wy,
+                            linear_lerp_sse2(wx_hi,
+                                             _mm_unpackhi_epi8(t00, zero),
+                                             _mm_unpackhi_epi8(t01, zero)),
+                            linear_lerp_sse2(wx_hi,
+                                             _mm_unpackhi_epi8(t10, zero),
+                                             _mm_unpackhi_epi8(t11, zero)));
+
+      _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(lo, hi));
+   }
+#endif
+
+   for (; i < width; i++) {
+      const unsigned wx = cols->weight[i] & 0xff;
+      out[i] = linear_lerp(linear_lerp(texels0[i0[i]], texels0[i1[i]], wx),
+                           linear_lerp(texels1[i0[i]], texels1[i1[i]], wx),
+                           weight);
+   }
+}
+
+
+/**
+ * x * y / 255 as lp_build_mul_norm() approximates it for blending.
+ */
+static inline unsigned
+linear_mul_norm(unsigned x, unsigned y)
+{
+   unsigned t = x * y;
+   return (t + (t >> 8) + 0x80) >> 8;
+}
+
+
+/**
+ * Swap red and blue, and force alpha to one.
+ */
+static inline uint32_t
+linear_color_pixel(const struct lp_fs_linear_info *info, uint32_t texel)
+{
+   if (info->swap_rb) {
+      texel = (texel & 0xff00ff00) |
+              ((texel >> 16) & 0xff) |
+              ((texel & 0xff) << 16);
+   }
+   if (info->tex_opaque) {
+      texel |= 0xff000000;
+   }
+   return texel;
+}
+
+
+/**
+ * Blend a pixel the way the jitted AoS blend code does, see lp_build_blend().
+ */
+static inline uint32_t
+linear_blend_pixel(enum lp_linear_blend blend, uint32_t src, uint32_t dst)
+{
+   unsigned src_alpha = src >> 24;
+   uint32_t res = 0;
+   unsigned c;
+
+   if (blend == LP_LINEAR_BLEND_NONE) {
+      return src;
+   }
+
+   for (c = 0; c < 32; c += 8) {
+      unsigned v = (src >> c) & 0xff;
+      if (blend == LP_LINEAR_BLEND_ALPHA) {
+         v = linear_mul_norm(v, src_alpha);
+      }
+      v += linear_mul_norm((dst >> c) & 0xff, 255 - src_alpha);
+      res |= MIN2(v, 255) << c;
+   }
+   return res;
+}
+
+
+#if defined(PIPE_ARCH_SSE)
+
+static inline __m128i
+linear_mul_norm_sse2(__m128i x, __m128i y)
+{
+   __m128i t = _mm_mullo_epi16(x, y);
+   t = _mm_add_epi16(t, _mm_srli_epi16(t, 8));
+   return _mm_srli_epi16(_mm_add_epi16(t, _mm_set1_epi16(0x80)), 8);
+}
+
+
+static inline __m128i
+linear_alpha_sse2(__m128i x)
+{
+   x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+   return _mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+
+/**
+ * Color and blend four pixels.
+ */
+static inline __m128i
+linear_shade4_sse2(const struct lp_fs_linear_info *info,
+                   __m128i src, __m128i dst)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i ones = _mm_set1_epi16(0xff);
+   __m128i src_lo, src_hi, dst_lo, dst_hi, a_lo, a_hi;
+
+   if (info->swap_rb) {
+      const __m128i ga = _mm_set1_epi32(0xff00ff00);
+      const __m128i low = _mm_set1_epi32(0xff);
+      src = _mm_or_si128(_mm_and_si128(src, ga),
+                         _mm_or_si128(_mm_and_si128(_mm_srli_epi32(src, 16), low),
+                                      _mm_slli_epi32(_mm_and_si128(src, low), 16)));
+   }
+   if (info->tex_opaque) {
+      src = _mm_or_si128(src, _mm_set1_epi32(0xff000000));
+   }
+
+   if (info->blend == LP_LINEAR_BLEND_NONE) {
+      return src;
+   }
+
+   src_lo = _mm_unpacklo_epi8(src, zero);
+   src_hi = _mm_unpackhi_epi8(src, zero);
+   a_lo = linear_alpha_sse2(src_lo);
+   a_hi = linear_alpha_sse2(src_hi);
+   dst_lo = _mm_unpacklo_epi8(dst, zero);
+   dst_hi = _mm_unpackhi_epi8(dst, zero);
+
+   if (info->blend == LP_LINEAR_BLEND_ALPHA) {
+      src_lo = linear_mul_norm_sse2(src_lo, a_lo);
+      src_hi = linear_mul_norm_sse2(src_hi, a_hi);
+   }
+
+   dst_lo = linear_mul_norm_sse2(dst_lo, _mm_sub_epi16(ones, a_lo));
+   dst_hi = linear_mul_norm_sse2(dst_hi, _mm_sub_epi16(ones, a_hi));
+   src_lo = _mm_add_epi16(src_lo, dst_lo);
+   src_hi = _mm_add_epi16(src_hi, dst_hi);
+
+   /* saturates */
+   return _mm_packus_epi16(src_lo, src_hi);
+}
+
+
+#endif /* PIPE_ARCH_SSE */
+
+
+/**
+ * Color and blend a span of texels into the color buffer.
+ * \param mask  which pixels to write, for spans of at most four pixels
+ */
+static void
+linear_shade_span(const struct lp_fs_linear_info *info,
+                  const uint32_t *src, uint32_t *dst,
+                  unsigned width, unsigned mask)
+{
+   unsigned i = 0;
+
+   if (mask != 0xf) {
+      for (i = 0; i < width; i++) {
+         if (mask & (1 << i)) {
+            dst[i] = linear_blend_pixel(info->blend,
+                                        linear_color_pixel(info, src[i]),
+                                        dst[i]);
+         }
+      }
+      return;
+   }
+
+#if defined(PIPE_ARCH_SSE)
+   for (; i + 4 <= width; i += 4) {
+      __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+      _mm_storeu_si128((__m128i *)(dst + i), linear_shade4_sse2(info, s, d));
+   }
+#endif
+
+   for (; i < width; i++) {
+      dst[i] = linear_blend_pixel(info->blend,
+                                  linear_color_pixel(info, src[i]),
+                                  dst[i]);
+   }
+}
+
+
+/**
+ * Shade a rectangle of a primitive flagged with inputs->linear.
+ * \param x, y  window coords of the rectangle, a multiple of four
+ * \param width, height  size of the rectangle, clipped to the tile here
+ * \param mask  coverage mask, only for 4x4 rectangles, 0xffff otherwise
+ * \return FALSE if the rectangle must be shaded by the fragment function
+ */
+boolean
+lp_rast_linear_shade(struct lp_rasterizer_task *task,
+                     const struct lp_rast_shader_inputs *inputs,
+                     unsigned x, unsigned y,
+                     unsigned width, unsigned height,
+                     unsigned mask)
+{
+   const struct lp_scene *scene = task->scene;
+   const struct lp_rast_state *state = task->state;
+   const struct lp_fs_linear_info *info = &state->variant->linear;
+   const struct lp_jit_texture *texture =
+      &state->jit_context.textures[info->unit];
+   const float (*a0)[4] = (const float (*)[4])GET_A0(inputs);
+   const float (*dadx)[4] = (const float (*)[4])GET_DADX(inputs);
+   const float (*dady)[4] = (const float (*)[4])GET_DADY(inputs);
+   const unsigned slot = info->tex_slot;
+   const unsigned level = texture->first_level;
+   const unsigned px = x % TILE_SIZE, py = y % TILE_SIZE;
+   const boolean fused = HAVE_LLVM >= 0x0304 && util_cpu_caps.has_fma;
+   PIPE_ALIGN_VAR(16) uint32_t texels[TILE_SIZE];
+   struct linear_sampler samp;
+   struct linear_axis cols, rows;
+   float s[TILE_SIZE], t[TILE_SIZE];
+   float scale_s, scale_t;
+   unsigned dst_stride;
+   uint8_t *dst;
+   unsigned i, j;
+
+   if (px >= task->width || py >= task->height) {
+      return TRUE;
+   }
+   width = MIN2(width, task->width - px);
+   height = MIN2(height, task->height - py);
+
+   /*
+    * s must only vary along x, and t along y.  Perspective inputs are
+    * divided by w, which must be exactly one.
+    */
+   if (dady[slot][0] != 0.0f || dadx[slot][1] != 0.0f) {
+      return FALSE;
+   }
+   if (info->perspective &&
+       (a0[0][3] != 1.0f || dadx[0][3] != 0.0f || dady[0][3] != 0.0f)) {
+      return FALSE;
+   }
+
+   samp.texels = (const uint8_t *)texture->base + texture->mip_offsets[level];
+   samp.stride = texture->row_stride[level];
+   samp.width = u_minify(texture->width, level);
+   samp.height = u_minify(texture->height, level);
+
+   /*
+    * The coefficients are relative to the window origin.  Adding the
+    * zero dady * y to s, or dtdx * x to t, changes neither.
+    */
+   for (i = 0; i < width; i++) {
+      s[i] = linear_interp(a0[slot][0], dadx[slot][0], (float)(x + i), fused);
+   }
+   for (j = 0; j < height; j++) {
+      t[j] = linear_interp(a0[slot][1], dady[slot][1], (float)(y + j), fused);
+   }
+
+   /* s and t are monotonic, so the ends bound them; also catches NaNs */
+   scale_s = info->normalized ? (float)samp.width : 1.0f;
+   scale_t = info->normalized ? (float)samp.height : 1.0f;
+   if (!(fabsf(s[0] * scale_s) < LINEAR_COORD_MAX &&
+         fabsf(s[width - 1] * scale_s) < LINEAR_COORD_MAX &&
+         fabsf(t[0] * scale_t) < LINEAR_COORD_MAX &&
+         fabsf(t[height - 1] * scale_t) < LINEAR_COORD_MAX)) {
+      return FALSE;
+   }
+
+   if (info->filter_linear) {
+      linear_axis_bilinear(&cols, s, width, samp.width, info->normalized,
+                           info->repeat_s, info->pot_width);
+      linear_axis_bilinear(&rows, t, height, samp.height, info->normalized,
+                           info->repeat_t, info->pot_height);
+   }
+   else {
+      linear_axis_nearest(&cols, s, width, samp.width, info->normalized,
+                          info->repeat_s, info->pot_width);
+      linear_axis_nearest(&rows, t, height, samp.height, info->normalized,
+                          info->repeat_t, info->pot_height);
+   }
+
+   /* the fragment function counts an invocation per 4x4 block */
+   task->thread_data.ps_invocations +=
+      DIV_ROUND_UP(width, 4) * DIV_ROUND_UP(height, 4);
+
+   dst = lp_rast_get_color_block_pointer(task, 0, x, y, inputs->layer);
+   dst_stride = scene->cbufs[0].stride;
+
+   for (j = 0; j < height; j++) {
+      uint32_t *row = (uint32_t *)(dst + j * dst_stride);
+      unsigned row_mask = mask == 0xffff ? 0xf : (mask >> (4 * j)) & 0xf;
+      const boolean direct = row_mask == 0xf &&
+                             info->blend == LP_LINEAR_BLEND_NONE &&
+                             !info->swap_rb && !info->tex_opaque;
+      uint32_t *out = direct ? row : texels;
+      const unsigned weight = rows.weight[j] & 0xff;
+
+      if (!row_mask) {
+         continue;
+      }
+
+      /* a zero weight picks the first texel exactly */
+      if (weight == 0 && cols.unweighted) {
+         linear_fetch_nearest(&samp, &cols, width, rows.i0[j], out);
+      }
+      else {
+         linear_fetch_bilinear(&samp, &cols, width, rows.i0[j],
+                               weight ? rows.i1[j] : rows.i0[j], weight, out);
+      }
+
+      if (!direct) {
+         linear_shade_span(info, texels, row, width, row_mask);
+      }
+   }
+
+   return TRUE;
+}
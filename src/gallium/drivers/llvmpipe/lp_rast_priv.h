@@ -91,6 +91,10 @@ struct lp_rasterizer_task
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   /** Depth bounds of the tile's hiz blocks, NULL if not tracked */
+   struct lp_hiz_block *hiz;
+   float hiz_zmin, hiz_zmax;  /**< bounds of the whole tile */
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
@@ -138,6 +142,13 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          unsigned x, unsigned y,
                          unsigned mask);
 
+boolean
+lp_rast_linear_shade(struct lp_rasterizer_task *task,
+                     const struct lp_rast_shader_inputs *inputs,
+                     unsigned x, unsigned y,
+                     unsigned width, unsigned height,
+                     unsigned mask);
+
 
 /**
  * Get the pointer to a 4x4 color block (within a 64x64 tile).
@@ -215,6 +226,200 @@ lp_rast_get_depth_block_pointer(struct lp_rasterizer_task *task,
 
 
 
+/**
+ * Get the depth bounds of a hiz block (within a 64x64 tile).
+ * \param bx, by  index of the block within the tile
+ */
+static inline struct lp_hiz_block *
+lp_rast_get_hiz_block(const struct lp_rasterizer_task *task,
+                      unsigned bx, unsigned by)
+{
+   assert(task->hiz);
+   assert(bx * LP_HIZ_BLOCK_SIZE < task->width);
+   assert(by * LP_HIZ_BLOCK_SIZE < task->height);
+
+   return task->hiz + by * task->scene->hiz.stride + bx;
+}
+
+
+/**
+ * Whether all the pixels of the depth buffer in a hiz block are within the
+ * current tile, that is the block isn't cut off by the framebuffer size.
+ */
+static inline boolean
+lp_rast_hiz_block_covered(const struct lp_rasterizer_task *task,
+                          unsigned bx, unsigned by)
+{
+   const struct lp_scene *scene = task->scene;
+
+   return ((bx + 1) * LP_HIZ_BLOCK_SIZE <= task->width ||
+           task->x + task->width == scene->hiz.width) &&
+          ((by + 1) * LP_HIZ_BLOCK_SIZE <= task->height ||
+           task->y + task->height == scene->hiz.height);
+}
+
+
+/**
+ * Whether all the fragments of a primitive are certain to fail the depth
+ * test against a depth buffer region with the given bounds.
+ */
+static inline boolean
+lp_rast_hiz_occluded(unsigned func,
+                     const struct lp_rast_shader_inputs *inputs,
+                     float zmin, float zmax)
+{
+   switch (func) {
+   case PIPE_FUNC_NEVER:
+      return TRUE;
+   case PIPE_FUNC_LESS:
+      return inputs->zmin >= zmax;
+   case PIPE_FUNC_LEQUAL:
+      return inputs->zmin > zmax;
+   case PIPE_FUNC_GREATER:
+      return inputs->zmax <= zmin;
+   case PIPE_FUNC_GEQUAL:
+      return inputs->zmax < zmin;
+   case PIPE_FUNC_EQUAL:
+      return inputs->zmin > zmax || inputs->zmax < zmin;
+   default:
+      return FALSE;
+   }
+}
+
+
+/**
+ * Hierarchical depth test of the whole current tile.
+ * \return TRUE if no fragment of the primitive can pass the depth test
+ */
+static inline boolean
+lp_rast_hiz_reject_tile(const struct lp_rasterizer_task *task,
+                        const struct lp_rast_shader_inputs *inputs)
+{
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+
+   if (!task->hiz || !variant->hiz_test)
+      return FALSE;
+
+   return lp_rast_hiz_occluded(variant->key.depth.func, inputs,
+                               task->hiz_zmin, task->hiz_zmax);
+}
+
+
+/**
+ * Hierarchical depth test of a square region of the current tile.
+ * \param x, y  location of the region in window coords
+ * \param size  size of the region, a multiple of 4 pixels
+ * \return TRUE if no fragment of the primitive can pass the depth test
+ */
+static inline boolean
+lp_rast_hiz_reject(const struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   unsigned x, unsigned y, unsigned size)
+{
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+   unsigned bx0, by0, bx1, by1, bx, by;
+
+   if (!task->hiz || !variant->hiz_test)
+      return FALSE;
+
+   /* Fragments beyond the framebuffer size are never shaded anyway. */
+   if (x % TILE_SIZE >= task->width || y % TILE_SIZE >= task->height)
+      return FALSE;
+
+   bx0 = (x % TILE_SIZE) / LP_HIZ_BLOCK_SIZE;
+   by0 = (y % TILE_SIZE) / LP_HIZ_BLOCK_SIZE;
+   bx1 = MIN2(x % TILE_SIZE + size, task->width) - 1;
+   by1 = MIN2(y % TILE_SIZE + size, task->height) - 1;
+   bx1 /= LP_HIZ_BLOCK_SIZE;
+   by1 /= LP_HIZ_BLOCK_SIZE;
+
+   for (by = by0; by <= by1; by++) {
+      for (bx = bx0; bx <= bx1; bx++) {
+         const struct lp_hiz_block *block = lp_rast_get_hiz_block(task, bx, by);
+         if (!lp_rast_hiz_occluded(variant->key.depth.func, inputs,
+                                   block->zmin, block->zmax))
+            return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Update the depth bounds of a hiz block after shading fragments of a
+ * primitive in it.
+ * \param x, y  location of a pixel of the block in window coords
+ * \param full  whether every pixel of the block was covered
+ */
+static inline void
+lp_rast_hiz_update(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   unsigned x, unsigned y, boolean full)
+{
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+   const unsigned bx = (x % TILE_SIZE) / LP_HIZ_BLOCK_SIZE;
+   const unsigned by = (y % TILE_SIZE) / LP_HIZ_BLOCK_SIZE;
+   struct lp_hiz_block *block;
+   float zmin, zmax;
+
+   if (!task->hiz || variant->hiz_update == LP_HIZ_UPDATE_NONE)
+      return;
+
+   if (x % TILE_SIZE >= task->width || y % TILE_SIZE >= task->height)
+      return;
+
+   block = lp_rast_get_hiz_block(task, bx, by);
+
+   if (variant->hiz_update == LP_HIZ_UPDATE_UNKNOWN) {
+      block->zmin = -INFINITY;
+      block->zmax = INFINITY;
+   }
+   else {
+      zmin = inputs->zmin;
+      zmax = inputs->zmax;
+      full = full && variant->hiz_full &&
+             lp_rast_hiz_block_covered(task, bx, by);
+
+      /*
+       * Fragments only get written when they pass the depth test, so the
+       * bounds can also shrink when the block is entirely overdrawn.
+       */
+      switch (variant->key.depth.func) {
+      case PIPE_FUNC_NEVER:
+      case PIPE_FUNC_EQUAL:
+         break;
+      case PIPE_FUNC_LESS:
+      case PIPE_FUNC_LEQUAL:
+         block->zmin = MIN2(block->zmin, zmin);
+         if (full)
+            block->zmax = MIN2(block->zmax, zmax);
+         break;
+      case PIPE_FUNC_GREATER:
+      case PIPE_FUNC_GEQUAL:
+         block->zmax = MAX2(block->zmax, zmax);
+         if (full)
+            block->zmin = MAX2(block->zmin, zmin);
+         break;
+      case PIPE_FUNC_ALWAYS:
+         if (full) {
+            block->zmin = zmin;
+            block->zmax = zmax;
+            break;
+         }
+         /* fall-through */
+      default:
+         block->zmin = MIN2(block->zmin, zmin);
+         block->zmax = MAX2(block->zmax, zmax);
+         break;
+      }
+   }
+
+   task->hiz_zmin = MIN2(task->hiz_zmin, block->zmin);
+   task->hiz_zmax = MAX2(task->hiz_zmax, block->zmax);
+}
+
+
 /**
  * Shade all pixels in a 4x4 block.  The fragment code omits the
  * triangle in/out tests.
@@ -257,6 +462,11 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
     * allocated 4x4 blocks hence need to filter them out here.
     */
    if ((x % TILE_SIZE) < task->width && (y % TILE_SIZE) < task->height) {
+      if (inputs->linear &&
+          lp_rast_linear_shade(task, inputs, x, y, 4, 4, 0xffff)) {
+         return;
+      }
+
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
@@ -275,6 +485,8 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
                                          stride,
                                          depth_stride);
       END_JIT_CALL();
+
+      lp_rast_hiz_update(task, inputs, x, y, FALSE);
    }
 }
 
@@ -58,9 +58,17 @@ block_full_16(struct lp_rasterizer_task *task,
    unsigned ix, iy;
    assert(x % 16 == 0);
    assert(y % 16 == 0);
+
+   if (tri->inputs.linear &&
+       lp_rast_linear_shade(task, &tri->inputs, x, y, 16, 16, 0xffff)) {
+      return;
+   }
+
    for (iy = 0; iy < 16; iy += 4)
       for (ix = 0; ix < 16; ix += 4)
 	 block_full_4(task, tri, x + ix, y + iy);
+
+   lp_rast_hiz_update(task, &tri->inputs, x, y, TRUE);
 }
 
 static inline unsigned
@@ -265,6 +273,9 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
    __m128i span_2;                /* 0,dcdx,2dcdx,3dcdx for plane 2 */
    __m128i unused;
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 16))
+      return;
+
    transpose4_epi32(&p0, &p1, &p2, &zero,
                     &c, &unused, &dcdx, &dcdy);
 
@@ -373,6 +384,9 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
    __m128i span_2;                /* 0,dcdx,2dcdx,3dcdx for plane 2 */
    __m128i unused;
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 4))
+      return;
+
    transpose4_epi32(&p0, &p1, &p2, &zero,
                     &c, &unused, &dcdx, &dcdy);
 
@@ -566,6 +580,9 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
    vshuf_mask2 = (__m128i) vec_splats((unsigned int) 0x04050607);
 #endif
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 16))
+      return;
+
    transpose4_epi32(&p0, &p1, &p2, &zero,
                     &c, &dcdx, &dcdy, &rej4);
 
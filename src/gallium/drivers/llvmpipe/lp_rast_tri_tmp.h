@@ -191,6 +191,10 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       return;
    }
 
+   if (lp_rast_hiz_reject_tile(task, &tri->inputs)) {
+      return;
+   }
+
    outmask = 0;                 /* outside one or more trivial reject planes */
    partmask = 0;                /* outside one or more trivial accept planes */
 
@@ -301,6 +305,9 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
       partial_mask &= ~(1 << i);
 
+      if (lp_rast_hiz_reject(task, &tri->inputs, px, py, 16))
+         continue;
+
       LP_COUNT(nr_partially_covered_16);
       TAG(do_block_16)(task, tri, plane, px, py, cx);
    }
@@ -316,6 +323,9 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
       inmask &= ~(1 << i);
 
+      if (lp_rast_hiz_reject(task, &tri->inputs, px, py, 16))
+         continue;
+
       LP_COUNT(nr_fully_covered_16);
       block_full_16(task, tri, px, py);
    }
@@ -345,6 +355,9 @@ TRI_16(struct lp_rasterizer_task *task,
    x += task->x;
    y += task->y;
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 16))
+      return;
+
    for (j = 0; j < NR_PLANES; j++) {
       const int dcdx = -plane[j].dcdx * 4;
       const int dcdy = plane[j].dcdy * 4;
@@ -410,6 +423,9 @@ TRI_4(struct lp_rasterizer_task *task,
    const int y = task->y + (mask >> 8);
    unsigned j;
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 4))
+      return;
+
    /* Iterate over partials:
     */
    {
@@ -197,6 +197,25 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
                                                zsbuf->u.tex.first_layer,
                                                LP_TEX_USAGE_READ_WRITE);
       scene->zsbuf.format_bytes = util_format_get_blocksize(zsbuf->format);
+
+      /*
+       * Depth bounds are only tracked for the first layer of the top level,
+       * when nothing else is being rendered to.
+       */
+      if (zsbuf->u.tex.level == 0 && zsbuf->u.tex.first_layer == 0) {
+         struct llvmpipe_resource *lpr = llvmpipe_resource(zsbuf->texture);
+
+         if (scene->fb_max_layer == 0 &&
+             zsbuf->format == zsbuf->texture->format) {
+            scene->hiz.blocks = lpr->hiz;
+            scene->hiz.stride = lpr->hiz_stride;
+            scene->hiz.width = lpr->base.width0;
+            scene->hiz.height = lpr->base.height0;
+         }
+         else {
+            llvmpipe_resource_hiz_invalidate(lpr);
+         }
+      }
    }
 }
 
@@ -231,6 +250,7 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                               zsbuf->u.tex.level,
                               zsbuf->u.tex.first_layer);
       scene->zsbuf.map = NULL;
+      scene->hiz.blocks = NULL;
    }
 
    /* Reset all command lists:
@@ -41,6 +41,7 @@
 
 struct lp_scene_queue;
 struct lp_rast_state;
+struct lp_hiz_block;
 
 /* We're limited to 2K by 2K for 32bit fixed point rasterization.
  * Will need a 64-bit version for larger framebuffers.
@@ -145,6 +146,15 @@ struct lp_scene {
       unsigned format_bytes;
    } zsbuf, cbufs[PIPE_MAX_COLOR_BUFS];
 
+   /* Hierarchical depth bounds of the zsbuf - valid only between
+    * begin_rasterization() and end_rasterization(), NULL if not tracked.
+    */
+   struct {
+      struct lp_hiz_block *blocks;
+      unsigned stride;         /**< blocks per row */
+      unsigned width, height;  /**< size of the depth buffer, in pixels */
+   } hiz;
+
    /* The amount of layers in the fb (minimum of all attachments) */
    unsigned fb_max_layer;
 
@@ -51,6 +51,9 @@ struct llvmpipe_screen
 
    unsigned num_threads;
 
+   /** Store sampler textures in micro-tiles (LP_TILED_TEXTURES) */
+   boolean tiled_textures;
+
    /* Increments whenever textures are modified.  Contexts can track this.
     */
    unsigned timestamp;
@@ -32,9 +32,11 @@
  * lp_setup_flush().
  */
 
+#include <float.h>
 #include <limits.h>
 
 #include "pipe/p_defines.h"
+#include "util/u_format.h"
 #include "util/u_framebuffer.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
@@ -389,6 +391,83 @@ lp_setup_bind_framebuffer( struct lp_setup_context *setup,
    setup->framebuffer.x1 = fb->width-1;
    setup->framebuffer.y1 = fb->height-1;
    setup->dirty |= LP_SETUP_NEW_SCISSOR;
+
+   setup->zs.unorm = FALSE;
+   setup->zs.ulp = 0.0f;
+   if (fb->zsbuf) {
+      const struct util_format_description *desc =
+         util_format_description(fb->zsbuf->format);
+      if (util_format_has_depth(desc)) {
+         const struct util_format_channel_description *chan =
+            &desc->channel[desc->swizzle[0]];
+         if (chan->type == UTIL_FORMAT_TYPE_UNSIGNED) {
+            /*
+             * The float to unorm conversion isn't exact beyond the float
+             * mantissa.
+             */
+            setup->zs.unorm = TRUE;
+            setup->zs.ulp = 1.0f / ((1 << MIN2(chan->size, 23)) - 1);
+         }
+      }
+   }
+}
+
+
+/**
+ * Compute the bounds of the depth values a primitive may write, for
+ * hierarchical depth.  The depth plane of the (already set up) position
+ * coefficients is evaluated at the n fixed point positions given, which
+ * must enclose all the primitive's fragments.
+ */
+void
+lp_setup_depth_range(const struct lp_setup_context *setup,
+                     struct lp_rast_shader_inputs *inputs,
+                     const int *x, const int *y, unsigned n)
+{
+   const struct lp_fragment_shader_variant *variant = setup->fs.current.variant;
+   const float z0 = GET_A0(inputs)[0][2];
+   const float dzdx = GET_DADX(inputs)[0][2];
+   const float dzdy = GET_DADY(inputs)[0][2];
+   float zmin = INFINITY, zmax = -INFINITY, mag = 0.0f;
+   unsigned i;
+
+   if (!variant->hiz_test && variant->hiz_update != LP_HIZ_UPDATE_RANGE)
+      return;
+
+   for (i = 0; i < n; i++) {
+      const float zx = dzdx * (x[i] * (1.0f / FIXED_ONE));
+      const float zy = dzdy * (y[i] * (1.0f / FIXED_ONE));
+      const float z = z0 + zx + zy;
+      zmin = MIN2(zmin, z);
+      zmax = MAX2(zmax, z);
+      mag = MAX2(mag, fabsf(z0) + fabsf(zx) + fabsf(zy));
+   }
+
+   /* Allow for the rounding of the fragment shader's interpolation. */
+   mag *= 8.0f * FLT_EPSILON;
+   zmin -= mag;
+   zmax += mag;
+
+   if (!(zmin <= zmax)) {
+      /* NaNs */
+      zmin = -INFINITY;
+      zmax = INFINITY;
+   }
+
+   if (variant->key.depth_clamp) {
+      const struct lp_jit_viewport *vp =
+         &setup->viewports[inputs->viewport_index];
+      zmin = CLAMP(zmin, vp->min_depth, vp->max_depth);
+      zmax = CLAMP(zmax, vp->min_depth, vp->max_depth);
+   }
+
+   if (setup->zs.unorm) {
+      zmin = CLAMP(zmin, 0.0f, 1.0f);
+      zmax = CLAMP(zmax, 0.0f, 1.0f);
+   }
+
+   inputs->zmin = zmin - setup->zs.ulp;
+   inputs->zmax = zmax + setup->zs.ulp;
 }
 
 
@@ -1380,21 +1459,35 @@ lp_setup_begin_query(struct lp_setup_context *setup,
 
    set_scene_state(setup, SETUP_ACTIVE, "begin_query");
 
-   if (!(pq->type == PIPE_QUERY_OCCLUSION_COUNTER ||
-         pq->type == PIPE_QUERY_OCCLUSION_PREDICATE ||
-         pq->type == PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE ||
-         pq->type == PIPE_QUERY_PIPELINE_STATISTICS))
-      return;
+   if (pq->type == PIPE_QUERY_TIME_ELAPSED) {
+      /*
+       * The start time is taken by the first bin rasterized after this
+       * point, there's nothing to accumulate at the end of each tile so
+       * the query isn't put on the active list.
+       */
+      if (setup->scene &&
+          !(setup->scene->tiles_x | setup->scene->tiles_y)) {
+         pq->start[0] = os_time_get_nano();
+         return;
+      }
+   }
+   else {
+      if (!(pq->type == PIPE_QUERY_OCCLUSION_COUNTER ||
+            pq->type == PIPE_QUERY_OCCLUSION_PREDICATE ||
+            pq->type == PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE ||
+            pq->type == PIPE_QUERY_PIPELINE_STATISTICS))
+         return;
 
-   /* init the query to its beginning state */
-   assert(setup->active_binned_queries < LP_MAX_ACTIVE_BINNED_QUERIES);
-   /* exceeding list size so just ignore the query */
-   if (setup->active_binned_queries >= LP_MAX_ACTIVE_BINNED_QUERIES) {
-      return;
+      /* init the query to its beginning state */
+      assert(setup->active_binned_queries < LP_MAX_ACTIVE_BINNED_QUERIES);
+      /* exceeding list size so just ignore the query */
+      if (setup->active_binned_queries >= LP_MAX_ACTIVE_BINNED_QUERIES) {
+         return;
+      }
+      assert(setup->active_queries[setup->active_binned_queries] == NULL);
+      setup->active_queries[setup->active_binned_queries] = pq;
+      setup->active_binned_queries++;
    }
-   assert(setup->active_queries[setup->active_binned_queries] == NULL);
-   setup->active_queries[setup->active_binned_queries] = pq;
-   setup->active_binned_queries++;
 
    assert(setup->scene);
    if (setup->scene) {
@@ -1435,8 +1528,10 @@ lp_setup_end_query(struct lp_setup_context *setup, struct llvmpipe_query *pq)
           pq->type == PIPE_QUERY_OCCLUSION_PREDICATE ||
           pq->type == PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE ||
           pq->type == PIPE_QUERY_PIPELINE_STATISTICS ||
-          pq->type == PIPE_QUERY_TIMESTAMP) {
-         if (pq->type == PIPE_QUERY_TIMESTAMP &&
+          pq->type == PIPE_QUERY_TIMESTAMP ||
+          pq->type == PIPE_QUERY_TIME_ELAPSED) {
+         if ((pq->type == PIPE_QUERY_TIMESTAMP ||
+              pq->type == PIPE_QUERY_TIME_ELAPSED) &&
                !(setup->scene->tiles_x | setup->scene->tiles_y)) {
             /*
              * If there's a zero width/height framebuffer, there's no bins and
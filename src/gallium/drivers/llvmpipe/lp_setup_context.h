@@ -116,6 +116,12 @@ struct lp_setup_context
    struct u_rect draw_regions[PIPE_MAX_VIEWPORTS];   /* intersection of fb & scissor */
    struct lp_jit_viewport viewports[PIPE_MAX_VIEWPORTS];
 
+   /** Depth buffer conversion, for the hierarchical depth bounds */
+   struct {
+      boolean unorm;       /**< values get clamped to [0, 1] */
+      float ulp;           /**< max rounding error of the conversion */
+   } zs;
+
    struct {
       unsigned flags;
       union util_color color_val[PIPE_MAX_COLOR_BUFS];
@@ -214,6 +220,11 @@ lp_setup_alloc_triangle(struct lp_scene *scene,
                         unsigned nr_planes,
                         unsigned *tri_size);
 
+void
+lp_setup_depth_range(const struct lp_setup_context *setup,
+                     struct lp_rast_shader_inputs *inputs,
+                     const int *x, const int *y, unsigned n);
+
 boolean
 lp_setup_bin_triangle(struct lp_setup_context *setup,
                       struct lp_rast_triangle *tri,
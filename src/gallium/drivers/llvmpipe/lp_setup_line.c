@@ -649,9 +649,12 @@ try_setup_line( struct lp_setup_context *setup,
 
    line->inputs.disable = FALSE;
    line->inputs.opaque = FALSE;
+   line->inputs.linear = FALSE;
    line->inputs.layer = layer;
    line->inputs.viewport_index = viewport_index;
 
+   lp_setup_depth_range(setup, &line->inputs, x, y, 4);
+
    /*
     * XXX: this code is mostly identical to the one in lp_setup_tri, except it
     * uses 4 planes instead of 3. Could share the code (including the sse
@@ -485,9 +485,16 @@ try_setup_point( struct lp_setup_context *setup,
 
    point->inputs.disable = FALSE;
    point->inputs.opaque = FALSE;
+   point->inputs.linear = FALSE;
    point->inputs.layer = layer;
    point->inputs.viewport_index = viewport_index;
 
+   /* Depth is constant across points, any position will do. */
+   {
+      const int zero = 0;
+      lp_setup_depth_range(setup, &point->inputs, &zero, &zero, 1);
+   }
+
    {
       struct lp_rast_plane *plane = GET_PLANES(point);
 
@@ -144,6 +144,31 @@ lp_setup_print_vertex(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Whether the triangle can be shaded with the linear span path.  The
+ * variant's inputs must not need perspective correction.
+ */
+static boolean
+lp_setup_linear_tri(const struct lp_setup_context *setup,
+                    const float (*v0)[4],
+                    const float (*v1)[4],
+                    const float (*v2)[4])
+{
+   const struct lp_fs_linear_info *info = &setup->fs.current.variant->linear;
+
+   if (!info->enabled) {
+      return FALSE;
+   }
+
+   if (info->perspective &&
+       (v0[0][3] != 1.0f || v1[0][3] != 1.0f || v2[0][3] != 1.0f)) {
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+
 /**
  * Print triangle vertex attribs (for debug).
  */
@@ -384,9 +409,12 @@ do_triangle_ccw(struct lp_setup_context *setup,
    tri->inputs.frontfacing = frontfacing;
    tri->inputs.disable = FALSE;
    tri->inputs.opaque = setup->fs.current.variant->opaque;
+   tri->inputs.linear = lp_setup_linear_tri(setup, v0, v1, v2);
    tri->inputs.layer = layer;
    tri->inputs.viewport_index = viewport_index;
 
+   lp_setup_depth_range(setup, &tri->inputs, position->x, position->y, 3);
+
    if (0)
       lp_dump_setup_coef(&setup->setup.variant->key,
                          (const float (*)[4])GET_A0(&tri->inputs),
@@ -189,6 +189,16 @@ void llvmpipe_update_derived( struct llvmpipe_context *llvmpipe )
    if (llvmpipe->tex_timestamp != lp_screen->timestamp) {
       llvmpipe->tex_timestamp = lp_screen->timestamp;
       llvmpipe->dirty |= LP_NEW_SAMPLER_VIEW;
+
+      /* Textures may have changed layout, which draw's shaders depend on */
+      if (lp_screen->tiled_textures) {
+         draw_set_sampler_views(llvmpipe->draw, PIPE_SHADER_VERTEX,
+                                llvmpipe->sampler_views[PIPE_SHADER_VERTEX],
+                                llvmpipe->num_sampler_views[PIPE_SHADER_VERTEX]);
+         draw_set_sampler_views(llvmpipe->draw, PIPE_SHADER_GEOMETRY,
+                                llvmpipe->sampler_views[PIPE_SHADER_GEOMETRY],
+                                llvmpipe->num_sampler_views[PIPE_SHADER_GEOMETRY]);
+      }
    }
 
    /* This needs LP_NEW_RASTERIZER because of draw_prepare_shader_outputs(). */
@@ -2803,6 +2803,7 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
    tgsi_dump(variant->shader->base.tokens, 0);
    dump_fs_variant_key(&variant->key);
    debug_printf("variant->opaque = %u\n", variant->opaque);
+   debug_printf("variant->linear.enabled = %u\n", variant->linear.enabled);
    debug_printf("\n");
 }
 
@@ -2862,6 +2863,35 @@ generate_variant(struct llvmpipe_context *lp,
          !shader->info.base.writes_samplemask
       ? TRUE : FALSE;
 
+   /*
+    * Determine how the variant interacts with the hierarchical depth bounds.
+    * Blocks can't be skipped when stencil ops would still have side effects
+    * on depth test failure, and the primitive's depth range is meaningless
+    * when the shader writes depth itself.
+    */
+   if (key->depth.enabled) {
+      boolean writes_z = shader->info.base.writes_z;
+
+      variant->hiz_test = !writes_z &&
+                          !key->stencil[0].enabled &&
+                          key->depth.func != PIPE_FUNC_ALWAYS &&
+                          key->depth.func != PIPE_FUNC_NOTEQUAL;
+
+      if (key->depth.writemask) {
+         variant->hiz_update = writes_z ? LP_HIZ_UPDATE_UNKNOWN
+                                        : LP_HIZ_UPDATE_RANGE;
+      }
+
+      variant->hiz_full = !writes_z &&
+                          !key->stencil[0].enabled &&
+                          !key->alpha.enabled &&
+                          !key->blend.alpha_to_coverage &&
+                          !shader->info.base.uses_kill &&
+                          !shader->info.base.writes_samplemask;
+   }
+
+   lp_fs_linear_analyse(shader, variant);
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       lp_debug_fs_variant(variant);
    }
@@ -47,6 +47,49 @@ struct lp_fragment_shader;
 #define RAST_EDGE_TEST 1
 
 
+/** How shading a primitive affects the hierarchical depth bounds */
+enum lp_hiz_update
+{
+   LP_HIZ_UPDATE_NONE = 0,   /**< depth buffer not written */
+   LP_HIZ_UPDATE_RANGE,      /**< written within the primitive's depth range */
+   LP_HIZ_UPDATE_UNKNOWN     /**< written with shader computed depth */
+};
+
+
+/** How the linear span path combines the shaded color with the buffer */
+enum lp_linear_blend
+{
+   LP_LINEAR_BLEND_NONE = 0,  /**< src */
+   LP_LINEAR_BLEND_OVER,      /**< src + dst * (1 - src.a) */
+   LP_LINEAR_BLEND_ALPHA      /**< src * src.a + dst * (1 - src.a) */
+};
+
+
+/**
+ * Description of a variant which can be shaded with the linear span path
+ * (see lp_rast_linear.c) instead of the jitted fragment function: a single
+ * 2D texture lookup of an 8-bit RGBA texture with nearest or bilinear
+ * filtering, written to a single 8-bit RGBA color buffer.
+ */
+struct lp_fs_linear_info
+{
+   unsigned enabled:1;
+   unsigned perspective:1;    /**< an input uses perspective interpolation */
+   unsigned normalized:1;     /**< texture coords are normalized */
+   unsigned filter_linear:1;  /**< bilinear rather than nearest filtering */
+   unsigned repeat_s:1;       /**< wrap with PIPE_TEX_WRAP_REPEAT */
+   unsigned repeat_t:1;
+   unsigned pot_width:1;      /**< the jitted code's power of two wrapping */
+   unsigned pot_height:1;
+   unsigned swap_rb:1;        /**< texture and color buffer R/B order differ */
+   unsigned cbuf_bgr:1;       /**< color buffer is in B8G8R8A8 order */
+   unsigned tex_opaque:1;     /**< texture alpha is always one */
+   unsigned blend:2;          /**< enum lp_linear_blend */
+   unsigned unit:8;           /**< texture unit and sampler */
+   unsigned tex_slot:8;       /**< coefficient slot of the texture coords */
+};
+
+
 struct lp_sampler_static_state
 {
    /*
@@ -99,6 +142,15 @@ struct lp_fragment_shader_variant
 
    boolean opaque;
 
+   /*
+    * Hierarchical depth, see lp_rast_hiz_reject() and lp_rast_hiz_update().
+    */
+   unsigned hiz_test:1;    /**< blocks may be rejected with key.depth.func */
+   unsigned hiz_update:2;  /**< enum lp_hiz_update */
+   unsigned hiz_full:1;    /**< every fragment passing the depth test writes */
+
+   struct lp_fs_linear_info linear;
+
    struct gallivm_state *gallivm;
 
    LLVMTypeRef jit_context_ptr_type;
@@ -145,6 +197,10 @@ struct lp_fragment_shader
 void
 lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant);
 
+void
+lp_fs_linear_analyse(const struct lp_fragment_shader *shader,
+                     struct lp_fragment_shader_variant *variant);
+
 void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant);
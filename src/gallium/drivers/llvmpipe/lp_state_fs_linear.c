@@ -0,0 +1,340 @@
+/**************************************************************************
+ *
+ * Copyright 2010 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Recognize fragment shader variants which can be shaded with the linear
+ * span path in lp_rast_linear.c.
+ *
+ * These are the shaders used by 2D compositors and for blits: a single
+ * nearest or bilinear filtered TEX of a 2D texture, with no depth/stencil
+ * and at most a simple alpha blend.
+ */
+
+#include <float.h>
+
+#include "pipe/p_defines.h"
+#include "pipe/p_shader_tokens.h"
+#include "util/u_format.h"
+#include "util/u_memory.h"
+#include "tgsi/tgsi_parse.h"
+
+#include "lp_debug.h"
+#include "lp_jit.h"
+#include "lp_state_fs.h"
+
+
+/**
+ * Whether the format is one of the 8-bit RGBA formats handled by the
+ * linear path, and whether its red and blue channels are swapped.
+ */
+static boolean
+linear_format(enum pipe_format format, boolean *bgr)
+{
+   switch (format) {
+   case PIPE_FORMAT_B8G8R8A8_UNORM:
+   case PIPE_FORMAT_B8G8R8X8_UNORM:
+      *bgr = TRUE;
+      return TRUE;
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+   case PIPE_FORMAT_R8G8B8X8_UNORM:
+      *bgr = FALSE;
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+
+static boolean
+linear_src_is_temp(const struct tgsi_full_src_register *src,
+                   unsigned index)
+{
+   return src->Register.File == TGSI_FILE_TEMPORARY &&
+          src->Register.Index == index &&
+          !src->Register.Indirect &&
+          !src->Register.Dimension &&
+          !src->Register.Negate &&
+          !src->Register.Absolute &&
+          src->Register.SwizzleX == TGSI_SWIZZLE_X &&
+          src->Register.SwizzleY == TGSI_SWIZZLE_Y &&
+          src->Register.SwizzleZ == TGSI_SWIZZLE_Z &&
+          src->Register.SwizzleW == TGSI_SWIZZLE_W;
+}
+
+
+static boolean
+linear_dst_is_color(const struct tgsi_full_dst_register *dst)
+{
+   return dst->Register.File == TGSI_FILE_OUTPUT &&
+          dst->Register.Index == 0 &&
+          !dst->Register.Indirect &&
+          dst->Register.WriteMask == TGSI_WRITEMASK_XYZW;
+}
+
+
+/**
+ * Match the shader instructions.
+ * Returns the TEX instruction's texture coordinate and sampler indices.
+ */
+static boolean
+linear_match_tokens(const struct tgsi_token *tokens,
+                    unsigned *tex_input,
+                    unsigned *unit,
+                    unsigned *tgsi_target)
+{
+   struct tgsi_parse_context parse;
+   unsigned step = 0;   /* 0: expect TEX, 1: expect MOV, 2: expect END */
+   unsigned temp = 0;
+   boolean ok = TRUE;
+
+   tgsi_parse_init(&parse, tokens);
+
+   while (ok && !tgsi_parse_end_of_tokens(&parse)) {
+      const struct tgsi_full_instruction *inst;
+
+      tgsi_parse_token(&parse);
+
+      if (parse.FullToken.Token.Type != TGSI_TOKEN_TYPE_INSTRUCTION) {
+         continue;
+      }
+
+      inst = &parse.FullToken.FullInstruction;
+
+      switch (step) {
+      case 0:
+         if (inst->Instruction.Opcode != TGSI_OPCODE_TEX ||
+             inst->Texture.NumOffsets ||
+             inst->Dst[0].Register.Indirect ||
+             inst->Dst[0].Register.WriteMask != TGSI_WRITEMASK_XYZW ||
+             inst->Src[0].Register.File != TGSI_FILE_INPUT ||
+             inst->Src[0].Register.Indirect ||
+             inst->Src[0].Register.Negate ||
+             inst->Src[0].Register.Absolute ||
+             inst->Src[0].Register.SwizzleX != TGSI_SWIZZLE_X ||
+             inst->Src[0].Register.SwizzleY != TGSI_SWIZZLE_Y ||
+             inst->Src[1].Register.File != TGSI_FILE_SAMPLER ||
+             inst->Src[1].Register.Indirect) {
+            ok = FALSE;
+            break;
+         }
+
+         *tex_input = inst->Src[0].Register.Index;
+         *unit = inst->Src[1].Register.Index;
+         *tgsi_target = inst->Texture.Texture;
+
+         if (linear_dst_is_color(&inst->Dst[0])) {
+            step = 2;
+         }
+         else if (inst->Dst[0].Register.File == TGSI_FILE_TEMPORARY) {
+            temp = inst->Dst[0].Register.Index;
+            step = 1;
+         }
+         else {
+            ok = FALSE;
+         }
+         break;
+
+      case 1:
+         ok = inst->Instruction.Opcode == TGSI_OPCODE_MOV &&
+              linear_dst_is_color(&inst->Dst[0]) &&
+              linear_src_is_temp(&inst->Src[0], temp);
+         step = 2;
+         break;
+
+      default:
+         ok = inst->Instruction.Opcode == TGSI_OPCODE_END;
+         step = 3;
+         break;
+      }
+   }
+
+   tgsi_parse_free(&parse);
+
+   return ok && step == 3;
+}
+
+
+/**
+ * Determine whether the variant can be shaded with the linear span path,
+ * and fill in variant->linear accordingly.
+ */
+void
+lp_fs_linear_analyse(const struct lp_fragment_shader *shader,
+                     struct lp_fragment_shader_variant *variant)
+{
+   const struct lp_fragment_shader_variant_key *key = &variant->key;
+   const struct tgsi_shader_info *info = &shader->info.base;
+   const struct pipe_rt_blend_state *rt = &key->blend.rt[0];
+   struct lp_fs_linear_info *linear = &variant->linear;
+   const struct lp_static_texture_state *texture;
+   const struct lp_static_sampler_state *sampler;
+   const struct util_format_description *tex_desc;
+   const struct lp_shader_input *input;
+   unsigned tex_input, unit, tgsi_target;
+   boolean tex_bgr, cbuf_bgr;
+
+   memset(linear, 0, sizeof *linear);
+
+#if !defined(PIPE_ARCH_SSE) || FLT_EVAL_METHOD != 0
+   /* The span code repeats the texture coordinate arithmetic of the jitted
+    * code for x86, in single precision.
+    */
+   return;
+#endif
+
+   if (LP_PERF & PERF_NO_SPANS)
+      return;
+
+   /* Fixed function state */
+   if (key->nr_cbufs != 1 ||
+       key->resource_1d ||
+       key->depth.enabled ||
+       key->stencil[0].enabled ||
+       key->alpha.enabled ||
+       key->occlusion_count ||
+       key->blend.logicop_enable ||
+       key->blend.alpha_to_coverage ||
+       key->blend.alpha_to_one ||
+       rt->colormask != PIPE_MASK_RGBA ||
+       !linear_format(key->cbuf_format[0], &cbuf_bgr)) {
+      return;
+   }
+
+   if (!rt->blend_enable) {
+      linear->blend = LP_LINEAR_BLEND_NONE;
+   }
+   else {
+      if (rt->rgb_func != PIPE_BLEND_ADD ||
+          rt->alpha_func != PIPE_BLEND_ADD ||
+          rt->rgb_src_factor != rt->alpha_src_factor ||
+          rt->rgb_dst_factor != rt->alpha_dst_factor ||
+          rt->rgb_dst_factor != PIPE_BLENDFACTOR_INV_SRC_ALPHA) {
+         return;
+      }
+      if (rt->rgb_src_factor == PIPE_BLENDFACTOR_ONE)
+         linear->blend = LP_LINEAR_BLEND_OVER;
+      else if (rt->rgb_src_factor == PIPE_BLENDFACTOR_SRC_ALPHA)
+         linear->blend = LP_LINEAR_BLEND_ALPHA;
+      else
+         return;
+   }
+
+   /* Shader */
+   if (info->num_outputs != 1 ||
+       info->output_semantic_name[0] != TGSI_SEMANTIC_COLOR ||
+       info->output_semantic_index[0] != 0 ||
+       info->uses_kill ||
+       info->writes_z ||
+       info->writes_stencil ||
+       info->writes_samplemask ||
+       !linear_match_tokens(shader->base.tokens, &tex_input, &unit,
+                            &tgsi_target)) {
+      return;
+   }
+
+   if (tex_input >= info->num_inputs ||
+       unit >= key->nr_samplers ||
+       unit >= key->nr_sampler_views) {
+      return;
+   }
+
+   input = &shader->inputs[tex_input];
+   if ((input->interp != LP_INTERP_LINEAR &&
+        input->interp != LP_INTERP_PERSPECTIVE) ||
+       input->cyl_wrap) {
+      return;
+   }
+   linear->perspective = input->interp == LP_INTERP_PERSPECTIVE;
+   linear->tex_slot = input->src_index;
+
+   /* Texture and sampler */
+   texture = &key->state[unit].texture_state;
+   sampler = &key->state[unit].sampler_state;
+
+   if (!linear_format(texture->format, &tex_bgr) ||
+       texture->swizzle_r != PIPE_SWIZZLE_X ||
+       texture->swizzle_g != PIPE_SWIZZLE_Y ||
+       texture->swizzle_b != PIPE_SWIZZLE_Z ||
+       (texture->swizzle_a != PIPE_SWIZZLE_W &&
+        texture->swizzle_a != PIPE_SWIZZLE_1)) {
+      return;
+   }
+
+   /* The spans read texels linearly */
+   if (texture->tiled)
+      return;
+
+   if (tgsi_target == TGSI_TEXTURE_2D) {
+      if (texture->target != PIPE_TEXTURE_2D || !sampler->normalized_coords)
+         return;
+   }
+   else if (tgsi_target == TGSI_TEXTURE_RECT) {
+      if (texture->target != PIPE_TEXTURE_RECT || sampler->normalized_coords)
+         return;
+   }
+   else {
+      return;
+   }
+
+   /* No level of detail, so no choice between minification and
+    * magnification
+    */
+   if (sampler->min_img_filter != sampler->mag_img_filter ||
+       sampler->min_mip_filter != PIPE_TEX_MIPFILTER_NONE ||
+       sampler->compare_mode != PIPE_TEX_COMPARE_NONE ||
+       sampler->force_nearest_s ||
+       sampler->force_nearest_t ||
+       (sampler->wrap_s != PIPE_TEX_WRAP_CLAMP_TO_EDGE &&
+        sampler->wrap_s != PIPE_TEX_WRAP_REPEAT) ||
+       (sampler->wrap_t != PIPE_TEX_WRAP_CLAMP_TO_EDGE &&
+        sampler->wrap_t != PIPE_TEX_WRAP_REPEAT)) {
+      return;
+   }
+
+   /* Unnormalized coords only allow clamping */
+   if (!sampler->normalized_coords &&
+       (sampler->wrap_s != PIPE_TEX_WRAP_CLAMP_TO_EDGE ||
+        sampler->wrap_t != PIPE_TEX_WRAP_CLAMP_TO_EDGE)) {
+      return;
+   }
+
+   tex_desc = util_format_description(texture->format);
+
+   linear->normalized = sampler->normalized_coords;
+   linear->filter_linear = sampler->min_img_filter == PIPE_TEX_FILTER_LINEAR;
+   linear->repeat_s = sampler->wrap_s == PIPE_TEX_WRAP_REPEAT;
+   linear->repeat_t = sampler->wrap_t == PIPE_TEX_WRAP_REPEAT;
+   linear->pot_width = texture->pot_width;
+   linear->pot_height = texture->pot_height;
+   linear->swap_rb = tex_bgr != cbuf_bgr;
+   linear->cbuf_bgr = cbuf_bgr;
+   linear->tex_opaque = texture->swizzle_a == PIPE_SWIZZLE_1 ||
+                        tex_desc->swizzle[3] == PIPE_SWIZZLE_1;
+   linear->unit = unit;
+   linear->enabled = TRUE;
+}
@@ -0,0 +1,658 @@
+/**************************************************************************
+ *
+ * Copyright 2010 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests for the linear span path.
+ *
+ * Draws textured quads with and without the span path (see
+ * lp_rast_linear.c), and checks that the results are the same bit for bit.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "util/u_box.h"
+#include "util/u_draw_quad.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_sampler.h"
+#include "util/u_simple_shaders.h"
+#include "util/u_string.h"
+#include "tgsi/tgsi_text.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_public.h"
+#include "lp_state_fs.h"
+#include "lp_test.h"
+
+
+/* Not a multiple of the tile size, nor of four, so that tiles get clipped */
+#define WIDTH 98
+#define HEIGHT 90
+
+#define NUM_QUADS 10
+
+
+struct linear_texture
+{
+   enum pipe_texture_target target;
+   enum pipe_format format;
+   unsigned width;
+   unsigned height;
+};
+
+
+static const struct linear_texture textures[] = {
+   { PIPE_TEXTURE_2D, PIPE_FORMAT_R8G8B8A8_UNORM, 64, 64 },
+   { PIPE_TEXTURE_2D, PIPE_FORMAT_R8G8B8A8_UNORM, 45, 27 },
+   { PIPE_TEXTURE_2D, PIPE_FORMAT_B8G8R8X8_UNORM, 32, 16 },
+   { PIPE_TEXTURE_RECT, PIPE_FORMAT_R8G8B8A8_UNORM, 45, 27 },
+};
+
+
+static const enum pipe_format cbuf_formats[] = {
+   PIPE_FORMAT_B8G8R8A8_UNORM,
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+};
+
+
+static const unsigned filters[] = {
+   PIPE_TEX_FILTER_NEAREST,
+   PIPE_TEX_FILTER_LINEAR,
+};
+
+
+static const unsigned wraps[] = {
+   PIPE_TEX_WRAP_CLAMP_TO_EDGE,
+   PIPE_TEX_WRAP_REPEAT,
+};
+
+
+/**
+ * Quads, as window coordinates and texel coordinates of their corners.
+ */
+static const struct {
+   float x0, y0, x1, y1;
+   float s0, t0, s1, t1;
+   boolean rotate;   /**< s varies along y, and t along x */
+} quads[NUM_QUADS] = {
+   /* 1:1, texel centers on pixel centers */
+   { 3, 5, 93, 85, 0, 0, 90, 80, FALSE },
+   /* 1:1 with subpixel offsets */
+   { 10.3f, 2.6f, 60.3f, 52.6f, 0.3f, 0.7f, 50.3f, 50.7f, FALSE },
+   /* magnified */
+   { 20, 8, 97, 77, 2.2f, 1.1f, 33.0f, 24.1f, FALSE },
+   /* minified */
+   { 0, 30, 50, 88, 0.4f, 0.0f, 83.7f, 58.6f, FALSE },
+   /* mirrored */
+   { 40, 10, 90, 60, 50.5f, 40.2f, 10.5f, 0.2f, FALSE },
+   /* beyond the edges */
+   { 1, 1, 97, 89, -70.3f, -30.6f, 90.1f, 61.4f, FALSE },
+   /* rotated, which the span path leaves to the jitted code */
+   { 8, 12, 70, 50, 0, 0, 38, 62, TRUE },
+   /* less than a 4x4 block */
+   { 61, 41, 67, 46, 5.5f, 3.5f, 11.5f, 8.5f, FALSE },
+   /* fractional edges */
+   { 31.7f, 45.2f, 77.4f, 88.9f, 1.0f, 2.0f, 30.5f, 25.25f, FALSE },
+   /* the whole window */
+   { 0, 0, WIDTH, HEIGHT, 0, 0, 63, 54, FALSE },
+};
+
+
+struct linear_test
+{
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   void *vs;
+   void *fs[2][2][2];   /**< [rect][perspective][spans] */
+   void *velems;
+   void *rasterizer;
+   void *dsa;
+   struct pipe_resource *vbuf;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "texture\t"
+           "cbuf_format\t"
+           "filter\t"
+           "wrap\t"
+           "blend\n");
+
+   fflush(fp);
+}
+
+
+static void *
+create_fs(struct pipe_context *pipe, boolean rect, boolean perspective)
+{
+   struct tgsi_token tokens[1000];
+   struct pipe_shader_state state;
+   char text[512];
+
+   util_snprintf(text, sizeof text,
+                 "FRAG\n"
+                 "DCL IN[0], GENERIC[0], %s\n"
+                 "DCL OUT[0], COLOR\n"
+                 "DCL SAMP[0]\n"
+                 "DCL SVIEW[0], %s, FLOAT\n"
+                 "TEX OUT[0], IN[0], SAMP[0], %s\n"
+                 "END\n",
+                 perspective ? "PERSPECTIVE" : "LINEAR",
+                 rect ? "RECT" : "2D",
+                 rect ? "RECT" : "2D");
+
+   if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens))) {
+      return NULL;
+   }
+
+   pipe_shader_state_from_tgsi(&state, tokens);
+   return pipe->create_fs_state(pipe, &state);
+}
+
+
+static boolean
+init_test(struct linear_test *test)
+{
+   static const enum tgsi_semantic names[] = {
+      TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_GENERIC
+   };
+   static const unsigned indices[] = { 0, 0 };
+   struct pipe_vertex_element velems[2];
+   struct pipe_rasterizer_state rasterizer;
+   struct pipe_depth_stencil_alpha_state dsa;
+   unsigned rect, perspective, spans;
+
+   memset(test, 0, sizeof *test);
+
+   test->screen = llvmpipe_create_screen(null_sw_create());
+   if (!test->screen) {
+      return FALSE;
+   }
+   test->pipe = test->screen->context_create(test->screen, NULL, 0);
+   if (!test->pipe) {
+      return FALSE;
+   }
+
+   test->vs = util_make_vertex_passthrough_shader(test->pipe, 2, names,
+                                                  indices, FALSE);
+
+   for (rect = 0; rect < 2; rect++) {
+      for (perspective = 0; perspective < 2; perspective++) {
+         for (spans = 0; spans < 2; spans++) {
+            test->fs[rect][perspective][spans] =
+               create_fs(test->pipe, rect, perspective);
+            if (!test->fs[rect][perspective][spans]) {
+               return FALSE;
+            }
+         }
+      }
+   }
+
+   memset(velems, 0, sizeof velems);
+   velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velems[1].src_offset = 4 * sizeof(float);
+   velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   test->velems = test->pipe->create_vertex_elements_state(test->pipe, 2,
+                                                           velems);
+
+   memset(&rasterizer, 0, sizeof rasterizer);
+   rasterizer.cull_face = PIPE_FACE_NONE;
+   rasterizer.half_pixel_center = 1;
+   rasterizer.bottom_edge_rule = 1;
+   rasterizer.depth_clip_near = 1;
+   rasterizer.depth_clip_far = 1;
+   test->rasterizer = test->pipe->create_rasterizer_state(test->pipe,
+                                                          &rasterizer);
+
+   memset(&dsa, 0, sizeof dsa);
+   test->dsa = test->pipe->create_depth_stencil_alpha_state(test->pipe, &dsa);
+
+   test->pipe->bind_vs_state(test->pipe, test->vs);
+   test->pipe->bind_vertex_elements_state(test->pipe, test->velems);
+   test->pipe->bind_rasterizer_state(test->pipe, test->rasterizer);
+   test->pipe->bind_depth_stencil_alpha_state(test->pipe, test->dsa);
+
+   return TRUE;
+}
+
+
+static void
+fini_test(struct linear_test *test)
+{
+   struct pipe_context *pipe = test->pipe;
+   unsigned rect, perspective, spans;
+
+   if (pipe) {
+      pipe->bind_vs_state(pipe, NULL);
+      pipe->bind_fs_state(pipe, NULL);
+      pipe->bind_vertex_elements_state(pipe, NULL);
+      pipe->bind_rasterizer_state(pipe, NULL);
+      pipe->bind_depth_stencil_alpha_state(pipe, NULL);
+
+      pipe_resource_reference(&test->vbuf, NULL);
+      for (rect = 0; rect < 2; rect++) {
+         for (perspective = 0; perspective < 2; perspective++) {
+            for (spans = 0; spans < 2; spans++) {
+               if (test->fs[rect][perspective][spans]) {
+                  pipe->delete_fs_state(pipe,
+                                        test->fs[rect][perspective][spans]);
+               }
+            }
+         }
+      }
+      if (test->vs)
+         pipe->delete_vs_state(pipe, test->vs);
+      if (test->velems)
+         pipe->delete_vertex_elements_state(pipe, test->velems);
+      if (test->rasterizer)
+         pipe->delete_rasterizer_state(pipe, test->rasterizer);
+      if (test->dsa)
+         pipe->delete_depth_stencil_alpha_state(pipe, test->dsa);
+      pipe->destroy(pipe);
+   }
+
+   if (test->screen)
+      test->screen->destroy(test->screen);
+}
+
+
+static struct pipe_resource *
+create_texture(struct linear_test *test, const struct linear_texture *tex)
+{
+   struct pipe_resource templ;
+   struct pipe_resource *res;
+   struct pipe_box box;
+   uint8_t *data;
+   unsigned i;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = tex->target;
+   templ.format = tex->format;
+   templ.width0 = tex->width;
+   templ.height0 = tex->height;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_SAMPLER_VIEW;
+
+   res = test->screen->resource_create(test->screen, &templ);
+   if (!res) {
+      return NULL;
+   }
+
+   /* Arbitrary texels, with alpha anywhere between zero and one */
+   data = MALLOC(tex->width * tex->height * 4);
+   for (i = 0; i < tex->width * tex->height * 4; i++) {
+      data[i] = (i * 2654435761u) >> 24;
+   }
+
+   u_box_2d(0, 0, tex->width, tex->height, &box);
+   test->pipe->texture_subdata(test->pipe, res, 0, 0, &box, data,
+                               tex->width * 4, 0);
+   FREE(data);
+
+   return res;
+}
+
+
+/**
+ * Write the vertices of all quads.  The positions are in clip space,
+ * and the texture coordinates normalized unless drawing from a RECT.
+ */
+static void
+write_quads(struct linear_test *test, const struct linear_texture *tex)
+{
+   const float su = tex->target == PIPE_TEXTURE_RECT ? 1.0f : 1.0f / tex->width;
+   const float tu = tex->target == PIPE_TEXTURE_RECT ? 1.0f : 1.0f / tex->height;
+   float vertices[NUM_QUADS][6][8];
+   unsigned i, k;
+
+   for (i = 0; i < NUM_QUADS; i++) {
+      static const unsigned corners[6][2] = {
+         { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 }, { 0, 1 }
+      };
+
+      for (k = 0; k < 6; k++) {
+         const unsigned cx = corners[k][0], cy = corners[k][1];
+         const float x = cx ? quads[i].x1 : quads[i].x0;
+         const float y = cy ? quads[i].y1 : quads[i].y0;
+         float *v = vertices[i][k];
+
+         v[0] = x * 2.0f / WIDTH - 1.0f;
+         v[1] = y * 2.0f / HEIGHT - 1.0f;
+         v[2] = 0.5f;
+         v[3] = 1.0f;
+         if (quads[i].rotate) {
+            v[4] = (cy ? quads[i].s1 : quads[i].s0) * su;
+            v[5] = (cx ? quads[i].t1 : quads[i].t0) * tu;
+         }
+         else {
+            v[4] = (cx ? quads[i].s1 : quads[i].s0) * su;
+            v[5] = (cy ? quads[i].t1 : quads[i].t0) * tu;
+         }
+         v[6] = 0.0f;
+         v[7] = 1.0f;
+      }
+   }
+
+   pipe_resource_reference(&test->vbuf, NULL);
+   test->vbuf = pipe_buffer_create(test->screen, PIPE_BIND_VERTEX_BUFFER,
+                                   PIPE_USAGE_DEFAULT, sizeof vertices);
+   pipe_buffer_write(test->pipe, test->vbuf, 0, sizeof vertices, vertices);
+}
+
+
+/**
+ * Whether the last variant used takes the linear span path.
+ */
+static boolean
+linear_enabled(struct pipe_context *pipe)
+{
+   const struct llvmpipe_context *lp = llvmpipe_context(pipe);
+   const struct lp_fs_variant_list_item *item = lp->fs_variants_list.next;
+
+   if (item == &lp->fs_variants_list) {
+      return FALSE;
+   }
+   return item->base->linear.enabled;
+}
+
+
+/**
+ * Draw all quads into a new color buffer, and read it back.
+ */
+static boolean
+draw(struct linear_test *test, void *fs, boolean spans,
+     enum pipe_format cbuf_format, uint8_t *pixels)
+{
+   struct pipe_context *pipe = test->pipe;
+   const union pipe_color_union clear_color = {
+      .f = { 0.2f, 0.4f, 0.6f, 0.8f }
+   };
+   struct pipe_resource templ, *cbuf;
+   struct pipe_surface surf_templ, *surf;
+   struct pipe_framebuffer_state fb;
+   struct pipe_viewport_state viewport;
+   struct pipe_transfer *transfer;
+   const uint8_t *map;
+   unsigned i, j;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = cbuf_format;
+   templ.width0 = WIDTH;
+   templ.height0 = HEIGHT;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   cbuf = test->screen->resource_create(test->screen, &templ);
+   if (!cbuf) {
+      return FALSE;
+   }
+
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = cbuf_format;
+   surf = pipe->create_surface(pipe, cbuf, &surf_templ);
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = WIDTH;
+   fb.height = HEIGHT;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = surf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   viewport.scale[0] = WIDTH / 2.0f;
+   viewport.scale[1] = HEIGHT / 2.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.translate[0] = WIDTH / 2.0f;
+   viewport.translate[1] = HEIGHT / 2.0f;
+   viewport.translate[2] = 0.5f;
+   pipe->set_viewport_states(pipe, 0, 1, &viewport);
+
+   pipe->clear(pipe, PIPE_CLEAR_COLOR, &clear_color, 0.0, 0);
+
+   /* The span path is chosen when creating variants */
+   if (!spans) {
+      LP_PERF |= PERF_NO_SPANS;
+   }
+
+   pipe->bind_fs_state(pipe, fs);
+   for (i = 0; i < NUM_QUADS; i++) {
+      util_draw_vertex_buffer(pipe, NULL, test->vbuf, 0,
+                              i * 6 * 8 * sizeof(float),
+                              PIPE_PRIM_TRIANGLES, 6, 2);
+   }
+
+   LP_PERF &= ~PERF_NO_SPANS;
+
+   map = pipe_transfer_map(pipe, cbuf, 0, 0, PIPE_TRANSFER_READ,
+                           0, 0, WIDTH, HEIGHT, &transfer);
+   for (j = 0; j < HEIGHT; j++) {
+      memcpy(pixels + j * WIDTH * 4, map + j * transfer->stride, WIDTH * 4);
+   }
+   pipe->transfer_unmap(pipe, transfer);
+
+   memset(&fb, 0, sizeof fb);
+   pipe->set_framebuffer_state(pipe, &fb);
+   pipe_surface_reference(&surf, NULL);
+   pipe_resource_reference(&cbuf, NULL);
+
+   return TRUE;
+}
+
+
+static boolean
+test_linear(struct linear_test *test, unsigned verbose, FILE *fp,
+            const struct linear_texture *tex, struct pipe_sampler_view *view,
+            enum pipe_format cbuf_format, unsigned filter, unsigned wrap,
+            unsigned blend_factor, boolean perspective)
+{
+   struct pipe_context *pipe = test->pipe;
+   const boolean rect = tex->target == PIPE_TEXTURE_RECT;
+   struct pipe_sampler_state sampler;
+   struct pipe_blend_state blend;
+   void *sampler_cso, *blend_cso;
+   uint8_t ref[HEIGHT][WIDTH][4], res[HEIGHT][WIDTH][4];
+   boolean success = TRUE;
+   boolean enabled;
+   unsigned i, j;
+
+   memset(&sampler, 0, sizeof sampler);
+   sampler.wrap_s = wrap;
+   sampler.wrap_t = wrap;
+   sampler.wrap_r = wrap;
+   sampler.min_img_filter = filter;
+   sampler.mag_img_filter = filter;
+   sampler.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+   sampler.normalized_coords = !rect;
+   sampler_cso = pipe->create_sampler_state(pipe, &sampler);
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   if (blend_factor != PIPE_BLENDFACTOR_ZERO) {
+      blend.rt[0].blend_enable = 1;
+      blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+      blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+      blend.rt[0].rgb_src_factor = blend_factor;
+      blend.rt[0].alpha_src_factor = blend_factor;
+      blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+      blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+   }
+   blend_cso = pipe->create_blend_state(pipe, &blend);
+
+   pipe->bind_sampler_states(pipe, PIPE_SHADER_FRAGMENT, 0, 1, &sampler_cso);
+   pipe->set_sampler_views(pipe, PIPE_SHADER_FRAGMENT, 0, 1, &view);
+   pipe->bind_blend_state(pipe, blend_cso);
+
+   if (!draw(test, test->fs[rect][perspective][0], FALSE, cbuf_format,
+             &ref[0][0][0]) ||
+       !draw(test, test->fs[rect][perspective][1], TRUE, cbuf_format,
+             &res[0][0][0])) {
+      success = FALSE;
+   }
+
+   /* Otherwise this would only compare the jitted code with itself */
+   enabled = linear_enabled(pipe);
+   if (!enabled) {
+      success = FALSE;
+   }
+
+   for (j = 0; success && j < HEIGHT; j++) {
+      for (i = 0; i < WIDTH; i++) {
+         if (memcmp(ref[j][i], res[j][i], 4) != 0) {
+            fprintf(stderr, "  pixel %u, %u: %02x%02x%02x%02x, "
+                    "expected %02x%02x%02x%02x\n", i, j,
+                    res[j][i][0], res[j][i][1], res[j][i][2], res[j][i][3],
+                    ref[j][i][0], ref[j][i][1], ref[j][i][2], ref[j][i][3]);
+            success = FALSE;
+            break;
+         }
+      }
+   }
+
+   if (verbose >= 1 || !success) {
+      fprintf(stderr,
+              "%s: texture=%s %ux%u%s cbuf=%s filter=%s wrap=%s blend=%s%s\n",
+              success ? "PASS" : "FAIL",
+              util_format_name(tex->format), tex->width, tex->height,
+              rect ? " RECT" : "",
+              util_format_name(cbuf_format),
+              filter == PIPE_TEX_FILTER_LINEAR ? "linear" : "nearest",
+              wrap == PIPE_TEX_WRAP_REPEAT ? "repeat" : "clamp_to_edge",
+              blend_factor == PIPE_BLENDFACTOR_ZERO ? "none" :
+              blend_factor == PIPE_BLENDFACTOR_ONE ? "over" : "alpha",
+              enabled ? "" : " (no span path)");
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%s %ux%u\t%s\t%u\t%u\t%u\n",
+              success ? "pass" : "fail",
+              util_format_name(tex->format), tex->width, tex->height,
+              util_format_name(cbuf_format), filter, wrap, blend_factor);
+      fflush(fp);
+   }
+
+   pipe->bind_blend_state(pipe, NULL);
+   pipe->delete_blend_state(pipe, blend_cso);
+   pipe->delete_sampler_state(pipe, sampler_cso);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   static const unsigned blend_factors[] = {
+      PIPE_BLENDFACTOR_ZERO,         /* no blending */
+      PIPE_BLENDFACTOR_ONE,
+      PIPE_BLENDFACTOR_SRC_ALPHA,
+   };
+   struct linear_test test;
+   boolean success = TRUE;
+   unsigned t, c, f, w, b;
+
+   if (!init_test(&test)) {
+      fini_test(&test);
+      return FALSE;
+   }
+
+   for (t = 0; t < ARRAY_SIZE(textures); t++) {
+      const struct linear_texture *tex = &textures[t];
+      struct pipe_resource *res = create_texture(&test, tex);
+      struct pipe_sampler_view templ, *view;
+
+      if (!res) {
+         success = FALSE;
+         continue;
+      }
+
+      u_sampler_view_default_template(&templ, res, res->format);
+      view = test.pipe->create_sampler_view(test.pipe, res, &templ);
+
+      write_quads(&test, tex);
+
+      for (c = 0; c < ARRAY_SIZE(cbuf_formats); c++) {
+         for (f = 0; f < ARRAY_SIZE(filters); f++) {
+            for (w = 0; w < ARRAY_SIZE(wraps); w++) {
+               /* unnormalized coords can't repeat */
+               if (tex->target == PIPE_TEXTURE_RECT &&
+                   wraps[w] == PIPE_TEX_WRAP_REPEAT) {
+                  continue;
+               }
+               for (b = 0; b < ARRAY_SIZE(blend_factors); b++) {
+                  /* also perspective interpolation, where w is one */
+                  if (!test_linear(&test, verbose, fp, tex, view,
+                                   cbuf_formats[c], filters[f], wraps[w],
+                                   blend_factors[b], (t + b) & 1)) {
+                     success = FALSE;
+                  }
+               }
+            }
+         }
+      }
+
+      test.pipe->set_sampler_views(test.pipe, PIPE_SHADER_FRAGMENT, 0, 0,
+                                   NULL);
+      pipe_sampler_view_reference(&view, NULL);
+      pipe_resource_reference(&res, NULL);
+   }
+
+   fini_test(&test);
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return TRUE;
+}
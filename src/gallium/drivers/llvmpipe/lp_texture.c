@@ -36,6 +36,7 @@
 #include "pipe/p_defines.h"
 
 #include "util/u_inlines.h"
+#include "util/u_box.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
@@ -43,6 +44,8 @@
 #include "util/simple_list.h"
 #include "util/u_transfer.h"
 
+#include "gallivm/lp_bld_sample.h"
+
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
@@ -183,6 +186,90 @@ fail:
 }
 
 
+/**
+ * Whether to store a texture in micro-tiles (see LP_TEXTURE_TILE_SIZE).
+ * This helps the locality of sampling, at the cost of conversions on
+ * transfers, so it is only done for textures which are just sampled.
+ * Textures which may be rendered to are converted back to the linear
+ * layout when that happens.
+ */
+static boolean
+llvmpipe_texture_can_tile(const struct llvmpipe_screen *screen,
+                          const struct pipe_resource *pt)
+{
+   const struct util_format_description *desc =
+      util_format_description(pt->format);
+
+   if (!screen->tiled_textures)
+      return FALSE;
+
+   if (!(pt->bind & PIPE_BIND_SAMPLER_VIEW) ||
+       (pt->bind & (PIPE_BIND_DEPTH_STENCIL |
+                    PIPE_BIND_DISPLAY_TARGET |
+                    PIPE_BIND_SCANOUT |
+                    PIPE_BIND_SHARED |
+                    PIPE_BIND_LINEAR |
+                    PIPE_BIND_SHADER_BUFFER |
+                    PIPE_BIND_SHADER_IMAGE)))
+      return FALSE;
+
+   /* Persistent mappings can't go through a linear copy */
+   if (pt->flags & (PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                    PIPE_RESOURCE_FLAG_MAP_COHERENT))
+      return FALSE;
+
+   if (llvmpipe_resource_is_1d(pt) || pt->nr_samples > 1)
+      return FALSE;
+
+   return desc->block.width == 1 && desc->block.height == 1 &&
+          util_is_power_of_two_nonzero(desc->block.bits / 8);
+}
+
+
+/**
+ * Copy a box of texels between a linear image and a level of a texture
+ * stored in micro-tiles, in the direction given by to_tiled.
+ */
+static void
+llvmpipe_tiled_copy(struct llvmpipe_resource *lpr, unsigned level,
+                    const struct pipe_box *box,
+                    uint8_t *linear, unsigned stride, unsigned layer_stride,
+                    boolean to_tiled)
+{
+   const unsigned bpp = util_format_get_blocksize(lpr->base.format);
+   const unsigned row_stride = lpr->row_stride[level];
+   const unsigned mask = LP_TEXTURE_TILE_SIZE - 1;
+   int x, y, z;
+
+   for (z = 0; z < box->depth; z++) {
+      uint8_t *image =
+         llvmpipe_get_texture_image_address(lpr, box->z + z, level);
+
+      for (y = 0; y < box->height; y++) {
+         const unsigned ty = box->y + y;
+         uint8_t *tiled_row = image + (ty & ~mask) * row_stride +
+                              (ty & mask) * LP_TEXTURE_TILE_SIZE * bpp;
+         uint8_t *linear_row = linear + z * layer_stride + y * stride;
+
+         /* copy one micro-tile row at a time */
+         for (x = 0; x < box->width; ) {
+            const unsigned tx = box->x + x;
+            const unsigned n = MIN2(LP_TEXTURE_TILE_SIZE - (tx & mask),
+                                    box->width - x);
+            uint8_t *texel = tiled_row +
+               ((tx & ~mask) * LP_TEXTURE_TILE_SIZE + (tx & mask)) * bpp;
+
+            if (to_tiled)
+               memcpy(texel, linear_row + x * bpp, n * bpp);
+            else
+               memcpy(linear_row + x * bpp, texel, n * bpp);
+            x += n;
+         }
+      }
+   }
+}
+
+
 /**
  * Check the size of the texture specified by 'res'.
  * \return TRUE if OK, FALSE if too large.
@@ -247,6 +334,7 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
       return NULL;
 
    lpr->base = *templat;
+   lpr->base.flags &= ~LP_RESOURCE_FLAG_TILED;
    pipe_reference_init(&lpr->base.reference, 1);
    lpr->base.screen = &screen->base;
 
@@ -264,6 +352,19 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
          /* texture map */
          if (!llvmpipe_texture_layout(screen, lpr, true))
             goto fail;
+
+         if (llvmpipe_texture_can_tile(screen, &lpr->base))
+            lpr->base.flags |= LP_RESOURCE_FLAG_TILED;
+      }
+
+      if ((lpr->base.bind & PIPE_BIND_DEPTH_STENCIL) &&
+          util_format_has_depth(util_format_description(lpr->base.format))) {
+         unsigned nblocks_y = DIV_ROUND_UP(lpr->base.height0,
+                                           LP_HIZ_BLOCK_SIZE);
+         lpr->hiz_stride = DIV_ROUND_UP(lpr->base.width0, LP_HIZ_BLOCK_SIZE);
+         /* Not fatal if this fails, we just won't do hierarchical depth. */
+         lpr->hiz = MALLOC(lpr->hiz_stride * nblocks_y * sizeof *lpr->hiz);
+         llvmpipe_resource_hiz_invalidate(lpr);
       }
    }
    else {
@@ -337,6 +438,8 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
       align_free(lpr->data);
    }
 
+   FREE(lpr->hiz);
+
 #ifdef DEBUG
    if (lpr->next)
       remove_from_list(lpr);
@@ -346,6 +449,84 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
 }
 
 
+/**
+ * Forget the hierarchical depth bounds of a resource, after its contents
+ * were changed behind the rasterizer's back.
+ */
+void
+llvmpipe_resource_hiz_invalidate(struct llvmpipe_resource *lpr)
+{
+   unsigned i, n;
+
+   if (!lpr->hiz)
+      return;
+
+   n = lpr->hiz_stride * DIV_ROUND_UP(lpr->base.height0, LP_HIZ_BLOCK_SIZE);
+   for (i = 0; i < n; i++) {
+      lpr->hiz[i].zmin = -INFINITY;
+      lpr->hiz[i].zmax = INFINITY;
+   }
+}
+
+
+/**
+ * Convert a texture stored in micro-tiles to the linear layout, which is
+ * needed before rendering to it.  This is permanent.
+ */
+void
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct llvmpipe_resource *lpr)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct pipe_resource *pt = &lpr->base;
+   unsigned level;
+
+   if (!(pt->flags & LP_RESOURCE_FLAG_TILED))
+      return;
+
+   llvmpipe_flush_resource(pipe, pt, 0,
+                           FALSE, /* read_only */
+                           TRUE, /* cpu_access */
+                           FALSE, /* do_not_block */
+                           __FUNCTION__);
+
+   for (level = 0; level <= pt->last_level; level++) {
+      const unsigned img_stride = lpr->img_stride[level];
+      unsigned num_slices, slice;
+      struct pipe_box box;
+      uint8_t *image;
+
+      if (pt->target == PIPE_TEXTURE_3D)
+         num_slices = u_minify(pt->depth0, level);
+      else
+         num_slices = pt->array_size;
+
+      image = MALLOC(img_stride);
+      if (!image) {
+         /* leave the texture readable at least */
+         return;
+      }
+
+      for (slice = 0; slice < num_slices; slice++) {
+         u_box_3d(0, 0, slice,
+                  u_minify(pt->width0, level), u_minify(pt->height0, level), 1,
+                  &box);
+         llvmpipe_tiled_copy(lpr, level, &box, image,
+                             lpr->row_stride[level], img_stride, FALSE);
+         memcpy(llvmpipe_get_texture_image_address(lpr, slice, level),
+                image, img_stride);
+      }
+
+      FREE(image);
+   }
+
+   pt->flags &= ~LP_RESOURCE_FLAG_TILED;
+
+   /* Have all contexts pick up the new layout. */
+   screen->timestamp++;
+}
+
+
 /**
  * Map a resource for read/write.
  */
@@ -390,6 +571,8 @@ llvmpipe_resource_map(struct pipe_resource *resource,
       return map;
    }
    else if (llvmpipe_resource_is_texture(resource)) {
+      /* tiled textures are only accessed through transfers and samplers */
+      assert(!(resource->flags & LP_RESOURCE_FLAG_TILED));
 
       map = llvmpipe_get_texture_image_address(lpr, layer, level);
       return map;
@@ -546,6 +729,12 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       }
    }
 
+   /* Tiled textures are only accessible through a linear copy */
+   if ((resource->flags & LP_RESOURCE_FLAG_TILED) &&
+       (usage & PIPE_TRANSFER_MAP_DIRECTLY)) {
+      return NULL;
+   }
+
    /* Check if we're mapping a current constant buffer */
    if ((usage & PIPE_TRANSFER_WRITE) &&
        (resource->bind & PIPE_BIND_CONSTANT_BUFFER)) {
@@ -596,6 +785,31 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
 
    format = lpr->base.format;
 
+   if (resource->flags & LP_RESOURCE_FLAG_TILED) {
+      pt->stride = box->width * util_format_get_blocksize(format);
+      pt->layer_stride = pt->stride * box->height;
+
+      lpt->staging = align_malloc(pt->layer_stride * box->depth, 16);
+      if (!lpt->staging) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         *transfer = NULL;
+         return NULL;
+      }
+
+      if (!(usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                     PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE))) {
+         llvmpipe_tiled_copy(lpr, level, box, lpt->staging,
+                             pt->stride, pt->layer_stride, FALSE);
+      }
+
+      if (usage & PIPE_TRANSFER_WRITE) {
+         screen->timestamp++;
+      }
+
+      return lpt->staging;
+   }
+
    map = llvmpipe_resource_map(resource,
                                level,
                                box->z,
@@ -609,6 +823,11 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       /* Do something to notify sharing contexts of a texture change.
        */
       screen->timestamp++;
+      lpr->timestamp = screen->timestamp;
+
+      /* The rasterizer no longer knows what's in the depth buffer. */
+      if (level == 0)
+         llvmpipe_resource_hiz_invalidate(lpr);
    }
 
    map +=
@@ -623,16 +842,28 @@ static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
-   assert(transfer->resource);
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
 
-   llvmpipe_resource_unmap(transfer->resource,
-                           transfer->level,
-                           transfer->box.z);
+   assert(transfer->resource);
 
    /* Effectively do the texture_update work here - if texture images
-    * needed post-processing to put them into hardware layout, this is
-    * where it would happen.  For llvmpipe, nothing to do.
+    * need post-processing to put them into the tiled layout, this is
+    * where it happens.
     */
+   if (lpt->staging) {
+      if (transfer->usage & PIPE_TRANSFER_WRITE) {
+         llvmpipe_tiled_copy(llvmpipe_resource(transfer->resource),
+                             transfer->level, &transfer->box, lpt->staging,
+                             transfer->stride, transfer->layer_stride, TRUE);
+      }
+      align_free(lpt->staging);
+   }
+   else {
+      llvmpipe_resource_unmap(transfer->resource,
+                              transfer->level,
+                              transfer->box.z);
+   }
+
    assert (transfer->resource);
    pipe_resource_reference(&transfer->resource, NULL);
    FREE(transfer);
@@ -49,6 +49,22 @@ struct llvmpipe_context;
 struct sw_displaytarget;
 
 
+/** Size of the square pixel blocks tracked for hierarchical depth */
+#define LP_HIZ_BLOCK_SIZE 16
+
+
+/**
+ * Hierarchical depth bounds of a LP_HIZ_BLOCK_SIZE square block of a depth
+ * buffer: all the depth values stored in the block lie within [zmin, zmax].
+ * Unknown contents are described by [-INFINITY, INFINITY].
+ */
+struct lp_hiz_block
+{
+   float zmin;
+   float zmax;
+};
+
+
 /**
  * llvmpipe subclass of pipe_resource.  A texture, drawing surface,
  * vertex buffer, const buffer, etc.
@@ -85,7 +101,19 @@ struct llvmpipe_resource
     */
    void *data;
 
+   /**
+    * Depth bounds of the blocks of level 0, layer 0 of depth buffers,
+    * maintained by the rasterizer for coarse occlusion culling.
+    * NULL if not tracked for this resource.
+    */
+   struct lp_hiz_block *hiz;
+   unsigned hiz_stride;  /**< blocks per row of hiz */
+
    boolean userBuffer;  /** Is this a user-space buffer? */
+   /**
+    * Screen timestamp of the last mapping for write, identifying the
+    * current contents of a buffer;  0 if unknown.
+    */
    unsigned timestamp;
 
    unsigned id;  /**< temporary, for debugging */
@@ -102,6 +130,9 @@ struct llvmpipe_transfer
    struct pipe_transfer base;
 
    unsigned long offset;
+
+   /** Linear copy of the box, for textures stored in micro-tiles */
+   void *staging;
 };
 
 
@@ -211,6 +242,15 @@ void *
 llvmpipe_resource_data(struct pipe_resource *resource);
 
 
+void
+llvmpipe_resource_hiz_invalidate(struct llvmpipe_resource *lpr);
+
+
+void
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct llvmpipe_resource *lpr);
+
+
 unsigned
 llvmpipe_resource_size(const struct pipe_resource *resource);
 
@@ -833,6 +833,7 @@ enum pipe_cap
    PIPE_CAP_MAX_TEXTURE_UPLOAD_MEMORY_BUDGET,
    PIPE_CAP_MAX_VERTEX_ELEMENT_SRC_OFFSET,
    PIPE_CAP_SURFACE_SAMPLE_COUNT,
+   PIPE_CAP_CONSTBUF0_PARTIAL_UPDATES,
 };
 
 /**
@@ -31,15 +31,30 @@
 #include "pipe/p_compiler.h"
 #include "pipe/p_format.h"
 #include "state_tracker/st_api.h"
+#include "util/u_queue.h"
 
 struct pipe_surface;
 struct st_framebuffer;
 struct dri_context;
+struct dri_drawable;
 
 #define DRI_SWAP_FENCES_MAX 4
 #define DRI_SWAP_FENCES_MASK 3
 #define DRI_SWAP_FENCES_DEFAULT 1
 
+#define DRISW_PRESENT_BUFFERS 2
+
+/**
+ * A back buffer of the DRISW present ring, and its pending presentation.
+ */
+struct drisw_present
+{
+   struct dri_drawable *drawable;
+   struct pipe_resource *texture;
+   struct pipe_fence_handle *fence;   /**< rendering to wait for */
+   struct util_queue_fence done;      /**< signalled once presented */
+};
+
 struct dri_drawable
 {
    struct st_framebuffer_iface base;
@@ -70,6 +85,11 @@ struct dri_drawable
    /* used only by DRISW */
    struct pipe_surface *drisw_surface;
 
+   /* DRISW asynchronous presentation, if enabled */
+   struct util_queue present_queue;
+   struct drisw_present present[DRISW_PRESENT_BUFFERS];
+   unsigned cur_present;
+
    /* hooks filled in by dri2 & drisw */
    void (*allocate_textures)(struct dri_context *ctx,
                              struct dri_drawable *drawable,
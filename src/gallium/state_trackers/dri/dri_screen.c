@@ -87,6 +87,8 @@ dri_fill_st_options(struct dri_screen *screen)
       driQueryOptionb(optionCache, "allow_glsl_cross_stage_interpolation_mismatch");
    options->allow_glsl_layout_qualifier_on_function_parameters =
       driQueryOptionb(optionCache, "allow_glsl_layout_qualifier_on_function_parameters");
+   options->mesa_async_texture_upload =
+      driQueryOptionb(optionCache, "mesa_async_texture_upload");
 
    driComputeOptionsSha1(optionCache, options->config_options_sha1);
 }
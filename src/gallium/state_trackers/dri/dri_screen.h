@@ -79,6 +79,7 @@ struct dri_screen
    enum pipe_texture_target target;
 
    boolean swrast_no_present;
+   boolean swrast_async_present;
 
    /* hooks filled in by dri2 & drisw */
    __DRIimage * (*lookup_egl_image)(struct dri_screen *ctx, void *handle);
@@ -42,6 +42,7 @@
 #include "dri_query_renderer.h"
 
 DEBUG_GET_ONCE_BOOL_OPTION(swrast_no_present, "SWRAST_NO_PRESENT", FALSE);
+DEBUG_GET_ONCE_BOOL_OPTION(swrast_async_present, "SWRAST_ASYNC_PRESENT", FALSE);
 
 static inline void
 get_drawable_info(__DRIdrawable *dPriv, int *x, int *y, int *w, int *h)
@@ -187,6 +188,17 @@ drisw_put_image_shm(struct dri_drawable *drawable,
    put_image_shm(dPriv, shmid, shmaddr, offset, x, y, width, height, stride);
 }
 
+/**
+ * Wait until the queued presentations of the drawable have completed, so
+ * that whatever follows is ordered after them.
+ */
+static inline void
+drisw_finish_present(struct dri_drawable *drawable)
+{
+   if (util_queue_is_initialized(&drawable->present_queue))
+      util_queue_finish(&drawable->present_queue);
+}
+
 static inline void
 drisw_present_texture(__DRIdrawable *dPriv,
                       struct pipe_resource *ptex, struct pipe_box *sub_box)
@@ -197,6 +209,8 @@ drisw_present_texture(__DRIdrawable *dPriv,
    if (screen->swrast_no_present)
       return;
 
+   drisw_finish_present(drawable);
+
    screen->base.screen->flush_frontbuffer(screen->base.screen, ptex, 0, 0, drawable, sub_box);
 }
 
@@ -223,6 +237,53 @@ drisw_copy_to_front(__DRIdrawable * dPriv,
  * Backend functions for st_framebuffer interface and swap_buffers.
  */
 
+static void
+drisw_present_execute(void *job, int thread_index)
+{
+   struct drisw_present *present = (struct drisw_present *)job;
+   struct dri_drawable *drawable = present->drawable;
+   struct pipe_screen *pscreen = drawable->screen->base.screen;
+
+   if (present->fence) {
+      pscreen->fence_finish(pscreen, NULL, present->fence,
+                            PIPE_TIMEOUT_INFINITE);
+      pscreen->fence_reference(pscreen, &present->fence, NULL);
+   }
+
+   pscreen->flush_frontbuffer(pscreen, present->texture, 0, 0,
+                              drawable, NULL);
+}
+
+/**
+ * Hand the back buffer over to the present thread, and continue rendering
+ * into the next buffer of the ring once its own presentation is done.
+ * The contents of the new back buffer are undefined.
+ */
+static void
+drisw_swap_buffers_async(struct dri_context *ctx,
+                         struct dri_drawable *drawable,
+                         struct pipe_resource *ptex)
+{
+   struct drisw_present *present = &drawable->present[drawable->cur_present];
+   struct drisw_present *next;
+
+   ctx->st->flush(ctx->st, ST_FLUSH_FRONT, &present->fence);
+
+   pipe_resource_reference(&present->texture, ptex);
+   util_queue_add_job(&drawable->present_queue, present, &present->done,
+                      drisw_present_execute, NULL);
+
+   drawable->cur_present = (drawable->cur_present + 1) % DRISW_PRESENT_BUFFERS;
+   next = &drawable->present[drawable->cur_present];
+   util_queue_fence_wait(&next->done);
+
+   /* A NULL texture gets allocated on the next validation */
+   pipe_resource_reference(&drawable->textures[ST_ATTACHMENT_BACK_LEFT],
+                           next->texture);
+
+   drisw_invalidate_drawable(drawable->dPriv);
+}
+
 static void
 drisw_swap_buffers(__DRIdrawable *dPriv)
 {
@@ -239,6 +300,11 @@ drisw_swap_buffers(__DRIdrawable *dPriv)
       if (ctx->pp)
          pp_run(ctx->pp, ptex, ptex, drawable->textures[ST_ATTACHMENT_DEPTH_STENCIL]);
 
+      if (util_queue_is_initialized(&drawable->present_queue)) {
+         drisw_swap_buffers_async(ctx, drawable, ptex);
+         return;
+      }
+
       ctx->st->flush(ctx->st, ST_FLUSH_FRONT, NULL);
 
       drisw_copy_to_front(dPriv, ptex);
@@ -316,6 +382,11 @@ drisw_allocate_textures(struct dri_context *stctx,
    if (resized) {
       for (i = 0; i < ST_ATTACHMENT_COUNT; i++)
          pipe_resource_reference(&drawable->textures[i], NULL);
+
+      /* and the back buffers still in the present ring */
+      drisw_finish_present(drawable);
+      for (i = 0; i < DRISW_PRESENT_BUFFERS; i++)
+         pipe_resource_reference(&drawable->present[i].texture, NULL);
    }
 
    memset(&templ, 0, sizeof(templ));
@@ -377,6 +448,9 @@ drisw_update_tex_buffer(struct dri_drawable *drawable,
 
    get_drawable_info(dPriv, &x, &y, &w, &h);
 
+   /* read back what has been presented so far */
+   drisw_finish_present(drawable);
+
    map = pipe_transfer_map(pipe, res,
                            0, 0, // level, layer,
                            PIPE_TRANSFER_WRITE,
@@ -451,6 +525,8 @@ drisw_init_screen(__DRIscreen * sPriv)
    screen->fd = -1;
 
    screen->swrast_no_present = debug_get_option_swrast_no_present();
+   screen->swrast_async_present = !screen->swrast_no_present &&
+                                  debug_get_option_swrast_async_present();
 
    sPriv->driverPrivate = (void *)screen;
    sPriv->extensions = drisw_screen_extensions;
@@ -488,7 +564,9 @@ drisw_create_buffer(__DRIscreen * sPriv,
                     __DRIdrawable * dPriv,
                     const struct gl_config * visual, boolean isPixmap)
 {
+   struct dri_screen *screen = dri_screen(sPriv);
    struct dri_drawable *drawable = NULL;
+   unsigned i;
 
    if (!dri_create_buffer(sPriv, dPriv, visual, isPixmap))
       return FALSE;
@@ -500,9 +578,38 @@ drisw_create_buffer(__DRIscreen * sPriv,
    drawable->flush_frontbuffer = drisw_flush_frontbuffer;
    drawable->update_tex_buffer = drisw_update_tex_buffer;
 
+   /* Without a thread the presentation simply stays synchronous */
+   if (screen->swrast_async_present && visual->doubleBufferMode && !isPixmap &&
+       util_queue_init(&drawable->present_queue, "swpresent",
+                       DRISW_PRESENT_BUFFERS, 1, 0)) {
+      for (i = 0; i < DRISW_PRESENT_BUFFERS; i++) {
+         drawable->present[i].drawable = drawable;
+         util_queue_fence_init(&drawable->present[i].done);
+      }
+   }
+
    return TRUE;
 }
 
+static void
+drisw_destroy_buffer(__DRIdrawable *dPriv)
+{
+   struct dri_drawable *drawable = dri_drawable(dPriv);
+   unsigned i;
+
+   if (util_queue_is_initialized(&drawable->present_queue)) {
+      util_queue_finish(&drawable->present_queue);
+      util_queue_destroy(&drawable->present_queue);
+
+      for (i = 0; i < DRISW_PRESENT_BUFFERS; i++) {
+         pipe_resource_reference(&drawable->present[i].texture, NULL);
+         util_queue_fence_destroy(&drawable->present[i].done);
+      }
+   }
+
+   dri_destroy_buffer(dPriv);
+}
+
 /**
  * DRI driver virtual function table.
  *
@@ -514,7 +621,7 @@ const struct __DriverAPIRec galliumsw_driver_api = {
    .CreateContext = dri_create_context,
    .DestroyContext = dri_destroy_context,
    .CreateBuffer = drisw_create_buffer,
-   .DestroyBuffer = dri_destroy_buffer,
+   .DestroyBuffer = drisw_destroy_buffer,
    .SwapBuffers = drisw_swap_buffers,
    .MakeCurrent = dri_make_current,
    .UnbindContext = dri_unbind_context,
@@ -40,6 +40,40 @@
 
 // Shader functions
 
+static struct spirv_to_nir_options
+anv_spirv_options(const struct anv_device *device)
+{
+   const struct anv_physical_device *pdevice =
+      &device->instance->physicalDevice;
+
+   return (struct spirv_to_nir_options) {
+      .lower_workgroup_access_to_offsets = true,
+      .caps = {
+         .float64 = pdevice->info.gen >= 8,
+         .int64 = pdevice->info.gen >= 8,
+         .tessellation = true,
+         .device_group = true,
+         .draw_parameters = true,
+         .image_write_without_format = true,
+         .min_lod = true,
+         .multiview = true,
+         .variable_pointers = true,
+         .storage_16bit = pdevice->info.gen >= 8,
+         .int16 = pdevice->info.gen >= 8,
+         .shader_viewport_index_layer = true,
+         .subgroup_arithmetic = true,
+         .subgroup_basic = true,
+         .subgroup_ballot = true,
+         .subgroup_quad = true,
+         .subgroup_shuffle = true,
+         .subgroup_vote = true,
+         .stencil_export = pdevice->info.gen >= 9,
+         .storage_8bit = pdevice->info.gen >= 8,
+         .post_depth_coverage = pdevice->info.gen >= 9,
+      },
+   };
+}
+
 VkResult anv_CreateShaderModule(
     VkDevice                                    _device,
     const VkShaderModuleCreateInfo*             pCreateInfo,
@@ -63,6 +97,10 @@ VkResult anv_CreateShaderModule(
 
    _mesa_sha1_compute(module->data, module->size, module->sha1);
 
+   /* The SPIR-V is only parsed once a pipeline misses the cache */
+   module->spirv = NULL;
+   module->alloc = pAllocator ? *pAllocator : device->alloc;
+
    *pShaderModule = anv_shader_module_to_handle(module);
 
    return VK_SUCCESS;
@@ -79,11 +117,49 @@ void anv_DestroyShaderModule(
    if (!module)
       return;
 
+   vk_free(&module->alloc, module->spirv);
+
    vk_free2(&device->alloc, pAllocator, module);
 }
 
 #define SPIR_V_MAGIC_NUMBER 0x07230203
 
+static void *
+anv_spirv_module_alloc(void *data, size_t size)
+{
+   const VkAllocationCallbacks *alloc = data;
+   return vk_alloc(alloc, size, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+}
+
+/* Returns the parsed preamble of the module's SPIR-V, running it the first
+ * time it is needed.  Several pipelines may be compiled from the same
+ * module at once, the first parse to be published wins.
+ */
+static const struct spirv_module *
+anv_shader_module_get_spirv(const struct anv_device *device,
+                            struct anv_shader_module *module)
+{
+   struct spirv_module *spirv = p_atomic_read(&module->spirv);
+   if (spirv)
+      return spirv;
+
+   struct spirv_to_nir_options spirv_options = anv_spirv_options(device);
+   spirv = spirv_module_create((const uint32_t *) module->data,
+                               module->size / 4, &spirv_options,
+                               anv_spirv_module_alloc, &module->alloc);
+   if (spirv == NULL)
+      return NULL;
+
+   struct spirv_module *old =
+      p_atomic_cmpxchg(&module->spirv, (struct spirv_module *) NULL, spirv);
+   if (old) {
+      vk_free(&module->alloc, spirv);
+      return old;
+   }
+
+   return spirv;
+}
+
 static const uint64_t stage_to_debug[] = {
    [MESA_SHADER_VERTEX] = DEBUG_VS,
    [MESA_SHADER_TESS_CTRL] = DEBUG_TCS,
@@ -99,7 +175,7 @@ static const uint64_t stage_to_debug[] = {
 static nir_shader *
 anv_shader_compile_to_nir(struct anv_pipeline *pipeline,
                           void *mem_ctx,
-                          const struct anv_shader_module *module,
+                          struct anv_shader_module *module,
                           const char *entrypoint_name,
                           gl_shader_stage stage,
                           const VkSpecializationInfo *spec_info)
@@ -111,7 +187,7 @@ anv_shader_compile_to_nir(struct anv_pipeline *pipeline,
    const nir_shader_compiler_options *nir_options =
       compiler->glsl_compiler_options[stage].NirOptions;
 
-   uint32_t *spirv = (uint32_t *) module->data;
+   MAYBE_UNUSED const uint32_t *spirv = (const uint32_t *) module->data;
    assert(spirv[0] == SPIR_V_MAGIC_NUMBER);
    assert(module->size % 4 == 0);
 
@@ -133,37 +209,18 @@ anv_shader_compile_to_nir(struct anv_pipeline *pipeline,
       }
    }
 
-   struct spirv_to_nir_options spirv_options = {
-      .lower_workgroup_access_to_offsets = true,
-      .caps = {
-         .float64 = device->instance->physicalDevice.info.gen >= 8,
-         .int64 = device->instance->physicalDevice.info.gen >= 8,
-         .tessellation = true,
-         .device_group = true,
-         .draw_parameters = true,
-         .image_write_without_format = true,
-         .min_lod = true,
-         .multiview = true,
-         .variable_pointers = true,
-         .storage_16bit = device->instance->physicalDevice.info.gen >= 8,
-         .int16 = device->instance->physicalDevice.info.gen >= 8,
-         .shader_viewport_index_layer = true,
-         .subgroup_arithmetic = true,
-         .subgroup_basic = true,
-         .subgroup_ballot = true,
-         .subgroup_quad = true,
-         .subgroup_shuffle = true,
-         .subgroup_vote = true,
-         .stencil_export = device->instance->physicalDevice.info.gen >= 9,
-         .storage_8bit = device->instance->physicalDevice.info.gen >= 8,
-         .post_depth_coverage = device->instance->physicalDevice.info.gen >= 9,
-      },
-   };
-
-   nir_function *entry_point =
-      spirv_to_nir(spirv, module->size / 4,
-                   spec_entries, num_spec_entries,
-                   stage, entrypoint_name, &spirv_options, nir_options);
+   const struct spirv_module *spirv_module =
+      anv_shader_module_get_spirv(device, module);
+   nir_function *entry_point = NULL;
+   if (spirv_module) {
+      entry_point = spirv_module_to_nir(spirv_module,
+                                        spec_entries, num_spec_entries,
+                                        stage, entrypoint_name, nir_options);
+   }
+   if (entry_point == NULL) {
+      free(spec_entries);
+      return NULL;
+   }
    nir_shader *nir = entry_point->shader;
    assert(nir->info.stage == stage);
    nir_validate_shader(nir, "after spirv_to_nir");
@@ -395,7 +452,7 @@ populate_cs_prog_key(const struct gen_device_info *devinfo,
 struct anv_pipeline_stage {
    gl_shader_stage stage;
 
-   const struct anv_shader_module *module;
+   struct anv_shader_module *module;
    const char *entrypoint;
    const VkSpecializationInfo *spec_info;
 
@@ -1110,7 +1167,7 @@ VkResult
 anv_pipeline_compile_cs(struct anv_pipeline *pipeline,
                         struct anv_pipeline_cache *cache,
                         const VkComputePipelineCreateInfo *info,
-                        const struct anv_shader_module *module,
+                        struct anv_shader_module *module,
                         const char *entrypoint,
                         const VkSpecializationInfo *spec_info)
 {
@@ -2350,6 +2350,9 @@ void anv_semaphore_reset_temporary(struct anv_device *device,
 
 struct anv_shader_module {
    unsigned char                                sha1[20];
+   /* Parsed SPIR-V preamble, allocated from alloc on first use */
+   struct spirv_module *                        spirv;
+   VkAllocationCallbacks                        alloc;
    uint32_t                                     size;
    char                                         data[0];
 };
@@ -2540,7 +2543,7 @@ VkResult
 anv_pipeline_compile_cs(struct anv_pipeline *pipeline,
                         struct anv_pipeline_cache *cache,
                         const VkComputePipelineCreateInfo *info,
-                        const struct anv_shader_module *module,
+                        struct anv_shader_module *module,
                         const char *entrypoint,
                         const VkSpecializationInfo *spec_info);
 
@@ -90,6 +90,11 @@ class PrintCode(gl_XML.gl_print_base):
     def print_sync_dispatch(self, func):
         out('debug_print_sync_fallback("{0}");'.format(func.name))
         self.print_sync_call(func)
+        self.print_call_after(func)
+
+    def print_call_after(self, func):
+        if func.marshal_call_after and func.return_type == 'void':
+            out('{0};'.format(func.marshal_call_after))
 
     def print_sync_body(self, func):
         out('/* {0}: marshalled synchronously */'.format(func.name))
@@ -101,6 +106,7 @@ class PrintCode(gl_XML.gl_print_base):
             out('_mesa_glthread_finish(ctx);')
             out('debug_print_sync("{0}");'.format(func.name))
             self.print_sync_call(func)
+            self.print_call_after(func)
         out('}')
         out('')
         out('')
@@ -134,6 +140,7 @@ class PrintCode(gl_XML.gl_print_base):
 
         if not func.fixed_params and not func.variable_params:
             out('(void) cmd;\n')
+        self.print_call_after(func)
         out('_mesa_post_marshal_hook(ctx);')
 
     def print_async_struct(self, func):
@@ -254,6 +261,14 @@ class PrintCode(gl_XML.gl_print_base):
                     out('return;')
                 out('}')
 
+            if func.marshal_sync:
+                out('if ({0}) {{'.format(func.marshal_sync))
+                with indent():
+                    out('_mesa_glthread_finish(ctx);')
+                    self.print_sync_dispatch(func)
+                    out('return;')
+                out('}')
+
             out('if (cmd_size <= MARSHAL_MAX_CMD_SIZE) {')
             with indent():
                 self.print_async_dispatch(func)
@@ -287,7 +302,7 @@ class PrintCode(gl_XML.gl_print_base):
             out('switch (cmd_base->cmd_id) {')
             for func in api.functionIterateAll():
                 flavor = func.marshal_flavor()
-                if flavor in ('skip', 'sync'):
+                if flavor in ('skip', 'sync', 'custom_sync'):
                     continue
                 out('case DISPATCH_CMD_{0}:'.format(func.name))
                 with indent():
@@ -332,7 +347,7 @@ class PrintCode(gl_XML.gl_print_base):
         async_funcs = []
         for func in api.functionIterateAll():
             flavor = func.marshal_flavor()
-            if flavor in ('skip', 'custom'):
+            if flavor in ('skip', 'custom', 'custom_sync'):
                 continue
             elif flavor == 'async':
                 self.print_async_body(func)
@@ -0,0 +1,250 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file avx2_format_utils.c
+ * AVX2 versions of the _mesa_swizzle_and_convert() cases in
+ * sse_format_utils.c, doing twice as many pixels per instruction.
+ *
+ * vpshufb and the pack instructions work within each 128-bit lane, so the
+ * kernels put a group of pixels in each lane and reuse the 128-bit shuffle
+ * controls.  The float operations are the same as in the SSE4.1 and the
+ * generic code, so the results are bit-identical to them.
+ */
+
+#include <immintrin.h>
+
+#include "main/simd_format_utils.h"
+
+/** Load 16 bytes into both lanes. */
+static inline __m256i
+load_both_lanes(const uint8_t *bytes)
+{
+   const __m128i v = _mm_loadu_si128((const __m128i *) bytes);
+
+   return _mm256_broadcastsi128_si256(v);
+}
+
+static inline __m256i
+combine_lanes(__m128i lo, __m128i hi)
+{
+   return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+static void
+swizzle_ubyte(uint8_t *dst, const uint8_t *src, int num_src_channels,
+              const uint8_t swizzle[4], uint8_t one, int count)
+{
+   /* Source bytes of the four pixels in each lane. */
+   const int lane_size = 4 * num_src_channels;
+   uint8_t shuffle_bytes[16], ones_bytes[16];
+   int s = 0;
+
+   _mesa_build_swizzle_shuffle(shuffle_bytes, ones_bytes, swizzle,
+                               num_src_channels, 1, 1, 4, one);
+
+   const __m256i shuffle = load_both_lanes(shuffle_bytes);
+   const __m256i ones = load_both_lanes(ones_bytes);
+
+   /* Eight pixels at a time, as long as both lanes can be loaded whole. */
+   for (; (count - s) * num_src_channels >= lane_size + 16; s += 8) {
+      __m256i pixels =
+         combine_lanes(_mm_loadu_si128((const __m128i *) src),
+                       _mm_loadu_si128((const __m128i *) (src + lane_size)));
+
+      pixels = _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), ones);
+      _mm256_storeu_si256((__m256i *) dst, pixels);
+
+      src += 2 * lane_size;
+      dst += 32;
+   }
+
+   _mesa_swizzle_ubyte_tail(dst, src, num_src_channels, swizzle, one,
+                            count - s);
+}
+
+/**
+ * Convert 8 or 16-bit unsigned channels to float, multiplying them by
+ * \p scale (1 / MAX_UINT(bits) if normalized, 1 otherwise).
+ */
+static void
+unsigned_to_float(float *dst, const uint8_t *src, unsigned src_size,
+                  int num_src_channels, const uint8_t swizzle[4],
+                  float scale, int count)
+{
+   const unsigned pixels = 4 / src_size;
+   const union { float f; uint32_t u; } one = { 1.0f };
+   uint8_t shuffle_bytes[4][16], ones_bytes[4][16];
+   __m256i shuffle[2], ones[2];
+   int s = 0;
+
+   for (unsigned p = 0; p < pixels; p++) {
+      const unsigned offset = p * num_src_channels * src_size;
+
+      _mesa_build_swizzle_shuffle(shuffle_bytes[p], ones_bytes[p], swizzle,
+                                  num_src_channels, src_size, 4, 1, one.u);
+      for (unsigned b = 0; b < 16; b++) {
+         if (!(shuffle_bytes[p][b] & 0x80))
+            shuffle_bytes[p][b] += offset;
+      }
+   }
+
+   /* Both lanes see the same 16 source bytes, and each picks the channels
+    * of one of two consecutive pixels out of them.
+    */
+   for (unsigned p = 0; p < pixels; p += 2) {
+      const __m128i *shuffles = (const __m128i *) shuffle_bytes[p];
+      const __m128i *onesv = (const __m128i *) ones_bytes[p];
+
+      shuffle[p / 2] = combine_lanes(_mm_loadu_si128(shuffles),
+                                     _mm_loadu_si128(shuffles + 1));
+      ones[p / 2] = combine_lanes(_mm_loadu_si128(onesv),
+                                  _mm_loadu_si128(onesv + 1));
+   }
+
+   const __m256 scale8 = _mm256_set1_ps(scale);
+
+   for (; (count - s) * num_src_channels * (int) src_size >= 16;
+        s += pixels) {
+      const __m256i data = load_both_lanes(src);
+
+      for (unsigned p = 0; p < pixels / 2; p++) {
+         const __m256i ints = _mm256_shuffle_epi8(data, shuffle[p]);
+         __m256 floats = _mm256_mul_ps(_mm256_cvtepi32_ps(ints), scale8);
+
+         /* Channels that are one are +0.0 at this point. */
+         floats = _mm256_or_ps(floats, _mm256_castsi256_ps(ones[p]));
+         _mm256_storeu_ps(dst, floats);
+         dst += 8;
+      }
+
+      src += pixels * num_src_channels * src_size;
+   }
+
+   _mesa_unsigned_to_float_tail(dst, src, src_size, num_src_channels,
+                                swizzle, scale, count - s);
+}
+
+/**
+ * Convert four float channels to normalized 8-bit channels.
+ */
+static void
+float_to_unorm8(uint8_t *dst, const float *src, const uint8_t swizzle[4],
+                int count)
+{
+   uint8_t shuffle_bytes[16], ones_bytes[16];
+   int s = 0;
+
+   _mesa_build_swizzle_shuffle(shuffle_bytes, ones_bytes, swizzle, 4, 1, 1, 4,
+                               UINT8_MAX);
+
+   const __m256i shuffle = load_both_lanes(shuffle_bytes);
+   const __m256i ones = load_both_lanes(ones_bytes);
+   const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+   const __m256 zero = _mm256_setzero_ps();
+   const __m256 one = _mm256_set1_ps(1.0f);
+   const __m256 max = _mm256_set1_ps(UINT8_MAX);
+
+   for (; s + 8 <= count; s += 8) {
+      __m256i ints[4];
+
+      for (unsigned p = 0; p < 4; p++) {
+         /* maxps returns its second operand for NaN, so NaN becomes 0 like
+          * in _mesa_float_to_unorm().  The conversion rounds to nearest
+          * even, like _mesa_lroundevenf().
+          */
+         __m256 f = _mm256_max_ps(_mm256_loadu_ps(src + p * 8), zero);
+         f = _mm256_mul_ps(_mm256_min_ps(f, one), max);
+         ints[p] = _mm256_cvtps_epi32(f);
+      }
+
+      /* Packing within the lanes leaves pixels 0, 2, 4, 6 in the lower lane
+       * and 1, 3, 5, 7 in the upper one.
+       */
+      __m256i bytes =
+         _mm256_packus_epi16(_mm256_packus_epi32(ints[0], ints[1]),
+                             _mm256_packus_epi32(ints[2], ints[3]));
+      bytes = _mm256_permutevar8x32_epi32(bytes, order);
+      bytes = _mm256_or_si256(_mm256_shuffle_epi8(bytes, shuffle), ones);
+      _mm256_storeu_si256((__m256i *) dst, bytes);
+
+      src += 32;
+      dst += 32;
+   }
+
+   _mesa_float_to_unorm8_tail(dst, src, swizzle, count - s);
+}
+
+/**
+ * Try to do a _mesa_swizzle_and_convert() operation with AVX2.
+ *
+ * \return  true if the operation was done, false if the generic version
+ *          has to be used.
+ */
+bool
+_mesa_avx2_swizzle_and_convert(void *void_dst,
+                               enum mesa_array_format_datatype dst_type,
+                               int num_dst_channels,
+                               const void *void_src,
+                               enum mesa_array_format_datatype src_type,
+                               int num_src_channels,
+                               const uint8_t swizzle[4], bool normalized,
+                               int count)
+{
+   if (!_mesa_simd_swizzle_supported(num_dst_channels, num_src_channels,
+                                     swizzle))
+      return false;
+
+   switch (dst_type) {
+   case MESA_ARRAY_FORMAT_TYPE_UBYTE:
+      if (src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE) {
+         swizzle_ubyte(void_dst, void_src, num_src_channels, swizzle,
+                       normalized ? UINT8_MAX : 1, count);
+         return true;
+      }
+      if (src_type == MESA_ARRAY_FORMAT_TYPE_FLOAT && normalized &&
+          num_src_channels == 4) {
+         float_to_unorm8(void_dst, void_src, swizzle, count);
+         return true;
+      }
+      return false;
+
+   case MESA_ARRAY_FORMAT_TYPE_FLOAT:
+      if (src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE) {
+         unsigned_to_float(void_dst, void_src, 1, num_src_channels, swizzle,
+                           normalized ? 1.0f / (float) MAX_UINT(8) : 1.0f,
+                           count);
+         return true;
+      }
+      if (src_type == MESA_ARRAY_FORMAT_TYPE_USHORT) {
+         unsigned_to_float(void_dst, void_src, 2, num_src_channels, swizzle,
+                           normalized ? 1.0f / (float) MAX_UINT(16) : 1.0f,
+                           count);
+         return true;
+      }
+      return false;
+
+   default:
+      return false;
+   }
+}
@@ -39,6 +39,7 @@
 #include "mtypes.h"
 #include "macros.h"
 #include "state.h"
+#include "texstore_async.h"
 
 
 /** Set this to 1 to debug/log glBlitFramebuffer() calls */
@@ -572,6 +573,9 @@ blit_framebuffer(struct gl_context *ctx,
       return;
    }
 
+   _mesa_finish_framebuffer_texture_uploads(ctx, readFb);
+   _mesa_finish_framebuffer_texture_uploads(ctx, drawFb);
+
    assert(ctx->Driver.BlitFramebuffer);
    ctx->Driver.BlitFramebuffer(ctx, readFb, drawFb,
                                srcX0, srcY0, srcX1, srcY1,
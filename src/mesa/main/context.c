@@ -131,6 +131,7 @@
 #include "stencil.h"
 #include "texcompress_s3tc.h"
 #include "texstate.h"
+#include "texstore_async.h"
 #include "transformfeedback.h"
 #include "mtypes.h"
 #include "varray.h"
@@ -1316,6 +1317,8 @@ _mesa_free_context_data( struct gl_context *ctx )
       _mesa_make_current(ctx, NULL, NULL);
    }
 
+   _mesa_finish_all_texture_uploads(ctx);
+
    /* unreference WinSysDraw/Read buffers */
    _mesa_reference_framebuffer(&ctx->WinSysDrawBuffer, NULL);
    _mesa_reference_framebuffer(&ctx->WinSysReadBuffer, NULL);
@@ -1689,6 +1692,10 @@ _mesa_make_current( struct gl_context *newCtx,
       }
    }
 
+   /* The uploads are finished by the thread the context is current to. */
+   if (curCtx && curCtx != newCtx)
+      _mesa_finish_all_texture_uploads(curCtx);
+
    if (curCtx &&
        (curCtx->WinSysDrawBuffer || curCtx->WinSysReadBuffer) &&
        /* make sure this context is valid for flushing */
@@ -1765,6 +1772,11 @@ _mesa_make_current( struct gl_context *newCtx,
          handle_first_current(newCtx);
          newCtx->FirstTimeCurrent = GL_FALSE;
       }
+
+      /* The above may have changed the viewport and framebuffer bindings
+       * behind the back of the glthread state tracking.
+       */
+      _mesa_glthread_invalidate_state(newCtx);
    }
 
    return GL_TRUE;
@@ -1850,6 +1862,7 @@ _mesa_flush(struct gl_context *ctx)
 {
    FLUSH_VERTICES( ctx, 0 );
    FLUSH_CURRENT( ctx, 0 );
+   _mesa_finish_all_texture_uploads(ctx);
    if (ctx->Driver.Flush) {
       ctx->Driver.Flush(ctx);
    }
@@ -1871,6 +1884,7 @@ _mesa_Finish(void)
 
    FLUSH_VERTICES(ctx, 0);
    FLUSH_CURRENT(ctx, 0);
+   _mesa_finish_all_texture_uploads(ctx);
 
    if (ctx->Driver.Finish) {
       ctx->Driver.Finish(ctx);
@@ -32,6 +32,7 @@
 #include "copyimage.h"
 #include "teximage.h"
 #include "texobj.h"
+#include "texstore_async.h"
 #include "fbobject.h"
 #include "textureview.h"
 #include "glformats.h"
@@ -539,6 +540,11 @@ copy_image_subdata(struct gl_context *ctx,
                    int dstX, int dstY, int dstZ, int dstLevel,
                    int srcWidth, int srcHeight, int srcDepth)
 {
+   if (srcTexImage)
+      _mesa_wait_texture_uploads(ctx, srcTexImage->TexObject, NULL);
+   if (dstTexImage)
+      _mesa_wait_texture_uploads(ctx, dstTexImage->TexObject, NULL);
+
    /* loop over 2D slices/faces/layers */
    for (int i = 0; i < srcDepth; ++i) {
       int newSrcZ = srcZ + i;
@@ -27,6 +27,9 @@
 #include "glformats.h"
 #include "format_pack.h"
 #include "format_unpack.h"
+#include "simd_format_utils.h"
+#include "x86/common_x86_asm.h"
+#include "util/u_cpu_detect.h"
 
 const mesa_array_format RGBA32_FLOAT =
    MESA_ARRAY_FORMAT(4, 1, 1, 1, 4, 0, 1, 2, 3);
@@ -181,6 +184,46 @@ _mesa_compute_rgba2base2rgba_component_mapping(GLenum baseFormat, uint8_t *map)
 }
 
 
+/**
+ * Try the vector versions of _mesa_swizzle_and_convert() that the CPU
+ * supports.
+ *
+ * \return  true if one of them did the conversion, false if the generic code
+ *          has to be used.
+ */
+static bool
+simd_swizzle_and_convert(void *void_dst,
+                         enum mesa_array_format_datatype dst_type,
+                         int num_dst_channels,
+                         const void *void_src,
+                         enum mesa_array_format_datatype src_type,
+                         int num_src_channels,
+                         const uint8_t swizzle[4], bool normalized, int count)
+{
+#if defined(USE_AVX2)
+   util_cpu_detect();
+#endif
+
+#if defined(USE_AVX2)
+   if (util_cpu_caps.has_avx2 &&
+       _mesa_avx2_swizzle_and_convert(void_dst, dst_type, num_dst_channels,
+                                      void_src, src_type, num_src_channels,
+                                      swizzle, normalized, count))
+      return true;
+#endif
+
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1 &&
+       _mesa_sse41_swizzle_and_convert(void_dst, dst_type, num_dst_channels,
+                                       void_src, src_type, num_src_channels,
+                                       swizzle, normalized, count))
+      return true;
+#endif
+
+   return false;
+}
+
+
 /**
  * Special case conversion function to swap r/b channels from the source
  * image to the dest image.
@@ -190,8 +233,24 @@ convert_ubyte_rgba_to_bgra(size_t width, size_t height,
                            const uint8_t *src, size_t src_stride,
                            uint8_t *dst, size_t dst_stride)
 {
+   static const uint8_t map_2103[4] = { 2, 1, 0, 3 };
    int row;
 
+   /* The vector versions take either all of the rows or none of them. */
+   if (height > 0 &&
+       simd_swizzle_and_convert(dst, MESA_ARRAY_FORMAT_TYPE_UBYTE, 4,
+                                src, MESA_ARRAY_FORMAT_TYPE_UBYTE, 4,
+                                map_2103, true, width)) {
+      for (row = 1; row < height; row++) {
+         src += src_stride;
+         dst += dst_stride;
+         simd_swizzle_and_convert(dst, MESA_ARRAY_FORMAT_TYPE_UBYTE, 4,
+                                  src, MESA_ARRAY_FORMAT_TYPE_UBYTE, 4,
+                                  map_2103, true, width);
+      }
+      return;
+   }
+
    if (sizeof(void *) == 8 &&
        src_stride % 8 == 0 &&
        dst_stride % 8 == 0 &&
@@ -1511,6 +1570,11 @@ _mesa_swizzle_and_convert(void *void_dst, enum mesa_array_format_datatype dst_ty
                                   swizzle, normalized, count))
       return;
 
+   if (simd_swizzle_and_convert(void_dst, dst_type, num_dst_channels,
+                                void_src, src_type, num_src_channels,
+                                swizzle, normalized, count))
+      return;
+
    switch (dst_type) {
    case MESA_ARRAY_FORMAT_TYPE_FLOAT:
       convert_float(void_dst, num_dst_channels, void_src, src_type,
@@ -36,6 +36,7 @@
 #include "mtypes.h"
 #include "teximage.h"
 #include "texobj.h"
+#include "texstore_async.h"
 #include "hash.h"
 
 bool
@@ -130,6 +131,7 @@ generate_texture_mipmap(struct gl_context *ctx,
    }
 
    _mesa_lock_texture(ctx, texObj);
+   _mesa_wait_texture_uploads(ctx, texObj, NULL);
 
    srcImage = _mesa_select_tex_image(texObj, target, texObj->BaseLevel);
    if (!no_error) {
@@ -92,6 +92,9 @@ _mesa_glthread_init(struct gl_context *ctx)
    }
 
    glthread->stats.queue = &glthread->queue;
+   glthread->vertex_arrays_dirty = true;
+   glthread->shadow_dirty = true;
+   glthread->error_possible = true;
    ctx->CurrentClientDispatch = ctx->MarshalExec;
    ctx->GLThread = glthread;
 
@@ -193,6 +196,9 @@ _mesa_glthread_finish(struct gl_context *ctx)
    if (u_thread_is_self(glthread->queue.threads[0]))
       return;
 
+   /* The caller is about to execute something directly. */
+   glthread->error_possible = true;
+
    struct glthread_batch *last = &glthread->batches[glthread->last];
    struct glthread_batch *next = &glthread->batches[glthread->next];
    bool synced = false;
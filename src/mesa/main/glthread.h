@@ -46,6 +46,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include "util/u_queue.h"
+#include "compiler/shader_enums.h"
 
 enum marshal_dispatch_cmd_id;
 struct gl_context;
@@ -66,6 +67,69 @@ struct glthread_batch
    uint8_t buffer[MARSHAL_MAX_CMD_SIZE];
 };
 
+/** A vertex array as seen by the application thread. */
+struct glthread_attrib
+{
+   /** Client memory address, or offset into the buffer object. */
+   const void *pointer;
+
+   /** Size of one element in bytes. */
+   unsigned element_size;
+
+   /** Distance between elements in bytes. */
+   unsigned stride;
+
+   /** Name of the buffer object bound when the pointer was set, or 0. */
+   unsigned buffer;
+};
+
+/**
+ * The subset of the current vertex array object that draw calls need to
+ * find and copy client memory arrays.
+ */
+struct glthread_vao
+{
+   /** Mask of VERT_BIT_* values indicating which arrays are enabled */
+   uint32_t enabled;
+
+   /** Mask of VERT_BIT_* values of arrays pointing to client memory */
+   uint32_t user_pointer_mask;
+
+   /**
+    * Mask of VERT_BIT_* values of client memory arrays in a layout we can't
+    * copy (shared bindings, relative offsets, instance divisors).  Draws
+    * enabling any of them are executed synchronously.
+    */
+   uint32_t opaque_mask;
+
+   /**
+    * Mask of VERT_BIT_* values of arrays whose own binding has an instance
+    * divisor or other arrays attached.  gl*Pointer() moves an array back to
+    * its own binding without changing either, so those arrays stay opaque.
+    */
+   uint32_t binding_opaque_mask;
+
+   struct glthread_attrib attribs[VERT_ATTRIB_MAX];
+};
+
+/**
+ * Frequently queried state, mirrored on the main thread so that glGet*() and
+ * glIsEnabled() don't have to synchronize with the worker thread.
+ */
+struct glthread_shadow
+{
+   /** Mask of GLTHREAD_CAP_* bits of enabled capabilities. */
+   uint32_t enabled;
+
+   float viewport[4];
+   int scissor[4];
+   unsigned matrix_mode;
+   unsigned active_texture;
+   unsigned current_program;
+   unsigned draw_framebuffer;
+   unsigned read_framebuffer;
+};
+
 struct glthread_state
 {
    /** Multithreaded queue. */
@@ -84,16 +148,54 @@ struct glthread_state
    unsigned next;
 
    /**
-    * Tracks on the main thread side whether the current vertex array binding
-    * is in a VBO.
+    * Tracks on the main thread side the name of the buffer bound to
+    * GL_ARRAY_BUFFER, 0 if client memory arrays are being specified.
+    */
+   unsigned array_buffer;
+
+   /**
+    * Tracks on the main thread side the name of the buffer bound to
+    * GL_ELEMENT_ARRAY_BUFFER, 0 if indices are passed in client memory.
+    */
+   unsigned element_array_buffer;
+
+   /** Client active texture unit, for glTexCoordPointer. */
+   unsigned client_active_texture;
+
+   /** Vertex arrays of the current VAO, tracked on the main thread side. */
+   struct glthread_vao vao;
+
+   /** Primitive restart state, needed for scanning client memory indices. */
+   bool primitive_restart;
+   bool primitive_restart_fixed_index;
+   unsigned restart_index;
+
+   /**
+    * Set when a call changed vertex array or primitive restart state in a
+    * way the main thread doesn't model.  The next draw that needs the
+    * tracked state synchronizes and reloads it from the context.
     */
-   bool vertex_array_is_vbo;
+   bool vertex_arrays_dirty;
+
+   /** Queried state mirrored on the main thread side. */
+   struct glthread_shadow shadow;
+
+   /**
+    * Set when a call changed the mirrored state in a way the main thread
+    * can't predict (an unknown name, an indexed variant, glPopAttrib(), ...).
+    * The next query synchronizes and reloads the shadow from the context.
+    */
+   bool shadow_dirty;
+
+   /** Whether glBegin() has been called without a matching glEnd(). */
+   bool inside_begin_end;
 
    /**
-    * Tracks on the main thread side whether the current element array (index
-    * buffer) binding is in a VBO.
+    * Whether anything that could have raised a GL error was queued or
+    * executed since the last glGetError().  If not, glGetError() returns
+    * GL_NO_ERROR without synchronizing.
     */
-   bool element_array_is_vbo;
+   bool error_possible;
 };
 
 void _mesa_glthread_init(struct gl_context *ctx);
@@ -102,5 +204,6 @@ void _mesa_glthread_destroy(struct gl_context *ctx);
 void _mesa_glthread_restore_dispatch(struct gl_context *ctx, const char *func);
 void _mesa_glthread_flush_batch(struct gl_context *ctx);
 void _mesa_glthread_finish(struct gl_context *ctx);
+void _mesa_glthread_invalidate_state(struct gl_context *ctx);
 
 #endif /* _GLTHREAD_H*/
@@ -0,0 +1,619 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** \file glthread_draw.c
+ *
+ * Marshalling of the draw calls that legacy applications issue with vertex
+ * arrays or indices in client memory.
+ *
+ * The main thread copies the vertex range referenced by the draw out of each
+ * client memory array, and the indices if they are in client memory too,
+ * into storage owned by the command: inline after it when small enough,
+ * otherwise a heap block the worker thread frees after the draw.  The worker
+ * thread points the arrays at the copies for the duration of the draw and
+ * restores them afterwards, so the application is free to reuse its memory
+ * as soon as the call returns, just like without threading.
+ */
+
+#include "main/glthread.h"
+#include "main/marshal.h"
+#include "main/dispatch.h"
+#include "main/marshal_generated.h"
+#include "main/mtypes.h"
+#include "main/bufferobj.h"
+#include "main/varray.h"
+#include "util/bitscan.h"
+#include "util/u_math.h"
+
+
+/* Draw*: marshalled asynchronously */
+struct marshal_cmd_Draw
+{
+   struct marshal_cmd_base cmd_base;
+   GLenum mode;
+   GLenum type;
+   GLint first;
+   GLsizei count;
+   GLuint start;
+   GLuint end;
+   GLint basevertex;
+   const GLvoid *indices;
+
+   /** Arrays pointed at copies of their client memory during the draw */
+   GLbitfield user_arrays;
+
+   /** Heap block holding the copies, or NULL if they follow the command */
+   void *heap;
+
+   /* Next util_bitcount(user_arrays) pointers are the addresses the arrays
+    * take during the draw, followed by the copied data unless it is in heap.
+    */
+};
+
+
+/**
+ * Points the arrays in cmd->user_arrays at their copies, saving the client
+ * memory pointers to restore afterwards.  Returns the mask of arrays changed.
+ */
+static GLbitfield
+bind_uploaded_arrays(struct gl_context *ctx,
+                     const struct marshal_cmd_Draw *cmd,
+                     const GLubyte **saved)
+{
+   struct gl_vertex_array_object *vao = ctx->Array.VAO;
+   const GLubyte *const *pointers = (const GLubyte *const *) (cmd + 1);
+   GLbitfield mask = cmd->user_arrays;
+   GLbitfield bound = 0;
+
+   while (mask) {
+      const int i = u_bit_scan(&mask);
+      struct gl_array_attributes *array = &vao->VertexAttrib[i];
+      struct gl_vertex_buffer_binding *binding =
+         &vao->BufferBinding[array->BufferBindingIndex];
+      const GLubyte *ptr = *pointers++;
+
+      /* The main thread tracks the bindings itself; if it was wrong about
+       * this one, the draw reads the buffer object as it would have anyway.
+       */
+      if (_mesa_is_bufferobj(binding->BufferObj))
+         continue;
+
+      saved[i] = array->Ptr;
+      array->Ptr = ptr;
+      _mesa_bind_vertex_buffer(ctx, vao, array->BufferBindingIndex,
+                               binding->BufferObj, (GLintptr) ptr,
+                               binding->Stride);
+      bound |= VERT_BIT(i);
+   }
+
+   return bound;
+}
+
+
+static void
+restore_arrays(struct gl_context *ctx, GLbitfield mask,
+               const GLubyte *const *saved)
+{
+   struct gl_vertex_array_object *vao = ctx->Array.VAO;
+
+   while (mask) {
+      const int i = u_bit_scan(&mask);
+      struct gl_array_attributes *array = &vao->VertexAttrib[i];
+      struct gl_vertex_buffer_binding *binding =
+         &vao->BufferBinding[array->BufferBindingIndex];
+
+      array->Ptr = saved[i];
+      _mesa_bind_vertex_buffer(ctx, vao, array->BufferBindingIndex,
+                               binding->BufferObj, (GLintptr) saved[i],
+                               binding->Stride);
+   }
+}
+
+
+/** Client memory to be copied for one draw call. */
+struct glthread_upload
+{
+   /** Arrays to copy, in VERT_BIT_* order */
+   GLbitfield user_arrays;
+
+   /** Vertex range referenced by the draw, including basevertex */
+   uint64_t min_index, max_index;
+
+   /**
+    * Disjoint byte ranges covering the arrays.  Interleaved arrays share a
+    * single range, so their memory is only copied once.
+    */
+   unsigned num_ranges;
+   struct {
+      uintptr_t start, end;
+      size_t offset;
+   } ranges[VERT_ATTRIB_MAX];
+
+   /** Indices to copy, if they are in client memory */
+   const GLvoid *indices;
+   size_t index_bytes;
+   size_t index_offset;
+
+   /** Total size of the copies */
+   size_t size;
+};
+
+
+static void
+upload_add_range(struct glthread_upload *up, uintptr_t start, uintptr_t end)
+{
+   unsigned i = 0;
+
+   while (i < up->num_ranges) {
+      if (start <= up->ranges[i].end && end >= up->ranges[i].start) {
+         start = MIN2(start, up->ranges[i].start);
+         end = MAX2(end, up->ranges[i].end);
+         up->ranges[i] = up->ranges[--up->num_ranges];
+         /* The grown range may now overlap one we already walked past. */
+         i = 0;
+      } else {
+         i++;
+      }
+   }
+
+   up->ranges[up->num_ranges].start = start;
+   up->ranges[up->num_ranges].end = end;
+   up->num_ranges++;
+}
+
+
+/**
+ * Computes the ranges to copy for the arrays in up->user_arrays.  Returns
+ * false if they can't be expressed in the address space.
+ */
+static bool
+upload_prepare(const struct glthread_state *glthread,
+               struct glthread_upload *up)
+{
+   GLbitfield mask = up->user_arrays;
+
+   while (mask) {
+      const struct glthread_attrib *attrib =
+         &glthread->vao.attribs[u_bit_scan(&mask)];
+      const uint64_t start = (uintptr_t) attrib->pointer +
+                             up->min_index * attrib->stride;
+      const uint64_t end = (uintptr_t) attrib->pointer +
+                           up->max_index * attrib->stride +
+                           attrib->element_size;
+
+      if (end > UINTPTR_MAX || end < start)
+         return false;
+
+      upload_add_range(up, start, end);
+   }
+
+   size_t size = 0;
+   for (unsigned i = 0; i < up->num_ranges; i++) {
+      up->ranges[i].offset = size;
+      size += ALIGN(up->ranges[i].end - up->ranges[i].start, 8);
+   }
+
+   up->index_offset = size;
+   size += up->index_bytes;
+   up->size = size;
+
+   return true;
+}
+
+
+/**
+ * Copies the client memory into data, and writes the addresses the arrays
+ * take during the draw into pointers.  Returns the new address of the
+ * indices.
+ */
+static const GLvoid *
+upload_fill(const struct glthread_state *glthread,
+            const struct glthread_upload *up, uint8_t *data,
+            const void **pointers)
+{
+   for (unsigned i = 0; i < up->num_ranges; i++) {
+      memcpy(data + up->ranges[i].offset, (const void *) up->ranges[i].start,
+             up->ranges[i].end - up->ranges[i].start);
+   }
+
+   GLbitfield mask = up->user_arrays;
+   while (mask) {
+      const struct glthread_attrib *attrib =
+         &glthread->vao.attribs[u_bit_scan(&mask)];
+      const uintptr_t ptr = (uintptr_t) attrib->pointer;
+      const uintptr_t start = ptr + up->min_index * attrib->stride;
+      unsigned r = 0;
+
+      while (start < up->ranges[r].start || start >= up->ranges[r].end)
+         r++;
+
+      /* Vertex i of the array is now read from its copy; the address of
+       * vertex 0 itself may lie outside of it.
+       */
+      *pointers++ = (const void *)
+         ((uintptr_t) data + up->ranges[r].offset + (ptr - up->ranges[r].start));
+   }
+
+   if (up->indices)
+      memcpy(data + up->index_offset, up->indices, up->index_bytes);
+
+   return data + up->index_offset;
+}
+
+
+static unsigned
+get_index_size(GLenum type)
+{
+   switch (type) {
+   case GL_UNSIGNED_BYTE:
+      return 1;
+   case GL_UNSIGNED_SHORT:
+      return 2;
+   case GL_UNSIGNED_INT:
+      return 4;
+   default:
+      return 0;
+   }
+}
+
+
+#define SCAN_INDICES(T)                                         \
+   do {                                                         \
+      const T *ind = (const T *) indices;                       \
+      for (GLsizei i = 0; i < count; i++) {                     \
+         const unsigned index = ind[i];                         \
+         if (restart && index == restart_index)                 \
+            continue;                                           \
+         min = MIN2(min, index);                                \
+         max = MAX2(max, index);                                \
+      }                                                         \
+   } while (0)
+
+/**
+ * Finds the range of vertices referenced by client memory indices.  Returns
+ * false if every index is the primitive restart index.
+ */
+static bool
+scan_indices(const struct glthread_state *glthread, const GLvoid *indices,
+             unsigned index_size, GLsizei count,
+             unsigned *min_index, unsigned *max_index)
+{
+   const bool restart = glthread->primitive_restart ||
+                        glthread->primitive_restart_fixed_index;
+   unsigned restart_index = glthread->restart_index;
+   unsigned min = ~0u, max = 0;
+
+   /* Same rule as _mesa_primitive_restart_index(). */
+   if (glthread->primitive_restart_fixed_index)
+      restart_index = 0xffffffffu >> 8 * (4 - index_size);
+
+   switch (index_size) {
+   case 1:
+      SCAN_INDICES(GLubyte);
+      break;
+   case 2:
+      SCAN_INDICES(GLushort);
+      break;
+   default:
+      SCAN_INDICES(GLuint);
+      break;
+   }
+
+   *min_index = min;
+   *max_index = max;
+   return min <= max;
+}
+
+#undef SCAN_INDICES
+
+
+/**
+ * Queues a draw call, copying the client memory it reads.  Returns false if
+ * the draw has to be executed synchronously instead.
+ */
+static bool
+marshal_draw(struct gl_context *ctx, uint16_t cmd_id, GLenum mode,
+             GLint first, GLsizei count, GLenum type, const GLvoid *indices,
+             GLuint start, GLuint end, GLint basevertex, bool indexed,
+             bool has_range)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_upload up;
+
+   up.user_arrays = 0;
+   up.num_ranges = 0;
+   up.indices = NULL;
+   up.index_bytes = 0;
+   up.size = 0;
+
+   /* Core contexts can't source client memory, and invalid calls raise an
+    * error on the worker thread before reading anything.
+    */
+   const unsigned index_size = indexed ? get_index_size(type) : 0;
+   if (ctx->API != API_OPENGL_CORE && count > 0 &&
+       (!indexed || index_size)) {
+      _mesa_glthread_update_vertex_arrays(ctx);
+
+      GLbitfield user_arrays = _mesa_glthread_user_arrays(ctx);
+      const bool user_indices = indexed && !glthread->element_array_buffer;
+
+      if (user_arrays & glthread->vao.opaque_mask)
+         return false;
+
+      if (user_arrays) {
+         int64_t min_index, max_index;
+
+         if (!indexed) {
+            min_index = first;
+            max_index = (int64_t) first + count - 1;
+         } else if (has_range) {
+            min_index = start;
+            max_index = end;
+         } else if (user_indices) {
+            unsigned min, max;
+
+            if (scan_indices(glthread, indices, index_size, count,
+                             &min, &max)) {
+               min_index = min;
+               max_index = max;
+            } else {
+               /* Only restart indices, so no vertex is fetched. */
+               min_index = 0;
+               max_index = -1;
+            }
+         } else {
+            /* Indices in a buffer object can't be read on this thread. */
+            return false;
+         }
+
+         min_index += basevertex;
+         max_index += basevertex;
+
+         /* first < 0 and end < start are errors; a range with negative
+          * vertices is undefined, leave it to the synchronous path.
+          */
+         if (max_index >= min_index) {
+            if (min_index < 0)
+               return false;
+
+            up.user_arrays = user_arrays;
+            up.min_index = min_index;
+            up.max_index = max_index;
+         }
+      }
+
+      if (user_indices) {
+         up.indices = indices;
+         up.index_bytes = (size_t) count * index_size;
+      }
+
+      if (!upload_prepare(glthread, &up))
+         return false;
+   }
+
+   const unsigned num_pointers = util_bitcount(up.user_arrays);
+   size_t cmd_size = sizeof(struct marshal_cmd_Draw) +
+                     num_pointers * sizeof(void *);
+   void *heap = NULL;
+
+   if (cmd_size + up.size <= MARSHAL_MAX_CMD_SIZE) {
+      cmd_size += up.size;
+   } else {
+      heap = malloc(up.size);
+      if (!heap)
+         return false;
+   }
+
+   struct marshal_cmd_Draw *cmd =
+      _mesa_glthread_allocate_command(ctx, cmd_id, cmd_size);
+   const void **pointers = (const void **) (cmd + 1);
+
+   cmd->mode = mode;
+   cmd->type = type;
+   cmd->first = first;
+   cmd->count = count;
+   cmd->start = start;
+   cmd->end = end;
+   cmd->basevertex = basevertex;
+   cmd->indices = indices;
+   cmd->user_arrays = up.user_arrays;
+   cmd->heap = heap;
+
+   if (up.size) {
+      uint8_t *data = heap ? heap : (uint8_t *) (pointers + num_pointers);
+      const GLvoid *uploaded_indices = upload_fill(glthread, &up, data,
+                                                   pointers);
+
+      if (up.indices)
+         cmd->indices = uploaded_indices;
+   }
+
+   _mesa_post_marshal_hook(ctx);
+   return true;
+}
+
+
+void
+_mesa_unmarshal_DrawArrays(struct gl_context *ctx,
+                           const struct marshal_cmd_Draw *cmd)
+{
+   const GLubyte *saved[VERT_ATTRIB_MAX];
+   const GLbitfield bound = bind_uploaded_arrays(ctx, cmd, saved);
+
+   CALL_DrawArrays(ctx->CurrentServerDispatch,
+                   (cmd->mode, cmd->first, cmd->count));
+
+   restore_arrays(ctx, bound, saved);
+   free(cmd->heap);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawArrays");
+
+   if (marshal_draw(ctx, DISPATCH_CMD_DrawArrays, mode, first, count,
+                    GL_NONE, NULL, 0, 0, 0, false, false))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawArrays");
+   CALL_DrawArrays(ctx->CurrentServerDispatch, (mode, first, count));
+}
+
+
+void
+_mesa_unmarshal_DrawElements(struct gl_context *ctx,
+                             const struct marshal_cmd_Draw *cmd)
+{
+   const GLubyte *saved[VERT_ATTRIB_MAX];
+   const GLbitfield bound = bind_uploaded_arrays(ctx, cmd, saved);
+
+   CALL_DrawElements(ctx->CurrentServerDispatch,
+                     (cmd->mode, cmd->count, cmd->type, cmd->indices));
+
+   restore_arrays(ctx, bound, saved);
+   free(cmd->heap);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawElements(GLenum mode, GLsizei count, GLenum type,
+                           const GLvoid *indices)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawElements");
+
+   if (marshal_draw(ctx, DISPATCH_CMD_DrawElements, mode, 0, count, type,
+                    indices, 0, 0, 0, true, false))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawElements");
+   CALL_DrawElements(ctx->CurrentServerDispatch,
+                     (mode, count, type, indices));
+}
+
+
+void
+_mesa_unmarshal_DrawRangeElements(struct gl_context *ctx,
+                                  const struct marshal_cmd_Draw *cmd)
+{
+   const GLubyte *saved[VERT_ATTRIB_MAX];
+   const GLbitfield bound = bind_uploaded_arrays(ctx, cmd, saved);
+
+   CALL_DrawRangeElements(ctx->CurrentServerDispatch,
+                          (cmd->mode, cmd->start, cmd->end, cmd->count,
+                           cmd->type, cmd->indices));
+
+   restore_arrays(ctx, bound, saved);
+   free(cmd->heap);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElements(GLenum mode, GLuint start, GLuint end,
+                                GLsizei count, GLenum type,
+                                const GLvoid *indices)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawRangeElements");
+
+   if (marshal_draw(ctx, DISPATCH_CMD_DrawRangeElements, mode, 0, count,
+                    type, indices, start, end, 0, true, true))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawRangeElements");
+   CALL_DrawRangeElements(ctx->CurrentServerDispatch,
+                          (mode, start, end, count, type, indices));
+}
+
+
+void
+_mesa_unmarshal_DrawElementsBaseVertex(struct gl_context *ctx,
+                                       const struct marshal_cmd_Draw *cmd)
+{
+   const GLubyte *saved[VERT_ATTRIB_MAX];
+   const GLbitfield bound = bind_uploaded_arrays(ctx, cmd, saved);
+
+   CALL_DrawElementsBaseVertex(ctx->CurrentServerDispatch,
+                               (cmd->mode, cmd->count, cmd->type,
+                                cmd->indices, cmd->basevertex));
+
+   restore_arrays(ctx, bound, saved);
+   free(cmd->heap);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type,
+                                     const GLvoid *indices, GLint basevertex)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawElementsBaseVertex");
+
+   if (marshal_draw(ctx, DISPATCH_CMD_DrawElementsBaseVertex, mode, 0, count,
+                    type, indices, 0, 0, basevertex, true, false))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawElementsBaseVertex");
+   CALL_DrawElementsBaseVertex(ctx->CurrentServerDispatch,
+                               (mode, count, type, indices, basevertex));
+}
+
+
+void
+_mesa_unmarshal_DrawRangeElementsBaseVertex(struct gl_context *ctx,
+                                            const struct marshal_cmd_Draw *cmd)
+{
+   const GLubyte *saved[VERT_ATTRIB_MAX];
+   const GLbitfield bound = bind_uploaded_arrays(ctx, cmd, saved);
+
+   CALL_DrawRangeElementsBaseVertex(ctx->CurrentServerDispatch,
+                                    (cmd->mode, cmd->start, cmd->end,
+                                     cmd->count, cmd->type, cmd->indices,
+                                     cmd->basevertex));
+
+   restore_arrays(ctx, bound, saved);
+   free(cmd->heap);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElementsBaseVertex(GLenum mode, GLuint start,
+                                          GLuint end, GLsizei count,
+                                          GLenum type, const GLvoid *indices,
+                                          GLint basevertex)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawRangeElementsBaseVertex");
+
+   if (marshal_draw(ctx, DISPATCH_CMD_DrawRangeElementsBaseVertex, mode, 0,
+                    count, type, indices, start, end, basevertex, true, true))
+      return;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync_fallback("DrawRangeElementsBaseVertex");
+   CALL_DrawRangeElementsBaseVertex(ctx->CurrentServerDispatch,
+                                    (mode, start, end, count, type, indices,
+                                     basevertex));
+}
@@ -0,0 +1,548 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** \file glthread_get.c
+ *
+ * Main thread side handling of glGetIntegerv(), glGetBooleanv(),
+ * glIsEnabled() and glGetError().
+ *
+ * Applications and middleware query state all the time, and every query used
+ * to wait for the worker thread to go idle.  The main thread now mirrors a
+ * small set of frequently queried state from the calls it marshals and
+ * answers queries for it directly.
+ *
+ * A setter whose effect can't be predicted without looking at the context
+ * (an object name that may not exist, an indexed variant, glPopAttrib(), a
+ * display list) marks the mirror dirty instead, and the next query
+ * synchronizes and reloads the whole mirror from the context.  Queries for
+ * anything else are still executed synchronously.
+ */
+
+#include "main/glthread.h"
+#include "main/marshal.h"
+#include "main/dispatch.h"
+#include "main/mtypes.h"
+#include "main/context.h"
+#include "main/extensions.h"
+#include "main/texstate.h"
+
+
+/** Capabilities mirrored by glthread_shadow::enabled. */
+enum glthread_cap
+{
+   GLTHREAD_CAP_BLEND               = 1 << 0,
+   GLTHREAD_CAP_CULL_FACE           = 1 << 1,
+   GLTHREAD_CAP_DEPTH_TEST          = 1 << 2,
+   GLTHREAD_CAP_DITHER              = 1 << 3,
+   GLTHREAD_CAP_POLYGON_OFFSET_FILL = 1 << 4,
+   GLTHREAD_CAP_SCISSOR_TEST        = 1 << 5,
+   GLTHREAD_CAP_STENCIL_TEST        = 1 << 6,
+   GLTHREAD_CAP_LIGHTING            = 1 << 7,
+   GLTHREAD_CAP_ALPHA_TEST          = 1 << 8,
+   GLTHREAD_CAP_FOG                 = 1 << 9,
+   GLTHREAD_CAP_NORMALIZE           = 1 << 10,
+   GLTHREAD_CAP_COLOR_MATERIAL      = 1 << 11,
+};
+
+
+static bool
+has_fixed_function(const struct gl_context *ctx)
+{
+   return ctx->API == API_OPENGL_COMPAT || ctx->API == API_OPENGLES;
+}
+
+
+/**
+ * Returns the GLTHREAD_CAP_* bit of a capability, or 0 if it isn't mirrored
+ * or isn't valid in this API (in which case the call raises an error).
+ */
+static uint32_t
+cap_bit(const struct gl_context *ctx, GLenum cap)
+{
+   switch (cap) {
+   case GL_BLEND:
+      return GLTHREAD_CAP_BLEND;
+   case GL_CULL_FACE:
+      return GLTHREAD_CAP_CULL_FACE;
+   case GL_DEPTH_TEST:
+      return GLTHREAD_CAP_DEPTH_TEST;
+   case GL_DITHER:
+      return GLTHREAD_CAP_DITHER;
+   case GL_POLYGON_OFFSET_FILL:
+      return GLTHREAD_CAP_POLYGON_OFFSET_FILL;
+   case GL_SCISSOR_TEST:
+      return GLTHREAD_CAP_SCISSOR_TEST;
+   case GL_STENCIL_TEST:
+      return GLTHREAD_CAP_STENCIL_TEST;
+   }
+
+   if (!has_fixed_function(ctx))
+      return 0;
+
+   switch (cap) {
+   case GL_LIGHTING:
+      return GLTHREAD_CAP_LIGHTING;
+   case GL_ALPHA_TEST:
+      return GLTHREAD_CAP_ALPHA_TEST;
+   case GL_FOG:
+      return GLTHREAD_CAP_FOG;
+   case GL_NORMALIZE:
+      return GLTHREAD_CAP_NORMALIZE;
+   case GL_COLOR_MATERIAL:
+      return GLTHREAD_CAP_COLOR_MATERIAL;
+   default:
+      return 0;
+   }
+}
+
+
+void
+_mesa_glthread_invalidate_shadow(struct gl_context *ctx)
+{
+   ctx->GLThread->shadow_dirty = true;
+}
+
+
+/**
+ * Invalidates everything the main thread tracks.  This is for calls that can
+ * change any state, and for changes made outside of the GL API such as
+ * binding the context.
+ */
+void
+_mesa_glthread_invalidate_state(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   glthread->shadow_dirty = true;
+   glthread->vertex_arrays_dirty = true;
+}
+
+
+/**
+ * Reloads the mirrored state from the context.  The mirror is reloaded as a
+ * whole since synchronizing is what costs.
+ */
+static void
+reload_shadow(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_shadow *shadow = &glthread->shadow;
+   uint32_t enabled = 0;
+
+   /* The worker thread is idle after this, so reading the context is safe. */
+   _mesa_glthread_finish(ctx);
+
+   if (ctx->Color.BlendEnabled & 1)
+      enabled |= GLTHREAD_CAP_BLEND;
+   if (ctx->Polygon.CullFlag)
+      enabled |= GLTHREAD_CAP_CULL_FACE;
+   if (ctx->Depth.Test)
+      enabled |= GLTHREAD_CAP_DEPTH_TEST;
+   if (ctx->Color.DitherFlag)
+      enabled |= GLTHREAD_CAP_DITHER;
+   if (ctx->Polygon.OffsetFill)
+      enabled |= GLTHREAD_CAP_POLYGON_OFFSET_FILL;
+   if (ctx->Scissor.EnableFlags & 1)
+      enabled |= GLTHREAD_CAP_SCISSOR_TEST;
+   if (ctx->Stencil.Enabled)
+      enabled |= GLTHREAD_CAP_STENCIL_TEST;
+   if (ctx->Light.Enabled)
+      enabled |= GLTHREAD_CAP_LIGHTING;
+   if (ctx->Color.AlphaEnabled)
+      enabled |= GLTHREAD_CAP_ALPHA_TEST;
+   if (ctx->Fog.Enabled)
+      enabled |= GLTHREAD_CAP_FOG;
+   if (ctx->Transform.Normalize)
+      enabled |= GLTHREAD_CAP_NORMALIZE;
+   if (ctx->Light.ColorMaterialEnabled)
+      enabled |= GLTHREAD_CAP_COLOR_MATERIAL;
+
+   shadow->enabled = enabled;
+
+   shadow->viewport[0] = ctx->ViewportArray[0].X;
+   shadow->viewport[1] = ctx->ViewportArray[0].Y;
+   shadow->viewport[2] = ctx->ViewportArray[0].Width;
+   shadow->viewport[3] = ctx->ViewportArray[0].Height;
+
+   shadow->scissor[0] = ctx->Scissor.ScissorArray[0].X;
+   shadow->scissor[1] = ctx->Scissor.ScissorArray[0].Y;
+   shadow->scissor[2] = ctx->Scissor.ScissorArray[0].Width;
+   shadow->scissor[3] = ctx->Scissor.ScissorArray[0].Height;
+
+   shadow->matrix_mode = ctx->Transform.MatrixMode;
+   shadow->active_texture = ctx->Texture.CurrentUnit;
+   shadow->current_program =
+      ctx->Shader.ActiveProgram ? ctx->Shader.ActiveProgram->Name : 0;
+   shadow->draw_framebuffer = ctx->DrawBuffer ? ctx->DrawBuffer->Name : 0;
+   shadow->read_framebuffer = ctx->ReadBuffer ? ctx->ReadBuffer->Name : 0;
+
+   glthread->shadow_dirty = false;
+}
+
+
+static const struct glthread_shadow *
+get_shadow(struct gl_context *ctx)
+{
+   if (unlikely(ctx->GLThread->shadow_dirty))
+      reload_shadow(ctx);
+
+   return &ctx->GLThread->shadow;
+}
+
+
+/**
+ * Returns whether a setter can update the mirror directly.  Between glBegin()
+ * and glEnd() state changes raise errors instead.
+ */
+static bool
+can_track(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (unlikely(glthread->inside_begin_end)) {
+      glthread->shadow_dirty = true;
+      return false;
+   }
+
+   return true;
+}
+
+
+void
+_mesa_glthread_BeginEnd(struct gl_context *ctx, bool begin)
+{
+   ctx->GLThread->inside_begin_end = begin;
+}
+
+
+void
+_mesa_glthread_shadow_cap(struct gl_context *ctx, GLenum cap, bool enable)
+{
+   const uint32_t bit = cap_bit(ctx, cap);
+
+   if (!bit || !can_track(ctx))
+      return;
+
+   if (enable)
+      ctx->GLThread->shadow.enabled |= bit;
+   else
+      ctx->GLThread->shadow.enabled &= ~bit;
+}
+
+
+void
+_mesa_glthread_Viewport(struct gl_context *ctx, GLint x, GLint y,
+                        GLsizei width, GLsizei height)
+{
+   struct glthread_shadow *shadow = &ctx->GLThread->shadow;
+
+   if (width < 0 || height < 0 || !can_track(ctx))
+      return;
+
+   /* Same clamping as clamp_viewport() in viewport.c. */
+   float fx = x, fy = y;
+
+   if (_mesa_has_ARB_viewport_array(ctx) ||
+       _mesa_has_OES_viewport_array(ctx)) {
+      fx = CLAMP(fx, ctx->Const.ViewportBounds.Min,
+                 ctx->Const.ViewportBounds.Max);
+      fy = CLAMP(fy, ctx->Const.ViewportBounds.Min,
+                 ctx->Const.ViewportBounds.Max);
+   }
+
+   shadow->viewport[0] = fx;
+   shadow->viewport[1] = fy;
+   shadow->viewport[2] = MIN2((float) width,
+                              (float) ctx->Const.MaxViewportWidth);
+   shadow->viewport[3] = MIN2((float) height,
+                              (float) ctx->Const.MaxViewportHeight);
+}
+
+
+void
+_mesa_glthread_Scissor(struct gl_context *ctx, GLint x, GLint y,
+                       GLsizei width, GLsizei height)
+{
+   struct glthread_shadow *shadow = &ctx->GLThread->shadow;
+
+   if (width < 0 || height < 0 || !can_track(ctx))
+      return;
+
+   shadow->scissor[0] = x;
+   shadow->scissor[1] = y;
+   shadow->scissor[2] = width;
+   shadow->scissor[3] = height;
+}
+
+
+void
+_mesa_glthread_MatrixMode(struct gl_context *ctx, GLenum mode)
+{
+   if (!can_track(ctx))
+      return;
+
+   switch (mode) {
+   case GL_MODELVIEW:
+   case GL_PROJECTION:
+   case GL_TEXTURE:
+      ctx->GLThread->shadow.matrix_mode = mode;
+      break;
+   default:
+      /* Program matrices depend on extensions and limits; reload. */
+      ctx->GLThread->shadow_dirty = true;
+      break;
+   }
+}
+
+
+void
+_mesa_glthread_ActiveTexture(struct gl_context *ctx, GLenum texture)
+{
+   const unsigned unit = texture - GL_TEXTURE0;
+
+   if (unit >= _mesa_max_tex_unit(ctx) || !can_track(ctx))
+      return;
+
+   ctx->GLThread->shadow.active_texture = unit;
+}
+
+
+void
+_mesa_glthread_BindFramebuffer(struct gl_context *ctx, GLenum target,
+                               GLuint framebuffer)
+{
+   struct glthread_shadow *shadow = &ctx->GLThread->shadow;
+
+   if (!can_track(ctx))
+      return;
+
+   /* Core contexts reject names that weren't generated, and only the worker
+    * thread knows which ones were.
+    */
+   if (framebuffer && ctx->API == API_OPENGL_CORE) {
+      ctx->GLThread->shadow_dirty = true;
+      return;
+   }
+
+   switch (target) {
+   case GL_FRAMEBUFFER:
+      shadow->draw_framebuffer = framebuffer;
+      shadow->read_framebuffer = framebuffer;
+      break;
+   case GL_DRAW_FRAMEBUFFER:
+      shadow->draw_framebuffer = framebuffer;
+      break;
+   case GL_READ_FRAMEBUFFER:
+      shadow->read_framebuffer = framebuffer;
+      break;
+   }
+}
+
+
+/** Deleting a bound framebuffer binds the window system framebuffer. */
+void
+_mesa_glthread_DeleteFramebuffers(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *framebuffers)
+{
+   struct glthread_shadow *shadow = &ctx->GLThread->shadow;
+
+   if (n < 0 || !framebuffers || !can_track(ctx))
+      return;
+
+   for (GLsizei i = 0; i < n; i++) {
+      if (!framebuffers[i])
+         continue;
+
+      if (shadow->draw_framebuffer == framebuffers[i])
+         shadow->draw_framebuffer = 0;
+      if (shadow->read_framebuffer == framebuffers[i])
+         shadow->read_framebuffer = 0;
+   }
+}
+
+
+/**
+ * Answers an integer query from the mirrored state.  Returns the number of
+ * values written, or 0 if the query has to be executed by the context.
+ * GL_VIEWPORT is handled by the callers since it is stored as floats.
+ */
+static unsigned
+get_shadow_integers(struct gl_context *ctx, GLenum pname, GLint *values)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   const uint32_t bit = cap_bit(ctx, pname);
+
+   if (bit) {
+      values[0] = !!(get_shadow(ctx)->enabled & bit);
+      return 1;
+   }
+
+   switch (pname) {
+   case GL_SCISSOR_BOX:
+      memcpy(values, get_shadow(ctx)->scissor, 4 * sizeof(GLint));
+      return 4;
+
+   case GL_MATRIX_MODE:
+      if (!has_fixed_function(ctx))
+         return 0;
+      values[0] = get_shadow(ctx)->matrix_mode;
+      return 1;
+
+   case GL_ACTIVE_TEXTURE:
+      values[0] = GL_TEXTURE0 + get_shadow(ctx)->active_texture;
+      return 1;
+
+   case GL_CURRENT_PROGRAM:
+      if (ctx->API == API_OPENGLES)
+         return 0;
+      values[0] = get_shadow(ctx)->current_program;
+      return 1;
+
+   case GL_DRAW_FRAMEBUFFER_BINDING:
+      values[0] = get_shadow(ctx)->draw_framebuffer;
+      return 1;
+
+   case GL_READ_FRAMEBUFFER_BINDING:
+      if (!_mesa_is_desktop_gl(ctx) && !_mesa_is_gles3(ctx))
+         return 0;
+      values[0] = get_shadow(ctx)->read_framebuffer;
+      return 1;
+
+   case GL_ARRAY_BUFFER_BINDING:
+      /* Core contexts reject names that weren't generated. */
+      if (ctx->API == API_OPENGL_CORE)
+         return 0;
+      _mesa_glthread_update_vertex_arrays(ctx);
+      values[0] = glthread->array_buffer;
+      return 1;
+
+   default:
+      return 0;
+   }
+}
+
+
+void GLAPIENTRY
+_mesa_marshal_GetIntegerv(GLenum pname, GLint *params)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   GLint values[4];
+   unsigned count;
+
+   /* Queries between glBegin() and glEnd() raise an error. */
+   if (likely(!ctx->GLThread->inside_begin_end)) {
+      if (pname == GL_VIEWPORT) {
+         const struct glthread_shadow *shadow = get_shadow(ctx);
+
+         for (unsigned i = 0; i < 4; i++)
+            params[i] = IROUND(shadow->viewport[i]);
+         return;
+      }
+
+      count = get_shadow_integers(ctx, pname, values);
+      if (count) {
+         memcpy(params, values, count * sizeof(GLint));
+         return;
+      }
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync("GetIntegerv");
+   CALL_GetIntegerv(ctx->CurrentServerDispatch, (pname, params));
+}
+
+
+void GLAPIENTRY
+_mesa_marshal_GetBooleanv(GLenum pname, GLboolean *params)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   GLint values[4];
+   unsigned count;
+
+   if (likely(!ctx->GLThread->inside_begin_end)) {
+      if (pname == GL_VIEWPORT) {
+         const struct glthread_shadow *shadow = get_shadow(ctx);
+
+         for (unsigned i = 0; i < 4; i++)
+            params[i] = shadow->viewport[i] != 0.0f;
+         return;
+      }
+
+      count = get_shadow_integers(ctx, pname, values);
+      if (count) {
+         for (unsigned i = 0; i < count; i++)
+            params[i] = values[i] != 0;
+         return;
+      }
+   }
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync("GetBooleanv");
+   CALL_GetBooleanv(ctx->CurrentServerDispatch, (pname, params));
+}
+
+
+GLboolean GLAPIENTRY
+_mesa_marshal_IsEnabled(GLenum cap)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   const uint32_t bit = cap_bit(ctx, cap);
+
+   if (bit && likely(!ctx->GLThread->inside_begin_end))
+      return (get_shadow(ctx)->enabled & bit) != 0;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync("IsEnabled");
+   return CALL_IsEnabled(ctx->CurrentServerDispatch, (cap));
+}
+
+
+/**
+ * Errors are only raised by executing GL calls, so if nothing was queued or
+ * executed since the last glGetError(), there can't be a new error to
+ * report and the worker thread can be left alone.  This is what makes
+ * glGetError() loops and error checks after locally answered queries free.
+ */
+GLenum GLAPIENTRY
+_mesa_marshal_GetError(void)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct glthread_state *glthread = ctx->GLThread;
+   GLenum error;
+
+   if (!glthread->error_possible && likely(!glthread->inside_begin_end))
+      return GL_NO_ERROR;
+
+   _mesa_glthread_finish(ctx);
+   debug_print_sync("GetError");
+   error = CALL_GetError(ctx->CurrentServerDispatch, ());
+
+   /* glGetError() itself raises an error between glBegin() and glEnd(). */
+   if (!glthread->inside_begin_end)
+      glthread->error_possible = false;
+
+   return error;
+}
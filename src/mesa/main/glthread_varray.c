@@ -0,0 +1,578 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** \file glthread_varray.c
+ *
+ * Main thread side tracking of the vertex array state that draw calls need
+ * in order to copy client memory arrays before handing the draw to the
+ * worker thread.
+ *
+ * Only the calls that legacy applications issue every frame are modeled
+ * here (the gl*Pointer() family, client state enables, buffer bindings and
+ * primitive restart).  Anything else that can change the arrays just marks
+ * the tracked state dirty, and the next draw that needs it synchronizes with
+ * the worker thread and reloads it from the context.
+ */
+
+#include "main/glthread.h"
+#include "main/marshal.h"
+#include "main/mtypes.h"
+#include "main/bufferobj.h"
+#include "main/varray.h"
+#include "util/bitscan.h"
+
+
+/**
+ * Returns the size of one vertex array element in bytes, or 0 if the
+ * combination is invalid and the call is going to raise an error.
+ */
+static unsigned
+element_size(GLint size, GLenum type)
+{
+   if (size == GL_BGRA)
+      size = 4;
+
+   if (size < 1 || size > 4)
+      return 0;
+
+   switch (type) {
+   case GL_BYTE:
+   case GL_UNSIGNED_BYTE:
+      return size;
+   case GL_SHORT:
+   case GL_UNSIGNED_SHORT:
+   case GL_HALF_FLOAT:
+   case GL_HALF_FLOAT_OES:
+      return size * 2;
+   case GL_INT:
+   case GL_UNSIGNED_INT:
+   case GL_FLOAT:
+   case GL_FIXED:
+      return size * 4;
+   case GL_DOUBLE:
+      return size * 8;
+   case GL_INT_2_10_10_10_REV:
+   case GL_UNSIGNED_INT_2_10_10_10_REV:
+   case GL_UNSIGNED_INT_10F_11F_11F_REV:
+      return 4;
+   default:
+      return 0;
+   }
+}
+
+
+void
+_mesa_glthread_invalidate_vertex_arrays(struct gl_context *ctx)
+{
+   ctx->GLThread->vertex_arrays_dirty = true;
+}
+
+
+/**
+ * Reloads the tracked state from the context if a call we don't model has
+ * invalidated it.
+ */
+void
+_mesa_glthread_update_vertex_arrays(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (likely(!glthread->vertex_arrays_dirty))
+      return;
+
+   /* The worker thread is idle after this, so reading the context is safe. */
+   _mesa_glthread_finish(ctx);
+
+   const struct gl_vertex_array_object *vao = ctx->Array.VAO;
+   struct glthread_vao *tracked = &glthread->vao;
+
+   tracked->enabled = vao->Enabled;
+   tracked->user_pointer_mask = 0;
+   tracked->opaque_mask = 0;
+   tracked->binding_opaque_mask = 0;
+
+   for (unsigned i = 0; i < VERT_ATTRIB_MAX; i++) {
+      const struct gl_array_attributes *array = &vao->VertexAttrib[i];
+      const struct gl_vertex_buffer_binding *binding =
+         &vao->BufferBinding[array->BufferBindingIndex];
+      const struct gl_vertex_buffer_binding *own_binding =
+         &vao->BufferBinding[i];
+      struct glthread_attrib *attrib = &tracked->attribs[i];
+
+      if (own_binding->InstanceDivisor ||
+          (own_binding->_BoundArrays & ~VERT_BIT(i)))
+         tracked->binding_opaque_mask |= VERT_BIT(i);
+
+      attrib->pointer = _mesa_vertex_attrib_address(array, binding);
+      attrib->element_size = array->Format._ElementSize;
+      attrib->stride = binding->Stride;
+      attrib->buffer = binding->BufferObj->Name;
+
+      if (_mesa_is_bufferobj(binding->BufferObj))
+         continue;
+
+      tracked->user_pointer_mask |= VERT_BIT(i);
+
+      /* The draw only repoints whole bindings, and only for vertex indices. */
+      if (array->RelativeOffset || binding->InstanceDivisor ||
+          (binding->_BoundArrays & vao->Enabled & ~VERT_BIT(i)))
+         tracked->opaque_mask |= VERT_BIT(i);
+   }
+
+   glthread->array_buffer = ctx->Array.ArrayBufferObj->Name;
+   glthread->element_array_buffer = vao->IndexBufferObj->Name;
+   glthread->client_active_texture = ctx->Array.ActiveTexture;
+   glthread->primitive_restart = ctx->Array.PrimitiveRestart;
+   glthread->primitive_restart_fixed_index =
+      ctx->Array.PrimitiveRestartFixedIndex;
+   glthread->restart_index = ctx->Array.RestartIndex;
+   glthread->vertex_arrays_dirty = false;
+}
+
+
+/* Vertex array data types, for checking the gl*Pointer() arguments. */
+#define BYTE_BIT           (1 << 0)
+#define UNSIGNED_BYTE_BIT  (1 << 1)
+#define SHORT_BIT          (1 << 2)
+#define UNSIGNED_SHORT_BIT (1 << 3)
+#define INT_BIT            (1 << 4)
+#define UNSIGNED_INT_BIT   (1 << 5)
+#define HALF_BIT           (1 << 6)
+#define FLOAT_BIT          (1 << 7)
+#define DOUBLE_BIT         (1 << 8)
+#define FIXED_BIT          (1 << 9)
+
+static GLbitfield
+type_to_bit(GLenum type)
+{
+   switch (type) {
+   case GL_BYTE:
+      return BYTE_BIT;
+   case GL_UNSIGNED_BYTE:
+      return UNSIGNED_BYTE_BIT;
+   case GL_SHORT:
+      return SHORT_BIT;
+   case GL_UNSIGNED_SHORT:
+      return UNSIGNED_SHORT_BIT;
+   case GL_INT:
+      return INT_BIT;
+   case GL_UNSIGNED_INT:
+      return UNSIGNED_INT_BIT;
+   case GL_HALF_FLOAT:
+      return HALF_BIT;
+   case GL_FLOAT:
+      return FLOAT_BIT;
+   case GL_DOUBLE:
+      return DOUBLE_BIT;
+   case GL_FIXED:
+      return FIXED_BIT;
+   default:
+      /* Packed and extension types are left to the worker thread. */
+      return 0;
+   }
+}
+
+
+/**
+ * Returns whether a gl*Pointer() call is certain to succeed, following the
+ * checks in varray.c.  Failing calls don't change the array, so they must not
+ * change the tracked state either.
+ *
+ * This only needs to be conservative: anything rejected here just makes the
+ * next draw reload the arrays from the context.  There are no VAO related
+ * errors to check, because core contexts don't use the tracked state and the
+ * others stop threading on glBindVertexArray(), leaving the default VAO bound.
+ */
+static bool
+is_valid_pointer(const struct gl_context *ctx, gl_vert_attrib attrib,
+                 GLint size, GLenum type, GLsizei stride, bool integer)
+{
+   const bool es1 = ctx->API == API_OPENGLES;
+   const bool desktop = _mesa_is_desktop_gl(ctx);
+   const GLbitfield type_bit = type_to_bit(type);
+   GLbitfield legal_types;
+   GLint size_min = 1, size_max = 4;
+
+   if (stride < 0 || stride > ctx->Const.MaxVertexAttribStride)
+      return false;
+
+   switch (attrib) {
+   case VERT_ATTRIB_POS:
+      size_min = 2;
+      legal_types = es1 ? (BYTE_BIT | SHORT_BIT | FLOAT_BIT | FIXED_BIT)
+                        : (SHORT_BIT | INT_BIT | HALF_BIT | FLOAT_BIT |
+                           DOUBLE_BIT);
+      break;
+   case VERT_ATTRIB_NORMAL:
+      size_min = 3;
+      size_max = 3;
+      legal_types = es1 ? (BYTE_BIT | SHORT_BIT | FLOAT_BIT | FIXED_BIT)
+                        : (BYTE_BIT | SHORT_BIT | INT_BIT | HALF_BIT |
+                           FLOAT_BIT | DOUBLE_BIT);
+      break;
+   case VERT_ATTRIB_COLOR0:
+   case VERT_ATTRIB_COLOR1:
+      if (attrib == VERT_ATTRIB_COLOR1 && es1)
+         return false;
+
+      /* GL_BGRA is always GL_UNSIGNED_BYTE or a packed type. */
+      if (desktop && ctx->Extensions.EXT_vertex_array_bgra &&
+          size == GL_BGRA && type == GL_UNSIGNED_BYTE)
+         return true;
+
+      size_min = es1 ? 4 : 3;
+      legal_types = es1 ? (UNSIGNED_BYTE_BIT | FLOAT_BIT | FIXED_BIT)
+                        : (BYTE_BIT | UNSIGNED_BYTE_BIT | SHORT_BIT |
+                           UNSIGNED_SHORT_BIT | INT_BIT | UNSIGNED_INT_BIT |
+                           HALF_BIT | FLOAT_BIT | DOUBLE_BIT);
+      break;
+   case VERT_ATTRIB_FOG:
+      size_max = 1;
+      legal_types = es1 ? 0 : (HALF_BIT | FLOAT_BIT | DOUBLE_BIT);
+      break;
+   case VERT_ATTRIB_COLOR_INDEX:
+      size_max = 1;
+      legal_types = es1 ? 0 : (UNSIGNED_BYTE_BIT | SHORT_BIT | INT_BIT |
+                               FLOAT_BIT | DOUBLE_BIT);
+      break;
+   case VERT_ATTRIB_EDGEFLAG:
+      size_max = 1;
+      legal_types = es1 ? 0 : UNSIGNED_BYTE_BIT;
+      break;
+   default:
+      if (attrib >= VERT_ATTRIB_TEX0 && attrib <= VERT_ATTRIB_TEX7) {
+         size_min = es1 ? 2 : 1;
+         legal_types = es1 ? (BYTE_BIT | SHORT_BIT | FLOAT_BIT | FIXED_BIT)
+                           : (SHORT_BIT | INT_BIT | HALF_BIT | FLOAT_BIT |
+                              DOUBLE_BIT);
+      } else if (attrib >= VERT_ATTRIB_GENERIC0 && attrib < VERT_ATTRIB_MAX) {
+         if (attrib - VERT_ATTRIB_GENERIC0 >=
+             ctx->Const.Program[MESA_SHADER_VERTEX].MaxAttribs)
+            return false;
+
+         /* ES 2.0 lacks the 32-bit integer and half float types. */
+         const bool full = desktop || _mesa_is_gles3(ctx);
+
+         legal_types = BYTE_BIT | UNSIGNED_BYTE_BIT | SHORT_BIT |
+                       UNSIGNED_SHORT_BIT;
+         if (full)
+            legal_types |= INT_BIT | UNSIGNED_INT_BIT;
+         if (!integer) {
+            legal_types |= FLOAT_BIT;
+            if (full)
+               legal_types |= HALF_BIT;
+            if (desktop)
+               legal_types |= DOUBLE_BIT;
+            if (!desktop || ctx->Extensions.ARB_ES2_compatibility)
+               legal_types |= FIXED_BIT;
+         }
+      } else {
+         return false;
+      }
+      break;
+   }
+
+   return (type_bit & legal_types) && size >= size_min && size <= size_max;
+}
+
+
+static void
+attrib_pointer(struct gl_context *ctx, gl_vert_attrib attrib,
+               GLint size, GLenum type, GLsizei stride,
+               const void *pointer, bool integer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_vao *vao = &glthread->vao;
+
+   if (!is_valid_pointer(ctx, attrib, size, type, stride, integer)) {
+      /* Let the next draw find out what the call did, if anything. */
+      glthread->vertex_arrays_dirty = true;
+      return;
+   }
+
+   struct glthread_attrib *a = &vao->attribs[attrib];
+   const unsigned elem_size = element_size(size, type);
+
+   a->pointer = pointer;
+   a->element_size = elem_size;
+   a->stride = stride ? stride : elem_size;
+   a->buffer = glthread->array_buffer;
+
+   if (glthread->array_buffer)
+      vao->user_pointer_mask &= ~VERT_BIT(attrib);
+   else
+      vao->user_pointer_mask |= VERT_BIT(attrib);
+
+   /* The array is back on its own binding with no relative offset, but that
+    * binding may still have an instance divisor or other arrays attached.
+    */
+   vao->opaque_mask = (vao->opaque_mask & ~VERT_BIT(attrib)) |
+                      (vao->binding_opaque_mask & VERT_BIT(attrib));
+}
+
+
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx, gl_vert_attrib attrib,
+                             GLint size, GLenum type, GLsizei stride,
+                             const void *pointer)
+{
+   attrib_pointer(ctx, attrib, size, type, stride, pointer, false);
+}
+
+
+void
+_mesa_glthread_GenericAttribPointer(struct gl_context *ctx, GLuint index,
+                                    GLint size, GLenum type, GLsizei stride,
+                                    const void *pointer)
+{
+   if (index >= MAX_VERTEX_GENERIC_ATTRIBS) {
+      ctx->GLThread->vertex_arrays_dirty = true;
+      return;
+   }
+
+   attrib_pointer(ctx, VERT_ATTRIB_GENERIC(index), size, type, stride,
+                  pointer, false);
+}
+
+
+void
+_mesa_glthread_GenericAttribIPointer(struct gl_context *ctx, GLuint index,
+                                     GLint size, GLenum type, GLsizei stride,
+                                     const void *pointer)
+{
+   if (index >= MAX_VERTEX_GENERIC_ATTRIBS) {
+      ctx->GLThread->vertex_arrays_dirty = true;
+      return;
+   }
+
+   attrib_pointer(ctx, VERT_ATTRIB_GENERIC(index), size, type, stride,
+                  pointer, true);
+}
+
+
+void
+_mesa_glthread_TexCoordPointer(struct gl_context *ctx, GLint size,
+                               GLenum type, GLsizei stride,
+                               const void *pointer)
+{
+   const unsigned unit = ctx->GLThread->client_active_texture;
+
+   _mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_TEX(unit), size, type,
+                                stride, pointer);
+}
+
+
+static void
+set_enabled(struct glthread_vao *vao, gl_vert_attrib attrib, bool enable)
+{
+   if (enable)
+      vao->enabled |= VERT_BIT(attrib);
+   else
+      vao->enabled &= ~VERT_BIT(attrib);
+}
+
+
+void
+_mesa_glthread_ClientState(struct gl_context *ctx, GLenum array, bool enable)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   gl_vert_attrib attrib;
+
+   switch (array) {
+   case GL_VERTEX_ARRAY:
+      attrib = VERT_ATTRIB_POS;
+      break;
+   case GL_NORMAL_ARRAY:
+      attrib = VERT_ATTRIB_NORMAL;
+      break;
+   case GL_COLOR_ARRAY:
+      attrib = VERT_ATTRIB_COLOR0;
+      break;
+   case GL_INDEX_ARRAY:
+      attrib = VERT_ATTRIB_COLOR_INDEX;
+      break;
+   case GL_TEXTURE_COORD_ARRAY:
+      attrib = VERT_ATTRIB_TEX(glthread->client_active_texture);
+      break;
+   case GL_EDGE_FLAG_ARRAY:
+      attrib = VERT_ATTRIB_EDGEFLAG;
+      break;
+   case GL_FOG_COORDINATE_ARRAY_EXT:
+      attrib = VERT_ATTRIB_FOG;
+      break;
+   case GL_SECONDARY_COLOR_ARRAY_EXT:
+      attrib = VERT_ATTRIB_COLOR1;
+      break;
+   case GL_POINT_SIZE_ARRAY_OES:
+      attrib = VERT_ATTRIB_POINT_SIZE;
+      break;
+   case GL_PRIMITIVE_RESTART_NV:
+      glthread->primitive_restart = enable;
+      return;
+   default:
+      glthread->vertex_arrays_dirty = true;
+      return;
+   }
+
+   set_enabled(&glthread->vao, attrib, enable);
+}
+
+
+void
+_mesa_glthread_VertexAttribArray(struct gl_context *ctx, GLuint index,
+                                 bool enable)
+{
+   /* Out of range indices raise an error without changing anything. */
+   if (index >= MAX_VERTEX_GENERIC_ATTRIBS)
+      return;
+
+   set_enabled(&ctx->GLThread->vao, VERT_ATTRIB_GENERIC(index), enable);
+}
+
+
+void
+_mesa_glthread_ClientActiveTexture(struct gl_context *ctx, GLenum texture)
+{
+   const unsigned unit = texture - GL_TEXTURE0;
+
+   if (unit < ctx->Const.MaxTextureCoordUnits)
+      ctx->GLThread->client_active_texture = unit;
+}
+
+
+/** Tracks the current bindings for the vertex array and index array buffers.
+ *
+ * Note that GL core makes it so that a buffer binding with an invalid handle
+ * in the "buffer" parameter will throw an error, and then a
+ * glVertexAttribPointer() that follows might not end up pointing at a VBO.
+ * However, in GL core the draw call would throw an error as well, so we don't
+ * really care if our tracking is wrong for this case -- we never need to
+ * marshal user data for draw calls, and the unmarshal will just generate an
+ * error or not as appropriate.
+ *
+ * For compatibility GL, we do need to accurately know whether the draw call
+ * on the unmarshal side will dereference a user pointer or load data from a
+ * VBO per vertex.  That would make it seem like we need to track whether a
+ * "buffer" is valid, so that we can know when an error will be generated
+ * instead of updating the binding.  However, compat GL has the ridiculous
+ * feature that if you pass a bad name, it just gens a buffer object for you,
+ * so we escape without having to know if things are valid or not.
+ */
+void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   switch (target) {
+   case GL_ARRAY_BUFFER:
+      glthread->array_buffer = buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER:
+      /* The current element array buffer binding is actually tracked in the
+       * vertex array object instead of the context.  Compat contexts stop
+       * threading on glBindVertexArray(), so there is only one to follow.
+       */
+      glthread->element_array_buffer = buffer;
+      break;
+   }
+}
+
+
+/**
+ * Deleting a bound buffer unbinds it, which turns the arrays that sourced it
+ * into client memory arrays with nonsensical pointers.  Nobody should draw
+ * with those, but reload the tracked state rather than guess.
+ */
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   const struct glthread_vao *vao = &glthread->vao;
+
+   if (n < 0 || !buffers)
+      return;
+
+   for (GLsizei i = 0; i < n; i++) {
+      const GLuint name = buffers[i];
+
+      if (!name)
+         continue;
+
+      if (glthread->array_buffer == name)
+         glthread->array_buffer = 0;
+      if (glthread->element_array_buffer == name)
+         glthread->element_array_buffer = 0;
+
+      GLbitfield mask = ~vao->user_pointer_mask & VERT_BIT_ALL;
+      while (mask) {
+         const int attrib = u_bit_scan(&mask);
+
+         if (vao->attribs[attrib].buffer == name) {
+            glthread->vertex_arrays_dirty = true;
+            return;
+         }
+      }
+   }
+}
+
+
+static void
+set_primitive_restart(struct gl_context *ctx, GLenum cap, bool enable)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   switch (cap) {
+   case GL_PRIMITIVE_RESTART:
+   case GL_PRIMITIVE_RESTART_NV:
+      glthread->primitive_restart = enable;
+      break;
+   case GL_PRIMITIVE_RESTART_FIXED_INDEX:
+      glthread->primitive_restart_fixed_index = enable;
+      break;
+   }
+}
+
+
+void
+_mesa_glthread_Enable(struct gl_context *ctx, GLenum cap)
+{
+   set_primitive_restart(ctx, cap, true);
+   _mesa_glthread_shadow_cap(ctx, cap, true);
+}
+
+
+void
+_mesa_glthread_Disable(struct gl_context *ctx, GLenum cap)
+{
+   set_primitive_restart(ctx, cap, false);
+   _mesa_glthread_shadow_cap(ctx, cap, false);
+}
+
+
+void
+_mesa_glthread_PrimitiveRestartIndex(struct gl_context *ctx, GLuint index)
+{
+   ctx->GLThread->restart_index = index;
+}
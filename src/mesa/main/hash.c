@@ -4,6 +4,10 @@
  *
  * Used for display lists, texture objects, vertex/fragment programs,
  * buffer objects, etc.  The hash functions are thread-safe.
+ *
+ * Small keys are stored in a direct-indexed array that _mesa_HashLookup()
+ * reads without locking, see struct _mesa_HashDense.  Other keys are stored
+ * in a struct hash_table protected by the table mutex.
  * 
  * \note key=0 is illegal.
  *
@@ -38,6 +42,36 @@
 #include "glheader.h"
 #include "hash.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
+
+
+/* The lock-free lookup relies on p_atomic_set() publishing with release
+ * semantics and p_atomic_read() loading with acquire semantics, which only
+ * the __atomic builtins provide.  Everywhere else lookups take the mutex.
+ */
+#if defined(PIPE_ATOMIC_GCC_INTRINSIC) && defined(USE_GCC_ATOMIC_BUILTINS)
+#define HASH_LOCK_FREE_LOOKUP 1
+#else
+#define HASH_LOCK_FREE_LOOKUP 0
+#endif
+
+
+/**
+ * Allocate a direct-indexed array with all entries unused.
+ */
+static struct _mesa_HashDense *
+dense_create(GLuint size)
+{
+   struct _mesa_HashDense *dense =
+      calloc(1, sizeof(*dense) + size * sizeof(void *));
+
+   if (!dense)
+      return NULL;
+
+   dense->Size = size;
+   dense->Data = (void **) (dense + 1);
+   return dense;
+}
 
 
 /**
@@ -50,10 +84,15 @@ _mesa_NewHashTable(void)
 {
    struct _mesa_HashTable *table = CALLOC_STRUCT(_mesa_HashTable);
 
+   STATIC_ASSERT(DELETED_KEY_VALUE < HASH_DENSE_MIN_SIZE);
+
    if (table) {
       table->ht = _mesa_hash_table_create(NULL, uint_key_hash,
                                           uint_key_compare);
-      if (table->ht == NULL) {
+      table->Dense = dense_create(HASH_DENSE_MIN_SIZE);
+      if (table->ht == NULL || table->Dense == NULL) {
+         _mesa_hash_table_destroy(table->ht, NULL);
+         free(table->Dense);
          free(table);
          _mesa_error_no_memory(__func__);
          return NULL;
@@ -88,12 +127,19 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
    assert(table);
 
-   if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
+   if (table->DenseCount ||
+       _mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
       _mesa_problem(NULL, "In _mesa_DeleteHashTable, found non-freed data");
    }
 
    _mesa_hash_table_destroy(table->ht, NULL);
 
+   while (table->Dense) {
+      struct _mesa_HashDense *prev = table->Dense->Prev;
+      free(table->Dense);
+      table->Dense = prev;
+   }
+
    mtx_destroy(&table->Mutex);
    free(table);
 }
@@ -112,8 +158,8 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
    assert(table);
    assert(key);
 
-   if (key == DELETED_KEY_VALUE)
-      return table->deleted_key_data;
+   if (key < table->Dense->Size)
+      return table->Dense->Data[key];
 
    entry = _mesa_hash_table_search_pre_hashed(table->ht,
                                               uint_hash(key),
@@ -137,6 +183,19 @@ void *
 _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    void *res;
+
+   assert(key);
+
+#if HASH_LOCK_FREE_LOOKUP
+   /* Names from glGen*() take this path, and don't contend on the mutex
+    * when several contexts share the table.
+    */
+   const struct _mesa_HashDense *dense = p_atomic_read(&table->Dense);
+
+   if (likely(key < dense->Size))
+      return p_atomic_read(&dense->Data[key]);
+#endif
+
    _mesa_HashLockMutex(table);
    res = _mesa_HashLookup_unlocked(table, key);
    _mesa_HashUnlockMutex(table);
@@ -162,6 +221,55 @@ _mesa_HashLookupLocked(struct _mesa_HashTable *table, GLuint key)
 }
 
 
+/**
+ * Store a value in the direct-indexed array, keeping DenseCount up to date.
+ */
+static inline void
+dense_store(struct _mesa_HashTable *table, GLuint key, void *data)
+{
+   struct _mesa_HashDense *dense = table->Dense;
+
+   table->DenseCount += (data != NULL) - (dense->Data[key] != NULL);
+   p_atomic_set(&dense->Data[key], data);
+}
+
+
+/**
+ * Double the size of the direct-indexed array, moving the hash table entries
+ * it now covers into it.
+ *
+ * The new array is filled before being published, so that lock-free readers
+ * see either the old array or the complete new one.  Readers of keys being
+ * moved out of the hash table are blocked on the mutex meanwhile.
+ */
+static void
+dense_grow(struct _mesa_HashTable *table)
+{
+   struct _mesa_HashDense *old = table->Dense;
+   struct _mesa_HashDense *dense = dense_create(old->Size * 2);
+
+   /* Out of memory: the hash table keeps working. */
+   if (!dense)
+      return;
+
+   memcpy(dense->Data, old->Data, old->Size * sizeof(void *));
+
+   hash_table_foreach(table->ht, entry) {
+      const GLuint key = (uintptr_t) entry->key;
+
+      if (key < dense->Size) {
+         dense->Data[key] = entry->data;
+         if (entry->data)
+            table->DenseCount++;
+         _mesa_hash_table_remove(table->ht, entry);
+      }
+   }
+
+   dense->Prev = old;
+   p_atomic_set(&table->Dense, dense);
+}
+
+
 static inline void
 _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
 {
@@ -174,8 +282,13 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = data;
+   /* Grow the array when names keep being allocated right past its end. */
+   if (key >= table->Dense->Size && key < table->Dense->Size * 2 &&
+       key < HASH_DENSE_MAX_SIZE)
+      dense_grow(table);
+
+   if (key < table->Dense->Size) {
+      dense_store(table, key, data);
    } else {
       entry = _mesa_hash_table_search_pre_hashed(table->ht, hash, uint_key(key));
       if (entry) {
@@ -244,8 +357,8 @@ _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
     */
    assert(!table->InDeleteAll);
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = NULL;
+   if (key < table->Dense->Size) {
+      dense_store(table, key, NULL);
    } else {
       entry = _mesa_hash_table_search_pre_hashed(table->ht,
                                                  uint_hash(key),
@@ -286,14 +399,21 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
    assert(callback);
    _mesa_HashLockMutex(table);
    table->InDeleteAll = GL_TRUE;
+
+   for (GLuint key = 1;
+        key < MIN2(table->Dense->Size, table->MaxKey + 1); key++) {
+      void *data = table->Dense->Data[key];
+
+      if (data) {
+         callback(key, data, userData);
+         dense_store(table, key, NULL);
+      }
+   }
+
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
       _mesa_hash_table_remove(table->ht, entry);
    }
-   if (table->deleted_key_data) {
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
-      table->deleted_key_data = NULL;
-   }
    table->InDeleteAll = GL_FALSE;
    _mesa_HashUnlockMutex(table);
 }
@@ -314,11 +434,20 @@ hash_walk_unlocked(const struct _mesa_HashTable *table,
    assert(table);
    assert(callback);
 
+   /* The callback may remove entries, or insert some and grow the array,
+    * so look at the current array for every key.
+    */
+   for (GLuint key = 1;
+        key < MIN2(table->Dense->Size, table->MaxKey + 1); key++) {
+      void *data = table->Dense->Data[key];
+
+      if (data)
+         callback(key, data, userData);
+   }
+
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
    }
-   if (table->deleted_key_data)
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
 }
 
 
@@ -357,8 +486,6 @@ debug_print_entry(GLuint key, void *data, void *userData)
 void
 _mesa_HashPrint(const struct _mesa_HashTable *table)
 {
-   if (table->deleted_key_data)
-      debug_print_entry(DELETED_KEY_VALUE, table->deleted_key_data, NULL);
    _mesa_HashWalk(table, debug_print_entry, NULL);
 }
 
@@ -415,12 +542,5 @@ _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
 GLuint
 _mesa_HashNumEntries(const struct _mesa_HashTable *table)
 {
-   GLuint count = 0;
-
-   if (table->deleted_key_data)
-      count++;
-
-   count += _mesa_hash_table_num_entries(table->ht);
-
-   return count;
+   return table->DenseCount + _mesa_hash_table_num_entries(table->ht);
 }
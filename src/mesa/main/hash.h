@@ -36,6 +36,10 @@
 #include "imports.h"
 #include "c11/threads.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * Magic GLuint object name that gets stored outside of the struct hash_table.
  *
@@ -45,10 +49,21 @@
  * and we use a 1:1 mapping from GLuints to key pointers, so we need to be
  * able to track a GLuint that happens to match the deleted key outside of
  * struct hash_table.  We tell the hash table to use "1" as the deleted key
- * value, so that we test the deleted-key-in-the-table path as best we can.
+ * value, which always falls into the direct-indexed array below.
  */
 #define DELETED_KEY_VALUE 1
 
+/**
+ * Size bounds of the direct-indexed array holding small object names.
+ *
+ * glGen*() hands out contiguous names starting from 1, so most tables only
+ * ever contain keys a direct-indexed array can hold.  The array starts small
+ * and doubles whenever a key just past its end is inserted, up to the
+ * maximum.  Larger or sparse keys go to the hash table.
+ */
+#define HASH_DENSE_MIN_SIZE 64
+#define HASH_DENSE_MAX_SIZE (64 * 1024)
+
 /** @{
  * Mapping from our use of GLuint as both the key and the hash value to the
  * hash_table.h API
@@ -93,16 +108,31 @@ uint_key(GLuint id)
 }
 /** @} */
 
+/**
+ * Direct-indexed storage for the keys below Size.
+ *
+ * Lookups read the current array without taking the table mutex.  Writers
+ * hold the mutex, and growing the array publishes a new copy rather than
+ * reallocating in place.  Retired arrays are kept on the Prev list until the
+ * table is destroyed, since a lock-free reader may still be using them; the
+ * geometric growth bounds them to the size of the current one.
+ */
+struct _mesa_HashDense {
+   GLuint Size;
+   struct _mesa_HashDense *Prev;         /**< retired smaller array */
+   void **Data;                          /**< Size entries, NULL if unused */
+};
+
 /**
  * The hash table data structure.
  */
 struct _mesa_HashTable {
-   struct hash_table *ht;
+   struct hash_table *ht;                /**< keys >= Dense->Size */
+   struct _mesa_HashDense *Dense;        /**< keys < Dense->Size */
+   GLuint DenseCount;                    /**< used entries in Dense */
    GLuint MaxKey;                        /**< highest key inserted so far */
    mtx_t Mutex;                          /**< mutual exclusion lock */
    GLboolean InDeleteAll;                /**< Debug check */
-   /** Value that would be in the table for DELETED_KEY_VALUE. */
-   void *deleted_key_data;
 };
 
 extern struct _mesa_HashTable *_mesa_NewHashTable(void);
@@ -175,5 +205,8 @@ _mesa_HashNumEntries(const struct _mesa_HashTable *table);
 
 extern void _mesa_test_hash_functions(void);
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -66,32 +66,58 @@ _mesa_glthread_allocate_command(struct gl_context *ctx,
    next->used += aligned_size;
    cmd_base->cmd_id = cmd_id;
    cmd_base->cmd_size = aligned_size;
+   glthread->error_possible = true;
    return cmd_base;
 }
 
+void
+_mesa_glthread_update_vertex_arrays(struct gl_context *ctx);
+
 /**
- * Instead of conditionally handling marshaling previously-bound user vertex
- * array data in draw calls (deprecated and removed in GL core), we just
- * disable threading at the point where the user sets a user vertex array.
+ * Returns the mask of enabled vertex arrays sourcing client memory.
+ *
+ * In compat contexts the position array is not read when generic attribute 0
+ * is enabled, so it is left out of the mask: its pointer may well be stale.
+ */
+static inline GLbitfield
+_mesa_glthread_user_arrays(const struct gl_context *ctx)
+{
+   const struct glthread_vao *vao = &ctx->GLThread->vao;
+   GLbitfield enabled = vao->enabled;
+
+   if (enabled & VERT_BIT_GENERIC0)
+      enabled &= ~VERT_BIT_POS;
+
+   return enabled & vao->user_pointer_mask;
+}
+
+/**
+ * Returns whether a draw call would dereference client memory vertex arrays.
+ * Draws that can't copy the arrays themselves use this to fall back to
+ * synchronous execution.
  */
 static inline bool
-_mesa_glthread_is_non_vbo_vertex_attrib_pointer(const struct gl_context *ctx)
+_mesa_glthread_has_non_vbo_vertices(struct gl_context *ctx)
 {
-   struct glthread_state *glthread = ctx->GLThread;
+   if (ctx->API == API_OPENGL_CORE)
+      return false;
 
-   return ctx->API != API_OPENGL_CORE && !glthread->vertex_array_is_vbo;
+   _mesa_glthread_update_vertex_arrays(ctx);
+   return _mesa_glthread_user_arrays(ctx) != 0;
 }
 
 /**
- * Instead of conditionally handling marshaling immediate index data in draw
- * calls (deprecated and removed in GL core), we just disable threading.
+ * Like _mesa_glthread_has_non_vbo_vertices(), but also checks for indices
+ * in client memory.
  */
 static inline bool
-_mesa_glthread_is_non_vbo_draw_elements(const struct gl_context *ctx)
+_mesa_glthread_has_non_vbo_vertices_or_indices(struct gl_context *ctx)
 {
-   struct glthread_state *glthread = ctx->GLThread;
+   if (ctx->API == API_OPENGL_CORE)
+      return false;
 
-   return ctx->API != API_OPENGL_CORE && !glthread->element_array_is_vbo;
+   return !ctx->GLThread->element_array_buffer ||
+          _mesa_glthread_has_non_vbo_vertices(ctx);
 }
 
 #define DEBUG_MARSHAL_PRINT_CALLS 0
@@ -174,6 +200,87 @@ _mesa_glthread_is_compat_bind_vertex_array(const struct gl_context *ctx)
    return ctx->API != API_OPENGL_CORE;
 }
 
+void
+_mesa_glthread_invalidate_vertex_arrays(struct gl_context *ctx);
+
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx, gl_vert_attrib attrib,
+                             GLint size, GLenum type, GLsizei stride,
+                             const void *pointer);
+
+void
+_mesa_glthread_GenericAttribPointer(struct gl_context *ctx, GLuint index,
+                                    GLint size, GLenum type, GLsizei stride,
+                                    const void *pointer);
+
+void
+_mesa_glthread_GenericAttribIPointer(struct gl_context *ctx, GLuint index,
+                                     GLint size, GLenum type, GLsizei stride,
+                                     const void *pointer);
+
+void
+_mesa_glthread_TexCoordPointer(struct gl_context *ctx, GLint size,
+                               GLenum type, GLsizei stride,
+                               const void *pointer);
+
+void
+_mesa_glthread_ClientState(struct gl_context *ctx, GLenum array, bool enable);
+
+void
+_mesa_glthread_VertexAttribArray(struct gl_context *ctx, GLuint index,
+                                 bool enable);
+
+void
+_mesa_glthread_ClientActiveTexture(struct gl_context *ctx, GLenum texture);
+
+void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer);
+
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers);
+
+void
+_mesa_glthread_Enable(struct gl_context *ctx, GLenum cap);
+
+void
+_mesa_glthread_Disable(struct gl_context *ctx, GLenum cap);
+
+void
+_mesa_glthread_PrimitiveRestartIndex(struct gl_context *ctx, GLuint index);
+
+void
+_mesa_glthread_invalidate_shadow(struct gl_context *ctx);
+
+void
+_mesa_glthread_BeginEnd(struct gl_context *ctx, bool begin);
+
+void
+_mesa_glthread_shadow_cap(struct gl_context *ctx, GLenum cap, bool enable);
+
+void
+_mesa_glthread_Viewport(struct gl_context *ctx, GLint x, GLint y,
+                        GLsizei width, GLsizei height);
+
+void
+_mesa_glthread_Scissor(struct gl_context *ctx, GLint x, GLint y,
+                       GLsizei width, GLsizei height);
+
+void
+_mesa_glthread_MatrixMode(struct gl_context *ctx, GLenum mode);
+
+void
+_mesa_glthread_ActiveTexture(struct gl_context *ctx, GLenum texture);
+
+void
+_mesa_glthread_BindFramebuffer(struct gl_context *ctx, GLenum target,
+                               GLuint framebuffer);
+
+void
+_mesa_glthread_DeleteFramebuffers(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *framebuffers);
+
 struct marshal_cmd_Enable;
 struct marshal_cmd_ShaderSource;
 struct marshal_cmd_Flush;
@@ -187,6 +294,12 @@ struct marshal_cmd_ClearBuffer;
 #define marshal_cmd_ClearBufferiv   marshal_cmd_ClearBuffer
 #define marshal_cmd_ClearBufferuiv  marshal_cmd_ClearBuffer
 #define marshal_cmd_ClearBufferfi   marshal_cmd_ClearBuffer
+struct marshal_cmd_Draw;
+#define marshal_cmd_DrawArrays                  marshal_cmd_Draw
+#define marshal_cmd_DrawElements                marshal_cmd_Draw
+#define marshal_cmd_DrawRangeElements           marshal_cmd_Draw
+#define marshal_cmd_DrawElementsBaseVertex      marshal_cmd_Draw
+#define marshal_cmd_DrawRangeElementsBaseVertex marshal_cmd_Draw
 
 void
 _mesa_unmarshal_Enable(struct gl_context *ctx,
@@ -281,4 +394,58 @@ void GLAPIENTRY
 _mesa_marshal_ClearBufferfi(GLenum buffer, GLint drawbuffer,
                             const GLfloat depth, const GLint stencil);
 
+void
+_mesa_unmarshal_DrawArrays(struct gl_context *ctx,
+                           const struct marshal_cmd_Draw *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawArrays(GLenum mode, GLint first, GLsizei count);
+
+void
+_mesa_unmarshal_DrawElements(struct gl_context *ctx,
+                             const struct marshal_cmd_Draw *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawElements(GLenum mode, GLsizei count, GLenum type,
+                           const GLvoid *indices);
+
+void
+_mesa_unmarshal_DrawRangeElements(struct gl_context *ctx,
+                                  const struct marshal_cmd_Draw *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElements(GLenum mode, GLuint start, GLuint end,
+                                GLsizei count, GLenum type,
+                                const GLvoid *indices);
+
+void
+_mesa_unmarshal_DrawElementsBaseVertex(struct gl_context *ctx,
+                                       const struct marshal_cmd_Draw *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type,
+                                     const GLvoid *indices, GLint basevertex);
+
+void
+_mesa_unmarshal_DrawRangeElementsBaseVertex(struct gl_context *ctx,
+                                            const struct marshal_cmd_Draw *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElementsBaseVertex(GLenum mode, GLuint start,
+                                          GLuint end, GLsizei count,
+                                          GLenum type, const GLvoid *indices,
+                                          GLint basevertex);
+
+void GLAPIENTRY
+_mesa_marshal_GetIntegerv(GLenum pname, GLint *params);
+
+void GLAPIENTRY
+_mesa_marshal_GetBooleanv(GLenum pname, GLboolean *params);
+
+GLboolean GLAPIENTRY
+_mesa_marshal_IsEnabled(GLenum cap);
+
+GLenum GLAPIENTRY
+_mesa_marshal_GetError(void);
+
 #endif /* MARSHAL_H */
@@ -38,11 +38,21 @@
 #include "texstore.h"
 #include "image.h"
 #include "macros.h"
+#include "parallel_for.h"
+#include "sse_mipmap.h"
+#include "x86/common_x86_asm.h"
 #include "util/half_float.h"
 #include "util/format_rgb9e5.h"
 #include "util/format_r11g11b10f.h"
 
 
+/**
+ * Minimum number of bytes of destination texels that are generated by one
+ * thread, see downsample_rows().
+ */
+#define MIPMAP_MIN_BAND_SIZE (64 * 1024)
+
+
 /**
  * Compute the expected number of mipmap levels in the texture given
  * the width/height/depth of the base image and the GL_TEXTURE_BASE_LEVEL/
@@ -186,6 +196,13 @@ do_row(GLenum datatype, GLuint comps, GLint srcWidth,
    assert(srcWidth == dstWidth || srcWidth == 2 * dstWidth);
    */
 
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1 && srcWidth != dstWidth &&
+       _mesa_sse41_downsample_row(datatype, comps, srcRowA, srcRowB,
+                                  dstWidth, dstRow))
+      return;
+#endif
+
    if (datatype == GL_UNSIGNED_BYTE && comps == 4) {
       GLuint i, j, k;
       const GLubyte(*rowA)[4] = (const GLubyte(*)[4]) srcRowA;
@@ -1467,6 +1484,73 @@ make_1d_mipmap(GLenum datatype, GLuint comps, GLint border,
 }
 
 
+/**
+ * The rows of a 2D mipmap level, see downsample_rows().
+ */
+struct mipmap_rows {
+   GLenum datatype;
+   GLuint comps;
+   GLint srcWidth;
+   const GLubyte *srcA, *srcB;
+   GLint srcStep;
+   GLint dstWidth;
+   GLubyte *dst;
+   GLint dstRowStride;
+};
+
+
+static void
+do_rows(void *data, unsigned start, unsigned end)
+{
+   const struct mipmap_rows *rows = (const struct mipmap_rows *) data;
+   const GLubyte *srcA = rows->srcA + (GLint) start * rows->srcStep;
+   const GLubyte *srcB = rows->srcB + (GLint) start * rows->srcStep;
+   GLubyte *dst = rows->dst + (GLint) start * rows->dstRowStride;
+   unsigned row;
+
+   for (row = start; row < end; row++) {
+      do_row(rows->datatype, rows->comps, rows->srcWidth, srcA, srcB,
+             rows->dstWidth, dst);
+      srcA += rows->srcStep;
+      srcB += rows->srcStep;
+      dst += rows->dstRowStride;
+   }
+}
+
+
+/**
+ * Call do_row() for \p count destination rows, starting with source rows
+ * \p srcA and \p srcB and moving \p srcStep bytes down the source for each
+ * destination row.  Large images are split into bands of rows which are
+ * done in parallel.
+ */
+static void
+downsample_rows(GLenum datatype, GLuint comps,
+                GLint srcWidth, const GLubyte *srcA, const GLubyte *srcB,
+                GLint srcStep, GLint dstWidth, GLubyte *dst,
+                GLint dstRowStride, GLint count)
+{
+   const GLint rowSize = dstWidth * bytes_per_pixel(datatype, comps);
+   struct mipmap_rows rows;
+
+   if (count <= 0)
+      return;
+
+   rows.datatype = datatype;
+   rows.comps = comps;
+   rows.srcWidth = srcWidth;
+   rows.srcA = srcA;
+   rows.srcB = srcB;
+   rows.srcStep = srcStep;
+   rows.dstWidth = dstWidth;
+   rows.dst = dst;
+   rows.dstRowStride = dstRowStride;
+
+   _mesa_parallel_for(count, DIV_ROUND_UP(MIPMAP_MIN_BAND_SIZE, rowSize),
+                      do_rows, &rows);
+}
+
+
 static void
 make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
                GLint srcWidth, GLint srcHeight,
@@ -1497,13 +1581,9 @@ make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
 
    dst = dstPtr + border * ((dstWidth + 1) * bpt);
 
-   for (row = 0; row < dstHeightNB; row++) {
-      do_row(datatype, comps, srcWidthNB, srcA, srcB,
-             dstWidthNB, dst);
-      srcA += srcRowStep * srcRowStride;
-      srcB += srcRowStep * srcRowStride;
-      dst += dstRowStride;
-   }
+   downsample_rows(datatype, comps, srcWidthNB, srcA, srcB,
+                   srcRowStep * srcRowStride, dstWidthNB, dst, dstRowStride,
+                   dstHeightNB);
 
    /* This is ugly but probably won't be used much */
    if (border > 0) {
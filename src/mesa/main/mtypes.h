@@ -69,6 +69,7 @@ struct gl_list_extensions;
 struct gl_meta_state;
 struct gl_program_cache;
 struct gl_texture_object;
+struct gl_texture_upload;
 struct gl_debug_state;
 struct gl_context;
 struct st_context;
@@ -988,6 +989,9 @@ struct gl_texture_object
    bool StencilSampling;       /**< Should we sample stencil instead of depth? */
    bool HandleAllocated;       /**< GL_ARB_bindless_texture */
 
+   /** Number of asynchronous uploads not finished yet, see texstore_async.c */
+   GLuint _PendingUploads;
+
    /** GL_OES_EGL_image_external */
    GLubyte RequiredTextureImageUnits;
 
@@ -3794,6 +3798,11 @@ struct gl_constants
     */
    GLboolean AllowHigherCompatVersion;
 
+   /**
+    * Convert large glTex[Sub]Image uploads on a worker thread.
+    */
+   GLboolean AsyncTextureUpload;
+
    /**
     * Allow layout qualifiers on function parameters.
     */
@@ -5021,6 +5030,9 @@ struct gl_context
 
    struct gl_meta_state *Meta;  /**< for "meta" operations */
 
+   /** Asynchronous texture uploads not finished yet */
+   struct gl_texture_upload *TexUploads;
+
    /* GL_EXT_framebuffer_object */
    struct gl_renderbuffer *CurrentRenderbuffer;
 
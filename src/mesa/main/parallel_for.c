@@ -0,0 +1,130 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file parallel_for.c
+ * Splitting CPU-bound texture work (mipmap generation, texture compression)
+ * over the CPUs.
+ *
+ * The work is run by the calling thread and the threads of a queue shared
+ * by all contexts, which is created the first time it's needed.  The
+ * functions given to _mesa_parallel_for() must not use the queue
+ * themselves.
+ */
+
+#include "c11/threads.h"
+#include "util/macros.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_queue.h"
+
+#include "parallel_for.h"
+
+struct parallel_job {
+   struct util_queue_fence fence;
+   mesa_parallel_func func;
+   void *data;
+   unsigned start, end;
+};
+
+static struct util_queue parallel_queue;
+static once_flag parallel_queue_once = ONCE_FLAG_INIT;
+
+static void
+init_parallel_queue(void)
+{
+   unsigned num_threads;
+
+   util_cpu_detect();
+   num_threads = MIN2(util_cpu_caps.nr_cpus, MESA_PARALLEL_MAX_JOBS) - 1;
+
+   /* If this fails, or there's only one CPU, everything is done on the
+    * calling thread.
+    */
+   if (num_threads > 0) {
+      util_queue_init(&parallel_queue, "mesa_par", MESA_PARALLEL_MAX_JOBS * 2,
+                      num_threads, 0);
+   }
+}
+
+static void
+execute_job(void *data, int thread_index)
+{
+   struct parallel_job *job = (struct parallel_job *) data;
+
+   job->func(job->data, job->start, job->end);
+}
+
+/**
+ * Call \p func for ranges covering [0, \p count), in parallel.
+ *
+ * Each range has at least \p min_count items, so that small amounts of work
+ * don't pay for the hand-off to other threads.  Returns once all of them
+ * are done.
+ */
+void
+_mesa_parallel_for(unsigned count, unsigned min_count,
+                   mesa_parallel_func func, void *data)
+{
+   struct parallel_job jobs[MESA_PARALLEL_MAX_JOBS];
+   unsigned num_jobs, per_job, i;
+
+   if (count == 0)
+      return;
+
+   num_jobs = MIN2(count / MAX2(min_count, 1), MESA_PARALLEL_MAX_JOBS);
+
+   if (num_jobs > 1) {
+      call_once(&parallel_queue_once, init_parallel_queue);
+      if (util_queue_is_initialized(&parallel_queue))
+         num_jobs = MIN2(num_jobs, parallel_queue.num_threads + 1);
+      else
+         num_jobs = 1;
+   }
+
+   if (num_jobs <= 1) {
+      func(data, 0, count);
+      return;
+   }
+
+   per_job = DIV_ROUND_UP(count, num_jobs);
+   num_jobs = DIV_ROUND_UP(count, per_job);
+
+   /* The first range is done on this thread while the others are queued. */
+   for (i = 1; i < num_jobs; i++) {
+      jobs[i].func = func;
+      jobs[i].data = data;
+      jobs[i].start = i * per_job;
+      jobs[i].end = MIN2((i + 1) * per_job, count);
+
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(&parallel_queue, &jobs[i], &jobs[i].fence,
+                         execute_job, NULL);
+   }
+
+   func(data, 0, per_job);
+
+   for (i = 1; i < num_jobs; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
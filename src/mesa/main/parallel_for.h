@@ -0,0 +1,44 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum number of ranges _mesa_parallel_for() splits its work into. */
+#define MESA_PARALLEL_MAX_JOBS 8
+
+typedef void (*mesa_parallel_func)(void *data, unsigned start, unsigned end);
+
+void
+_mesa_parallel_for(unsigned count, unsigned min_count,
+                   mesa_parallel_func func, void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PARALLEL_FOR_H */
@@ -34,6 +34,7 @@
 #include "context.h"
 #include "texobj.h"
 #include "teximage.h"
+#include "texstore_async.h"
 #include "enums.h"
 
 /*
@@ -599,6 +600,9 @@ bind_image_texture(struct gl_context *ctx, struct gl_texture_object *texObj,
    FLUSH_VERTICES(ctx, 0);
    ctx->NewDriverState |= ctx->DriverFlags.NewImageUnits;
 
+   /* Binding image units doesn't go through the state validation. */
+   _mesa_wait_texture_uploads(ctx, texObj, NULL);
+
    set_image_binding(u, texObj, level, layered, layer, access, format);
 }
 
@@ -756,6 +760,7 @@ bind_image_textures(struct gl_context *ctx, GLuint first, GLuint count,
          }
 
          /* Update the texture binding */
+         _mesa_wait_texture_uploads(ctx, texObj, NULL);
          set_image_binding(u, texObj, 0,
                            _mesa_tex_target_is_layered(texObj->Target),
                            0, GL_READ_WRITE, tex_format);
@@ -0,0 +1,187 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file simd_format_utils.h
+ * Vector versions of the most common _mesa_swizzle_and_convert() cases, and
+ * the pieces they share.
+ *
+ * Each version returns true if it did the conversion, or false if the
+ * generic code in format_utils.c has to be used.  They only take four
+ * destination channels, 1 to 4 source channels and swizzles that don't
+ * read past the source channels; the channel moves are done with byte
+ * shuffles built by _mesa_build_swizzle_shuffle().
+ */
+
+#ifndef SIMD_FORMAT_UTILS_H
+#define SIMD_FORMAT_UTILS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "main/format_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool
+_mesa_sse41_swizzle_and_convert(void *void_dst,
+                                enum mesa_array_format_datatype dst_type,
+                                int num_dst_channels,
+                                const void *void_src,
+                                enum mesa_array_format_datatype src_type,
+                                int num_src_channels,
+                                const uint8_t swizzle[4], bool normalized,
+                                int count);
+
+bool
+_mesa_avx2_swizzle_and_convert(void *void_dst,
+                               enum mesa_array_format_datatype dst_type,
+                               int num_dst_channels,
+                               const void *void_src,
+                               enum mesa_array_format_datatype src_type,
+                               int num_src_channels,
+                               const uint8_t swizzle[4], bool normalized,
+                               int count);
+
+/**
+ * Whether the channel counts and swizzle are ones the vector versions take.
+ */
+static inline bool
+_mesa_simd_swizzle_supported(int num_dst_channels, int num_src_channels,
+                             const uint8_t swizzle[4])
+{
+   if (num_dst_channels != 4 ||
+       num_src_channels < 1 || num_src_channels > 4)
+      return false;
+
+   for (unsigned i = 0; i < 4; i++) {
+      if (swizzle[i] < 4 ? swizzle[i] >= num_src_channels
+                         : swizzle[i] == MESA_FORMAT_SWIZZLE_NONE)
+         return false;
+   }
+
+   return true;
+}
+
+/**
+ * Fill in the 16-byte shuffle control that moves destination channel i of
+ * each of the \p pixels pixels in a vector from source channel swizzle[i].
+ * Source and destination channels are \p src_size and \p dst_size bytes,
+ * with the source value zero-extended to the destination size.  Channels
+ * that are zero or one get 0x80 (zero) in the control, which both pshufb and
+ * tbl turn into zero; for those that are one, \p one_bits is or'ed into
+ * \p ones afterwards.
+ */
+static inline void
+_mesa_build_swizzle_shuffle(uint8_t shuffle[16], uint8_t ones[16],
+                            const uint8_t swizzle[4], int num_src_channels,
+                            unsigned src_size, unsigned dst_size,
+                            unsigned pixels, uint32_t one_bits)
+{
+   memset(shuffle, 0x80, 16);
+   memset(ones, 0, 16);
+
+   for (unsigned p = 0; p < pixels; p++) {
+      for (unsigned i = 0; i < 4; i++) {
+         uint8_t *dst = shuffle + (p * 4 + i) * dst_size;
+
+         if (swizzle[i] < 4) {
+            const unsigned src =
+               (p * num_src_channels + swizzle[i]) * src_size;
+
+            for (unsigned b = 0; b < src_size; b++)
+               dst[b] = src + b;
+         } else if (swizzle[i] == MESA_FORMAT_SWIZZLE_ONE) {
+            memcpy(ones + (p * 4 + i) * dst_size, &one_bits, dst_size);
+         }
+      }
+   }
+}
+
+/* Scalar versions of the kernels, for the pixels that don't fill a vector. */
+
+static inline void
+_mesa_swizzle_ubyte_tail(uint8_t *dst, const uint8_t *src,
+                         int num_src_channels, const uint8_t swizzle[4],
+                         uint8_t one, int count)
+{
+   for (int s = 0; s < count; s++) {
+      for (unsigned i = 0; i < 4; i++) {
+         if (swizzle[i] < 4)
+            dst[i] = src[swizzle[i]];
+         else
+            dst[i] = swizzle[i] == MESA_FORMAT_SWIZZLE_ONE ? one : 0;
+      }
+
+      src += num_src_channels;
+      dst += 4;
+   }
+}
+
+static inline void
+_mesa_unsigned_to_float_tail(float *dst, const uint8_t *src,
+                             unsigned src_size, int num_src_channels,
+                             const uint8_t swizzle[4], float scale, int count)
+{
+   for (int s = 0; s < count; s++) {
+      for (unsigned i = 0; i < 4; i++) {
+         if (swizzle[i] < 4) {
+            const unsigned value = src_size == 1 ?
+               src[swizzle[i]] : ((const uint16_t *) src)[swizzle[i]];
+
+            dst[i] = value * scale;
+         } else {
+            dst[i] = swizzle[i] == MESA_FORMAT_SWIZZLE_ONE ? 1.0f : 0.0f;
+         }
+      }
+
+      src += num_src_channels * src_size;
+      dst += 4;
+   }
+}
+
+static inline void
+_mesa_float_to_unorm8_tail(uint8_t *dst, const float *src,
+                           const uint8_t swizzle[4], int count)
+{
+   for (int s = 0; s < count; s++) {
+      for (unsigned i = 0; i < 4; i++) {
+         if (swizzle[i] < 4)
+            dst[i] = _mesa_float_to_unorm(src[swizzle[i]], 8);
+         else
+            dst[i] = swizzle[i] == MESA_FORMAT_SWIZZLE_ONE ? UINT8_MAX : 0;
+      }
+
+      src += 4;
+      dst += 4;
+   }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIMD_FORMAT_UTILS_H */
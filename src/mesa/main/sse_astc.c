@@ -0,0 +1,112 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file sse_astc.c
+ * SSE4.1 version of the endpoint interpolation of the ASTC decoder.
+ *
+ * Both 16-bit endpoints of a texel are expanded from the same 8-bit values,
+ * so the interpolation can be done on the 8-bit values with 16-bit
+ * arithmetic and expanded afterwards, with the same results as the 32-bit
+ * arithmetic of the specification.
+ */
+
+#include <smmintrin.h>
+#include <string.h>
+
+#include "main/sse_astc.h"
+
+static inline __m128i
+load_endpoints(const uint8_t endpoints[4][4], const uint8_t *partitions,
+               int i, bool pair)
+{
+   uint32_t e[2];
+
+   memcpy(&e[0], endpoints[partitions[i]], 4);
+   memcpy(&e[1], endpoints[partitions[i + pair]], 4);
+
+   return _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) e));
+}
+
+static inline uint64_t
+texel_weights(const uint8_t *weights0, const uint8_t *weights1,
+              int plane1_component, int i)
+{
+   uint64_t w = weights0[i] * 0x0001000100010001ull;
+
+   if (weights1) {
+      const int shift = plane1_component * 16;
+
+      w = (w & ~(0xffffull << shift)) | ((uint64_t) weights1[i] << shift);
+   }
+
+   return w;
+}
+
+/**
+ * Interpolate the endpoints of \p count texels of a block with their
+ * weights, giving the UNORM16 color of each texel.
+ *
+ * \param partitions  the partition of each texel
+ * \param weights1    the weights of the second plane, or NULL
+ * \param endpoints   the two 8-bit endpoints of each partition
+ */
+void
+_mesa_sse41_astc_interpolate(int count, const uint8_t *partitions,
+                             const uint8_t *weights0, const uint8_t *weights1,
+                             int plane1_component,
+                             const uint8_t endpoints[2][4][4], bool srgb,
+                             uint16_t *out)
+{
+   /* Two texels at a time, the last one possibly on its own. */
+   for (int i = 0; i < count; i += 2) {
+      const bool pair = i + 1 < count;
+      const __m128i e0 = load_endpoints(endpoints[0], partitions, i, pair);
+      const __m128i e1 = load_endpoints(endpoints[1], partitions, i, pair);
+      const __m128i w =
+         _mm_set_epi64x(texel_weights(weights0, weights1, plane1_component,
+                                      i + pair),
+                        texel_weights(weights0, weights1, plane1_component, i));
+
+      /* t = e0 * (64 - w) + e1 * w, at most 255 * 64. */
+      const __m128i t = _mm_add_epi16(_mm_slli_epi16(e0, 6),
+                                      _mm_mullo_epi16(_mm_sub_epi16(e1, e0), w));
+
+      /* For linear colors the endpoints are e * 257, which gives
+       * (257 * t + 32) >> 6 = 4 * t + ((t + 32) >> 6).  For sRGB they are
+       * e * 256 + 128, which gives 4 * t + 128.
+       */
+      __m128i c = _mm_slli_epi16(t, 2);
+      if (srgb) {
+         c = _mm_add_epi16(c, _mm_set1_epi16(128));
+      } else {
+         c = _mm_add_epi16(c, _mm_srli_epi16(_mm_add_epi16(t, _mm_set1_epi16(32)),
+                                             6));
+      }
+
+      if (pair)
+         _mm_storeu_si128((__m128i *) (out + i * 4), c);
+      else
+         _mm_storel_epi64((__m128i *) (out + i * 4), c);
+   }
+}
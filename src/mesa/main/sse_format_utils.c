@@ -0,0 +1,220 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file sse_format_utils.c
+ * SSE4.1 versions of the most common _mesa_swizzle_and_convert() cases:
+ * swizzling 8-bit channels (RGBA8 <-> BGRA8, RGB8 -> RGBX8, L8 -> RGBA8,
+ * ...), unpacking 8 and 16-bit channels to float, and packing float to
+ * normalized 8-bit channels.
+ *
+ * The results are bit-identical to the generic code in format_utils.c: the
+ * conversions use the same float operations, in the same order, and the
+ * pixels that don't fill a whole vector go through the same helpers.
+ * avx2_format_utils.c follows the same structure.
+ */
+
+#include <smmintrin.h>
+
+#include "main/simd_format_utils.h"
+
+static void
+swizzle_ubyte(uint8_t *dst, const uint8_t *src, int num_src_channels,
+              const uint8_t swizzle[4], uint8_t one, int count)
+{
+   uint8_t shuffle_bytes[16], ones_bytes[16];
+   int s = 0;
+
+   _mesa_build_swizzle_shuffle(shuffle_bytes, ones_bytes, swizzle,
+                               num_src_channels, 1, 1, 4, one);
+
+   const __m128i shuffle = _mm_loadu_si128((const __m128i *) shuffle_bytes);
+   const __m128i ones = _mm_loadu_si128((const __m128i *) ones_bytes);
+
+   /* Four pixels at a time, as long as a whole vector can be loaded. */
+   for (; (count - s) * num_src_channels >= 16; s += 4) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *) src);
+
+      pixels = _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), ones);
+      _mm_storeu_si128((__m128i *) dst, pixels);
+
+      src += 4 * num_src_channels;
+      dst += 16;
+   }
+
+   _mesa_swizzle_ubyte_tail(dst, src, num_src_channels, swizzle, one,
+                            count - s);
+}
+
+/**
+ * Convert 8 or 16-bit unsigned channels to float, multiplying them by
+ * \p scale (1 / MAX_UINT(bits) if normalized, 1 otherwise).
+ */
+static void
+unsigned_to_float(float *dst, const uint8_t *src, unsigned src_size,
+                  int num_src_channels, const uint8_t swizzle[4],
+                  float scale, int count)
+{
+   const unsigned pixels = 4 / src_size;
+   const union { float f; uint32_t u; } one = { 1.0f };
+   uint8_t shuffle_bytes[16], ones_bytes[16];
+   __m128i shuffle[4], ones[4];
+   int s = 0;
+
+   /* One control per destination pixel, each picking its channels out of
+    * the same loaded vector.
+    */
+   for (unsigned p = 0; p < pixels; p++) {
+      const unsigned offset = p * num_src_channels * src_size;
+
+      _mesa_build_swizzle_shuffle(shuffle_bytes, ones_bytes, swizzle,
+                                  num_src_channels, src_size, 4, 1, one.u);
+      for (unsigned b = 0; b < 16; b++) {
+         if (!(shuffle_bytes[b] & 0x80))
+            shuffle_bytes[b] += offset;
+      }
+
+      shuffle[p] = _mm_loadu_si128((const __m128i *) shuffle_bytes);
+      ones[p] = _mm_loadu_si128((const __m128i *) ones_bytes);
+   }
+
+   const __m128 scale4 = _mm_set1_ps(scale);
+
+   for (; (count - s) * num_src_channels * (int) src_size >= 16;
+        s += pixels) {
+      const __m128i data = _mm_loadu_si128((const __m128i *) src);
+
+      for (unsigned p = 0; p < pixels; p++) {
+         const __m128i ints = _mm_shuffle_epi8(data, shuffle[p]);
+         __m128 floats = _mm_mul_ps(_mm_cvtepi32_ps(ints), scale4);
+
+         /* Channels that are one are +0.0 at this point. */
+         floats = _mm_or_ps(floats, _mm_castsi128_ps(ones[p]));
+         _mm_storeu_ps(dst, floats);
+         dst += 4;
+      }
+
+      src += pixels * num_src_channels * src_size;
+   }
+
+   _mesa_unsigned_to_float_tail(dst, src, src_size, num_src_channels,
+                                swizzle, scale, count - s);
+}
+
+/**
+ * Convert four float channels to normalized 8-bit channels.
+ */
+static void
+float_to_unorm8(uint8_t *dst, const float *src, const uint8_t swizzle[4],
+                int count)
+{
+   uint8_t shuffle_bytes[16], ones_bytes[16];
+   int s = 0;
+
+   _mesa_build_swizzle_shuffle(shuffle_bytes, ones_bytes, swizzle, 4, 1, 1, 4,
+                               UINT8_MAX);
+
+   const __m128i shuffle = _mm_loadu_si128((const __m128i *) shuffle_bytes);
+   const __m128i ones = _mm_loadu_si128((const __m128i *) ones_bytes);
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1.0f);
+   const __m128 max = _mm_set1_ps(UINT8_MAX);
+
+   for (; s + 4 <= count; s += 4) {
+      __m128i ints[4];
+
+      for (unsigned p = 0; p < 4; p++) {
+         /* maxps returns its second operand for NaN, so NaN becomes 0 like
+          * in _mesa_float_to_unorm().  The conversion rounds to nearest
+          * even, like _mesa_lroundevenf().
+          */
+         __m128 f = _mm_max_ps(_mm_loadu_ps(src + p * 4), zero);
+         f = _mm_mul_ps(_mm_min_ps(f, one), max);
+         ints[p] = _mm_cvtps_epi32(f);
+      }
+
+      __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(ints[0], ints[1]),
+                                       _mm_packus_epi32(ints[2], ints[3]));
+      bytes = _mm_or_si128(_mm_shuffle_epi8(bytes, shuffle), ones);
+      _mm_storeu_si128((__m128i *) dst, bytes);
+
+      src += 16;
+      dst += 16;
+   }
+
+   _mesa_float_to_unorm8_tail(dst, src, swizzle, count - s);
+}
+
+/**
+ * Try to do a _mesa_swizzle_and_convert() operation with SSE4.1.
+ *
+ * \return  true if the operation was done, false if the generic version
+ *          has to be used.
+ */
+bool
+_mesa_sse41_swizzle_and_convert(void *void_dst,
+                                enum mesa_array_format_datatype dst_type,
+                                int num_dst_channels,
+                                const void *void_src,
+                                enum mesa_array_format_datatype src_type,
+                                int num_src_channels,
+                                const uint8_t swizzle[4], bool normalized,
+                                int count)
+{
+   if (!_mesa_simd_swizzle_supported(num_dst_channels, num_src_channels,
+                                     swizzle))
+      return false;
+
+   switch (dst_type) {
+   case MESA_ARRAY_FORMAT_TYPE_UBYTE:
+      if (src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE) {
+         swizzle_ubyte(void_dst, void_src, num_src_channels, swizzle,
+                       normalized ? UINT8_MAX : 1, count);
+         return true;
+      }
+      if (src_type == MESA_ARRAY_FORMAT_TYPE_FLOAT && normalized &&
+          num_src_channels == 4) {
+         float_to_unorm8(void_dst, void_src, swizzle, count);
+         return true;
+      }
+      return false;
+
+   case MESA_ARRAY_FORMAT_TYPE_FLOAT:
+      if (src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE) {
+         unsigned_to_float(void_dst, void_src, 1, num_src_channels, swizzle,
+                           normalized ? 1.0f / (float) MAX_UINT(8) : 1.0f,
+                           count);
+         return true;
+      }
+      if (src_type == MESA_ARRAY_FORMAT_TYPE_USHORT) {
+         unsigned_to_float(void_dst, void_src, 2, num_src_channels, swizzle,
+                           normalized ? 1.0f / (float) MAX_UINT(16) : 1.0f,
+                           count);
+         return true;
+      }
+      return false;
+
+   default:
+      return false;
+   }
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file sse_mipmap.c
+ * SSE4.1 versions of the 2x2 box filter used by mipmap.c for the common
+ * 8-bit and float formats.
+ *
+ * These produce exactly the same results as do_row() in mipmap.c: the
+ * integer sums are exact and the float sums are done in the same order.
+ */
+
+#include <smmintrin.h>
+
+#include "main/sse_mipmap.h"
+
+static void
+downsample_ubyte4(const GLubyte *rowA, const GLubyte *rowB,
+                  GLint dstWidth, GLubyte *dst)
+{
+   const __m128i zero = _mm_setzero_si128();
+   GLint i = 0;
+
+   for (; i + 4 <= dstWidth; i += 4) {
+      __m128i sums[2];
+
+      for (unsigned h = 0; h < 2; h++) {
+         const __m128i a = _mm_loadu_si128((const __m128i *) rowA + h);
+         const __m128i b = _mm_loadu_si128((const __m128i *) rowB + h);
+
+         /* Source pixels 0, 1 and 2, 3 of the vector, with 16-bit channels
+          * and the two rows added.
+          */
+         const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                          _mm_unpacklo_epi8(b, zero));
+         const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                          _mm_unpackhi_epi8(b, zero));
+
+         sums[h] = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi),
+                                 _mm_unpackhi_epi64(lo, hi));
+      }
+
+      _mm_storeu_si128((__m128i *) dst,
+                       _mm_packus_epi16(_mm_srli_epi16(sums[0], 2),
+                                        _mm_srli_epi16(sums[1], 2)));
+
+      rowA += 32;
+      rowB += 32;
+      dst += 16;
+   }
+
+   for (; i < dstWidth; i++) {
+      for (unsigned c = 0; c < 4; c++)
+         dst[c] = (rowA[c] + rowA[4 + c] + rowB[c] + rowB[4 + c]) / 4;
+
+      rowA += 8;
+      rowB += 8;
+      dst += 4;
+   }
+}
+
+static void
+downsample_ubyte1(const GLubyte *rowA, const GLubyte *rowB,
+                  GLint dstWidth, GLubyte *dst)
+{
+   const __m128i ones = _mm_set1_epi8(1);
+   GLint i = 0;
+
+   for (; i + 16 <= dstWidth; i += 16) {
+      __m128i sums[2];
+
+      for (unsigned h = 0; h < 2; h++) {
+         const __m128i a = _mm_loadu_si128((const __m128i *) rowA + h);
+         const __m128i b = _mm_loadu_si128((const __m128i *) rowB + h);
+
+         /* pmaddubsw adds each pair of neighbouring bytes. */
+         sums[h] = _mm_add_epi16(_mm_maddubs_epi16(a, ones),
+                                 _mm_maddubs_epi16(b, ones));
+      }
+
+      _mm_storeu_si128((__m128i *) dst,
+                       _mm_packus_epi16(_mm_srli_epi16(sums[0], 2),
+                                        _mm_srli_epi16(sums[1], 2)));
+
+      rowA += 32;
+      rowB += 32;
+      dst += 16;
+   }
+
+   for (; i < dstWidth; i++) {
+      *dst++ = (rowA[0] + rowA[1] + rowB[0] + rowB[1]) >> 2;
+      rowA += 2;
+      rowB += 2;
+   }
+}
+
+static void
+downsample_float4(const GLfloat *rowA, const GLfloat *rowB,
+                  GLint dstWidth, GLfloat *dst)
+{
+   const __m128 quarter = _mm_set1_ps(0.25F);
+
+   for (GLint i = 0; i < dstWidth; i++) {
+      __m128 sum = _mm_add_ps(_mm_loadu_ps(rowA), _mm_loadu_ps(rowA + 4));
+      sum = _mm_add_ps(sum, _mm_loadu_ps(rowB));
+      sum = _mm_add_ps(sum, _mm_loadu_ps(rowB + 4));
+      _mm_storeu_ps(dst, _mm_mul_ps(sum, quarter));
+
+      rowA += 8;
+      rowB += 8;
+      dst += 4;
+   }
+}
+
+static void
+downsample_float1(const GLfloat *rowA, const GLfloat *rowB,
+                  GLint dstWidth, GLfloat *dst)
+{
+   const __m128 quarter = _mm_set1_ps(0.25F);
+   GLint i = 0;
+
+   for (; i + 4 <= dstWidth; i += 4) {
+      const __m128 a0 = _mm_loadu_ps(rowA), a1 = _mm_loadu_ps(rowA + 4);
+      const __m128 b0 = _mm_loadu_ps(rowB), b1 = _mm_loadu_ps(rowB + 4);
+
+      /* Split the even and odd source pixels. */
+      __m128 sum = _mm_add_ps(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)),
+                              _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)));
+      sum = _mm_add_ps(sum, _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+      sum = _mm_add_ps(sum, _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+      _mm_storeu_ps(dst, _mm_mul_ps(sum, quarter));
+
+      rowA += 8;
+      rowB += 8;
+      dst += 4;
+   }
+
+   for (; i < dstWidth; i++) {
+      *dst++ = (rowA[0] + rowA[1] + rowB[0] + rowB[1]) * 0.25F;
+      rowA += 2;
+      rowB += 2;
+   }
+}
+
+/**
+ * Average two source rows into a destination row half as wide, for the
+ * formats that have an SSE4.1 version.
+ *
+ * \return  true if the row was done, false if the generic version has to
+ *          be used.
+ */
+bool
+_mesa_sse41_downsample_row(GLenum datatype, GLuint comps,
+                           const void *srcRowA, const void *srcRowB,
+                           GLint dstWidth, void *dstRow)
+{
+   switch (datatype) {
+   case GL_UNSIGNED_BYTE:
+      if (comps == 4) {
+         downsample_ubyte4(srcRowA, srcRowB, dstWidth, dstRow);
+         return true;
+      }
+      if (comps == 1) {
+         downsample_ubyte1(srcRowA, srcRowB, dstWidth, dstRow);
+         return true;
+      }
+      return false;
+
+   case GL_FLOAT:
+      if (comps == 4) {
+         downsample_float4(srcRowA, srcRowB, dstWidth, dstRow);
+         return true;
+      }
+      if (comps == 1) {
+         downsample_float1(srcRowA, srcRowB, dstWidth, dstRow);
+         return true;
+      }
+      return false;
+
+   default:
+      return false;
+   }
+}
@@ -50,6 +50,7 @@
 #include "texenvprogram.h"
 #include "texobj.h"
 #include "texstate.h"
+#include "texstore_async.h"
 #include "varray.h"
 #include "vbo/vbo.h"
 #include "viewport.h"
@@ -369,6 +370,10 @@ _mesa_update_state_locked( struct gl_context *ctx )
    }
 
  out:
+   /* The textures that the next command may access must be uploaded. */
+   if (ctx->TexUploads)
+      _mesa_finish_bound_texture_uploads(ctx);
+
    new_prog_state |= update_program_constants(ctx);
 
    ctx->NewState |= new_prog_state;
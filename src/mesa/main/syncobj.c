@@ -66,6 +66,7 @@
 #include "util/set.h"
 
 #include "syncobj.h"
+#include "texstore_async.h"
 
 static struct gl_sync_object *
 _mesa_new_sync_object(struct gl_context *ctx)
@@ -289,6 +290,9 @@ fence_sync(struct gl_context *ctx, GLenum condition, GLbitfield flags)
       syncObj->Flags = flags;
       syncObj->StatusFlag = 0;
 
+      /* The fence must cover the uploads of the earlier commands too. */
+      _mesa_finish_all_texture_uploads(ctx);
+
       ctx->Driver.FenceSync(ctx, syncObj, condition, flags);
 
       simple_mtx_lock(&ctx->Shared->Mutex);
@@ -0,0 +1,280 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "main/formats.h"
+#include "main/sse_astc.h"
+#include "main/texcompress_astc.h"
+#include "util/half_float.h"
+#include "util/macros.h"
+
+#include "test_random.h"
+
+/**
+ * Tests and benchmark for the ASTC decoder.
+ *
+ * Images made of random valid blocks are decoded at once, which splits them
+ * into bands decoded on several threads, and compared with the blocks
+ * decoded one at a time.  The images are also checked against hashes of
+ * what the decoder gave before it decoded whole blocks at a time, so that
+ * the output stays bit-exact with it.  The speed of each block footprint is
+ * printed.
+ */
+
+#define BLOCKS 64
+
+/** 32-bit FNV-1a hash of the decoded texels. */
+static uint32_t
+hash_texels(const std::vector<uint8_t> &texels)
+{
+   uint32_t hash = 2166136261u;
+
+   for (unsigned i = 0; i < texels.size(); i++)
+      hash = (hash ^ texels[i]) * 16777619u;
+
+   return hash;
+}
+
+/** Decode a single block, which doesn't use the other threads. */
+static void
+decode_block(const uint8_t *block, unsigned blk_w, unsigned blk_h,
+             mesa_format format, uint8_t *texels)
+{
+   _mesa_unpack_astc_2d_ldr(texels, blk_w * 4, block, 16, blk_w, blk_h,
+                            format);
+}
+
+/**
+ * Make random blocks and keep the ones that don't decode to the error
+ * color, which gives a mix of partition counts, weight ranges and endpoint
+ * modes.
+ */
+static std::vector<uint8_t>
+make_valid_blocks(mesa_format format, unsigned count)
+{
+   static const uint8_t error_color[4] = { 0xff, 0, 0xff, 0xff };
+   unsigned blk_w, blk_h;
+   std::vector<uint8_t> blocks;
+   uint32_t state = 1;
+
+   _mesa_get_format_block_size(format, &blk_w, &blk_h);
+   std::vector<uint8_t> texels(blk_w * blk_h * 4);
+
+   while (blocks.size() < count * 16) {
+      uint8_t block[16];
+
+      for (unsigned i = 0; i < 16; i++)
+         block[i] = next_random(&state);
+
+      decode_block(block, blk_w, blk_h, format, texels.data());
+
+      if (memcmp(texels.data(), error_color, 4) != 0)
+         blocks.insert(blocks.end(), block, block + 16);
+   }
+
+   return blocks;
+}
+
+TEST(AstcDecode, Footprints)
+{
+   static const struct {
+      mesa_format format;
+      /* Hash of the image decoded by the previous decoder */
+      uint32_t hash;
+   } formats[] = {
+      { MESA_FORMAT_RGBA_ASTC_4x4, 0x22c02107 },
+      { MESA_FORMAT_RGBA_ASTC_5x5, 0x249392d5 },
+      { MESA_FORMAT_RGBA_ASTC_6x6, 0x31749f82 },
+      { MESA_FORMAT_RGBA_ASTC_8x5, 0x010d9cf9 },
+      { MESA_FORMAT_RGBA_ASTC_8x8, 0x90101627 },
+      { MESA_FORMAT_RGBA_ASTC_10x10, 0xfaa80963 },
+      { MESA_FORMAT_RGBA_ASTC_12x12, 0xe0328a11 },
+      { MESA_FORMAT_SRGB8_ALPHA8_ASTC_4x4, 0x8197a293 },
+      { MESA_FORMAT_SRGB8_ALPHA8_ASTC_8x8, 0x7726d4d0 },
+   };
+
+   for (unsigned f = 0; f < ARRAY_SIZE(formats); f++) {
+      const mesa_format format = formats[f].format;
+      const std::vector<uint8_t> valid = make_valid_blocks(format, 61);
+      unsigned blk_w, blk_h;
+
+      _mesa_get_format_block_size(format, &blk_w, &blk_h);
+
+      /* The last row and column of blocks are only partially covered. */
+      const unsigned width = BLOCKS * blk_w - 1;
+      const unsigned height = BLOCKS * blk_h - 3;
+      std::vector<uint8_t> blocks(BLOCKS * BLOCKS * 16);
+      std::vector<uint8_t> image(width * height * 4);
+      std::vector<uint8_t> texels(blk_w * blk_h * 4);
+
+      for (unsigned i = 0; i < BLOCKS * BLOCKS; i++)
+         memcpy(&blocks[i * 16], &valid[(i % 61) * 16], 16);
+
+      const auto start = std::chrono::steady_clock::now();
+      _mesa_unpack_astc_2d_ldr(image.data(), width * 4, blocks.data(),
+                               BLOCKS * 16, width, height, format);
+      const std::chrono::duration<double> time =
+         std::chrono::steady_clock::now() - start;
+
+      printf("%-36s %8.1f Mtexels/s\n", _mesa_get_format_name(format),
+             width * height / time.count() / 1e6);
+
+      EXPECT_EQ(formats[f].hash, hash_texels(image))
+         << _mesa_get_format_name(format);
+
+      for (unsigned by = 0; by < BLOCKS; by++) {
+         for (unsigned bx = 0; bx < BLOCKS; bx++) {
+            decode_block(&blocks[(by * BLOCKS + bx) * 16], blk_w, blk_h,
+                         format, texels.data());
+
+            for (unsigned y = 0; y < blk_h && by * blk_h + y < height; y++) {
+               const unsigned w = MIN2(blk_w, width - bx * blk_w);
+
+               ASSERT_EQ(0, memcmp(&image[((by * blk_h + y) * width +
+                                           bx * blk_w) * 4],
+                                   &texels[y * blk_w * 4], w * 4))
+                  << _mesa_get_format_name(format) << " block "
+                  << bx << ", " << by << " row " << y;
+            }
+         }
+      }
+   }
+}
+
+TEST(AstcDecode, Reference)
+{
+   /* A two-partition block, and what the previous decoder gave for it. */
+   static const uint8_t block[16] = {
+      0x32, 0xf0, 0x52, 0x0c, 0x97, 0x67, 0xc8, 0xf3,
+      0xb8, 0xbd, 0x28, 0x4e, 0xa2, 0x0c, 0x5f, 0x98,
+   };
+   static const uint8_t rgba[4 * 4 * 4] = {
+      0x69, 0x34, 0xcd, 0xff, 0x7a, 0x3d, 0xee, 0xff,
+      0x61, 0x30, 0xbd, 0xff, 0x6c, 0xb3, 0xff, 0xff,
+      0x6f, 0x37, 0xd9, 0xff, 0x7a, 0x3d, 0xee, 0xff,
+      0x72, 0x39, 0xdf, 0xff, 0x4c, 0x7e, 0xb4, 0xff,
+      0x72, 0x38, 0xde, 0xff, 0x75, 0x3a, 0xe4, 0xff,
+      0x75, 0x3a, 0xe4, 0xff, 0x42, 0x6c, 0x9a, 0xff,
+      0x72, 0x38, 0xde, 0xff, 0x69, 0x34, 0xcd, 0xff,
+      0x69, 0x34, 0xcd, 0xff, 0x49, 0x79, 0xad, 0xff,
+   };
+   static const uint8_t srgb[4 * 4 * 4] = {
+      0x6a, 0x34, 0xce, 0xff, 0x7b, 0x3d, 0xef, 0xff,
+      0x61, 0x30, 0xbd, 0xff, 0x6c, 0xb3, 0xff, 0xff,
+      0x6f, 0x37, 0xd9, 0xff, 0x7b, 0x3d, 0xef, 0xff,
+      0x73, 0x39, 0xdf, 0xff, 0x4c, 0x7e, 0xb4, 0xff,
+      0x72, 0x39, 0xde, 0xff, 0x75, 0x3a, 0xe4, 0xff,
+      0x75, 0x3a, 0xe4, 0xff, 0x42, 0x6c, 0x9b, 0xff,
+      0x72, 0x39, 0xde, 0xff, 0x6a, 0x34, 0xce, 0xff,
+      0x6a, 0x34, 0xce, 0xff, 0x4a, 0x79, 0xad, 0xff,
+   };
+   uint8_t texels[4 * 4 * 4];
+
+   decode_block(block, 4, 4, MESA_FORMAT_RGBA_ASTC_4x4, texels);
+   for (unsigned i = 0; i < ARRAY_SIZE(texels); i++)
+      EXPECT_EQ(rgba[i], texels[i]) << "byte " << i;
+
+   decode_block(block, 4, 4, MESA_FORMAT_SRGB8_ALPHA8_ASTC_4x4, texels);
+   for (unsigned i = 0; i < ARRAY_SIZE(texels); i++)
+      EXPECT_EQ(srgb[i], texels[i]) << "byte " << i;
+}
+
+TEST(AstcDecode, VoidExtent)
+{
+   static const uint16_t colors[][4] = {
+      { 0x0000, 0x0001, 0x00ff, 0x0100 },
+      { 0x7fff, 0x8000, 0x8080, 0xfeff },
+      { 0xff00, 0xff7f, 0xfffe, 0xffff },
+   };
+
+   for (unsigned i = 0; i < ARRAY_SIZE(colors); i++) {
+      /* Block mode of a void-extent block, LDR, without extent. */
+      uint8_t block[16] = { 0xfc, 0xfd, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+      uint8_t texels[4 * 4 * 4];
+
+      memcpy(block + 8, colors[i], 8);
+      decode_block(block, 4, 4, MESA_FORMAT_RGBA_ASTC_4x4, texels);
+
+      for (unsigned t = 0; t < 4 * 4; t++) {
+         for (unsigned c = 0; c < 4; c++) {
+            const uint16_t v = colors[i][c];
+
+            EXPECT_EQ(_mesa_half_to_unorm8(_mesa_uint16_div_64k_to_half(v)),
+                      texels[t * 4 + c]) << "value " << v;
+         }
+      }
+   }
+}
+
+TEST(AstcDecode, Interpolate)
+{
+#if defined(USE_SSE41) && defined(__GNUC__)
+   if (!__builtin_cpu_supports("sse4.1"))
+      return;
+
+   uint32_t state = 1;
+
+   for (unsigned iter = 0; iter < 1000; iter++) {
+      const int count = 1 + next_random(&state) % 144;
+      const bool dual_plane = next_random(&state) & 1;
+      const bool srgb = next_random(&state) & 1;
+      const int plane1_component = next_random(&state) % 4;
+      uint8_t partitions[144], weights[2][144], endpoints[2][4][4];
+      uint16_t colors[145 * 4];
+
+      for (int i = 0; i < count; i++) {
+         partitions[i] = next_random(&state) % 4;
+         weights[0][i] = next_random(&state) % 65;
+         weights[1][i] = next_random(&state) % 65;
+      }
+      for (unsigned i = 0; i < sizeof(endpoints); i++)
+         (&endpoints[0][0][0])[i] = next_random(&state);
+
+      memset(colors, 0xcd, sizeof(colors));
+      _mesa_sse41_astc_interpolate(count, partitions, weights[0],
+                                   dual_plane ? weights[1] : NULL,
+                                   plane1_component, endpoints, srgb, colors);
+
+      for (int i = 0; i < count; i++) {
+         for (int c = 0; c < 4; c++) {
+            const uint8_t e0 = endpoints[0][partitions[i]][c];
+            const uint8_t e1 = endpoints[1][partitions[i]][c];
+            const int c0 = srgb ? (e0 << 8) | 0x80 : (e0 << 8) | e0;
+            const int c1 = srgb ? (e1 << 8) | 0x80 : (e1 << 8) | e1;
+            const int w = weights[dual_plane && c == plane1_component][i];
+
+            ASSERT_EQ((c0 * (64 - w) + c1 * w + 32) >> 6, colors[i * 4 + c])
+               << "texel " << i << " channel " << c;
+         }
+      }
+
+      /* Nothing past the last texel may be written. */
+      EXPECT_EQ(0xcdcd, colors[count * 4]);
+   }
+#endif
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "main/texcompress_bptc.h"
+#include "util/macros.h"
+
+#include "test_random.h"
+
+/**
+ * Tests and benchmark for the BPTC_RGBA_UNORM encoder.
+ *
+ * Each test image is compressed at every GL_TEXTURE_COMPRESSION_HINT
+ * setting and decompressed with the texture fetch function.  The PSNR and
+ * the speed of each setting are printed, so that changes to the encoder
+ * can be compared, and the PSNR is checked against a minimum.
+ */
+
+#define SIZE 256
+
+static uint8_t
+to_ubyte(float value)
+{
+   return (uint8_t) (CLAMP(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+/** Smooth gradients in every channel. */
+static void
+make_gradient(std::vector<uint8_t> &image, int width, int height)
+{
+   for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+         uint8_t *texel = &image[(y * width + x) * 4];
+
+         texel[0] = x * 255 / (width - 1);
+         texel[1] = y * 255 / (height - 1);
+         texel[2] = (x + y) * 255 / (width + height - 2);
+         texel[3] = 255 - x * 255 / (width - 1);
+      }
+   }
+}
+
+/** Something like a photograph: low frequencies with a little noise. */
+static void
+make_natural(std::vector<uint8_t> &image, int width, int height)
+{
+   uint32_t state = 1;
+
+   for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+         uint8_t *texel = &image[(y * width + x) * 4];
+         const float u = x / (float) width, v = y / (float) height;
+         const float noise = (next_random(&state) % 16) / 255.0f;
+
+         texel[0] = to_ubyte(0.5f + 0.4f * sinf(u * 9.0f + v * 3.0f) + noise);
+         texel[1] = to_ubyte(0.4f + 0.3f * cosf(v * 7.0f - u * 2.0f) + noise);
+         texel[2] = to_ubyte(0.3f + 0.3f * sinf((u + v) * 5.0f) + noise);
+         texel[3] = 255;
+      }
+   }
+}
+
+/** Hard-edged shapes with alpha, like a UI texture or a sprite. */
+static void
+make_cutout(std::vector<uint8_t> &image, int width, int height)
+{
+   for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+         uint8_t *texel = &image[(y * width + x) * 4];
+         const int dx = x % 32 - 16, dy = y % 32 - 16;
+         const bool inside = dx * dx + dy * dy < 100;
+
+         texel[0] = inside ? 240 : 20;
+         texel[1] = inside ? 180 : 40;
+         texel[2] = (x / 32 + y / 32) * 16;
+         texel[3] = inside ? 255 : 0;
+      }
+   }
+}
+
+static double
+compress_and_measure(const std::vector<uint8_t> &image, int width, int height,
+                     GLenum hint, double *mb_per_s)
+{
+   const int block_rowstride = (width + 3) / 4 * 16;
+   std::vector<uint8_t> blocks(block_rowstride * ((height + 3) / 4));
+   const compressed_fetch_func fetch =
+      _mesa_get_bptc_fetch_func(MESA_FORMAT_BPTC_RGBA_UNORM);
+   double squared_error = 0.0;
+
+   const auto start = std::chrono::steady_clock::now();
+   _mesa_bptc_compress_rgba_unorm(width, height, image.data(), width * 4,
+                                  blocks.data(), block_rowstride, hint);
+   const std::chrono::duration<double> time =
+      std::chrono::steady_clock::now() - start;
+
+   *mb_per_s = image.size() / time.count() / (1024.0 * 1024.0);
+
+   for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+         float texel[4];
+
+         fetch(blocks.data(), width, x, y, texel);
+
+         for (int c = 0; c < 4; c++) {
+            const double diff = to_ubyte(texel[c]) - image[(y * width + x) * 4 + c];
+            squared_error += diff * diff;
+         }
+      }
+   }
+
+   if (squared_error == 0.0)
+      return INFINITY;
+
+   return 10.0 * log10(255.0 * 255.0 / (squared_error / image.size()));
+}
+
+TEST(BptcCompress, Quality)
+{
+   static const struct {
+      const char *name;
+      void (*make)(std::vector<uint8_t> &image, int width, int height);
+      /* Minimum PSNR for GL_FASTEST, GL_DONT_CARE and GL_NICEST */
+      double min_psnr[3];
+   } images[] = {
+      { "gradient", make_gradient, { 36.0, 36.0, 48.0 } },
+      { "natural", make_natural, { 34.0, 34.0, 42.0 } },
+      { "cutout", make_cutout, { 34.0, 34.0, 55.0 } },
+   };
+   static const GLenum hints[] = { GL_FASTEST, GL_DONT_CARE, GL_NICEST };
+   static const char *const hint_names[] = { "fastest", "dont_care", "nicest" };
+   std::vector<uint8_t> image(SIZE * SIZE * 4);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(images); i++) {
+      double psnr[ARRAY_SIZE(hints)];
+
+      images[i].make(image, SIZE, SIZE);
+
+      for (unsigned h = 0; h < ARRAY_SIZE(hints); h++) {
+         double mb_per_s;
+
+         psnr[h] = compress_and_measure(image, SIZE, SIZE, hints[h],
+                                        &mb_per_s);
+         printf("%-10s %-10s %8.1f MB/s %6.2f dB\n", images[i].name,
+                hint_names[h], mb_per_s, psnr[h]);
+
+         EXPECT_LE(images[i].min_psnr[h], psnr[h])
+            << images[i].name << " " << hint_names[h];
+      }
+
+      /* Only GL_NICEST selects the slower encoder. */
+      EXPECT_EQ(psnr[0], psnr[1]) << images[i].name;
+      EXPECT_LT(psnr[1], psnr[2]) << images[i].name;
+   }
+}
+
+TEST(BptcCompress, PartialBlocks)
+{
+   /* A single color can be encoded exactly if all of its components have
+    * the same lowest bit, as the p-bit is shared by the components.  This
+    * includes the texels of the blocks that are only partially covered by
+    * the image.
+    */
+   const int width = 37, height = 19;
+   std::vector<uint8_t> image(width * height * 4);
+   double mb_per_s;
+
+   for (int i = 0; i < width * height; i++) {
+      image[i * 4 + 0] = 201;
+      image[i * 4 + 1] = 65;
+      image[i * 4 + 2] = 7;
+      image[i * 4 + 3] = 129;
+   }
+
+   EXPECT_EQ(INFINITY, compress_and_measure(image, width, height,
+                                            GL_NICEST, &mb_per_s));
+}
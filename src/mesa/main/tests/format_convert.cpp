@@ -0,0 +1,251 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include "main/format_utils.h"
+#include "main/simd_format_utils.h"
+
+#include "test_random.h"
+
+/**
+ * Tests for the fast paths of _mesa_swizzle_and_convert().
+ *
+ * The expected values are computed one channel at a time with the same
+ * conversion helpers the generic code uses, so the fast paths have to be
+ * bit-exact with it.  Pixel counts go up to a few vectors to cover both the
+ * vector loops and the tails.
+ */
+
+#define MAX_PIXELS 37
+
+static const uint8_t swizzles[][4] = {
+   { 0, 1, 2, 3 },
+   { 2, 1, 0, 3 },
+   { 3, 2, 1, 0 },
+   { 0, 1, 2, MESA_FORMAT_SWIZZLE_ONE },
+   { 2, 1, 0, MESA_FORMAT_SWIZZLE_ONE },
+   { 0, 0, 0, MESA_FORMAT_SWIZZLE_ONE },
+   { 0, 0, 0, 1 },
+   { MESA_FORMAT_SWIZZLE_ZERO, 0, MESA_FORMAT_SWIZZLE_ONE, 1 },
+};
+
+static bool
+swizzle_valid(const uint8_t swizzle[4], int num_src_channels)
+{
+   for (unsigned i = 0; i < 4; i++) {
+      if (swizzle[i] < 4 && swizzle[i] >= num_src_channels)
+         return false;
+   }
+   return true;
+}
+
+/**
+ * Fill \p src with pseudo-random channels and work out what a conversion
+ * with \p swizzle should produce, using \p convert for each channel.
+ */
+template<typename SRC, typename DST, typename CONVERT>
+static void
+setup(SRC *src, DST *expected, int num_src_channels,
+      const uint8_t swizzle[4], DST zero, DST one, CONVERT convert)
+{
+   uint32_t state = 0xdeadbeef;
+
+   for (int i = 0; i < MAX_PIXELS * num_src_channels; i++)
+      src[i] = (SRC) next_random(&state);
+
+   for (int p = 0; p < MAX_PIXELS; p++) {
+      for (unsigned i = 0; i < 4; i++) {
+         if (swizzle[i] < 4)
+            expected[p * 4 + i] = convert(src[p * num_src_channels + swizzle[i]]);
+         else
+            expected[p * 4 + i] =
+               swizzle[i] == MESA_FORMAT_SWIZZLE_ONE ? one : zero;
+      }
+   }
+}
+
+typedef bool (*swizzle_and_convert_func)(void *, mesa_array_format_datatype,
+                                         int, const void *,
+                                         mesa_array_format_datatype, int,
+                                         const uint8_t *, bool, int);
+
+/**
+ * Check one of the vector versions of _mesa_swizzle_and_convert().
+ */
+template<typename DST>
+static void
+check_simd(swizzle_and_convert_func func, int count, const DST *expected,
+           enum mesa_array_format_datatype dst_type,
+           const void *src, enum mesa_array_format_datatype src_type,
+           int num_src_channels, const uint8_t swizzle[4], bool normalized)
+{
+   DST dst[(MAX_PIXELS + 1) * 4];
+
+   memset(dst, 0xcd, sizeof(dst));
+   EXPECT_TRUE(func(dst, dst_type, 4, src, src_type, num_src_channels,
+                    swizzle, normalized, count));
+   EXPECT_EQ(0, memcmp(dst, expected, count * 4 * sizeof(DST)))
+      << "count " << count;
+
+   /* Nothing past the last pixel may be written. */
+   const DST *end = dst + count * 4;
+   for (unsigned b = 0; b < sizeof(DST) * 4; b++)
+      EXPECT_EQ(0xcd, ((const uint8_t *) end)[b]) << "count " << count;
+}
+
+/**
+ * Run the conversion through the public entrypoint and through each vector
+ * version the CPU supports, and check that they all match.
+ */
+template<typename DST>
+static void
+check(DST *expected, enum mesa_array_format_datatype dst_type,
+      const void *src, enum mesa_array_format_datatype src_type,
+      int num_src_channels, const uint8_t swizzle[4], bool normalized)
+{
+   DST dst[(MAX_PIXELS + 1) * 4];
+
+   for (int count = 0; count <= MAX_PIXELS; count++) {
+      memset(dst, 0xcd, sizeof(dst));
+      _mesa_swizzle_and_convert(dst, dst_type, 4, src, src_type,
+                                num_src_channels, swizzle, normalized, count);
+      EXPECT_EQ(0, memcmp(dst, expected, count * 4 * sizeof(DST)))
+         << "count " << count;
+
+#if defined(USE_SSE41) && defined(__GNUC__)
+      if (__builtin_cpu_supports("sse4.1")) {
+         check_simd(_mesa_sse41_swizzle_and_convert, count, expected,
+                    dst_type, src, src_type, num_src_channels, swizzle,
+                    normalized);
+      }
+#endif
+#if defined(USE_AVX2) && defined(__GNUC__)
+      if (__builtin_cpu_supports("avx2")) {
+         check_simd(_mesa_avx2_swizzle_and_convert, count, expected,
+                    dst_type, src, src_type, num_src_channels, swizzle,
+                    normalized);
+      }
+#endif
+   }
+}
+
+TEST(FormatConvert, UbyteToUbyte)
+{
+   uint8_t src[MAX_PIXELS * 4], expected[MAX_PIXELS * 4];
+
+   for (int normalized = 0; normalized < 2; normalized++) {
+      for (int chans = 1; chans <= 4; chans++) {
+         for (unsigned s = 0; s < ARRAY_SIZE(swizzles); s++) {
+            if (!swizzle_valid(swizzles[s], chans))
+               continue;
+
+            setup(src, expected, chans, swizzles[s], (uint8_t) 0,
+                  (uint8_t) (normalized ? UINT8_MAX : 1),
+                  [](uint8_t x) { return x; });
+            check(expected, MESA_ARRAY_FORMAT_TYPE_UBYTE,
+                  src, MESA_ARRAY_FORMAT_TYPE_UBYTE, chans, swizzles[s],
+                  normalized);
+         }
+      }
+   }
+}
+
+TEST(FormatConvert, UbyteToFloat)
+{
+   uint8_t src[MAX_PIXELS * 4];
+   float expected[MAX_PIXELS * 4];
+
+   for (int chans = 1; chans <= 4; chans++) {
+      for (unsigned s = 0; s < ARRAY_SIZE(swizzles); s++) {
+         if (!swizzle_valid(swizzles[s], chans))
+            continue;
+
+         setup(src, expected, chans, swizzles[s], 0.0f, 1.0f,
+               [](uint8_t x) { return _mesa_unorm_to_float(x, 8); });
+         check(expected, MESA_ARRAY_FORMAT_TYPE_FLOAT,
+               src, MESA_ARRAY_FORMAT_TYPE_UBYTE, chans, swizzles[s], true);
+
+         setup(src, expected, chans, swizzles[s], 0.0f, 1.0f,
+               [](uint8_t x) { return (float) x; });
+         check(expected, MESA_ARRAY_FORMAT_TYPE_FLOAT,
+               src, MESA_ARRAY_FORMAT_TYPE_UBYTE, chans, swizzles[s], false);
+      }
+   }
+}
+
+TEST(FormatConvert, UshortToFloat)
+{
+   uint16_t src[MAX_PIXELS * 4];
+   float expected[MAX_PIXELS * 4];
+
+   for (int chans = 1; chans <= 4; chans++) {
+      for (unsigned s = 0; s < ARRAY_SIZE(swizzles); s++) {
+         if (!swizzle_valid(swizzles[s], chans))
+            continue;
+
+         setup(src, expected, chans, swizzles[s], 0.0f, 1.0f,
+               [](uint16_t x) { return _mesa_unorm_to_float(x, 16); });
+         check(expected, MESA_ARRAY_FORMAT_TYPE_FLOAT,
+               src, MESA_ARRAY_FORMAT_TYPE_USHORT, chans, swizzles[s], true);
+      }
+   }
+}
+
+TEST(FormatConvert, FloatToUnorm8)
+{
+   float src[MAX_PIXELS * 4];
+   uint8_t expected[MAX_PIXELS * 4];
+
+   /* Out of range values, NaN and values halfway between two results. */
+   static const float special[] = {
+      -1.0f, -0.0f, 0.0f, 1.0f, 1.5f, 1e10f, -INFINITY, INFINITY, NAN,
+      0.5f / 255.0f, 1.5f / 255.0f, 2.5f / 255.0f, 0.5f, 254.5f / 255.0f,
+   };
+
+   for (unsigned s = 0; s < ARRAY_SIZE(swizzles); s++) {
+      setup(src, expected, 4, swizzles[s], (uint8_t) 0, (uint8_t) UINT8_MAX,
+            [](float x) { return (uint8_t) 0; });
+
+      uint32_t state = 1;
+      for (int i = 0; i < MAX_PIXELS * 4; i++) {
+         if (i % 3 == 0)
+            src[i] = special[(i / 3) % ARRAY_SIZE(special)];
+         else
+            src[i] = (next_random(&state) % 4096) / 3000.0f - 0.1f;
+      }
+
+      for (int p = 0; p < MAX_PIXELS; p++) {
+         for (unsigned i = 0; i < 4; i++) {
+            if (swizzles[s][i] < 4) {
+               expected[p * 4 + i] =
+                  _mesa_float_to_unorm(src[p * 4 + swizzles[s][i]], 8);
+            }
+         }
+      }
+
+      check(expected, MESA_ARRAY_FORMAT_TYPE_UBYTE,
+            src, MESA_ARRAY_FORMAT_TYPE_FLOAT, 4, swizzles[s], true);
+   }
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include "main/hash.h"
+
+/**
+ * Tests for the GL object name table, covering both the direct-indexed
+ * array used for small names and the hash table used for the others.
+ */
+
+static void *
+value(GLuint key)
+{
+   return (void *) (uintptr_t) (key * 16 + 8);
+}
+
+static void
+count_entry(GLuint key, void *data, void *userData)
+{
+   EXPECT_EQ(value(key), data);
+   (*(unsigned *) userData)++;
+}
+
+static void
+remove_entry(GLuint key, void *data, void *userData)
+{
+   _mesa_HashRemoveLocked((struct _mesa_HashTable *) userData, key);
+}
+
+class HashTable : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   struct _mesa_HashTable *table;
+};
+
+void
+HashTable::SetUp()
+{
+   table = _mesa_NewHashTable();
+   ASSERT_NE((void *) NULL, table);
+}
+
+void
+HashTable::TearDown()
+{
+   _mesa_HashWalk(table, remove_entry, table);
+   EXPECT_EQ(0u, _mesa_HashNumEntries(table));
+   _mesa_DeleteHashTable(table);
+}
+
+TEST_F(HashTable, ContiguousNames)
+{
+   /* Enough names to grow the direct-indexed array several times. */
+   const GLuint count = HASH_DENSE_MIN_SIZE * 8;
+
+   for (GLuint key = 1; key <= count; key++) {
+      EXPECT_EQ(key, _mesa_HashFindFreeKeyBlock(table, 1));
+      _mesa_HashInsert(table, key, value(key));
+   }
+
+   EXPECT_EQ(count, _mesa_HashNumEntries(table));
+   EXPECT_LT(count, table->Dense->Size);
+
+   for (GLuint key = 1; key <= count; key++)
+      EXPECT_EQ(value(key), _mesa_HashLookup(table, key));
+
+   EXPECT_EQ((void *) NULL, _mesa_HashLookup(table, count + 1));
+}
+
+TEST_F(HashTable, SparseNames)
+{
+   const GLuint keys[] = {
+      DELETED_KEY_VALUE, 2, HASH_DENSE_MIN_SIZE - 1, HASH_DENSE_MIN_SIZE,
+      HASH_DENSE_MAX_SIZE, 1000000, 0xfffffffe,
+   };
+   unsigned walked = 0;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      _mesa_HashInsert(table, keys[i], value(keys[i]));
+
+   EXPECT_EQ(ARRAY_SIZE(keys), _mesa_HashNumEntries(table));
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      EXPECT_EQ(value(keys[i]), _mesa_HashLookup(table, keys[i]));
+
+   _mesa_HashWalk(table, count_entry, &walked);
+   EXPECT_EQ(ARRAY_SIZE(keys), walked);
+
+   /* A huge name must not make the array grow to cover it. */
+   EXPECT_GT(HASH_DENSE_MAX_SIZE, table->Dense->Size);
+}
+
+TEST_F(HashTable, GrowthMovesHashedNames)
+{
+   const GLuint size = table->Dense->Size;
+   const GLuint far = size * 2 + 10;
+
+   /* This one is too far ahead to grow the array and ends up hashed. */
+   _mesa_HashInsert(table, far, value(far));
+   EXPECT_EQ(size, table->Dense->Size);
+
+   /* Filling the gap grows the array, which must take the hashed one. */
+   for (GLuint key = 1; key < far; key++)
+      _mesa_HashInsert(table, key, value(key));
+
+   EXPECT_LT(far, table->Dense->Size);
+   EXPECT_EQ(far, _mesa_HashNumEntries(table));
+
+   for (GLuint key = 1; key <= far; key++)
+      EXPECT_EQ(value(key), _mesa_HashLookup(table, key));
+}
+
+TEST_F(HashTable, ReplaceAndRemove)
+{
+   const GLuint keys[] = { 3, HASH_DENSE_MAX_SIZE + 3 };
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++) {
+      _mesa_HashInsert(table, keys[i], value(1));
+      _mesa_HashInsert(table, keys[i], value(keys[i]));
+      EXPECT_EQ(value(keys[i]), _mesa_HashLookup(table, keys[i]));
+   }
+
+   EXPECT_EQ(2u, _mesa_HashNumEntries(table));
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++) {
+      _mesa_HashRemove(table, keys[i]);
+      EXPECT_EQ((void *) NULL, _mesa_HashLookup(table, keys[i]));
+   }
+
+   EXPECT_EQ(0u, _mesa_HashNumEntries(table));
+}
+
+TEST_F(HashTable, DeleteAll)
+{
+   const GLuint keys[] = { 1, 5, HASH_DENSE_MAX_SIZE * 2 };
+   unsigned deleted = 0;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      _mesa_HashInsert(table, keys[i], value(keys[i]));
+
+   _mesa_HashDeleteAll(table, count_entry, &deleted);
+
+   EXPECT_EQ(ARRAY_SIZE(keys), deleted);
+   EXPECT_EQ(0u, _mesa_HashNumEntries(table));
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      EXPECT_EQ((void *) NULL, _mesa_HashLookup(table, keys[i]));
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "main/mipmap.h"
+#include "util/macros.h"
+
+extern "C" {
+#include "main/cpuinfo.h"
+#include "x86/common_x86_asm.h"
+}
+
+#include "test_random.h"
+
+/**
+ * Tests for the 2x2 box filter of _mesa_generate_mipmap_level().
+ *
+ * The sizes include levels big enough to be split into bands that are done
+ * on several threads, odd sizes where the last source row and column are
+ * dropped, and levels that are only one texel wide or high.  The float
+ * texels aren't integers, so the sums have to be done in the same order as
+ * the reference to match.
+ */
+
+class Mipmap : public ::testing::Test {
+protected:
+   /* Set cpu_has_sse4_1, so that the SSE4.1 rows are used when the CPU has
+    * it, as they are in a context.
+    */
+   static void SetUpTestCase()
+   {
+      _mesa_get_cpu_features();
+   }
+};
+
+static const struct {
+   GLint width, height;
+} sizes[] = {
+   { 1024, 1024 },
+   { 1023, 517 },
+   { 37, 19 },
+   { 1, 600 },
+   { 600, 1 },
+   { 2, 2 },
+};
+
+static GLubyte
+average(GLubyte a, GLubyte b, GLubyte c, GLubyte d)
+{
+   return (a + b + c + d) / 4;
+}
+
+static GLfloat
+average(GLfloat a, GLfloat b, GLfloat c, GLfloat d)
+{
+   return (a + b + c + d) * 0.25F;
+}
+
+static void
+random_texel(uint32_t *state, GLubyte *texel)
+{
+   *texel = next_random(state) % 256;
+}
+
+static void
+random_texel(uint32_t *state, GLfloat *texel)
+{
+   *texel = (next_random(state) % 100000) / 3000.0F;
+}
+
+template<typename T>
+static void
+test_level(GLenum datatype, GLuint comps)
+{
+   for (unsigned s = 0; s < ARRAY_SIZE(sizes); s++) {
+      const GLint srcWidth = sizes[s].width, srcHeight = sizes[s].height;
+      const GLint dstWidth = MAX2(srcWidth / 2, 1);
+      const GLint dstHeight = MAX2(srcHeight / 2, 1);
+      std::vector<T> src(srcWidth * srcHeight * comps);
+      std::vector<T> dst(dstWidth * dstHeight * comps);
+      uint32_t state = 0x1234;
+
+      for (size_t i = 0; i < src.size(); i++)
+         random_texel(&state, &src[i]);
+
+      const GLubyte *srcData = (const GLubyte *) src.data();
+      GLubyte *dstData = (GLubyte *) dst.data();
+
+      _mesa_generate_mipmap_level(GL_TEXTURE_2D, datatype, comps, 0,
+                                  srcWidth, srcHeight, 1, &srcData,
+                                  srcWidth * comps * sizeof(T),
+                                  dstWidth, dstHeight, 1, &dstData,
+                                  dstWidth * comps * sizeof(T));
+
+      for (GLint y = 0; y < dstHeight; y++) {
+         const GLint y0 = srcHeight == dstHeight ? y : y * 2;
+         const GLint y1 = srcHeight == dstHeight ? y : y * 2 + 1;
+
+         for (GLint x = 0; x < dstWidth; x++) {
+            const GLint x0 = srcWidth == dstWidth ? x : x * 2;
+            const GLint x1 = srcWidth == dstWidth ? x : x * 2 + 1;
+
+            for (GLuint c = 0; c < comps; c++) {
+               const T expected =
+                  average(src[(y0 * srcWidth + x0) * comps + c],
+                          src[(y0 * srcWidth + x1) * comps + c],
+                          src[(y1 * srcWidth + x0) * comps + c],
+                          src[(y1 * srcWidth + x1) * comps + c]);
+
+               ASSERT_EQ(expected, dst[(y * dstWidth + x) * comps + c])
+                  << srcWidth << "x" << srcHeight << " texel "
+                  << x << ", " << y << " channel " << c;
+            }
+         }
+      }
+   }
+}
+
+#if defined(USE_SSE41) && defined(__GNUC__)
+TEST_F(Mipmap, DetectsSSE41)
+{
+   EXPECT_EQ(__builtin_cpu_supports("sse4.1") != 0, cpu_has_sse4_1 != 0);
+}
+#endif
+
+TEST_F(Mipmap, Ubyte)
+{
+   for (GLuint comps = 1; comps <= 4; comps++)
+      test_level<GLubyte>(GL_UNSIGNED_BYTE, comps);
+}
+
+TEST_F(Mipmap, Float)
+{
+   for (GLuint comps = 1; comps <= 4; comps++)
+      test_level<GLfloat>(GL_FLOAT, comps);
+}
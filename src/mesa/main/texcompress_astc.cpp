@@ -35,9 +35,15 @@
 
 #include "texcompress_astc.h"
 #include "macros.h"
+#include "parallel_for.h"
+#include "sse_astc.h"
 #include "util/half_float.h"
 #include <stdio.h>
 
+extern "C" {
+#include "x86/common_x86_asm.h"
+}
+
 static bool VERBOSE_DECODE = false;
 static bool VERBOSE_WRITE = false;
 
@@ -47,6 +53,28 @@ uint16_div_64k_to_half_to_unorm8(uint16_t v)
    return _mesa_half_to_unorm8(_mesa_uint16_div_64k_to_half(v));
 }
 
+/**
+ * uint16_div_64k_to_half_to_unorm8() of every UNORM16 value, which is too
+ * slow to be done for every channel of every texel.
+ */
+struct unorm8_table
+{
+   uint8_t v[65536];
+
+   unorm8_table()
+   {
+      for (unsigned i = 0; i < ARRAY_SIZE(v); i++)
+         v[i] = uint16_div_64k_to_half_to_unorm8(i);
+   }
+};
+
+static const uint8_t *
+get_unorm8_table()
+{
+   static const unorm8_table table;
+   return table.v;
+}
+
 class decode_error
 {
 public:
@@ -275,14 +303,14 @@ static uint32_t hash52(uint32_t p)
    return p;
 }
 
-static int select_partition(int seed, int x, int y, int z, int partitioncount,
-                            int small_block)
+/**
+ * Compute the partition of every texel of a block.  The seeds only depend
+ * on the partition index, so they are computed once for the whole block.
+ */
+static void compute_partitions(int seed, int partitioncount, int small_block,
+                               int block_w, int block_h, int block_d,
+                               uint8_t *partitions)
 {
-   if (small_block) {
-      x <<= 1;
-      y <<= 1;
-      z <<= 1;
-   }
    seed += (partitioncount - 1) * 1024;
    uint32_t rnum = hash52(seed);
    uint8_t seed1 = rnum & 0xF;
@@ -334,29 +362,41 @@ static int select_partition(int seed, int x, int y, int z, int partitioncount,
    seed11 >>= sh3;
    seed12 >>= sh3;
 
-   int a = seed1 * x + seed2 * y + seed11 * z + (rnum >> 14);
-   int b = seed3 * x + seed4 * y + seed12 * z + (rnum >> 10);
-   int c = seed5 * x + seed6 * y + seed9 * z + (rnum >> 6);
-   int d = seed7 * x + seed8 * y + seed10 * z + (rnum >> 2);
-
-   a &= 0x3F;
-   b &= 0x3F;
-   c &= 0x3F;
-   d &= 0x3F;
-
-   if (partitioncount < 4)
-      d = 0;
-   if (partitioncount < 3)
-      c = 0;
-
-   if (a >= b && a >= c && a >= d)
-      return 0;
-   else if (b >= c && b >= d)
-      return 1;
-   else if (c >= d)
-      return 2;
-   else
-      return 3;
+   int scale = small_block ? 2 : 1;
+   int idx = 0;
+   for (int z = 0; z < block_d * scale; z += scale) {
+      for (int y = 0; y < block_h * scale; y += scale) {
+         for (int x = 0; x < block_w * scale; x += scale) {
+            int a = seed1 * x + seed2 * y + seed11 * z + (rnum >> 14);
+            int b = seed3 * x + seed4 * y + seed12 * z + (rnum >> 10);
+            int c = seed5 * x + seed6 * y + seed9 * z + (rnum >> 6);
+            int d = seed7 * x + seed8 * y + seed10 * z + (rnum >> 2);
+
+            a &= 0x3F;
+            b &= 0x3F;
+            c &= 0x3F;
+            d &= 0x3F;
+
+            if (partitioncount < 4)
+               d = 0;
+            if (partitioncount < 3)
+               c = 0;
+
+            int partition;
+            if (a >= b && a >= c && a >= d)
+               partition = 0;
+            else if (b >= c && b >= d)
+               partition = 1;
+            else if (c >= d)
+               partition = 2;
+            else
+               partition = 3;
+
+            assert(partition < partitioncount);
+            partitions[idx++] = partition;
+         }
+      }
+   }
 }
 
 
@@ -625,6 +665,7 @@ struct Block
    void calculate_remaining_bits();
    decode_error::type calculate_colour_endpoints_size();
 
+   uint8_t unquantise_weight(uint8_t v) const;
    void unquantise_weights();
    void unquantise_colour_endpoints();
 
@@ -1163,99 +1204,132 @@ void Block::unpack_weights(InputBitVector in)
    }
 }
 
-void Block::unquantise_weights()
+uint8_t Block::unquantise_weight(uint8_t v) const
 {
-   assert(num_weights <= (int)ARRAY_SIZE(weights_quant));
-   assert(num_weights <= (int)ARRAY_SIZE(weights));
+   uint8_t w;
 
-   memset(weights, 0, sizeof(weights));
-
-   for (int i = 0; i < num_weights; ++i) {
+   if (wt_trits) {
 
-      uint8_t v = weights_quant[i];
-      uint8_t w;
+      if (wt_bits == 0) {
+         w = v * 32;
+      } else {
+         uint8_t A, B, C, D;
+         A = (v & 0x1) ? 0x7F : 0x00;
+         switch (wt_bits) {
+         case 1:
+            B = 0;
+            C = 50;
+            D = v >> 1;
+            break;
+         case 2:
+            B = (v & 0x2) ? 0x45 : 0x00;
+            C = 23;
+            D = v >> 2;
+            break;
+         case 3:
+            B = ((v & 0x6) >> 1) | ((v & 0x6) << 4);
+            C = 11;
+            D = v >> 3;
+            break;
+         default:
+            unreachable("");
+         }
+         uint16_t T = D * C + B;
+         T = T ^ A;
+         T = (A & 0x20) | (T >> 2);
+         assert(T < 64);
+         if (T > 32)
+            T++;
+         w = T;
+      }
 
-      if (wt_trits) {
+   } else if (wt_quints) {
 
-         if (wt_bits == 0) {
-            w = v * 32;
-         } else {
-            uint8_t A, B, C, D;
-            A = (v & 0x1) ? 0x7F : 0x00;
-            switch (wt_bits) {
-            case 1:
-               B = 0;
-               C = 50;
-               D = v >> 1;
-               break;
-            case 2:
-               B = (v & 0x2) ? 0x45 : 0x00;
-               C = 23;
-               D = v >> 2;
-               break;
-            case 3:
-               B = ((v & 0x6) >> 1) | ((v & 0x6) << 4);
-               C = 11;
-               D = v >> 3;
-               break;
-            default:
-               unreachable("");
-            }
-            uint16_t T = D * C + B;
-            T = T ^ A;
-            T = (A & 0x20) | (T >> 2);
-            assert(T < 64);
-            if (T > 32)
-               T++;
-            w = T;
+      if (wt_bits == 0) {
+         w = v * 16;
+      } else {
+         uint8_t A, B, C, D;
+         A = (v & 0x1) ? 0x7F : 0x00;
+         switch (wt_bits) {
+         case 1:
+            B = 0;
+            C = 28;
+            D = v >> 1;
+            break;
+         case 2:
+            B = (v & 0x2) ? 0x42 : 0x00;
+            C = 13;
+            D = v >> 2;
+            break;
+         default:
+            unreachable("");
          }
+         uint16_t T = D * C + B;
+         T = T ^ A;
+         T = (A & 0x20) | (T >> 2);
+         assert(T < 64);
+         if (T > 32)
+            T++;
+         w = T;
+      }
 
-      } else if (wt_quints) {
+   } else {
 
-         if (wt_bits == 0) {
-            w = v * 16;
-         } else {
-            uint8_t A, B, C, D;
-            A = (v & 0x1) ? 0x7F : 0x00;
-            switch (wt_bits) {
-            case 1:
-               B = 0;
-               C = 28;
-               D = v >> 1;
-               break;
-            case 2:
-               B = (v & 0x2) ? 0x42 : 0x00;
-               C = 13;
-               D = v >> 2;
-               break;
-            default:
-               unreachable("");
-            }
-            uint16_t T = D * C + B;
-            T = T ^ A;
-            T = (A & 0x20) | (T >> 2);
-            assert(T < 64);
-            if (T > 32)
-               T++;
-            w = T;
-         }
-         weights[i] = w;
+      switch (wt_bits) {
+      case 1: w = v ? 0x3F : 0x00; break;
+      case 2: w = v | (v << 2) | (v << 4); break;
+      case 3: w = v | (v << 3); break;
+      case 4: w = (v >> 2) | (v << 2); break;
+      case 5: w = (v >> 4) | (v << 1); break;
+      default: unreachable("");
+      }
+      assert(w < 64);
+      if (w > 32)
+         w++;
+   }
+   return w;
+}
 
-      } else {
+/**
+ * The unquantised weights of each weight range, indexed by the maximum
+ * quantised value (which is different for every range) and the quantised
+ * value.
+ */
+struct weight_table
+{
+   uint8_t v[32][32];
 
-         switch (wt_bits) {
-         case 1: w = v ? 0x3F : 0x00; break;
-         case 2: w = v | (v << 2) | (v << 4); break;
-         case 3: w = v | (v << 3); break;
-         case 4: w = (v >> 2) | (v << 2); break;
-         case 5: w = (v >> 4) | (v << 1); break;
-         default: unreachable("");
+   weight_table()
+   {
+      for (int high_prec = 0; high_prec <= 1; ++high_prec) {
+         for (int wt_range = 0x2; wt_range <= 0x7; ++wt_range) {
+            Block blk;
+            blk.high_prec = high_prec;
+            blk.wt_range = wt_range;
+            blk.wt_w = blk.wt_h = blk.wt_d = 1;
+            blk.dual_plane = 0;
+            blk.calculate_from_weights();
+
+            for (int i = 0; i <= blk.wt_max; ++i)
+               v[blk.wt_max][i] = blk.unquantise_weight(i);
          }
-         assert(w < 64);
-         if (w > 32)
-            w++;
       }
-      weights[i] = w;
+   }
+};
+
+void Block::unquantise_weights()
+{
+   static const weight_table table;
+
+   assert(num_weights <= (int)ARRAY_SIZE(weights_quant));
+   assert(num_weights <= (int)ARRAY_SIZE(weights));
+
+   memset(weights, 0, sizeof(weights));
+
+   const uint8_t *unquantised = table.v[wt_max];
+   for (int i = 0; i < num_weights; ++i) {
+      assert(weights_quant[i] <= wt_max);
+      weights[i] = unquantised[weights_quant[i]];
    }
 }
 
@@ -1605,24 +1679,68 @@ decode_error::type Block::decode(const Decoder &decoder, InputBitVector in)
    return decode_error::ok;
 }
 
+/**
+ * Interpolate the endpoints of \p count texels with their weights, giving
+ * the UNORM16 color of each texel.
+ */
+static void
+interpolate_texels(int count, const uint8_t *partitions,
+                   const uint8_t *weights0, const uint8_t *weights1,
+                   int plane1_component, const uint8_t endpoints[2][4][4],
+                   bool srgb, uint16_t *output)
+{
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1) {
+      _mesa_sse41_astc_interpolate(count, partitions, weights0, weights1,
+                                   plane1_component, endpoints, srgb, output);
+      return;
+   }
+#endif
+
+   for (int i = 0; i < count; ++i) {
+      const uint8_t *e0 = endpoints[0][partitions[i]];
+      const uint8_t *e1 = endpoints[1][partitions[i]];
+
+      for (int j = 0; j < 4; ++j) {
+         /* Expand to 16 bits. */
+         int c0, c1;
+         if (srgb) {
+            c0 = (e0[j] << 8) | 0x80;
+            c1 = (e1[j] << 8) | 0x80;
+         } else {
+            c0 = (e0[j] << 8) | e0[j];
+            c1 = (e1[j] << 8) | e1[j];
+         }
+
+         int w = weights1 && j == plane1_component ? weights1[i] : weights0[i];
+
+         /* Interpolate to produce UNORM16, applying weights. */
+         output[i*4+j] = (uint16_t)((c0 * (64 - w) + c1 * w + 32) >> 6);
+      }
+   }
+}
+
 void Block::write_decoded(const Decoder &decoder, uint16_t *output)
 {
    /* sRGB can only be stored as unorm8. */
    assert(!decoder.srgb || decoder.output_unorm8);
 
+   const uint8_t *unorm8 = decoder.output_unorm8 ? get_unorm8_table() : NULL;
+   int num_texels = decoder.block_w * decoder.block_h * decoder.block_d;
+
    if (is_void_extent) {
-      for (int idx = 0; idx < decoder.block_w*decoder.block_h*decoder.block_d; ++idx) {
+      for (int idx = 0; idx < num_texels; ++idx) {
          if (decoder.output_unorm8) {
             if (decoder.srgb) {
                output[idx*4+0] = void_extent_colour_r >> 8;
                output[idx*4+1] = void_extent_colour_g >> 8;
                output[idx*4+2] = void_extent_colour_b >> 8;
             } else {
-               output[idx*4+0] = uint16_div_64k_to_half_to_unorm8(void_extent_colour_r);
-               output[idx*4+1] = uint16_div_64k_to_half_to_unorm8(void_extent_colour_g);
-               output[idx*4+2] = uint16_div_64k_to_half_to_unorm8(void_extent_colour_b);
+               output[idx*4+0] = unorm8[void_extent_colour_r];
+               output[idx*4+1] = unorm8[void_extent_colour_g];
+               output[idx*4+2] = unorm8[void_extent_colour_b];
             }
-            output[idx*4+3] = uint16_div_64k_to_half_to_unorm8(void_extent_colour_a);
+            output[idx*4+3] = unorm8[void_extent_colour_a];
          } else {
             /* Store the color as FP16. */
             output[idx*4+0] = _mesa_uint16_div_64k_to_half(void_extent_colour_r);
@@ -1634,90 +1752,47 @@ void Block::write_decoded(const Decoder &decoder, uint16_t *output)
       return;
    }
 
-   int small_block = (decoder.block_w * decoder.block_h * decoder.block_d) < 31;
-
-   int idx = 0;
-   for (int z = 0; z < decoder.block_d; ++z) {
-      for (int y = 0; y < decoder.block_h; ++y) {
-         for (int x = 0; x < decoder.block_w; ++x) {
-
-            int partition;
-            if (num_parts > 1) {
-               partition = select_partition(partition_index, x, y, z, num_parts, small_block);
-               assert(partition < num_parts);
-            } else {
-               partition = 0;
-            }
-
-            /* TODO: HDR */
+   int small_block = num_texels < 31;
 
-            uint8x4_t e0 = endpoints_decoded[0][partition];
-            uint8x4_t e1 = endpoints_decoded[1][partition];
-            uint16_t c0[4], c1[4];
+   uint8_t partitions[216];
+   if (num_parts > 1) {
+      compute_partitions(partition_index, num_parts, small_block,
+                         decoder.block_w, decoder.block_h, decoder.block_d,
+                         partitions);
+   } else {
+      memset(partitions, 0, num_texels);
+   }
 
-            /* Expand to 16 bits. */
-            if (decoder.srgb) {
-               c0[0] = (uint16_t)((e0.v[0] << 8) | 0x80);
-               c0[1] = (uint16_t)((e0.v[1] << 8) | 0x80);
-               c0[2] = (uint16_t)((e0.v[2] << 8) | 0x80);
-               c0[3] = (uint16_t)((e0.v[3] << 8) | 0x80);
-
-               c1[0] = (uint16_t)((e1.v[0] << 8) | 0x80);
-               c1[1] = (uint16_t)((e1.v[1] << 8) | 0x80);
-               c1[2] = (uint16_t)((e1.v[2] << 8) | 0x80);
-               c1[3] = (uint16_t)((e1.v[3] << 8) | 0x80);
-            } else {
-               c0[0] = (uint16_t)((e0.v[0] << 8) | e0.v[0]);
-               c0[1] = (uint16_t)((e0.v[1] << 8) | e0.v[1]);
-               c0[2] = (uint16_t)((e0.v[2] << 8) | e0.v[2]);
-               c0[3] = (uint16_t)((e0.v[3] << 8) | e0.v[3]);
-
-               c1[0] = (uint16_t)((e1.v[0] << 8) | e1.v[0]);
-               c1[1] = (uint16_t)((e1.v[1] << 8) | e1.v[1]);
-               c1[2] = (uint16_t)((e1.v[2] << 8) | e1.v[2]);
-               c1[3] = (uint16_t)((e1.v[3] << 8) | e1.v[3]);
-            }
+   /* TODO: HDR */
 
-            int w[4];
-            if (dual_plane) {
-               int w0 = infill_weights[0][idx];
-               int w1 = infill_weights[1][idx];
-               w[0] = w[1] = w[2] = w[3] = w0;
-               w[colour_component_selector] = w1;
-            } else {
-               int w0 = infill_weights[0][idx];
-               w[0] = w[1] = w[2] = w[3] = w0;
-            }
+   STATIC_ASSERT(sizeof(endpoints_decoded) == 2 * 4 * 4);
+   uint16_t colours[216 * 4];
+   interpolate_texels(num_texels, partitions, infill_weights[0],
+                      dual_plane ? infill_weights[1] : NULL,
+                      colour_component_selector,
+                      reinterpret_cast<const uint8_t (*)[4][4]>(endpoints_decoded),
+                      decoder.srgb, colours);
 
-            /* Interpolate to produce UNORM16, applying weights. */
-            uint16_t c[4] = {
-               (uint16_t)((c0[0] * (64 - w[0]) + c1[0] * w[0] + 32) >> 6),
-               (uint16_t)((c0[1] * (64 - w[1]) + c1[1] * w[1] + 32) >> 6),
-               (uint16_t)((c0[2] * (64 - w[2]) + c1[2] * w[2] + 32) >> 6),
-               (uint16_t)((c0[3] * (64 - w[3]) + c1[3] * w[3] + 32) >> 6),
-            };
-
-            if (decoder.output_unorm8) {
-               if (decoder.srgb) {
-                  output[idx*4+0] = c[0] >> 8;
-                  output[idx*4+1] = c[1] >> 8;
-                  output[idx*4+2] = c[2] >> 8;
-               } else {
-                  output[idx*4+0] = c[0] == 65535 ? 0xff : uint16_div_64k_to_half_to_unorm8(c[0]);
-                  output[idx*4+1] = c[1] == 65535 ? 0xff : uint16_div_64k_to_half_to_unorm8(c[1]);
-                  output[idx*4+2] = c[2] == 65535 ? 0xff : uint16_div_64k_to_half_to_unorm8(c[2]);
-               }
-               output[idx*4+3] = c[3] == 65535 ? 0xff : uint16_div_64k_to_half_to_unorm8(c[3]);
-            } else {
-               /* Store the color as FP16. */
-               output[idx*4+0] = c[0] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[0]);
-               output[idx*4+1] = c[1] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[1]);
-               output[idx*4+2] = c[2] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[2]);
-               output[idx*4+3] = c[3] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[3]);
-            }
+   for (int idx = 0; idx < num_texels; ++idx) {
+      const uint16_t *c = &colours[idx * 4];
 
-            idx++;
+      if (decoder.output_unorm8) {
+         if (decoder.srgb) {
+            output[idx*4+0] = c[0] >> 8;
+            output[idx*4+1] = c[1] >> 8;
+            output[idx*4+2] = c[2] >> 8;
+         } else {
+            output[idx*4+0] = unorm8[c[0]];
+            output[idx*4+1] = unorm8[c[1]];
+            output[idx*4+2] = unorm8[c[2]];
          }
+         output[idx*4+3] = unorm8[c[3]];
+      } else {
+         /* Store the color as FP16. */
+         output[idx*4+0] = c[0] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[0]);
+         output[idx*4+1] = c[1] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[1]);
+         output[idx*4+2] = c[2] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[2]);
+         output[idx*4+3] = c[3] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[3]);
       }
    }
 }
@@ -1813,9 +1888,64 @@ decode_error::type Block::calculate_colour_endpoints_size()
    return decode_error::invalid_colour_endpoints_size;
 }
 
+struct unpack_job
+{
+   const Decoder *dec;
+   uint8_t *dst_row;
+   unsigned dst_stride;
+   const uint8_t *src_row;
+   unsigned src_stride;
+   unsigned src_width, src_height;
+   unsigned x_blocks;
+};
+
+/**
+ * Decode the rows of blocks [start, end).
+ */
+static void
+unpack_block_rows(void *data, unsigned start, unsigned end)
+{
+   const unpack_job *job = (const unpack_job *) data;
+   const Decoder &dec = *job->dec;
+   const unsigned blk_w = dec.block_w, blk_h = dec.block_h;
+   const unsigned block_size = 16;
+
+   for (unsigned y = start; y < end; ++y) {
+      const uint8_t *src_row = job->src_row + y * job->src_stride;
+      uint8_t *dst_row = job->dst_row + y * blk_h * job->dst_stride;
+
+      for (unsigned x = 0; x < job->x_blocks; ++x) {
+         /* Same size as the largest block. */
+         uint16_t block_out[12 * 12 * 4];
+
+         dec.decode(src_row + x * block_size, block_out);
+
+         /* This can be smaller with NPOT dimensions. */
+         unsigned dst_blk_w = MIN2(blk_w, job->src_width  - x*blk_w);
+         unsigned dst_blk_h = MIN2(blk_h, job->src_height - y*blk_h);
+
+         for (unsigned sub_y = 0; sub_y < dst_blk_h; ++sub_y) {
+            for (unsigned sub_x = 0; sub_x < dst_blk_w; ++sub_x) {
+               uint8_t *dst = dst_row + sub_y * job->dst_stride +
+                              (x * blk_w + sub_x) * 4;
+               const uint16_t *src = &block_out[(sub_y * blk_w + sub_x) * 4];
+
+               dst[0] = src[0];
+               dst[1] = src[1];
+               dst[2] = src[2];
+               dst[3] = src[3];
+            }
+         }
+      }
+   }
+}
+
 /**
  * Decode ASTC 2D LDR texture data.
  *
+ * Large images are split into bands of block rows which are decoded on
+ * several threads.
+ *
  * \param src_width in pixels
  * \param src_height in pixels
  * \param dst_stride in bytes
@@ -1835,37 +1965,27 @@ _mesa_unpack_astc_2d_ldr(uint8_t *dst_row,
    unsigned blk_w, blk_h;
    _mesa_get_format_block_size(format, &blk_w, &blk_h);
 
-   const unsigned block_size = 16;
    unsigned x_blocks = (src_width + blk_w - 1) / blk_w;
    unsigned y_blocks = (src_height + blk_h - 1) / blk_h;
 
-   Decoder dec(blk_w, blk_h, 1, srgb, true);
-
-   for (unsigned y = 0; y < y_blocks; ++y) {
-      for (unsigned x = 0; x < x_blocks; ++x) {
-         /* Same size as the largest block. */
-         uint16_t block_out[12 * 12 * 4];
-
-         dec.decode(src_row + x * block_size, block_out);
-
-         /* This can be smaller with NPOT dimensions. */
-         unsigned dst_blk_w = MIN2(blk_w, src_width  - x*blk_w);
-         unsigned dst_blk_h = MIN2(blk_h, src_height - y*blk_h);
+   if (x_blocks == 0)
+      return;
 
-         for (unsigned sub_y = 0; sub_y < dst_blk_h; ++sub_y) {
-            for (unsigned sub_x = 0; sub_x < dst_blk_w; ++sub_x) {
-               uint8_t *dst = dst_row + sub_y * dst_stride +
-                              (x * blk_w + sub_x) * 4;
-               const uint16_t *src = &block_out[(sub_y * blk_w + sub_x) * 4];
+   Decoder dec(blk_w, blk_h, 1, srgb, true);
 
-               dst[0] = src[0];
-               dst[1] = src[1];
-               dst[2] = src[2];
-               dst[3] = src[3];
-            }
-         }
-      }
-      src_row += src_stride;
-      dst_row += dst_stride * blk_h;
-   }
+   unpack_job job;
+   job.dec = &dec;
+   job.dst_row = dst_row;
+   job.dst_stride = dst_stride;
+   job.src_row = src_row;
+   job.src_stride = src_stride;
+   job.src_width = src_width;
+   job.src_height = src_height;
+   job.x_blocks = x_blocks;
+
+   /* Minimum number of blocks decoded by each thread. */
+   const unsigned min_blocks_per_job = 1024;
+
+   _mesa_parallel_for(y_blocks, DIV_ROUND_UP(min_blocks_per_job, x_blocks),
+                      unpack_block_rows, &job);
 }
@@ -33,6 +33,12 @@
 #include "texstore.h"
 #include "image.h"
 #include "mtypes.h"
+#include "parallel_for.h"
+
+/**
+ * Minimum number of blocks compressed by one thread.
+ */
+#define MIN_BLOCKS_PER_JOB 1024
 
 static void
 fetch_bptc_rgb_float(const GLubyte *map,
@@ -122,6 +128,110 @@ _mesa_get_bptc_fetch_func(mesa_format format)
    }
 }
 
+/**
+ * An image to compress, see _mesa_bptc_compress_rgba_unorm() and
+ * _mesa_bptc_compress_rgb_float().
+ */
+struct compress_job {
+   int width, height;
+   const void *src;
+   int src_rowstride;
+   uint8_t *dst;
+   int dst_rowstride;
+   enum bptc_quality quality;
+   bool is_signed;
+};
+
+static void
+compress_rgba_unorm_rows(void *data, unsigned start, unsigned end)
+{
+   const struct compress_job *job = (const struct compress_job *) data;
+   const int y = start * BLOCK_SIZE;
+
+   compress_rgba_unorm(job->width, MIN2(end * BLOCK_SIZE, job->height) - y,
+                       (const uint8_t *) job->src + y * job->src_rowstride,
+                       job->src_rowstride,
+                       job->dst + start * job->dst_rowstride,
+                       job->dst_rowstride, job->quality);
+}
+
+static void
+compress_rgb_float_rows(void *data, unsigned start, unsigned end)
+{
+   const struct compress_job *job = (const struct compress_job *) data;
+   const int y = start * BLOCK_SIZE;
+
+   compress_rgb_float(job->width, MIN2(end * BLOCK_SIZE, job->height) - y,
+                      (const float *) ((const uint8_t *) job->src +
+                                       y * job->src_rowstride),
+                      job->src_rowstride,
+                      job->dst + start * job->dst_rowstride,
+                      job->dst_rowstride, job->is_signed);
+}
+
+static void
+compress_in_parallel(struct compress_job *job, mesa_parallel_func func)
+{
+   const unsigned block_columns = DIV_ROUND_UP(job->width, BLOCK_SIZE);
+   const unsigned block_rows = DIV_ROUND_UP(job->height, BLOCK_SIZE);
+
+   _mesa_parallel_for(block_rows,
+                      DIV_ROUND_UP(MIN_BLOCKS_PER_JOB, block_columns),
+                      func, job);
+}
+
+/**
+ * Compress an RGBA8 image to BPTC_RGBA_UNORM, with rows of blocks spread
+ * over the CPUs.
+ *
+ * \param quality_hint  GL_FASTEST, GL_DONT_CARE or GL_NICEST, like
+ *                      GL_TEXTURE_COMPRESSION_HINT.  Only GL_NICEST
+ *                      selects the slower, higher quality encoder.
+ */
+void
+_mesa_bptc_compress_rgba_unorm(int width, int height,
+                               const uint8_t *src, int src_rowstride,
+                               uint8_t *dst, int dst_rowstride,
+                               GLenum quality_hint)
+{
+   struct compress_job job;
+
+   job.width = width;
+   job.height = height;
+   job.src = src;
+   job.src_rowstride = src_rowstride;
+   job.dst = dst;
+   job.dst_rowstride = dst_rowstride;
+
+   job.quality = quality_hint == GL_NICEST ? BPTC_QUALITY_HIGH :
+                                             BPTC_QUALITY_FAST;
+
+   compress_in_parallel(&job, compress_rgba_unorm_rows);
+}
+
+/**
+ * Compress an RGB float image to one of the BPTC float formats, with rows
+ * of blocks spread over the CPUs.
+ */
+void
+_mesa_bptc_compress_rgb_float(int width, int height,
+                              const float *src, int src_rowstride,
+                              uint8_t *dst, int dst_rowstride,
+                              bool is_signed)
+{
+   struct compress_job job;
+
+   job.width = width;
+   job.height = height;
+   job.src = src;
+   job.src_rowstride = src_rowstride;
+   job.dst = dst;
+   job.dst_rowstride = dst_rowstride;
+   job.is_signed = is_signed;
+
+   compress_in_parallel(&job, compress_rgb_float_rows);
+}
+
 GLboolean
 _mesa_texstore_bptc_rgba_unorm(TEXSTORE_PARAMS)
 {
@@ -158,9 +268,10 @@ _mesa_texstore_bptc_rgba_unorm(TEXSTORE_PARAMS)
                                          srcFormat, srcType);
    }
 
-   compress_rgba_unorm(srcWidth, srcHeight,
-                       pixels, rowstride,
-                       dstSlices[0], dstRowStride);
+   _mesa_bptc_compress_rgba_unorm(srcWidth, srcHeight,
+                                  pixels, rowstride,
+                                  dstSlices[0], dstRowStride,
+                                  ctx->Hint.TextureCompression);
 
    free((void *) tempImage);
 
@@ -203,10 +314,10 @@ texstore_bptc_rgb_float(TEXSTORE_PARAMS,
                                          srcFormat, srcType);
    }
 
-   compress_rgb_float(srcWidth, srcHeight,
-                      pixels, rowstride,
-                      dstSlices[0], dstRowStride,
-                      is_signed);
+   _mesa_bptc_compress_rgb_float(srcWidth, srcHeight,
+                                 pixels, rowstride,
+                                 dstSlices[0], dstRowStride,
+                                 is_signed);
 
    free((void *) tempImage);
 
@@ -28,6 +28,9 @@
 #ifndef TEXCOMPRESS_BPTC_TMP_H
 #define TEXCOMPRESS_BPTC_TMP_H
 
+#include <float.h>
+#include <limits.h>
+#include <math.h>
 #include "util/format_srgb.h"
 #include "util/half_float.h"
 #include "macros.h"
@@ -73,6 +76,16 @@ struct bit_writer {
    uint8_t *dst;
 };
 
+/* Trade-off between speed and quality when compressing to
+ * BPTC_RGBA_UNORM.
+ */
+enum bptc_quality {
+   /* Mode 4, with endpoints picked by splitting the texels by luminance */
+   BPTC_QUALITY_FAST,
+   /* Mode 6, with endpoints on the principal axis of the texels */
+   BPTC_QUALITY_HIGH,
+};
+
 static const struct bptc_unorm_mode
 bptc_unorm_modes[] = {
    /* 0 */ { 3, 4, false, false, 4, 0, true,  false, 3, 0 },
@@ -1243,7 +1256,7 @@ get_rgba_endpoints_unorm(int width, int height,
          for (i = 0; i < 3; i++)
             sums[endpoint][i] += p[i];
 
-         if (p[2] < average_alpha) {
+         if (p[3] < average_alpha) {
             endpoint = 0;
             alpha_left_endpoint_count++;
          } else {
@@ -1453,10 +1466,264 @@ compress_rgba_unorm_block(int src_width, int src_height,
                              endpoints);
 }
 
+/* Number of texels in a block, with their position in the block */
+struct unorm_block {
+   int n_texels;
+   uint8_t texels[BLOCK_SIZE * BLOCK_SIZE][4];
+   uint8_t positions[BLOCK_SIZE * BLOCK_SIZE];
+};
+
+static void
+load_unorm_block(int src_width, int src_height,
+                 const uint8_t *src, int src_rowstride,
+                 struct unorm_block *block)
+{
+   int y, x;
+
+   block->n_texels = 0;
+
+   for (y = 0; y < src_height; y++) {
+      for (x = 0; x < src_width; x++) {
+         memcpy(block->texels[block->n_texels], src + x * 4, 4);
+         block->positions[block->n_texels] = y * BLOCK_SIZE + x;
+         block->n_texels++;
+      }
+      src += src_rowstride;
+   }
+}
+
+/* Finds the line through the texels that best fits them (the mean and the
+ * direction of largest variance) and returns the two ends of the segment of
+ * it that the texels project onto.
+ */
+static void
+get_principal_axis_endpoints_unorm(const struct unorm_block *block,
+                                   float endpoints[2][4])
+{
+   float mean[4] = { 0.0f }, axis[4], covariance[4][4] = { { 0.0f } };
+   float t, t_min = 0.0f, t_max = 0.0f, length;
+   int i, j, k, iteration;
+
+   for (i = 0; i < block->n_texels; i++)
+      for (j = 0; j < 4; j++)
+         mean[j] += block->texels[i][j];
+   for (j = 0; j < 4; j++)
+      mean[j] /= block->n_texels;
+
+   for (i = 0; i < block->n_texels; i++) {
+      for (j = 0; j < 4; j++) {
+         for (k = j; k < 4; k++) {
+            covariance[j][k] += (block->texels[i][j] - mean[j]) *
+                                (block->texels[i][k] - mean[k]);
+         }
+      }
+   }
+   for (j = 0; j < 4; j++)
+      for (k = 0; k < j; k++)
+         covariance[j][k] = covariance[k][j];
+
+   /* Power iteration, starting from the diagonal which is usually already
+    * close to the principal axis.
+    */
+   for (j = 0; j < 4; j++)
+      axis[j] = covariance[j][j];
+
+   for (iteration = 0; iteration < 8; iteration++) {
+      float next[4];
+
+      length = 0.0f;
+      for (j = 0; j < 4; j++) {
+         next[j] = 0.0f;
+         for (k = 0; k < 4; k++)
+            next[j] += covariance[j][k] * axis[k];
+         length = MAX2(length, fabsf(next[j]));
+      }
+
+      if (length == 0.0f)
+         break;
+
+      for (j = 0; j < 4; j++)
+         axis[j] = next[j] / length;
+   }
+
+   length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] +
+                  axis[2] * axis[2] + axis[3] * axis[3]);
+
+   if (length > 0.0f) {
+      for (j = 0; j < 4; j++)
+         axis[j] /= length;
+
+      for (i = 0; i < block->n_texels; i++) {
+         t = 0.0f;
+         for (j = 0; j < 4; j++)
+            t += (block->texels[i][j] - mean[j]) * axis[j];
+         t_min = MIN2(t_min, t);
+         t_max = MAX2(t_max, t);
+      }
+   }
+
+   for (j = 0; j < 4; j++) {
+      endpoints[0][j] = CLAMP(mean[j] + t_min * axis[j], 0.0f, 255.0f);
+      endpoints[1][j] = CLAMP(mean[j] + t_max * axis[j], 0.0f, 255.0f);
+   }
+}
+
+/* Quantizes an endpoint to the 7 bits per component and shared p-bit of
+ * mode 6, picking the p-bit that gives the smallest error.
+ */
+static void
+quantize_mode6_endpoint(const float endpoint[4],
+                        uint8_t quantized[4], int *pbit)
+{
+   float best_error = FLT_MAX;
+   int p, j;
+
+   for (p = 0; p < 2; p++) {
+      uint8_t values[4];
+      float error = 0.0f;
+
+      for (j = 0; j < 4; j++) {
+         int value = (int) ((endpoint[j] - p) / 2.0f + 0.5f);
+         float diff;
+
+         values[j] = CLAMP(value, 0, 127);
+         diff = (values[j] * 2 + p) - endpoint[j];
+         error += diff * diff;
+      }
+
+      if (error < best_error) {
+         best_error = error;
+         memcpy(quantized, values, sizeof values);
+         *pbit = p;
+      }
+   }
+}
+
+/* Picks the closest palette entry for each texel.  Only the entries next
+ * to the projection of the texel onto the line between the endpoints are
+ * tried.
+ */
+static void
+get_mode6_indices(const struct unorm_block *block,
+                  uint8_t quantized[2][4], const int pbits[2],
+                  uint8_t indices[BLOCK_SIZE * BLOCK_SIZE])
+{
+   int palette[16][4], direction[4];
+   int length_squared = 0;
+   int i, j, index;
+
+   for (index = 0; index < 16; index++) {
+      for (j = 0; j < 4; j++) {
+         palette[index][j] = interpolate(quantized[0][j] * 2 + pbits[0],
+                                         quantized[1][j] * 2 + pbits[1],
+                                         index, 4);
+      }
+   }
+
+   for (j = 0; j < 4; j++) {
+      direction[j] = palette[15][j] - palette[0][j];
+      length_squared += direction[j] * direction[j];
+   }
+
+   for (i = 0; i < block->n_texels; i++) {
+      int best_error = INT_MAX;
+      int first, last, dot = 0;
+
+      for (j = 0; j < 4; j++)
+         dot += (block->texels[i][j] - palette[0][j]) * direction[j];
+
+      if (length_squared > 0) {
+         index = CLAMP((dot * 15 + length_squared / 2) / length_squared,
+                       0, 15);
+      } else {
+         index = 0;
+      }
+
+      first = MAX2(index - 1, 0);
+      last = MIN2(index + 1, 15);
+
+      for (index = first; index <= last; index++) {
+         int error = 0;
+
+         for (j = 0; j < 4; j++) {
+            int diff = palette[index][j] - block->texels[i][j];
+            error += diff * diff;
+         }
+
+         if (error < best_error) {
+            best_error = error;
+            indices[i] = index;
+         }
+      }
+   }
+}
+
+static void
+compress_rgba_unorm_block_mode6(int src_width, int src_height,
+                                const uint8_t *src, int src_rowstride,
+                                uint8_t *dst)
+{
+   struct unorm_block block;
+   float endpoints[2][4];
+   uint8_t quantized[2][4];
+   uint8_t texel_indices[BLOCK_SIZE * BLOCK_SIZE] = { 0 };
+   uint8_t indices[BLOCK_SIZE * BLOCK_SIZE] = { 0 };
+   int pbits[2];
+   struct bit_writer writer;
+   int component, endpoint, i;
+
+   load_unorm_block(src_width, src_height, src, src_rowstride, &block);
+   get_principal_axis_endpoints_unorm(&block, endpoints);
+
+   for (endpoint = 0; endpoint < 2; endpoint++) {
+      quantize_mode6_endpoint(endpoints[endpoint],
+                              quantized[endpoint], pbits + endpoint);
+   }
+   get_mode6_indices(&block, quantized, pbits, texel_indices);
+
+   /* The most-significant bit of the first index is implicitly zero, so
+    * swap the endpoints if needed.
+    */
+   if (texel_indices[0] & 8) {
+      uint8_t temp[4];
+      int temp_pbit;
+
+      memcpy(temp, quantized[0], sizeof temp);
+      memcpy(quantized[0], quantized[1], sizeof temp);
+      memcpy(quantized[1], temp, sizeof temp);
+      temp_pbit = pbits[0];
+      pbits[0] = pbits[1];
+      pbits[1] = temp_pbit;
+
+      for (i = 0; i < block.n_texels; i++)
+         texel_indices[i] = 15 - texel_indices[i];
+   }
+
+   for (i = 0; i < block.n_texels; i++)
+      indices[block.positions[i]] = texel_indices[i];
+
+   writer.dst = dst;
+   writer.pos = 0;
+   writer.buf = 0;
+
+   write_bits(&writer, 7, 0x40); /* mode 6 */
+
+   for (component = 0; component < 4; component++)
+      for (endpoint = 0; endpoint < 2; endpoint++)
+         write_bits(&writer, 7, quantized[endpoint][component]);
+
+   for (endpoint = 0; endpoint < 2; endpoint++)
+      write_bits(&writer, 1, pbits[endpoint]);
+
+   for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++)
+      write_bits(&writer, i == 0 ? 3 : 4, indices[i]);
+}
+
 static void
 compress_rgba_unorm(int width, int height,
                     const uint8_t *src, int src_rowstride,
-                    uint8_t *dst, int dst_rowstride)
+                    uint8_t *dst, int dst_rowstride,
+                    enum bptc_quality quality)
 {
    int dst_row_diff;
    int y, x;
@@ -1468,11 +1735,19 @@ compress_rgba_unorm(int width, int height,
 
    for (y = 0; y < height; y += BLOCK_SIZE) {
       for (x = 0; x < width; x += BLOCK_SIZE) {
-         compress_rgba_unorm_block(MIN2(width - x, BLOCK_SIZE),
-                                   MIN2(height - y, BLOCK_SIZE),
-                                   src + x * 4 + y * src_rowstride,
-                                   src_rowstride,
-                                   dst);
+         if (quality == BPTC_QUALITY_FAST) {
+            compress_rgba_unorm_block(MIN2(width - x, BLOCK_SIZE),
+                                      MIN2(height - y, BLOCK_SIZE),
+                                      src + x * 4 + y * src_rowstride,
+                                      src_rowstride,
+                                      dst);
+         } else {
+            compress_rgba_unorm_block_mode6(MIN2(width - x, BLOCK_SIZE),
+                                            MIN2(height - y, BLOCK_SIZE),
+                                            src + x * 4 + y * src_rowstride,
+                                            src_rowstride,
+                                            dst);
+         }
          dst += BLOCK_BYTES;
       }
       dst += dst_row_diff;
@@ -46,6 +46,7 @@
 #include "teximage.h"
 #include "texobj.h"
 #include "texstore.h"
+#include "texstore_async.h"
 #include "format_utils.h"
 #include "pixeltransfer.h"
 
@@ -1422,6 +1423,7 @@ get_texture_image(struct gl_context *ctx,
    }
 
    _mesa_lock_texture(ctx, texObj);
+   _mesa_wait_texture_uploads(ctx, texObj, NULL);
 
    for (i = 0; i < numFaces; i++) {
       texImage = texObj->Image[firstFace + i][level];
@@ -1743,6 +1745,7 @@ get_compressed_texture_image(struct gl_context *ctx,
    }
 
    _mesa_lock_texture(ctx, texObj);
+   _mesa_wait_texture_uploads(ctx, texObj, NULL);
 
    for (i = 0; i < numFaces; i++) {
       texImage = texObj->Image[firstFace + i][level];
@@ -54,6 +54,7 @@
 #include "mtypes.h"
 #include "glformats.h"
 #include "texstore.h"
+#include "texstore_async.h"
 #include "pbo.h"
 
 
@@ -2762,6 +2763,7 @@ check_gen_mipmap(struct gl_context *ctx, GLenum target,
        level == texObj->BaseLevel &&
        level < texObj->MaxLevel) {
       assert(ctx->Driver.GenerateMipmap);
+      _mesa_wait_texture_uploads(ctx, texObj, NULL);
       ctx->Driver.GenerateMipmap(ctx, target, texObj);
    }
 }
@@ -3086,6 +3088,7 @@ teximage(struct gl_context *ctx, GLboolean compressed, GLuint dims,
             _mesa_error(ctx, GL_OUT_OF_MEMORY, "%s%uD", func, dims);
          }
          else {
+            _mesa_wait_texture_uploads(ctx, texObj, texImage);
             ctx->Driver.FreeTextureImageBuffer(ctx, texImage);
 
             _mesa_init_teximage_fields(ctx, texImage,
@@ -3284,6 +3287,7 @@ _mesa_EGLImageTargetTexture2DOES (GLenum target, GLeglImageOES image)
    if (!texImage) {
       _mesa_error(ctx, GL_OUT_OF_MEMORY, "glEGLImageTargetTexture2D");
    } else {
+      _mesa_wait_texture_uploads(ctx, texObj, texImage);
       ctx->Driver.FreeTextureImageBuffer(ctx, texImage);
 
       ctx->Driver.EGLImageTargetTexture2D(ctx, target,
@@ -3315,6 +3319,9 @@ texture_sub_image(struct gl_context *ctx, GLuint dims,
 
    _mesa_lock_texture(ctx, texObj);
    {
+      /* Earlier uploads to the same image have to be stored first. */
+      _mesa_wait_texture_uploads(ctx, texObj, texImage);
+
       if (width > 0 && height > 0 && depth > 0) {
          /* If we have a border, offset=-1 is legal.  Bias by border width. */
          switch (dims) {
@@ -3834,6 +3841,10 @@ copy_texture_sub_image(struct gl_context *ctx, GLuint dims,
 
    texImage = _mesa_select_tex_image(texObj, target, level);
 
+   /* The source may be a texture too. */
+   _mesa_wait_texture_uploads(ctx, texObj, texImage);
+   _mesa_finish_framebuffer_texture_uploads(ctx, ctx->ReadBuffer);
+
    /* If we have a border, offset=-1 is legal.  Bias by border width. */
    switch (dims) {
    case 3:
@@ -4047,6 +4058,8 @@ copyteximage(struct gl_context *ctx, GLuint dims,
          const GLuint face = _mesa_tex_target_to_face(target);
 
          /* Free old texture image */
+         _mesa_wait_texture_uploads(ctx, texObj, texImage);
+         _mesa_finish_framebuffer_texture_uploads(ctx, ctx->ReadBuffer);
          ctx->Driver.FreeTextureImageBuffer(ctx, texImage);
 
          _mesa_init_teximage_fields(ctx, texImage, width, height, 1,
@@ -4546,6 +4559,7 @@ _mesa_ClearTexSubImage(GLuint texture, GLint level,
       return;
 
    _mesa_lock_texture(ctx, texObj);
+   _mesa_wait_texture_uploads(ctx, texObj, NULL);
 
    numImages = get_tex_images_for_clear(ctx, "glClearTexSubImage",
                                         texObj, level, texImages);
@@ -4622,6 +4636,7 @@ _mesa_ClearTexImage( GLuint texture, GLint level,
       return;
 
    _mesa_lock_texture(ctx, texObj);
+   _mesa_wait_texture_uploads(ctx, texObj, NULL);
 
    numImages = get_tex_images_for_clear(ctx, "glClearTexImage",
                                         texObj, level, texImages);
@@ -4959,6 +4974,8 @@ compressed_texture_sub_image(struct gl_context *ctx, GLuint dims,
 
    _mesa_lock_texture(ctx, texObj);
    {
+      _mesa_wait_texture_uploads(ctx, texObj, texImage);
+
       if (width > 0 && height > 0 && depth > 0) {
          ctx->Driver.CompressedTexSubImage(ctx, dims, texImage,
                                            xoffset, yoffset, zoffset,
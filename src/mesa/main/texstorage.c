@@ -36,6 +36,7 @@
 #include "texobj.h"
 #include "mipmap.h"
 #include "texstorage.h"
+#include "texstore_async.h"
 #include "textureview.h"
 #include "mtypes.h"
 #include "glformats.h"
@@ -454,6 +455,8 @@ texture_storage(struct gl_context *ctx, GLuint dims,
       assert(height > 0);
       assert(depth > 0);
 
+      _mesa_wait_texture_uploads(ctx, texObj, NULL);
+
       if (!initialize_texture_fields(ctx, texObj, levels, width, height, depth,
                                      internalformat, texFormat)) {
          return;
@@ -71,6 +71,7 @@
 #include "texcompress_bptc.h"
 #include "teximage.h"
 #include "texstore.h"
+#include "texstore_async.h"
 #include "enums.h"
 #include "glformats.h"
 #include "pixeltransfer.h"
@@ -1064,6 +1065,14 @@ store_texsubimage(struct gl_context *ctx,
 
    assert(numSlices == 1 || srcImageStride != 0);
 
+   if (ctx->Const.AsyncTextureUpload &&
+       _mesa_texstore_async(ctx, dims, texImage, xoffset, yoffset,
+                            sliceOffset, width, height, numSlices,
+                            format, type, src, srcImageStride, packing)) {
+      _mesa_unmap_teximage_pbo(ctx, packing);
+      return;
+   }
+
    for (slice = 0; slice < numSlices; slice++) {
       GLubyte *dstMap;
       GLint dstRowStride;
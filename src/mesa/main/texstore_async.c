@@ -0,0 +1,369 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file texstore_async.c
+ * Asynchronous texture uploads.
+ *
+ * With the AsyncTextureUpload option, large glTex[Sub]Image uploads that
+ * need a format conversion are converted and stored by a worker thread.
+ * The user's data is copied and the destination slices are mapped on the
+ * GL thread, so only the conversion happens in the background.  The texture
+ * object counts its pending uploads, and each upload has a fence.
+ *
+ * Only the commands that access a texture wait for its uploads to finish,
+ * which is also when the slices are unmapped:
+ *  - state validation, for the textures used by the current programs and
+ *    texture units, the bound image units and the current framebuffers,
+ *  - the commands that read or write the texture images directly,
+ *  - glFlush, glFinish and unbinding or destroying the context, for all
+ *    uploads, so that other contexts see the data after synchronizing with
+ *    this one as required by the spec.
+ *
+ * Immutable textures are always uploaded synchronously, because their
+ * storage may be shared with texture views that aren't tracked here.  So
+ * are textures with bindless handles, because resident handles can be used
+ * by any command.  Creating the first handle of a texture waits for its
+ * uploads.
+ */
+
+#include "c11/threads.h"
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_queue.h"
+
+#include "format_utils.h"
+#include "formats.h"
+#include "glformats.h"
+#include "image.h"
+#include "texobj.h"
+#include "texstore.h"
+#include "texstore_async.h"
+
+/** Smaller uploads are done right away. */
+#define MIN_ASYNC_UPLOAD_SIZE (256 * 1024)
+
+/** Maximum number of worker threads. */
+#define MAX_UPLOAD_THREADS 2
+
+struct gl_texture_upload
+{
+   struct util_queue_fence fence;
+
+   /** Next pending upload of the context */
+   struct gl_texture_upload *next;
+
+   /** Referenced until the upload is finished */
+   struct gl_texture_object *texObj;
+   struct gl_texture_image *texImage;
+   GLuint sliceOffset, numSlices;
+   GLint width, height;
+
+   /** Copy of the user's data, with tightly packed rows */
+   GLubyte *src;
+   uint32_t srcFormat;
+   GLint srcRowStride;
+   size_t srcImageStride;
+
+   mesa_format dstFormat;
+   GLint dstRowStride;
+   GLubyte **dstMaps;
+
+   bool needRebase;
+   uint8_t rebaseSwizzle[4];
+};
+
+static struct util_queue upload_queue;
+static once_flag upload_queue_once = ONCE_FLAG_INIT;
+
+static void
+init_upload_queue(void)
+{
+   util_cpu_detect();
+
+   /* There's nothing to win with a single CPU. */
+   if (util_cpu_caps.nr_cpus > 1) {
+      util_queue_init(&upload_queue, "mesa_texup", 16,
+                      MIN2(util_cpu_caps.nr_cpus - 1, MAX_UPLOAD_THREADS),
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL);
+   }
+}
+
+/**
+ * Whether the upload is large and needs the conversion of texstore_rgba(),
+ * which doesn't depend on the context state.
+ */
+static bool
+can_store_async(struct gl_context *ctx,
+                const struct gl_texture_image *texImage,
+                GLenum format, GLenum type,
+                const struct gl_pixelstore_attrib *packing, uint64_t size)
+{
+   const mesa_format dstFormat = texImage->TexFormat;
+   const GLenum baseFormat = texImage->_BaseFormat;
+   const struct gl_texture_object *texObj = texImage->TexObject;
+
+   if (texObj->Immutable || texObj->HandleAllocated ||
+       size < MIN_ASYNC_UPLOAD_SIZE || size > SIZE_MAX)
+      return false;
+
+   if (_mesa_is_depth_or_stencil_format(baseFormat) ||
+       _mesa_is_format_compressed(dstFormat) ||
+       dstFormat == MESA_FORMAT_YCBCR || dstFormat == MESA_FORMAT_YCBCR_REV)
+      return false;
+
+   if (format == GL_COLOR_INDEX || type == GL_BITMAP || packing->SwapBytes)
+      return false;
+
+   if (_mesa_texstore_needs_transfer_ops(ctx, baseFormat, dstFormat))
+      return false;
+
+   /* Plain copies don't take long enough to be worth it. */
+   return !_mesa_texstore_can_use_memcpy(ctx, baseFormat, dstFormat,
+                                         format, type, packing);
+}
+
+static void
+store_upload(void *data, int thread_index)
+{
+   struct gl_texture_upload *upload = (struct gl_texture_upload *) data;
+   GLuint slice;
+
+   for (slice = 0; slice < upload->numSlices; slice++) {
+      _mesa_format_convert(upload->dstMaps[slice], upload->dstFormat,
+                           upload->dstRowStride,
+                           upload->src + slice * upload->srcImageStride,
+                           upload->srcFormat, upload->srcRowStride,
+                           upload->width, upload->height,
+                           upload->needRebase ? upload->rebaseSwizzle : NULL);
+   }
+}
+
+static void
+finish_upload(struct gl_context *ctx, struct gl_texture_upload *upload)
+{
+   GLuint slice;
+
+   util_queue_fence_wait(&upload->fence);
+   util_queue_fence_destroy(&upload->fence);
+
+   for (slice = 0; slice < upload->numSlices; slice++) {
+      ctx->Driver.UnmapTextureImage(ctx, upload->texImage,
+                                    upload->sliceOffset + slice);
+   }
+
+   p_atomic_dec(&upload->texObj->_PendingUploads);
+   _mesa_reference_texobj(&upload->texObj, NULL);
+   free(upload->src);
+   free(upload);
+}
+
+/**
+ * Queue the store of a 1D/2D slice, or of several slices, of a
+ * glTex[Sub]Image upload.  The parameters are the ones of the slice loop of
+ * store_texsubimage().
+ *
+ * \return  false if the upload has to be done synchronously.
+ */
+bool
+_mesa_texstore_async(struct gl_context *ctx, GLuint dims,
+                     struct gl_texture_image *texImage,
+                     GLint xoffset, GLint yoffset, GLuint sliceOffset,
+                     GLint width, GLint height, GLuint numSlices,
+                     GLenum format, GLenum type, const GLubyte *src,
+                     GLint srcImageStride,
+                     const struct gl_pixelstore_attrib *packing)
+{
+   const GLint bpp = _mesa_bytes_per_pixel(format, type);
+   struct gl_texture_upload *upload;
+   GLuint slice;
+   GLint row;
+
+   if (bpp <= 0 ||
+       !can_store_async(ctx, texImage, format, type, packing,
+                        (uint64_t) width * height * numSlices * bpp))
+      return false;
+
+   call_once(&upload_queue_once, init_upload_queue);
+   if (!util_queue_is_initialized(&upload_queue))
+      return false;
+
+   upload = calloc(1, sizeof(*upload) + numSlices * sizeof(GLubyte *));
+   if (!upload)
+      return false;
+
+   upload->dstMaps = (GLubyte **) (upload + 1);
+   upload->sliceOffset = sliceOffset;
+   upload->numSlices = numSlices;
+   upload->width = width;
+   upload->height = height;
+   upload->srcFormat = _mesa_format_from_format_and_type(format, type);
+   upload->srcRowStride = width * bpp;
+   upload->srcImageStride = (size_t) upload->srcRowStride * height;
+   upload->dstFormat = _mesa_get_srgb_format_linear(texImage->TexFormat);
+
+   if (_mesa_get_format_base_format(texImage->TexFormat) !=
+       texImage->_BaseFormat) {
+      upload->needRebase =
+         _mesa_compute_rgba2base2rgba_component_mapping(texImage->_BaseFormat,
+                                                        upload->rebaseSwizzle);
+   }
+
+   upload->src = malloc(upload->srcImageStride * numSlices);
+   if (!upload->src) {
+      free(upload);
+      return false;
+   }
+
+   for (slice = 0; slice < numSlices; slice++) {
+      ctx->Driver.MapTextureImage(ctx, texImage, sliceOffset + slice,
+                                  xoffset, yoffset, width, height,
+                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT,
+                                  &upload->dstMaps[slice],
+                                  &upload->dstRowStride);
+      if (!upload->dstMaps[slice]) {
+         while (slice--) {
+            ctx->Driver.UnmapTextureImage(ctx, texImage, sliceOffset + slice);
+         }
+         free(upload->src);
+         free(upload);
+         return false;
+      }
+   }
+
+   /* The user's data may change as soon as we return, so it's copied here,
+    * which is much faster than the conversion.
+    */
+   for (slice = 0; slice < numSlices; slice++) {
+      const GLubyte *srcSlice =
+         _mesa_image_address(dims, packing, src + slice * srcImageStride,
+                             width, height, format, type, 0, 0, 0);
+      const GLint srcRowStride =
+         _mesa_image_row_stride(packing, width, format, type);
+      GLubyte *dst = upload->src + slice * upload->srcImageStride;
+
+      for (row = 0; row < height; row++) {
+         memcpy(dst, srcSlice, upload->srcRowStride);
+         srcSlice += srcRowStride;
+         dst += upload->srcRowStride;
+      }
+   }
+
+   _mesa_reference_texobj(&upload->texObj, texImage->TexObject);
+   upload->texImage = texImage;
+   p_atomic_inc(&upload->texObj->_PendingUploads);
+
+   upload->next = ctx->TexUploads;
+   ctx->TexUploads = upload;
+
+   /* Make the next state validation look for the textures it has to wait
+    * for.
+    */
+   ctx->NewState |= _NEW_TEXTURE_OBJECT;
+
+   util_queue_fence_init(&upload->fence);
+   util_queue_add_job(&upload_queue, upload, &upload->fence,
+                      store_upload, NULL);
+
+   return true;
+}
+
+/**
+ * Wait for the uploads of \p texImage, or of all images of \p texObj if
+ * \p texImage is NULL, that were queued by this context.
+ */
+void
+_mesa_finish_texture_uploads(struct gl_context *ctx,
+                             struct gl_texture_object *texObj,
+                             struct gl_texture_image *texImage)
+{
+   struct gl_texture_upload **link = &ctx->TexUploads;
+
+   while (*link) {
+      struct gl_texture_upload *upload = *link;
+
+      if (upload->texObj == texObj &&
+          (!texImage || upload->texImage == texImage)) {
+         *link = upload->next;
+         finish_upload(ctx, upload);
+      } else {
+         link = &upload->next;
+      }
+   }
+}
+
+/**
+ * Wait for the uploads of the textures attached to \p fb.
+ */
+void
+_mesa_finish_framebuffer_texture_uploads(struct gl_context *ctx,
+                                         struct gl_framebuffer *fb)
+{
+   GLuint i;
+
+   if (!ctx->TexUploads || !fb)
+      return;
+
+   for (i = 0; i < BUFFER_COUNT; i++) {
+      if (fb->Attachment[i].Type == GL_TEXTURE)
+         _mesa_wait_texture_uploads(ctx, fb->Attachment[i].Texture, NULL);
+   }
+}
+
+/**
+ * Wait for the uploads of the textures that the next command may access
+ * through the current state.  Called by the state validation, once the
+ * texture units are up to date.
+ */
+void
+_mesa_finish_bound_texture_uploads(struct gl_context *ctx)
+{
+   GLint unit;
+   GLuint i;
+
+   if (!ctx->TexUploads)
+      return;
+
+   for (unit = 0; unit <= ctx->Texture._MaxEnabledTexImageUnit; unit++)
+      _mesa_wait_texture_uploads(ctx, ctx->Texture.Unit[unit]._Current, NULL);
+
+   for (i = 0; i < ctx->Const.MaxImageUnits; i++)
+      _mesa_wait_texture_uploads(ctx, ctx->ImageUnits[i].TexObj, NULL);
+
+   _mesa_finish_framebuffer_texture_uploads(ctx, ctx->DrawBuffer);
+   _mesa_finish_framebuffer_texture_uploads(ctx, ctx->ReadBuffer);
+}
+
+/**
+ * Wait for all uploads queued by this context.
+ */
+void
+_mesa_finish_all_texture_uploads(struct gl_context *ctx)
+{
+   while (ctx->TexUploads) {
+      struct gl_texture_upload *upload = ctx->TexUploads;
+
+      ctx->TexUploads = upload->next;
+      finish_upload(ctx, upload);
+   }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright © 2018 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TEXSTORE_ASYNC_H
+#define TEXSTORE_ASYNC_H
+
+#include <stdbool.h>
+
+#include "glheader.h"
+#include "mtypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool
+_mesa_texstore_async(struct gl_context *ctx, GLuint dims,
+                     struct gl_texture_image *texImage,
+                     GLint xoffset, GLint yoffset, GLuint sliceOffset,
+                     GLint width, GLint height, GLuint numSlices,
+                     GLenum format, GLenum type, const GLubyte *src,
+                     GLint srcImageStride,
+                     const struct gl_pixelstore_attrib *packing);
+
+void
+_mesa_finish_texture_uploads(struct gl_context *ctx,
+                             struct gl_texture_object *texObj,
+                             struct gl_texture_image *texImage);
+
+void
+_mesa_finish_framebuffer_texture_uploads(struct gl_context *ctx,
+                                         struct gl_framebuffer *fb);
+
+void
+_mesa_finish_bound_texture_uploads(struct gl_context *ctx);
+
+void
+_mesa_finish_all_texture_uploads(struct gl_context *ctx);
+
+/**
+ * Wait for the asynchronous uploads to \p texImage, or to any image of
+ * \p texObj if \p texImage is NULL, before the images are accessed.
+ */
+static inline void
+_mesa_wait_texture_uploads(struct gl_context *ctx,
+                           struct gl_texture_object *texObj,
+                           struct gl_texture_image *texImage)
+{
+   if (unlikely(texObj && texObj->_PendingUploads))
+      _mesa_finish_texture_uploads(ctx, texObj, texImage);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEXSTORE_ASYNC_H */
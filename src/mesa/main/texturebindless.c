@@ -30,6 +30,7 @@
 #include "shaderimage.h"
 #include "teximage.h"
 #include "texobj.h"
+#include "texstore_async.h"
 #include "texturebindless.h"
 
 #include "util/hash_table.h"
@@ -221,6 +222,11 @@ get_texture_handle(struct gl_context *ctx, struct gl_texture_object *texObj,
    struct gl_texture_handle_object *texHandleObj;
    GLuint64 handle;
 
+   /* Textures with handles are uploaded synchronously, and resident handles
+    * can be used without binding the texture.
+    */
+   _mesa_wait_texture_uploads(ctx, texObj, NULL);
+
    /* The ARB_bindless_texture spec says:
     *
     * "The handle for each texture or texture/sampler pair is unique; the same
@@ -300,6 +306,9 @@ get_image_handle(struct gl_context *ctx, struct gl_texture_object *texObj,
    struct gl_image_unit imgObj;
    GLuint64 handle;
 
+   /* See get_texture_handle(). */
+   _mesa_wait_texture_uploads(ctx, texObj, NULL);
+
    /* The ARB_bindless_texture spec says:
     *
     * "The handle returned for each combination of <texture>, <level>,
@@ -1035,6 +1035,47 @@ _mesa_flush_vertices_for_uniforms(struct gl_context *ctx,
    ctx->NewDriverState |= new_driver_state;
 }
 
+/**
+ * Record which part of each stage's parameter list a uniform update wrote,
+ * so that the driver only needs to upload that range of the constants.
+ */
+static void
+mark_driver_storage_dirty(struct gl_shader_program *shProg,
+                          const struct gl_uniform_storage *uni,
+                          unsigned offset, unsigned count)
+{
+   unsigned mask = uni->active_shader_mask;
+
+   while (mask) {
+      const int stage = u_bit_scan(&mask);
+      struct gl_linked_shader *sh = shProg->_LinkedShaders[stage];
+
+      if (!sh || !sh->Program->Parameters)
+         continue;
+
+      struct gl_program_parameter_list *params = sh->Program->Parameters;
+      const gl_constant_value *base = params->ParameterValues;
+      const gl_constant_value *end = base + params->NumParameterValues;
+
+      /* Each stage's storage is one of the driver storage entries; find the
+       * one that lives in this stage's parameter list.
+       */
+      for (unsigned s = 0; s < uni->num_driver_storage; s++) {
+         const struct gl_uniform_driver_storage *store = &uni->driver_storage[s];
+         const gl_constant_value *data = (const gl_constant_value *) store->data;
+
+         if (data < base || data >= end)
+            continue;
+
+         const unsigned stride = store->element_stride / sizeof(*data);
+         const unsigned first = (data - base) + offset * stride;
+
+         _mesa_mark_parameter_values_dirty(params, first,
+                                           first + count * stride);
+      }
+   }
+}
+
 static void
 copy_uniforms_to_storage(gl_constant_value *storage,
                          struct gl_uniform_storage *uni,
@@ -1152,6 +1193,8 @@ _mesa_uniform(GLint location, GLsizei count, const GLvoid *values,
       _mesa_propagate_uniforms_to_driver_storage(uni, offset, count);
    }
 
+   mark_driver_storage_dirty(shProg, uni, offset, count);
+
    /* If the uniform is a sampler, do the extra magic necessary to propagate
     * the changes through.
     */
@@ -1408,6 +1451,8 @@ _mesa_uniform_matrix(GLint location, GLsizei count,
 
       _mesa_propagate_uniforms_to_driver_storage(uni, offset, count);
    }
+
+   mark_driver_storage_dirty(shProg, uni, offset, count);
 }
 
 static void
@@ -1538,6 +1583,8 @@ _mesa_uniform_handle(GLint location, GLsizei count, const GLvoid *values,
       _mesa_propagate_uniforms_to_driver_storage(uni, offset, count);
    }
 
+   mark_driver_storage_dirty(shProg, uni, offset, count);
+
    if (uni->type->is_sampler()) {
       /* Mark this bindless sampler as not bound to a texture unit because
        * it refers to a texture handle.
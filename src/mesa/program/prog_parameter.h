@@ -120,6 +120,19 @@ struct gl_program_parameter_list
    gl_constant_value *ParameterValues; /**< Array [Size] of gl_constant_value */
    GLbitfield StateFlags; /**< _NEW_* flags indicating which state changes
                                might invalidate ParameterValues[] */
+
+   /**
+    * Range [DirtyStart, DirtyEnd) of ParameterValues[] written by uniform
+    * updates and state loads since the driver last consumed it.  Empty when
+    * DirtyStart >= DirtyEnd.
+    */
+   unsigned DirtyStart, DirtyEnd;
+
+   /**
+    * Set by the driver when it consumes the dirty range, so that it can tell
+    * whether someone else (e.g. another context) reset the range since.
+    */
+   unsigned DirtySerial;
 };
 
 
@@ -185,6 +198,30 @@ _mesa_lookup_parameter_index(const struct gl_program_parameter_list *paramList,
    return -1;
 }
 
+/**
+ * Grow the dirty range of \p paramList to include ParameterValues[start]
+ * up to (but not including) ParameterValues[end].
+ */
+static inline void
+_mesa_mark_parameter_values_dirty(struct gl_program_parameter_list *paramList,
+                                  unsigned start, unsigned end)
+{
+   if (end > paramList->NumParameterValues)
+      end = paramList->NumParameterValues;
+   if (start >= end)
+      return;
+
+   if (paramList->DirtyStart >= paramList->DirtyEnd) {
+      paramList->DirtyStart = start;
+      paramList->DirtyEnd = end;
+   } else {
+      if (start < paramList->DirtyStart)
+         paramList->DirtyStart = start;
+      if (end > paramList->DirtyEnd)
+         paramList->DirtyEnd = end;
+   }
+}
+
 #ifdef __cplusplus
 }
 #endif
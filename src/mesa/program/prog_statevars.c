@@ -1080,6 +1080,7 @@ _mesa_load_state_parameters(struct gl_context *ctx,
          _mesa_fetch_state(ctx,
 			   paramList->Parameters[i].StateIndexes,
                            paramList->ParameterValues + pvo);
+         _mesa_mark_parameter_values_dirty(paramList, pvo, pvo + 4);
       }
    }
 }
@@ -37,6 +37,8 @@
 #include "main/shaderapi.h"
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
+#include "util/hash_table.h"
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
 #include "util/u_upload_mgr.h"
 #include "cso_cache/cso_context.h"
@@ -48,6 +50,151 @@
 #include "st_program.h"
 #include "st_cb_bufferobjects.h"
 
+/**
+ * Constant buffer 0 of a program in one context.
+ */
+struct st_constbuf
+{
+   /** Copy of the program's parameter values */
+   struct pipe_resource *buffer;
+   /** ParameterValues and their size when the buffer was filled */
+   const void *ptr;
+   unsigned size;
+   /** gl_program_parameter_list::DirtySerial when the buffer was filled */
+   unsigned serial;
+};
+
+
+/**
+ * Upload the constants of \p prog into the program's constant buffer,
+ * writing only the range of the parameter list that changed since the
+ * buffer was last filled from it.  Each program has its own buffer, so that
+ * switching programs doesn't refill it.
+ *
+ * Returns false if the constants must be passed as a user buffer instead.
+ */
+static bool
+upload_dirty_constants(struct st_context *st, struct gl_program *prog,
+                       enum pipe_shader_type shader_type,
+                       struct pipe_constant_buffer *cb)
+{
+   /* Serials are unique across lists, and never 0 (the initial value), so
+    * a buffer filled from a freed list never looks current for a new one
+    * allocated at the same address.
+    */
+   static unsigned last_serial;
+   struct gl_program_parameter_list *params = prog->Parameters;
+   struct pipe_context *pipe = st->pipe;
+   const unsigned paramBytes = params->NumParameterValues * sizeof(GLfloat);
+   struct st_constbuf *constbuf;
+   struct hash_entry *entry;
+
+   /* Subroutine indices, bindless handles and ATI constants are rewritten
+    * on every upload without going through the dirty range.
+    */
+   if (prog->sh.NumSubroutineUniformRemapTable ||
+       prog->sh.NumBindlessSamplers || prog->sh.NumBindlessImages ||
+       (shader_type == PIPE_SHADER_FRAGMENT && st->fp->ati_fs))
+      return false;
+
+   if (!st->constbufs) {
+      st->constbufs = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                              _mesa_key_pointer_equal);
+      if (!st->constbufs)
+         return false;
+   }
+
+   entry = _mesa_hash_table_search(st->constbufs, prog);
+   if (entry) {
+      constbuf = entry->data;
+   } else {
+      constbuf = CALLOC_STRUCT(st_constbuf);
+      if (!constbuf)
+         return false;
+      _mesa_hash_table_insert(st->constbufs, prog, constbuf);
+   }
+
+   if (constbuf->buffer &&
+       constbuf->ptr == params->ParameterValues &&
+       constbuf->size == paramBytes &&
+       constbuf->serial == params->DirtySerial) {
+      if (params->DirtyStart < params->DirtyEnd) {
+         const unsigned start = params->DirtyStart * sizeof(GLfloat);
+         const unsigned end = params->DirtyEnd * sizeof(GLfloat);
+
+         pipe->buffer_subdata(pipe, constbuf->buffer,
+                              PIPE_TRANSFER_DISCARD_RANGE, start, end - start,
+                              (uint8_t *) params->ParameterValues + start);
+      }
+   } else {
+      if (!constbuf->buffer || constbuf->buffer->width0 < paramBytes) {
+         pipe_resource_reference(&constbuf->buffer, NULL);
+         constbuf->buffer = pipe_buffer_create_const0(pipe->screen,
+                                                      PIPE_BIND_CONSTANT_BUFFER,
+                                                      PIPE_USAGE_DYNAMIC,
+                                                      MAX2(paramBytes, 256));
+         if (!constbuf->buffer)
+            return false;
+      }
+
+      pipe->buffer_subdata(pipe, constbuf->buffer,
+                           PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE,
+                           0, paramBytes, params->ParameterValues);
+   }
+
+   params->DirtyStart = params->DirtyEnd = 0;
+   params->DirtySerial = p_atomic_inc_return(&last_serial);
+   constbuf->ptr = params->ParameterValues;
+   constbuf->size = paramBytes;
+   constbuf->serial = params->DirtySerial;
+
+   cb->buffer = constbuf->buffer;
+   cb->user_buffer = NULL;
+   return true;
+}
+
+
+static void
+destroy_constbuf(struct hash_entry *entry)
+{
+   struct st_constbuf *constbuf = entry->data;
+
+   pipe_resource_reference(&constbuf->buffer, NULL);
+   free(constbuf);
+}
+
+
+/**
+ * Free the constant buffer of a program that is being deleted.
+ *
+ * Only the current context's buffer is freed.  Other contexts sharing the
+ * program keep theirs until they are destroyed; a program allocated at the
+ * same address later only reuses the memory, since its serial won't match.
+ */
+void
+st_release_constbuf(struct st_context *st, struct gl_program *prog)
+{
+   struct hash_entry *entry;
+
+   if (!st->constbufs)
+      return;
+
+   entry = _mesa_hash_table_search(st->constbufs, prog);
+   if (entry) {
+      destroy_constbuf(entry);
+      _mesa_hash_table_remove(st->constbufs, entry);
+   }
+}
+
+
+void
+st_destroy_constbufs(struct st_context *st)
+{
+   _mesa_hash_table_destroy(st->constbufs, destroy_constbuf);
+   st->constbufs = NULL;
+}
+
+
 /**
  * Pass the given program parameters to the graphics pipe as a
  * constant buffer.
@@ -109,6 +256,9 @@ st_upload_constants(struct st_context *st, struct gl_program *prog)
       cb.buffer_offset = 0;
       cb.buffer_size = paramBytes;
 
+      if (st->has_constbuf0_partial_updates)
+         upload_dirty_constants(st, prog, shader_type, &cb);
+
       if (ST_DEBUG & DEBUG_CONSTANTS) {
          debug_printf("%s(shader=%d, numParams=%d, stateFlags=0x%x)\n",
                       __func__, shader_type, params->NumParameters,
@@ -117,7 +267,6 @@ st_upload_constants(struct st_context *st, struct gl_program *prog)
       }
 
       cso_set_constant_buffer(st->cso_context, shader_type, 0, &cb);
-      pipe_resource_reference(&cb.buffer, NULL);
 
       st->state.constants[shader_type].ptr = params->ParameterValues;
       st->state.constants[shader_type].size = paramBytes;
@@ -37,5 +37,9 @@ struct st_context;
 
 void st_upload_constants(struct st_context *st, struct gl_program *prog);
 
+void st_release_constbuf(struct st_context *st, struct gl_program *prog);
+
+void st_destroy_constbufs(struct st_context *st);
+
 
 #endif /* ST_ATOM_CONSTBUF_H */
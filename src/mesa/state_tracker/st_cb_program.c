@@ -40,6 +40,7 @@
 #include "cso_cache/cso_context.h"
 #include "draw/draw_context.h"
 
+#include "st_atom_constbuf.h"
 #include "st_context.h"
 #include "st_debug.h"
 #include "st_program.h"
@@ -144,6 +145,8 @@ st_delete_program(struct gl_context *ctx, struct gl_program *prog)
       assert(0); /* problem */
    }
 
+   st_release_constbuf(st, prog);
+
    /* delete base class */
    _mesa_delete_program( ctx, prog );
 }
@@ -69,6 +69,7 @@
 #include "st_cb_texturebarrier.h"
 #include "st_cb_viewport.h"
 #include "st_atom.h"
+#include "st_atom_constbuf.h"
 #include "st_draw.h"
 #include "st_extensions.h"
 #include "st_gen_mipmap.h"
@@ -273,6 +274,8 @@ st_destroy_context_priv(struct st_context *st, bool destroy_pipe)
                                 &st->state.frag_sampler_views[i]);
    }
 
+   st_destroy_constbufs(st);
+
    /* free glReadPixels cache data */
    st_invalidate_readpix_cache(st);
    util_throttle_deinit(st->pipe->screen, &st->throttle);
@@ -462,6 +465,8 @@ st_create_context_priv(struct gl_context *ctx, struct pipe_context *pipe,
       screen->get_param(screen, PIPE_CAP_TGSI_PACK_HALF_FLOAT);
    st->has_multi_draw_indirect =
       screen->get_param(screen, PIPE_CAP_MULTI_DRAW_INDIRECT);
+   st->has_constbuf0_partial_updates =
+      screen->get_param(screen, PIPE_CAP_CONSTBUF0_PARTIAL_UPDATES);
 
    st->has_hw_atomics =
       screen->get_shader_param(screen, PIPE_SHADER_FRAGMENT,
@@ -128,6 +128,13 @@ struct st_context
    boolean has_half_float_packing;
    boolean has_multi_draw_indirect;
    boolean can_bind_const_buffer_as_vertex;
+   boolean has_constbuf0_partial_updates;
+
+   /**
+    * Constant buffer 0 of each program, for drivers that take partial
+    * updates.  Maps struct gl_program to struct st_constbuf.
+    */
+   struct hash_table *constbufs;
 
    /**
     * If a shader can be created when we get its source.
@@ -1037,6 +1037,8 @@ void st_init_extensions(struct pipe_screen *screen,
 
    consts->AllowHigherCompatVersion = options->allow_higher_compat_version;
 
+   consts->AsyncTextureUpload = options->mesa_async_texture_upload;
+
    consts->ForceGLSLAbsSqrt = options->force_glsl_abs_sqrt;
 
    consts->AllowGLSLBuiltinVariableRedeclaration = options->allow_glsl_builtin_variable_redeclaration;
@@ -75,6 +75,17 @@ struct vbo_save_vertex_list {
    GLuint prim_count;
 
    struct vbo_save_primitive_store *prim_store;
+
+   /* The primitives above, converted at compile time into a single list of
+    * indexed points, lines or triangles that reference each distinct vertex
+    * once.  ib.obj is NULL if the primitives couldn't be converted.
+    */
+   struct {
+      struct _mesa_prim prim;
+      struct _mesa_index_buffer ib;
+      GLuint min_index, max_index;
+      bool has_diagonals;   /**< built from quads or polygons */
+   } merged;
 };
 
 
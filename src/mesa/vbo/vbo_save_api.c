@@ -82,6 +82,7 @@ USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "main/state.h"
 #include "main/varray.h"
 #include "util/bitscan.h"
+#include "util/hash_table.h"
 
 #include "vbo_noop.h"
 #include "vbo_private.h"
@@ -412,6 +413,284 @@ convert_line_loop_to_strip(struct vbo_save_context *save,
 }
 
 
+/**
+ * Return the independent primitive type that a primitive of the given mode
+ * decomposes into, or GL_NONE if it can't be part of a merged draw.
+ */
+static GLenum
+merged_prim_mode(GLenum mode)
+{
+   switch (mode) {
+   case GL_POINTS:
+      return GL_POINTS;
+   case GL_LINES:
+   case GL_LINE_STRIP:
+   case GL_LINE_LOOP:
+      return GL_LINES;
+   case GL_TRIANGLES:
+   case GL_TRIANGLE_STRIP:
+   case GL_TRIANGLE_FAN:
+   case GL_QUADS:
+   case GL_QUAD_STRIP:
+   case GL_POLYGON:
+      return GL_TRIANGLES;
+   default:
+      return GL_NONE;
+   }
+}
+
+
+/**
+ * Return the number of indices needed to draw a primitive as independent
+ * points, lines or triangles.
+ */
+static GLuint
+merged_index_count(const struct _mesa_prim *prim)
+{
+   const GLuint n = prim->count;
+
+   switch (prim->mode) {
+   case GL_POINTS:
+      return n;
+   case GL_LINES:
+      return n & ~1u;
+   case GL_LINE_STRIP:
+      return n >= 2 ? 2 * (n - 1) : 0;
+   case GL_LINE_LOOP:
+      return n >= 2 ? 2 * n : 0;
+   case GL_TRIANGLES:
+      return n - n % 3;
+   case GL_TRIANGLE_STRIP:
+   case GL_TRIANGLE_FAN:
+   case GL_POLYGON:
+      return n >= 3 ? 3 * (n - 2) : 0;
+   case GL_QUADS:
+      return (n / 4) * 6;
+   case GL_QUAD_STRIP:
+      return n >= 4 ? ((n - 2) / 2) * 6 : 0;
+   default:
+      unreachable("Unexpected primitive type");
+   }
+}
+
+
+/**
+ * Return the index of the first vertex in the list that is identical to
+ * vertex \p v, adding \p v to the table if there is none.
+ */
+static GLuint
+dedup_vertex(const fi_type *buffer, GLuint vertex_size,
+             GLuint *table, GLuint mask, GLuint v)
+{
+   const fi_type *vert = buffer + v * vertex_size;
+   const size_t size = vertex_size * sizeof(fi_type);
+   GLuint slot = _mesa_hash_data(vert, size) & mask;
+
+   /* Entries hold the vertex index plus one, zero means empty. */
+   while (table[slot]) {
+      const GLuint other = table[slot] - 1;
+
+      if (memcmp(buffer + other * vertex_size, vert, size) == 0)
+         return other;
+      slot = (slot + 1) & mask;
+   }
+
+   table[slot] = v + 1;
+   return v;
+}
+
+
+/**
+ * Convert the primitives of a vertex list into a single indexed draw of
+ * independent points, lines or triangles, so that replaying a list made of
+ * many small glBegin/glEnd pairs costs one draw call.  Identical vertices
+ * share an index.
+ *
+ * The triangles are emitted so that each keeps the provoking vertex it had
+ * with the last vertex convention, and the winding of the original
+ * primitive.  Playback only uses the merged draw when the result can't be
+ * told apart from drawing the original primitives.
+ */
+static void
+compile_merged_draw(struct gl_context *ctx, struct vbo_save_vertex_list *node,
+                    GLuint start_offset)
+{
+   struct vbo_save_context *save = &vbo_context(ctx)->save;
+   const GLuint vertex_size = save->vertex_size;
+   GLenum mode = GL_NONE;
+   GLuint count = 0;
+   bool has_diagonals = false;
+
+   memset(&node->merged, 0, sizeof(node->merged));
+
+   /* A single primitive is already a single draw, and edge flags are only
+    * meaningful for the original polygons.
+    */
+   if (node->prim_count < 2 || !vertex_size ||
+       (save->enabled & BITFIELD64_BIT(VBO_ATTRIB_EDGEFLAG)))
+      return;
+
+   for (GLuint i = 0; i < node->prim_count; i++) {
+      const struct _mesa_prim *prim = &node->prims[i];
+      const GLenum prim_mode = merged_prim_mode(prim->mode);
+
+      if (prim_mode == GL_NONE || (mode != GL_NONE && prim_mode != mode) ||
+          prim->start + prim->count > node->vertex_count)
+         return;
+
+      /* Closing a line loop that wraps into another list is done by the
+       * driver from the begin/end flags.
+       */
+      if (prim->mode == GL_LINE_LOOP && (!prim->begin || !prim->end))
+         return;
+
+      mode = prim_mode;
+      count += merged_index_count(prim);
+      has_diagonals |= prim->mode == GL_QUADS ||
+                       prim->mode == GL_QUAD_STRIP ||
+                       prim->mode == GL_POLYGON;
+   }
+
+   if (!count)
+      return;
+
+   GLuint table_size = 1;
+   while (table_size < 2 * node->vertex_count)
+      table_size <<= 1;
+
+   GLuint *table = calloc(table_size, sizeof(GLuint));
+   GLuint *remap = malloc(node->vertex_count * sizeof(GLuint));
+   GLuint *indices = malloc(count * sizeof(GLuint));
+   if (!table || !remap || !indices) {
+      free(table);
+      free(remap);
+      free(indices);
+      return;
+   }
+
+   for (GLuint v = 0; v < node->vertex_count; v++) {
+      remap[v] = dedup_vertex(save->buffer_map, vertex_size,
+                              table, table_size - 1, v);
+   }
+   free(table);
+
+   GLuint *out = indices;
+   GLuint min_index = ~0u, max_index = 0;
+
+   for (GLuint i = 0; i < node->prim_count; i++) {
+      const struct _mesa_prim *prim = &node->prims[i];
+      const GLuint n = prim->count;
+      GLuint *first = out;
+      GLuint k;
+
+#define V(k) remap[prim->start + (k)]
+#define EMIT2(a, b) do { *out++ = V(a); *out++ = V(b); } while (0)
+#define EMIT3(a, b, c) do { EMIT2(a, b); *out++ = V(c); } while (0)
+
+      switch (prim->mode) {
+      case GL_POINTS:
+         for (k = 0; k < n; k++)
+            *out++ = V(k);
+         break;
+      case GL_LINES:
+         for (k = 0; k + 1 < n; k += 2)
+            EMIT2(k, k + 1);
+         break;
+      case GL_LINE_STRIP:
+      case GL_LINE_LOOP:
+         for (k = 0; k + 1 < n; k++)
+            EMIT2(k, k + 1);
+         if (prim->mode == GL_LINE_LOOP && n >= 2)
+            EMIT2(n - 1, 0);
+         break;
+      case GL_TRIANGLES:
+         for (k = 0; k + 2 < n; k += 3)
+            EMIT3(k, k + 1, k + 2);
+         break;
+      case GL_TRIANGLE_STRIP:
+         for (k = 0; k + 2 < n; k++) {
+            if (k & 1)
+               EMIT3(k + 1, k, k + 2);
+            else
+               EMIT3(k, k + 1, k + 2);
+         }
+         break;
+      case GL_TRIANGLE_FAN:
+         for (k = 1; k + 1 < n; k++)
+            EMIT3(0, k, k + 1);
+         break;
+      case GL_POLYGON:
+         /* The provoking vertex of a polygon is its first one. */
+         for (k = 1; k + 1 < n; k++)
+            EMIT3(k, k + 1, 0);
+         break;
+      case GL_QUADS:
+         for (k = 0; k + 3 < n; k += 4) {
+            EMIT3(k, k + 1, k + 3);
+            EMIT3(k + 1, k + 2, k + 3);
+         }
+         break;
+      case GL_QUAD_STRIP:
+         for (k = 0; k + 3 < n; k += 2) {
+            EMIT3(k, k + 1, k + 3);
+            EMIT3(k + 2, k, k + 3);
+         }
+         break;
+      }
+
+#undef EMIT3
+#undef EMIT2
+#undef V
+
+      assert(out - first == merged_index_count(prim));
+
+      for (; first < out; first++) {
+         *first += start_offset;
+         min_index = MIN2(min_index, *first);
+         max_index = MAX2(max_index, *first);
+      }
+   }
+
+   free(remap);
+
+   /* Narrow the indices in place when they fit in 16 bits. */
+   unsigned index_size = sizeof(GLuint);
+   if (max_index <= 0xffff) {
+      GLushort *indices16 = (GLushort *) indices;
+
+      for (GLuint i = 0; i < count; i++)
+         indices16[i] = indices[i];
+      index_size = sizeof(GLushort);
+   }
+
+   struct gl_buffer_object *obj = ctx->Driver.NewBufferObject(ctx, VBO_BUF_ID);
+   if (obj &&
+       !ctx->Driver.BufferData(ctx, GL_ELEMENT_ARRAY_BUFFER_ARB,
+                               count * index_size, indices,
+                               GL_STATIC_DRAW_ARB, GL_MAP_WRITE_BIT |
+                               GL_DYNAMIC_STORAGE_BIT, obj))
+      _mesa_reference_buffer_object(ctx, &obj, NULL);
+
+   free(indices);
+
+   if (!obj)
+      return;
+
+   node->merged.prim.mode = mode;
+   node->merged.prim.indexed = 1;
+   node->merged.prim.begin = 1;
+   node->merged.prim.end = 1;
+   node->merged.prim.count = count;
+   node->merged.prim.num_instances = 1;
+   node->merged.ib.count = count;
+   node->merged.ib.index_size = index_size;
+   node->merged.ib.obj = obj;
+   node->merged.min_index = min_index;
+   node->merged.max_index = max_index;
+   node->merged.has_diagonals = has_diagonals;
+}
+
+
 /* Compare the present vao if it has the same setup. */
 static bool
 compare_vao(gl_vertex_processing_mode mode,
@@ -644,6 +923,8 @@ compile_vertex_list(struct gl_context *ctx)
 
    merge_prims(node->prims, &node->prim_count);
 
+   compile_merged_draw(ctx, node, start_offset);
+
    /* Correct the primitive starts, we can only do this here as copy_vertices
     * and convert_line_loop_to_strip above consume the uncorrected starts.
     * On the other hand the _vbo_loopback_vertex_list call below needs the
@@ -1812,6 +2093,8 @@ vbo_destroy_vertex_list(struct gl_context *ctx, void *data)
    for (gl_vertex_processing_mode vpm = VP_MODE_FF; vpm < VP_MODE_MAX; ++vpm)
       _mesa_reference_vao(ctx, &node->VAO[vpm], NULL);
 
+   _mesa_reference_buffer_object(ctx, &node->merged.ib.obj, NULL);
+
    if (--node->prim_store->refcount == 0)
       free(node->prim_store);
 
@@ -1844,6 +2127,13 @@ vbo_print_vertex_list(struct gl_context *ctx, void *data, FILE *f)
              (prim->begin) ? "BEGIN" : "(wrap)",
              (prim->end) ? "END" : "(wrap)");
    }
+
+   if (node->merged.ib.obj) {
+      fprintf(f, "   merged: %s, %u indices, %u..%u\n",
+              _mesa_lookup_prim_by_nr(node->merged.prim.mode),
+              node->merged.ib.count, node->merged.min_index,
+              node->merged.max_index);
+   }
 }
 
 
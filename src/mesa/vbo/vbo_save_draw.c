@@ -35,6 +35,7 @@
 #include "main/macros.h"
 #include "main/light.h"
 #include "main/state.h"
+#include "main/transformfeedback.h"
 #include "main/varray.h"
 #include "util/bitscan.h"
 
@@ -144,6 +145,57 @@ loopback_vertex_list(struct gl_context *ctx,
 }
 
 
+/**
+ * Whether drawing the merged, indexed primitive of the list gives the same
+ * result as drawing its original primitives with the current state.
+ */
+static bool
+can_draw_merged(struct gl_context *ctx,
+                const struct vbo_save_vertex_list *node)
+{
+   if (!node->merged.ib.obj)
+      return false;
+
+   /* Feedback and selection report the primitives as they were drawn:
+    * merged quads and polygons would come back as triangles.
+    */
+   if (ctx->RenderMode != GL_RENDER)
+      return false;
+
+   /* The diagonals of quads and polygons would show up as edges. */
+   if (node->merged.has_diagonals &&
+       (ctx->Polygon.FrontMode != GL_FILL || ctx->Polygon.BackMode != GL_FILL))
+      return false;
+
+   /* The conversion only keeps the last vertex convention's provoking
+    * vertex, and the stipple pattern restarts with each independent line.
+    */
+   if (ctx->Light.ProvokingVertex != GL_LAST_VERTEX_CONVENTION_EXT ||
+       (node->merged.prim.mode == GL_LINES && ctx->Line.StippleFlag))
+      return false;
+
+   /* Primitive IDs and the order of captured vertices depend on the
+    * original primitives.
+    */
+   if (_mesa_is_xfb_active_and_unpaused(ctx) ||
+       ctx->_Shader->CurrentProgram[MESA_SHADER_GEOMETRY] ||
+       ctx->_Shader->CurrentProgram[MESA_SHADER_TESS_EVAL] ||
+       (ctx->FragmentProgram._Current &&
+        (ctx->FragmentProgram._Current->info.system_values_read &
+         BITFIELD64_BIT(SYSTEM_VALUE_PRIMITIVE_ID))))
+      return false;
+
+   /* Duplicate vertices were folded together, which renumbers them. */
+   if (ctx->VertexProgram._Current &&
+       (ctx->VertexProgram._Current->info.system_values_read &
+        (BITFIELD64_BIT(SYSTEM_VALUE_VERTEX_ID) |
+         BITFIELD64_BIT(SYSTEM_VALUE_VERTEX_ID_ZERO_BASE))))
+      return false;
+
+   return true;
+}
+
+
 /**
  * Execute the buffer and save copied verts.
  * This is called from the display list code when executing
@@ -209,7 +261,12 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
 
       assert(ctx->NewState == 0);
 
-      if (node->vertex_count > 0) {
+      if (can_draw_merged(ctx, node)) {
+         ctx->Driver.Draw(ctx, &node->merged.prim, 1, &node->merged.ib,
+                          GL_TRUE, node->merged.min_index,
+                          node->merged.max_index, NULL, 0, NULL);
+      }
+      else if (node->vertex_count > 0) {
          GLuint min_index = _vbo_save_get_min_index(node);
          GLuint max_index = _vbo_save_get_max_index(node);
          ctx->Driver.Draw(ctx, node->prims, node->prim_count, NULL, GL_TRUE,
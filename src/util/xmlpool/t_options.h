@@ -220,6 +220,11 @@ DRI_CONF_OPT_BEGIN_B(mesa_no_error, def) \
         DRI_CONF_DESC(en,gettext("Disable GL driver error checking")) \
 DRI_CONF_OPT_END
 
+#define DRI_CONF_MESA_ASYNC_TEXTURE_UPLOAD(def) \
+DRI_CONF_OPT_BEGIN_B(mesa_async_texture_upload, def) \
+        DRI_CONF_DESC(en,gettext("Convert large texture uploads on a separate thread")) \
+DRI_CONF_OPT_END
+
 #define DRI_CONF_DISABLE_EXT_BUFFER_AGE(def) \
 DRI_CONF_OPT_BEGIN_B(glx_disable_ext_buffer_age, def) \
    DRI_CONF_DESC(en, gettext("Disable the GLX_EXT_buffer_age extension")) \